@@ -0,0 +1,488 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "libsve4_decode/decoder.h"
+#include "libsve4_decode/error.h"
+#include "libsve4_decode/frame.h"
+#include "libsve4_log/error.h"
+#include "libsve4_log/init.h"
+#include "libsve4_utils/allocator.h"
+#include "libsve4_utils/buffer.h"
+#include "libsve4_utils/stats_allocator.h"
+
+#ifdef _WIN32
+#include <windows.h>
+// windows.h must come first
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// DECODE BENCHMARK
+//
+// Opens every case, decodes it from start to end and closes it, a few times,
+// then prints one JSON object per case to stdout (see print_result()). The
+// default cases use the media created by `make bench` in assets/generated,
+// media given on the command line replace them.
+//
+// Allocations are counted through the decoder and frame allocators, so memory
+// FFmpeg and libwebp allocate on their own is only visible in the peak RSS.
+// The peak RSS is the high-water mark of the whole process, pass a single
+// file to measure one case in isolation.
+
+#define BENCH_DIR SVE4_ROOT_DIR "/assets/generated/benchmark/"
+#define NS_PER_SEC 1000000000LL
+
+enum {
+  DEFAULT_RUNS = 5,
+  DEFAULT_WARMUP_RUNS = 1,
+  MAX_DECODERS = 16,
+  KIB = 1024,
+};
+
+typedef struct {
+  const char* _Nonnull path;
+  sve4_decode_decoder_backend_t backend;
+  // decoders sharing a demuxer, each of them decodes the whole video stream
+  size_t num_decoders;
+} bench_case_t;
+
+static const bench_case_t default_cases[] = {
+    {BENCH_DIR "320x240_h264.mkv", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 1},
+    {BENCH_DIR "1280x720_h264.mkv", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 1},
+    {BENCH_DIR "1280x720_h264.mkv", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 4},
+    {BENCH_DIR "1920x1080_h264.mkv", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 1},
+    {BENCH_DIR "1920x1080_h264.mkv", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 4},
+    {BENCH_DIR "1920x1080_hevc.mkv", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 1},
+    {BENCH_DIR "1280x720_vp9.webm", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 1},
+    {BENCH_DIR "3840x2160_h264.mkv", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 1},
+    {BENCH_DIR "640x480_anim.webp", SVE4_DECODE_DECODER_BACKEND_LIBWEBP, 1},
+    {BENCH_DIR "640x480_anim.webp", SVE4_DECODE_DECODER_BACKEND_FFMPEG, 1},
+};
+
+typedef struct {
+  size_t runs, warmup_runs;
+  sve4_decode_decoder_backend_t backend;
+  size_t num_decoders;
+} bench_options_t;
+
+typedef struct {
+  size_t frames;
+  size_t width, height;
+  int64_t open_ns, decode_ns;
+} bench_run_t;
+
+typedef struct {
+  sve4_decode_error_t err;
+  size_t frames;
+  size_t width, height;
+  // means over the measured runs
+  double open_ns;
+  double allocs_per_frame, alloc_bytes_per_frame;
+  // over the measured runs
+  int64_t median_ns_per_frame, min_ns_per_frame;
+  size_t peak_alloc_bytes;
+  long peak_rss_kib;
+} bench_result_t;
+
+static int64_t now_ns(void) {
+#ifdef _WIN32
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  return (int64_t)(counter.QuadPart / frequency.QuadPart * NS_PER_SEC +
+                   counter.QuadPart % frequency.QuadPart * NS_PER_SEC /
+                       frequency.QuadPart);
+#else
+  struct timespec timestamp;
+  clock_gettime(CLOCK_MONOTONIC, &timestamp);
+  return (int64_t)timestamp.tv_sec * NS_PER_SEC + timestamp.tv_nsec;
+#endif
+}
+
+// -1 if unknown
+static long peak_rss_kib(void) {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters;
+  if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters))
+    return -1;
+  return (long)(counters.PeakWorkingSetSize / KIB);
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  // bytes instead of kilobytes
+  return usage.ru_maxrss / KIB;
+#else
+  return usage.ru_maxrss;
+#endif
+#endif
+}
+
+static bool is_default_error(sve4_decode_error_t err,
+                             sve4_decode_error_default_t code) {
+  return err.source == SVE4_DECODE_ERROR_SRC_DEFAULT &&
+         err.error_code == (int32_t)code;
+}
+
+static sve4_decode_error_t run_once(const bench_case_t* _Nonnull bench_case,
+                                    sve4_allocator_t* _Nonnull allocator,
+                                    sve4_allocator_t* _Nonnull frame_allocator,
+                                    bench_run_t* _Nonnull run) {
+  sve4_decode_decoder_t decoders[MAX_DECODERS] = {0};
+  bool done[MAX_DECODERS] = {0};
+  sve4_buffer_ref_t demuxer = NULL;
+  sve4_decode_error_t err = sve4_decode_success;
+  size_t num_open = 0;
+  *run = (bench_run_t){0};
+
+  int64_t start = now_ns();
+  for (; num_open < bench_case->num_decoders; ++num_open) {
+    sve4_decode_decoder_config_t config = {
+        .url = bench_case->path,
+        .backend = bench_case->backend,
+        .allocator = allocator,
+        .frame_allocator = frame_allocator,
+        .demuxer = sve4_buffer_ref(demuxer),
+    };
+    err = sve4_decode_decoder_open(&decoders[num_open], &config);
+    if (!sve4_decode_error_is_success(err)) {
+      // only taken over on success
+      sve4_buffer_free(&config.demuxer);
+      goto done;
+    }
+    if (!demuxer)
+      demuxer = sve4_decode_decoder_get_demuxer(&decoders[num_open]);
+  }
+  run->open_ns = now_ns() - start;
+
+  // round-robin, so that no decoder waits for packets the others have not
+  // consumed yet
+  start = now_ns();
+  for (size_t num_done = 0; num_done < num_open;) {
+    for (size_t i = 0; i < num_open; ++i) {
+      if (done[i])
+        continue;
+      sve4_decode_frame_t frame = {0};
+      err = sve4_decode_decoder_get_frame(&decoders[i], &frame, NULL);
+      if (is_default_error(err, SVE4_DECODE_ERROR_DEFAULT_EOF)) {
+        done[i] = true;
+        ++num_done;
+        continue;
+      }
+      if (!sve4_decode_error_is_success(err))
+        goto done;
+      run->width = frame.width;
+      run->height = frame.height;
+      ++run->frames;
+      sve4_decode_frame_free(&frame);
+    }
+  }
+  run->decode_ns = now_ns() - start;
+  err = sve4_decode_success;
+
+done:
+  for (size_t i = 0; i < num_open; ++i)
+    sve4_decode_decoder_close(&decoders[i]);
+  return err;
+}
+
+static int compare_i64(const void* _Nonnull lhs, const void* _Nonnull rhs) {
+  int64_t a = *(const int64_t*)lhs;
+  int64_t b = *(const int64_t*)rhs;
+  return (a > b) - (a < b);
+}
+
+static size_t total_allocs(const sve4_allocator_stats_t stats[2]) {
+  return stats[0].num_allocs + stats[0].num_grows + stats[1].num_allocs +
+         stats[1].num_grows;
+}
+
+static size_t total_alloc_bytes(const sve4_allocator_stats_t stats[2]) {
+  return stats[0].total_bytes + stats[1].total_bytes;
+}
+
+static void get_stats(sve4_allocator_t allocators[2],
+                      sve4_allocator_stats_t stats[2]) {
+  stats[0] = sve4_allocator_stats_get(&allocators[0]);
+  stats[1] = sve4_allocator_stats_get(&allocators[1]);
+}
+
+static bench_result_t run_case(const bench_case_t* _Nonnull bench_case,
+                               const bench_options_t* _Nonnull options) {
+  bench_result_t result = {
+      .err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY),
+      .peak_rss_kib = -1,
+  };
+  sve4_allocator_t allocators[2];
+  int64_t* ns_per_frame = calloc(options->runs, sizeof *ns_per_frame);
+  if (!ns_per_frame)
+    return result;
+  if (!sve4_allocator_stats_init(&allocators[0], NULL, "decoder"))
+    goto fail_decoder_allocator;
+  if (!sve4_allocator_stats_init(&allocators[1], NULL, "frames"))
+    goto fail_frame_allocator;
+  result.err = sve4_decode_success;
+
+  bench_run_t run;
+  for (size_t i = 0; i < options->warmup_runs; ++i) {
+    result.err = run_once(bench_case, &allocators[0], &allocators[1], &run);
+    if (!sve4_decode_error_is_success(result.err))
+      goto done;
+  }
+
+  sve4_allocator_stats_t before[2];
+  sve4_allocator_stats_t after[2];
+  get_stats(allocators, before);
+  for (size_t i = 0; i < options->runs; ++i) {
+    result.err = run_once(bench_case, &allocators[0], &allocators[1], &run);
+    if (!sve4_decode_error_is_success(result.err))
+      goto done;
+    if (run.frames == 0) {
+      result.err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_EOF);
+      goto done;
+    }
+    ns_per_frame[i] = run.decode_ns / (int64_t)run.frames;
+    result.open_ns += (double)run.open_ns;
+  }
+  get_stats(allocators, after);
+
+  result.frames = run.frames;
+  result.width = run.width;
+  result.height = run.height;
+  result.open_ns /= (double)options->runs;
+  double num_frames = (double)run.frames * (double)options->runs;
+  result.allocs_per_frame =
+      (double)(total_allocs(after) - total_allocs(before)) / num_frames;
+  result.alloc_bytes_per_frame =
+      (double)(total_alloc_bytes(after) - total_alloc_bytes(before)) /
+      num_frames;
+  result.peak_alloc_bytes = after[0].peak_bytes + after[1].peak_bytes;
+  qsort(ns_per_frame, options->runs, sizeof *ns_per_frame, compare_i64);
+  result.min_ns_per_frame = ns_per_frame[0];
+  result.median_ns_per_frame = ns_per_frame[options->runs / 2];
+  result.peak_rss_kib = peak_rss_kib();
+
+done:
+  sve4_allocator_stats_destroy(&allocators[1]);
+fail_frame_allocator:
+  sve4_allocator_stats_destroy(&allocators[0]);
+fail_decoder_allocator:
+  free(ns_per_frame);
+  return result;
+}
+
+static const char* _Nonnull backend_name(
+    sve4_decode_decoder_backend_t backend) {
+  switch (backend) {
+  case SVE4_DECODE_DECODER_BACKEND_AUTO:
+    return "AUTO";
+  case SVE4_DECODE_DECODER_BACKEND_LIBWEBP:
+    return "LIBWEBP";
+  case SVE4_DECODE_DECODER_BACKEND_FFMPEG:
+    return "FFMPEG";
+  }
+  return "UNKNOWN";
+}
+
+static bool parse_backend(const char* _Nonnull name,
+                          sve4_decode_decoder_backend_t* _Nonnull backend) {
+  static const sve4_decode_decoder_backend_t backends[] = {
+      SVE4_DECODE_DECODER_BACKEND_AUTO,
+      SVE4_DECODE_DECODER_BACKEND_LIBWEBP,
+      SVE4_DECODE_DECODER_BACKEND_FFMPEG,
+  };
+  for (size_t i = 0; i < sizeof backends / sizeof backends[0]; ++i) {
+    if (strcmp(name, backend_name(backends[i])) == 0) {
+      *backend = backends[i];
+      return true;
+    }
+  }
+  return false;
+}
+
+static void print_json_string(FILE* _Nonnull out, const char* _Nonnull str) {
+  fputc('"', out);
+  for (; *str; ++str) {
+    unsigned char c = (unsigned char)*str;
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if (c < ' ')
+      fprintf(out, "\\u%04x", c);
+    else
+      fputc(c, out);
+  }
+  fputc('"', out);
+}
+
+// one object per case. frames counts the frames of all decoders in one run,
+// times are in nanoseconds and the *_ns_per_frame fields are over the
+// measured runs. cases whose backend is not built in are "unavailable", failed
+// cases only have the error fields instead.
+static void print_result(FILE* _Nonnull out,
+                         const bench_case_t* _Nonnull bench_case,
+                         const bench_result_t* _Nonnull result) {
+  fputs("    {\"media\": ", out);
+  print_json_string(out, bench_case->path);
+  fprintf(out, ", \"backend\": \"%s\", \"decoders\": %zu, ",
+          backend_name(bench_case->backend), bench_case->num_decoders);
+  if (is_default_error(result->err,
+                       SVE4_DECODE_ERROR_DEFAULT_BACKEND_MISSING)) {
+    fputs("\"status\": \"unavailable\"}", out);
+    return;
+  }
+  if (!sve4_decode_error_is_success(result->err)) {
+    fprintf(out,
+            "\"status\": \"error\", \"error_source\": %d, "
+            "\"error_code\": %" PRId32 "}",
+            (int)result->err.source, result->err.error_code);
+    return;
+  }
+
+  double median = (double)result->median_ns_per_frame;
+  fprintf(out,
+          "\"status\": \"ok\", \"width\": %zu, \"height\": %zu, "
+          "\"frames\": %zu, \"open_ns\": %.0f, "
+          "\"median_ns_per_frame\": %" PRId64 ", "
+          "\"min_ns_per_frame\": %" PRId64 ", \"frames_per_sec\": %.2f, "
+          "\"allocs_per_frame\": %.2f, \"alloc_bytes_per_frame\": %.0f, "
+          "\"peak_alloc_bytes\": %zu, \"peak_rss_kib\": %ld}",
+          result->width, result->height, result->frames, result->open_ns,
+          result->median_ns_per_frame, result->min_ns_per_frame,
+          median > 0 ? (double)NS_PER_SEC / median : 0.0,
+          result->allocs_per_frame, result->alloc_bytes_per_frame,
+          result->peak_alloc_bytes, result->peak_rss_kib);
+}
+
+static void usage(const char* _Nonnull name) {
+  fprintf(stderr,
+          "usage: %s [options] [media...]\n"
+          "  -r <runs>      measured runs per case (default %d)\n"
+          "  -w <runs>      warmup runs per case (default %d)\n"
+          "  -b <backend>   AUTO, LIBWEBP or FFMPEG, for the given media\n"
+          "                 (default AUTO)\n"
+          "  -d <decoders>  decoders sharing a demuxer, for the given media\n"
+          "                 (default 1)\n"
+          "  -o <file>      writes the JSON there instead of stdout\n",
+          name, DEFAULT_RUNS, DEFAULT_WARMUP_RUNS);
+}
+
+static bool parse_size(const char* _Nullable str, size_t min, size_t max,
+                       size_t* _Nonnull value) {
+  if (!str)
+    return false;
+  char* end = NULL;
+  unsigned long long parsed = strtoull(str, &end, 10);
+  if (end == str || *end || parsed < min || parsed > max)
+    return false;
+  *value = (size_t)parsed;
+  return true;
+}
+
+static bool add_log(void) {
+  if (sve4_log_init(NULL) != SVE4_LOG_ERROR_SUCCESS)
+    return false;
+  // stdout is for the results
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_WARNING,
+      .id_mapping = sve4_log_id_mapping_default(),
+      .path_shorten =
+          {
+              .max_length = SVE4_LOG_SHORTEN_PATH_MAX_LENGTH,
+              .root_prefix = SVE4_ROOT_DIR,
+          },
+  };
+  return sve4_log_to_stderr(&config.callback, false) ==
+             SVE4_LOG_ERROR_SUCCESS &&
+         sve4_log_add_config(&config, NULL) == SVE4_LOG_ERROR_SUCCESS;
+}
+
+int main(int argc, char* argv[]) {
+  bench_options_t options = {
+      .runs = DEFAULT_RUNS,
+      .warmup_runs = DEFAULT_WARMUP_RUNS,
+      .backend = SVE4_DECODE_DECODER_BACKEND_AUTO,
+      .num_decoders = 1,
+  };
+  const char* output = NULL;
+  int first_media = 1;
+  for (; first_media < argc && argv[first_media][0] == '-'; ++first_media) {
+    const char* flag = argv[first_media];
+    const char* value = first_media + 1 < argc ? argv[++first_media] : NULL;
+    bool ok = strlen(flag) == 2;
+    if (ok && flag[1] == 'r')
+      ok = parse_size(value, 1, SIZE_MAX / sizeof(int64_t), &options.runs);
+    else if (ok && flag[1] == 'w')
+      ok = parse_size(value, 0, SIZE_MAX, &options.warmup_runs);
+    else if (ok && flag[1] == 'd')
+      ok = parse_size(value, 1, MAX_DECODERS, &options.num_decoders);
+    else if (ok && flag[1] == 'b')
+      ok = value && parse_backend(value, &options.backend);
+    else if (ok && flag[1] == 'o')
+      ok = (output = value) != NULL;
+    else
+      ok = false;
+    if (!ok) {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  FILE* out = output ? fopen(output, "w") : stdout;
+  if (!out) {
+    perror(output);
+    return 1;
+  }
+  if (!add_log()) {
+    fprintf(stderr, "unable to initialize logging\n");
+    if (out != stdout)
+      fclose(out);
+    return 1;
+  }
+
+  size_t num_cases = first_media < argc ? (size_t)(argc - first_media)
+                                        : sizeof default_cases /
+                                              sizeof default_cases[0];
+  fprintf(out, "{\n  \"runs\": %zu,\n  \"warmup_runs\": %zu,\n",
+          options.runs, options.warmup_runs);
+  fputs("  \"results\": [\n", out);
+  bool failed = false;
+  for (size_t i = 0; i < num_cases; ++i) {
+    bench_case_t bench_case = first_media < argc
+                                  ? (bench_case_t){
+                                        .path = argv[first_media + (int)i],
+                                        .backend = options.backend,
+                                        .num_decoders = options.num_decoders,
+                                    }
+                                  : default_cases[i];
+    fprintf(stderr, "%s (%s, %zu decoder(s))\n", bench_case.path,
+            backend_name(bench_case.backend), bench_case.num_decoders);
+    bench_result_t result = run_case(&bench_case, &options);
+    if (is_default_error(result.err,
+                         SVE4_DECODE_ERROR_DEFAULT_BACKEND_MISSING)) {
+      fputs("  backend not available\n", stderr);
+    } else if (!sve4_decode_error_is_success(result.err)) {
+      failed = true;
+      fprintf(stderr, "  failed: source=%d, code=%" PRId32 "\n",
+              (int)result.err.source, result.err.error_code);
+    }
+    print_result(out, &bench_case, &result);
+    fputs(i + 1 < num_cases ? ",\n" : "\n", out);
+  }
+  fputs("  ]\n}\n", out);
+
+  sve4_log_destroy();
+  if (out != stdout && fclose(out) != 0) {
+    perror(output);
+    return 1;
+  }
+  return failed ? 1 : 0;
+}
@@ -117,6 +117,9 @@ sve4_decode_error_t
 sve4_decode_decoder_open(sve4_decode_decoder_t* _Nonnull decoder,
                          const sve4_decode_decoder_config_t* _Nonnull config) {
   decoder->demuxer = NULL;
+  decoder->get_frame = NULL;
+  decoder->seek = NULL;
+  decoder->get_subtitles = NULL;
   switch (decoder->backend = sve4_decode_select_backend(config)) {
   case SVE4_DECODE_DECODER_BACKEND_AUTO:
     sve4_panic("*_AUTO returned from sve4_decode_select_backend. This should "
@@ -165,6 +168,16 @@ sve4_decode_decoder_seek(sve4_decode_decoder_t* _Nonnull decoder, int64_t pos) {
   return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_UNIMPLEMENTED);
 }
 
+sve4_decode_error_t sve4_decode_decoder_get_subtitles(
+    sve4_decode_decoder_t* _Nonnull decoder, int64_t pts,
+    const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues,
+    size_t* _Nonnull nb_cues, const struct timespec* _Nullable deadline) {
+  assert(decoder && nb_cues);
+  if (decoder->get_subtitles)
+    return decoder->get_subtitles(decoder, pts, cues, nb_cues, deadline);
+  return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_UNIMPLEMENTED);
+}
+
 void sve4_decode_decoder_close(sve4_decode_decoder_t* decoder) {
   if (!decoder)
     return;
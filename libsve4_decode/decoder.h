@@ -7,7 +7,9 @@
 
 #include "libsve4_decode/error.h"
 #include "libsve4_decode/frame.h"
+#include "libsve4_decode/subtitle.h"
 #include "libsve4_utils/buffer.h"
+#include "libsve4_utils/buffer_pool.h"
 
 #ifdef SVE4_DECODE_HAVE_FFMPEG
 #include <libavcodec/avcodec.h>
@@ -31,6 +33,10 @@ typedef struct sve4_decode_decoder_t {
       const struct timespec* _Nullable deadline);
   sve4_decode_error_t (*_Nullable seek)(
       struct sve4_decode_decoder_t* _Nonnull decoder, int64_t pos);
+  sve4_decode_error_t (*_Nullable get_subtitles)(
+      struct sve4_decode_decoder_t* _Nonnull decoder, int64_t pts,
+      const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues,
+      size_t* _Nonnull nb_cues, const struct timespec* _Nullable deadline);
 } sve4_decode_decoder_t;
 
 typedef enum {
@@ -77,8 +83,18 @@ size_t sve4_decode_stream_choose(
 typedef struct {
   const char* _Nonnull url;
   sve4_decode_decoder_backend_t backend;
+  // used as is: to measure the decoder, wrap this and frame_allocator in
+  // stats allocators (see libsve4_utils/stats_allocator.h)
   sve4_allocator_t* _Nullable allocator;
+  // allocates decoded frames, which are large enough to benefit from the large
+  // object allocator (see libsve4_utils/large_allocator.h). FFmpeg frames
+  // only need small headers, taken from sve4_allocator_pool_shared() if NULL.
   sve4_allocator_t* _Nullable frame_allocator;
+  // if set, frames allocated by the decoder are taken from (and recycled
+  // into) this pool instead of frame_allocator. only backends that allocate
+  // frames themselves (libwebp) use it: FFmpeg decodes into buffers of its
+  // own per-codec pool and hands them out as external buffers.
+  sve4_buffer_pool_t* _Nullable frame_pool;
   sve4_decode_stream_chooser_t stream_chooser;
   sve4_buffer_ref_t _Nullable demuxer;
   size_t packet_queue_initial_capacity; // only useful for multi-decoder setups
@@ -139,6 +155,21 @@ SVE4_DECODE_EXPORT
 sve4_decode_error_t
 sve4_decode_decoder_seek(sve4_decode_decoder_t* _Nonnull decoder, int64_t pos);
 
+// Looks up the subtitle cues displayed at pts (in nanoseconds). On input
+// *nb_cues is the capacity of cues, on output it is the number of active cues,
+// which can be larger than the capacity. Only subtitle streams support this;
+// their cues are decoded in the background once the decoder is opened, and
+// this waits until that is done (or deadline passes). Subtitles of inputs that
+// cannot be read twice (pipes, network streams) are decoded along with the
+// demuxer they share with other decoders instead: this never waits then, and
+// only knows the cues read so far. Cues stay valid until the decoder is
+// closed.
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_decoder_get_subtitles(
+    sve4_decode_decoder_t* _Nonnull decoder, int64_t pts,
+    const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues,
+    size_t* _Nonnull nb_cues, const struct timespec* _Nullable deadline);
+
 SVE4_DECODE_EXPORT
 void sve4_decode_decoder_close(sve4_decode_decoder_t* _Nullable decoder);
 
@@ -1,8 +1,10 @@
 #include "ffmpeg.h"
 
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 #include <time.h>
 
 #include "libsve4_decode/ffmpeg_decoder.h"
@@ -16,8 +18,10 @@
 #include <libavcodec/codec_id.h>
 #include <libavcodec/codec_par.h>
 #include <libavformat/avformat.h>
+#include <libavformat/avio.h>
 
 #include "ffmpeg_packet_queue.h"
+#include "ffmpeg_subtitle.h"
 #include "frame.h"
 
 // NOLINTNEXTLINE(misc-include-cleaner)
@@ -55,6 +59,116 @@ static sve4_decode_error_t ffmpeg_seek(sve4_decode_decoder_t* decoder,
   return sve4_decode_ffmpeg_decoder_inner_seek(inner_decoder, pos);
 }
 
+static void subtitle_decoder_destructor(char* mem) {
+  sve4_decode_ffmpeg_subtitle_decoder_t* decoder =
+      (sve4_decode_ffmpeg_subtitle_decoder_t*)(void*)mem;
+  sve4_decode_ffmpeg_close_subtitle_decoder_inner(decoder);
+}
+
+static sve4_decode_error_t
+ffmpeg_get_subtitles(sve4_decode_decoder_t* _Nonnull decoder, int64_t pts,
+                     const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues,
+                     size_t* _Nonnull nb_cues,
+                     const struct timespec* _Nullable deadline) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  sve4_decode_ffmpeg_subtitle_decoder_t* inner_decoder =
+      (sve4_decode_ffmpeg_subtitle_decoder_t*)sve4_buffer_get_data(
+          decoder->data);
+#pragma GCC diagnostic pop
+  return sve4_decode_ffmpeg_subtitle_decoder_inner_get_cues(
+      inner_decoder, pts, cues, nb_cues, deadline);
+}
+
+static sve4_decode_error_t ffmpeg_subtitle_seek(sve4_decode_decoder_t* decoder,
+                                                int64_t pos) {
+  // cues are looked up by timestamp, there is no read position to move
+  (void)decoder;
+  (void)pos;
+  return sve4_decode_success;
+}
+
+// reading the input a second time is only cheap (and only possible) for
+// local files: pipes would lose data and network streams would be downloaded
+// twice
+static bool can_reopen(sve4_buffer_ref_t _Nonnull demuxer_ref,
+                       const sve4_decode_decoder_config_t* _Nonnull config) {
+  sve4_decode_ffmpeg_demuxer_t* demuxer =
+      (sve4_decode_ffmpeg_demuxer_t*)sve4_buffer_get_data(demuxer_ref);
+  const AVFormatContext* ctx = demuxer->ctx;
+  if (!config->url || (ctx->flags & AVFMT_FLAG_CUSTOM_IO) || !ctx->pb ||
+      !(ctx->pb->seekable & AVIO_SEEKABLE_NORMAL))
+    return false;
+  const char* protocol = avio_find_protocol_name(config->url);
+  return protocol && strcmp(protocol, "file") == 0;
+}
+
+// demuxer is the demuxer the stream was chosen from: either config->demuxer or
+// one opened just for this decoder
+static sve4_decode_error_t
+open_subtitle_decoder(sve4_decode_decoder_t* _Nonnull decoder,
+                      sve4_buffer_ref_t _Nonnull demuxer, size_t stream_index,
+                      const sve4_decode_decoder_config_t* _Nonnull config) {
+  sve4_decode_error_t err;
+  sve4_buffer_ref_t shared_demuxer = NULL;
+  // handed over to the inner decoder
+  sve4_buffer_ref_t inner_demuxer = demuxer;
+  bool streaming = false;
+  if (demuxer == config->demuxer) {
+    shared_demuxer = demuxer;
+    streaming = true;
+    if (can_reopen(demuxer, config)) {
+      sve4_log_debug("ffmpeg: opening private demuxer for subtitle stream %zu",
+                     stream_index);
+      err = sve4_decode_ffmpeg_open_demuxer(&inner_demuxer, config);
+      if (sve4_decode_error_is_success(err))
+        streaming = false;
+      else
+        sve4_log_warn("ffmpeg: failed to open private demuxer for subtitle "
+                      "stream %zu, streaming it from the shared demuxer",
+                      stream_index);
+    }
+    // a streaming decoder holds its own reference through its reader
+    if (streaming)
+      inner_demuxer = sve4_buffer_ref(demuxer);
+  }
+
+  sve4_buffer_ref_t inner_decoder_ref =
+      sve4_buffer_create(config->allocator,
+                         sizeof(sve4_decode_ffmpeg_subtitle_decoder_t), NULL);
+  if (!inner_decoder_ref) {
+    // never the reference of config->demuxer, so always ours to free
+    sve4_buffer_free(&inner_demuxer);
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+  }
+
+  sve4_decode_ffmpeg_subtitle_decoder_t* inner_decoder =
+      (sve4_decode_ffmpeg_subtitle_decoder_t*)sve4_buffer_get_data(
+          inner_decoder_ref);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  err = sve4_decode_ffmpeg_open_subtitle_decoder_inner(
+      inner_decoder, inner_demuxer, stream_index, streaming, config);
+#pragma GCC diagnostic pop
+  if (!sve4_decode_error_is_success(err)) {
+    sve4_buffer_free(&inner_decoder_ref);
+    return err;
+  }
+  // the inner decoder cleans up after itself on failure, so the destructor is
+  // only installed once it is fully open
+  inner_decoder_ref->destructor = subtitle_decoder_destructor;
+  inner_decoder->shared_demuxer = shared_demuxer;
+
+  // only a demuxer that was passed in is shared, a private one is read by
+  // the background thread
+  decoder->demuxer = shared_demuxer;
+  decoder->data = inner_decoder_ref;
+  decoder->get_frame = NULL;
+  decoder->seek = ffmpeg_subtitle_seek;
+  decoder->get_subtitles = ffmpeg_get_subtitles;
+  return sve4_decode_success;
+}
+
 sve4_decode_error_t
 sve4_decode_ffmpeg_open_decoder(sve4_decode_decoder_t* decoder,
                                 const sve4_decode_decoder_config_t* config) {
@@ -76,7 +190,8 @@ sve4_decode_ffmpeg_open_decoder(sve4_decode_decoder_t* decoder,
   }
 
   inner_decoder_ref = sve4_buffer_create(
-      NULL, sizeof(sve4_decode_ffmpeg_decoder_t), inner_decoder_destructor);
+      config->allocator, sizeof(sve4_decode_ffmpeg_decoder_t),
+      inner_decoder_destructor);
   if (!inner_decoder_ref) {
     err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
     goto fail;
@@ -99,7 +214,7 @@ sve4_decode_ffmpeg_open_decoder(sve4_decode_decoder_t* decoder,
                  nb_streams);
   size_t stream_index = sve4_decode_stream_choose(
       decoder, &config->stream_chooser, streams, nb_streams);
-  if (stream_index > nb_streams) {
+  if (stream_index >= nb_streams) {
     sve4_log_error(
         "ffmpeg: user returns invalid stream index %zu (nb_streams=%zu)",
         stream_index, nb_streams);
@@ -107,10 +222,17 @@ sve4_decode_ffmpeg_open_decoder(sve4_decode_decoder_t* decoder,
     goto fail;
   }
 
+  bool is_subtitle =
+      streams[stream_index].type == SVE4_DECODE_MEDIA_TYPE_SUBTITLE;
   sve4_free(config->allocator, streams);
   streams = NULL;
 
   sve4_log_debug("ffmpeg: selected stream index %zu", stream_index);
+  if (is_subtitle) {
+    sve4_buffer_free(&inner_decoder_ref);
+    return open_subtitle_decoder(decoder, demuxer, stream_index, config);
+  }
+
   err = sve4_decode_ffmpeg_open_decoder_inner(inner_decoder, demuxer,
                                               stream_index, config);
   if (!sve4_decode_error_is_success(err))
@@ -139,29 +261,13 @@ static const AVCodec* _Nullable pick_codec(
   return codec;
 }
 
-sve4_decode_error_t sve4_decode_ffmpeg_open_decoder_inner(
-    sve4_decode_ffmpeg_decoder_t* _Nonnull decoder,
-    sve4_buffer_ref_t _Nonnull demuxer_ref, size_t stream_index,
+sve4_decode_error_t sve4_decode_ffmpeg_open_codec_context(
+    AVCodecContext* _Nullable* _Nonnull ctx,
+    const AVCodecParameters* _Nonnull codecpar, size_t stream_index,
     const sve4_decode_decoder_config_t* _Nonnull config) {
-  decoder->ctx = NULL;
-  decoder->demuxer = demuxer_ref;
-  decoder->stream_index = stream_index;
-  decoder->last_packet_idx = SIZE_MAX;
-  decoder->packet_queue_initial_capacity =
-      config->packet_queue_initial_capacity
-          ? config->packet_queue_initial_capacity
-          // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
-          : 8;
-  decoder->frame_allocator = config->frame_allocator;
-
   sve4_decode_error_t err;
-  sve4_decode_ffmpeg_demuxer_t* demuxer =
-      (sve4_decode_ffmpeg_demuxer_t*)sve4_buffer_get_data(demuxer_ref);
-
-  const AVCodec* codec =
-      config->avcodec_open2
-          ? config->avcodec_open2->codec
-          : pick_codec(config, demuxer->ctx->streams[stream_index]->codecpar);
+  const AVCodec* codec = config->avcodec_open2 ? config->avcodec_open2->codec
+                                               : pick_codec(config, codecpar);
   if (!codec) {
     sve4_log_error("ffmpeg: failed to find codec for stream index %zu",
                    stream_index);
@@ -170,34 +276,63 @@ sve4_decode_error_t sve4_decode_ffmpeg_open_decoder_inner(
   }
 
   sve4_log_debug("ffmpeg: picked codec %s", codec->name);
-  if (!(decoder->ctx = avcodec_alloc_context3(codec))) {
+  if (!(*ctx = avcodec_alloc_context3(codec))) {
     err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
     goto fail;
   }
 
-  sve4_log_debug(
-      "ffmpeg: setting codec parameters for decoder %p (AVCodecContext* %p)",
-      (void*)decoder, (void*)decoder->ctx);
-  err = sve4_decode_defaulterr(avcodec_parameters_to_context(
-      decoder->ctx, demuxer->ctx->streams[stream_index]->codecpar));
+  sve4_log_debug("ffmpeg: setting codec parameters for AVCodecContext* %p",
+                 (void*)*ctx);
+  err = sve4_decode_defaulterr(avcodec_parameters_to_context(*ctx, codecpar));
   if (!sve4_decode_error_is_success(err))
     goto fail;
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
   if (config->setup_codec_context && config->setup_codec_context->setup)
-    config->setup_codec_context->setup(decoder->ctx,
+    config->setup_codec_context->setup(*ctx,
                                        config->setup_codec_context->user_ptr);
 #pragma GCC diagnostic pop
 
-  sve4_log_debug("ffmpeg: opening codec context for decoder %p",
-                 (void*)decoder);
+  sve4_log_debug("ffmpeg: opening AVCodecContext* %p", (void*)*ctx);
   err = sve4_decode_defaulterr(avcodec_open2(
-      decoder->ctx, codec,
+      *ctx, codec,
       config->avcodec_open2 ? config->avcodec_open2->options : NULL));
   if (!sve4_decode_error_is_success(err))
     goto fail;
 
+  return sve4_decode_success;
+
+fail:
+  avcodec_free_context(ctx);
+  return err;
+}
+
+sve4_decode_error_t sve4_decode_ffmpeg_open_decoder_inner(
+    sve4_decode_ffmpeg_decoder_t* _Nonnull decoder,
+    sve4_buffer_ref_t _Nonnull demuxer_ref, size_t stream_index,
+    const sve4_decode_decoder_config_t* _Nonnull config) {
+  decoder->ctx = NULL;
+  decoder->demuxer = demuxer_ref;
+  decoder->stream_index = stream_index;
+  decoder->last_packet_idx = SIZE_MAX;
+  decoder->packet_queue_initial_capacity =
+      config->packet_queue_initial_capacity
+          ? config->packet_queue_initial_capacity
+          // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+          : 8;
+  decoder->frame_allocator = config->frame_allocator;
+
+  sve4_decode_error_t err;
+  sve4_decode_ffmpeg_demuxer_t* demuxer =
+      (sve4_decode_ffmpeg_demuxer_t*)sve4_buffer_get_data(demuxer_ref);
+
+  err = sve4_decode_ffmpeg_open_codec_context(
+      &decoder->ctx, demuxer->ctx->streams[stream_index]->codecpar,
+      stream_index, config);
+  if (!sve4_decode_error_is_success(err))
+    goto fail;
+
   err = sve4_decode_ffmpeg_demuxer_add_decoder(demuxer, decoder);
   if (!sve4_decode_error_is_success(err))
     goto fail;
@@ -2,7 +2,6 @@
 
 #include <stddef.h>
 #include <stdint.h>
-#include <string.h>
 #include <time.h>
 
 #include "libsve4_decode/ffmpeg_demuxer.h"
@@ -12,6 +11,7 @@
 #include "libsve4_utils/allocator.h"
 #include "libsve4_utils/buffer.h"
 #include "libsve4_utils/formats.h"
+#include "libsve4_utils/pool.h"
 
 #include <libavcodec/avcodec.h>
 #include <libavcodec/packet.h>
@@ -30,15 +30,9 @@ sve4_decode_error_t sve4_decode_ffmpeg_decoder_inner_init_packet_queue(
                                        decoder->packet_queue_initial_capacity);
 }
 
-// buffer is structured like this, but this is not standard:
-// typedef struct {
-//   sve4_decode_ram_frame_t frame;
-//   AVFrame* av_frame;
-// } av_ram_frame_t;
-
-static void av_frame_destructor(char* mem) {
-  AVFrame* av_frame = NULL;
-  memcpy(&av_frame, mem + sizeof(sve4_decode_ram_frame_t), sizeof(av_frame));
+static void release_av_frame(void* _Nullable opaque, void* _Nullable data) {
+  (void)data;
+  AVFrame* av_frame = opaque;
   sve4_log_debug("ffmpeg: freeing AVFrame %p backing ram frame",
                  (void*)av_frame);
   av_frame_free(&av_frame);
@@ -59,11 +53,39 @@ static void convert_pts(AVFrame* frame, int64_t orig_time_base_num,
   frame->duration = av_rescale(frame->duration, num, den);
 }
 
+// wraps the memory backing the planes of av_frame, taking ownership of
+// av_frame on success. frames backed by a single AVBufferRef (e.g. hardware
+// frames) are unwrapped into that reference. otherwise the buffer spans
+// buf[0] and keeps the whole frame alive, so that its pointer and size always
+// describe pixel memory.
+static sve4_buffer_ref_t _Nullable wrap_av_frame(
+    sve4_allocator_t* _Nullable allocator, AVFrame* _Nonnull av_frame) {
+  AVBufferRef* first = av_frame->buf[0];
+  if (first && !av_frame->buf[1] && !av_frame->nb_extended_buf) {
+    sve4_buffer_ref_t buffer = sve4_buffer_from_av_buffer(allocator, first);
+    if (buffer) {
+      // the planes stay valid through the reference taken over
+      av_frame->buf[0] = NULL;
+      av_frame_free(&av_frame);
+    }
+    return buffer;
+  }
+
+  return sve4_buffer_create_external(
+      allocator, first ? first->data : NULL, first ? (size_t)first->size : 0,
+      release_av_frame, av_frame);
+}
+
+// takes ownership of av_frame, whose planes are referenced instead of copied
 static sve4_decode_error_t
 map_frame_to_sve4_frame(AVFrame* _Nonnull av_frame,
                         sve4_decode_frame_t* _Nonnull frame,
-                        sve4_allocator_t* frame_allocator) {
+                        sve4_allocator_t* _Nullable frame_allocator) {
   sve4_decode_frame_free(frame);
+  // the planes belong to FFmpeg, only two small headers are allocated per
+  // frame here
+  if (!frame_allocator)
+    frame_allocator = sve4_allocator_pool_shared();
 
   frame->kind = SVE4_DECODE_FRAME_KIND_RAM_FRAME;
   frame->format = (sve4_fmt_t){
@@ -78,22 +100,34 @@ map_frame_to_sve4_frame(AVFrame* _Nonnull av_frame,
   frame->width = (size_t)av_frame->width;
   frame->height = (size_t)av_frame->height;
 
-  frame->buffer = sve4_buffer_create(
-      frame_allocator, sizeof(sve4_decode_ram_frame_t) + sizeof(AVFrame*),
-      av_frame_destructor);
+  // av_frame may be gone once wrapped
+  uint8_t* data[SVE4_DECODE_RAM_FRAME_MAX_PLANES];
+  size_t linesizes[SVE4_DECODE_RAM_FRAME_MAX_PLANES];
+  for (size_t i = 0; i < SVE4_DECODE_RAM_FRAME_MAX_PLANES; ++i) {
+    data[i] = av_frame->data[i];
+    linesizes[i] = (size_t)av_frame->linesize[i];
+  }
+
+  sve4_buffer_ref_t parent = wrap_av_frame(frame_allocator, av_frame);
+  if (!parent) {
+    av_frame_free(&av_frame);
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+  }
+
+  // the view holds the only reference to parent, so the planes live exactly
+  // as long as the frame does
+  frame->buffer = sve4_decode_ram_frame_create_view(frame_allocator, parent);
+  sve4_buffer_unref(parent);
   if (!frame->buffer)
     return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
-  char* mem = sve4_buffer_get_data(frame->buffer);
+  sve4_decode_ram_frame_t* ram_frame = sve4_buffer_get_data(frame->buffer);
 #pragma GCC diagnostic pop
-  memcpy(mem + sizeof(sve4_decode_ram_frame_t), &av_frame, sizeof(AVFrame*));
-
-  sve4_decode_ram_frame_t* ram_frame = (sve4_decode_ram_frame_t*)(void*)mem;
   for (size_t i = 0; i < SVE4_DECODE_RAM_FRAME_MAX_PLANES; ++i) {
-    ram_frame->data[i] = av_frame->data[i];
-    ram_frame->linesizes[i] = (size_t)av_frame->linesize[i];
+    ram_frame->data[i] = data[i];
+    ram_frame->linesizes[i] = linesizes[i];
   }
 
   return sve4_decode_success;
@@ -109,8 +143,9 @@ sve4_decode_error_t sve4_decode_ffmpeg_decoder_inner_get_frame(
     err = sve4_decode_ffmpegerr(avcodec_receive_frame(decoder->ctx, av_frame));
     // NOLINTNEXTLINE(misc-include-cleaner)
     if (err.error_code == AVERROR(EAGAIN)) {
-      sve4_log_debug("ffmpeg: decoder %p needs more packets to produce a frame",
-                     (void*)decoder);
+      sve4_log_debug_ratelimited(
+          "ffmpeg: decoder %p needs more packets to produce a frame",
+          (void*)decoder);
       // read a packet
       AVPacket* packet = NULL;
       err = sve4_decode_ffmpeg_demuxer_read_packet(decoder->demuxer, decoder,
@@ -137,15 +172,13 @@ sve4_decode_error_t sve4_decode_ffmpeg_decoder_inner_get_frame(
     convert_pts(av_frame, decoder->ctx->time_base.num,
                 decoder->ctx->time_base.den);
 
+    sve4_log_debug("ffmpeg: mapping AVFrame* %p to sve4_decode_frame_t %p",
+                   (void*)av_frame, (void*)frame);
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
-    err = map_frame_to_sve4_frame(av_frame, frame, decoder->frame_allocator);
+    // av_frame is owned by frame now, or freed already on failure
+    return map_frame_to_sve4_frame(av_frame, frame, decoder->frame_allocator);
 #pragma GCC diagnostic pop
-    if (!sve4_decode_error_is_success(err))
-      goto fail;
-    sve4_log_debug("ffmpeg: mapped AVFrame* %p to sve4_decode_frame_t %p",
-                   (void*)av_frame, (void*)frame);
-    return sve4_decode_success;
   }
 
 fail:
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "sve4_decode_export.h"
 
 #include "libsve4_decode/decoder.h"
@@ -21,8 +23,19 @@ typedef struct sve4_decode_ffmpeg_decoder_t {
   sve4_ffmpeg_packet_queue_t packet_queue;
   size_t last_packet_idx;
   sve4_allocator_t* _Nullable frame_allocator;
+  // set before opening for streams with few packets (subtitles): their queue
+  // is empty most of the time and must neither make the demuxer read ahead of
+  // the other streams nor make it wait for room
+  bool sparse;
 } sve4_decode_ffmpeg_decoder_t;
 
+// picks (unless overridden by config) and opens a codec for the given stream
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_ffmpeg_open_codec_context(
+    AVCodecContext* _Nullable* _Nonnull ctx,
+    const AVCodecParameters* _Nonnull codecpar, size_t stream_index,
+    const sve4_decode_decoder_config_t* _Nonnull config);
+
 SVE4_DECODE_EXPORT
 sve4_decode_error_t sve4_decode_ffmpeg_open_decoder_inner(
     sve4_decode_ffmpeg_decoder_t* _Nonnull decoder,
@@ -49,7 +49,8 @@ sve4_decode_error_t sve4_decode_ffmpeg_open_demuxer(
     sve4_buffer_ref_t* _Nonnull demuxer_ref,
     const sve4_decode_decoder_config_t* _Nonnull config) {
   sve4_decode_error_t err;
-  *demuxer_ref = sve4_buffer_create(NULL, sizeof(sve4_decode_ffmpeg_demuxer_t),
+  *demuxer_ref = sve4_buffer_create(config->allocator,
+                                    sizeof(sve4_decode_ffmpeg_demuxer_t),
                                     demuxer_destructor);
   if (!*demuxer_ref) {
     err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
@@ -101,7 +102,6 @@ static sve4_decode_error_t
 init_thread_demuxer(sve4_decode_ffmpeg_demuxer_t* demuxer) {
   if (demuxer->use_thread)
     return sve4_decode_success;
-  demuxer->use_thread = true;
   sve4_log_debug("ffmpeg: initializing demuxer thread for demuxer %p",
                  (void*)demuxer);
   atomic_store(&demuxer->running, true);
@@ -111,6 +111,8 @@ init_thread_demuxer(sve4_decode_ffmpeg_demuxer_t* demuxer) {
     return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_THREADS);
   }
 
+  // only a running thread is joined by the destructor
+  demuxer->use_thread = true;
   return sve4_decode_success;
 }
 
@@ -167,8 +169,9 @@ sve4_decode_ffmpeg_demuxer_add_decoder(sve4_decode_ffmpeg_demuxer_t* demuxer,
   }
 
   sve4_decode_ffmpeg_decoder_t* first_decoder = demuxer->first_decoder;
-  if (first_decoder) {
-    if (first_decoder == demuxer->last_decoder) {
+  if (first_decoder || decoder->sparse) {
+    if (first_decoder && first_decoder == demuxer->last_decoder &&
+        !first_decoder->packet_queue.queue) {
       sve4_log_debug("ffmpeg: demuxer is already attached to a decoder, "
                      "initializing packet queue for this decoder %p",
                      (void*)first_decoder);
@@ -185,6 +188,16 @@ sve4_decode_ffmpeg_demuxer_add_decoder(sve4_decode_ffmpeg_demuxer_t* demuxer,
       goto ret;
   }
 
+  // sparse decoders never read on their own, the packets of their stream are
+  // always routed to them by the demuxer thread
+  if (decoder->sparse) {
+    err = init_thread_demuxer(demuxer);
+    if (!sve4_decode_error_is_success(err))
+      goto ret;
+  }
+
+  decoder->prev = demuxer->last_decoder;
+  decoder->next = NULL;
   demuxer->last_decoder ? (demuxer->last_decoder->next = decoder)
                         : (demuxer->first_decoder = decoder);
   demuxer->last_decoder = decoder;
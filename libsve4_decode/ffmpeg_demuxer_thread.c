@@ -63,6 +63,8 @@ static bool needs_force_push(thread_ctx_t* ctx) {
   bool empty = false;
   for (sve4_decode_ffmpeg_decoder_t* decoder = ctx->demuxer->first_decoder;
        decoder != NULL; decoder = decoder->next) {
+    if (decoder->sparse)
+      continue;
     bool queue_empty = false;
     sve4_decode_error_t err =
         sve4_ffmpeg_packet_queue_is_empty(&decoder->packet_queue, &queue_empty);
@@ -82,6 +84,29 @@ static bool needs_force_push(thread_ctx_t* ctx) {
   return empty;
 }
 
+// sparse decoders only get the packets read for the other decoders: reading
+// for them alone would run through (and drop) the whole input
+static bool has_readers(thread_ctx_t* ctx) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (mtx_lock(&ctx->demuxer->decoder_linked_list_mtx) != thrd_success) {
+    sve4_log_error("Failed to lock decoder linked list mutex in demuxer "
+                   "packet thread");
+    return false;
+  }
+
+  bool readers = false;
+  for (sve4_decode_ffmpeg_decoder_t* decoder = ctx->demuxer->first_decoder;
+       decoder != NULL; decoder = decoder->next)
+    readers = readers || !decoder->sparse;
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (mtx_unlock(&ctx->demuxer->decoder_linked_list_mtx) != thrd_success)
+    sve4_log_error("Failed to unlock decoder linked list mutex in demuxer "
+                   "packet thread");
+
+  return readers;
+}
+
 static int read_frame(thread_ctx_t* ctx) {
   if (ctx->demuxer->reach_eof || ctx->has_pending_packet)
     return DT_ERROR_SUCCESS;
@@ -199,7 +224,8 @@ static int try_send_packet(thread_ctx_t* ctx, bool force_push,
         (void*)packet, ctx->current_packet_idx, (void*)decoder,
         decoder->stream_index);
     sve4_decode_error_t push_err = sve4_ffmpeg_packet_queue_push(
-        &decoder->packet_queue, packet, deadline, force_push);
+        &decoder->packet_queue, packet, deadline,
+        force_push || decoder->sparse);
     if (sve4_decode_error_is_success(push_err)) {
       decoder->last_packet_idx = ctx->current_packet_idx;
       continue;
@@ -241,18 +267,24 @@ int sve4_demuxer_thread_main(void* user_ptr) {
       continue;
     }
 
+    // nothing to do until a seek or a reader comes along
+    if (!has_readers(&ctx) ||
+        (ctx.demuxer->reach_eof && !ctx.has_pending_packet)) {
+      struct timespec interval = {0};
+      timespec_add_ns(&interval, ctx.demuxer_interval_ns);
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      thrd_sleep(&interval, NULL);
+      continue;
+    }
+
     bool force_push = needs_force_push(&ctx);
     if ((err = read_frame(&ctx)) != DT_ERROR_SUCCESS)
       goto ret;
 
     struct timespec deadline = get_deadline(&ctx);
     bool timeout = false;
+    // the packet stays pending (and is not read over) until it is sent
     try_send_packet(&ctx, force_push, &deadline, &timeout);
-
-    if (!timeout) {
-      ctx.has_pending_packet = true;
-      av_packet_unref(ctx.current_packet);
-    }
   }
 
 ret:
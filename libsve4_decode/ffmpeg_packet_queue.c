@@ -72,9 +72,9 @@ sve4_decode_error_t sve4_ffmpeg_packet_queue_push(
 
   // Wait until there is space
   while (!force_push && av_fifo_can_write(queue->queue) == 0) {
-    sve4_log_debug("ffmpeg: packet queue full, waiting for packets to be "
-                   "popped... (condvar %p)",
-                   (void*)&queue->push_condvar);
+    sve4_log_debug_ratelimited("ffmpeg: packet queue full, waiting for "
+                               "packets to be popped... (condvar %p)",
+                               (void*)&queue->push_condvar);
     err = thread_err_to_sve4(
         time_point
             // NOLINTNEXTLINE(misc-include-cleaner)
@@ -125,9 +125,9 @@ sve4_ffmpeg_packet_queue_pop(sve4_ffmpeg_packet_queue_t* _Nonnull queue,
   // Wait until there is space
   size_t can_read = 0;
   while ((can_read = av_fifo_can_read(queue->queue)) == 0) {
-    sve4_log_debug("ffmpeg: packet queue empty, waiting for packets to be "
-                   "pushed... (condvar %p)",
-                   (void*)&queue->pop_condvar);
+    sve4_log_debug_ratelimited("ffmpeg: packet queue empty, waiting for "
+                               "packets to be pushed... (condvar %p)",
+                               (void*)&queue->pop_condvar);
     err = thread_err_to_sve4(
         time_point
             // NOLINTNEXTLINE(misc-include-cleaner)
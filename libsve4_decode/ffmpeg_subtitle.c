@@ -0,0 +1,435 @@
+#include "ffmpeg_subtitle.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "libsve4_decode/ffmpeg_decoder.h"
+#include "libsve4_decode/ffmpeg_demuxer.h"
+#include "libsve4_decode/ram_frame.h"
+#include "libsve4_decode/subtitle.h"
+#include "libsve4_log/api.h"
+#include "libsve4_utils/buffer.h"
+#include "libsve4_utils/formats.h"
+
+#include <libavcodec/avcodec.h>
+#include <libavcodec/packet.h>
+#include <libavformat/avformat.h>
+#include <libavutil/avutil.h>
+#include <libavutil/error.h>
+#include <libavutil/mathematics.h>
+
+#include "error.h"
+#include "frame.h"
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+static const AVRational ns_time_base = {1, 1000000000};
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+static const int64_t ns_per_ms = 1000000;
+
+static sve4_decode_error_t
+bitmap_to_frame(const AVSubtitleRect* _Nonnull rect,
+                sve4_allocator_t* _Nullable allocator,
+                sve4_decode_frame_t* _Nonnull frame) {
+  sve4_decode_error_t err = sve4_decode_alloc_ram_frame(
+      frame, allocator, sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8),
+      (size_t)rect->w, (size_t)rect->h, (const size_t[]){1});
+  if (!sve4_decode_error_is_success(err))
+    return err;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  sve4_decode_ram_frame_t* ram_frame = sve4_buffer_get_data(frame->buffer);
+#pragma GCC diagnostic pop
+
+  // data[0] holds palette indices, data[1] the palette as native endian
+  // 0xAARRGGBB words
+  uint32_t palette[256] = {0};
+  memcpy(palette, rect->data[1],
+         sizeof(uint32_t) * (size_t)sve4_min(rect->nb_colors, 256));
+  for (size_t y = 0; y < (size_t)rect->h; ++y) {
+    const uint8_t* src = rect->data[0] + y * (size_t)rect->linesize[0];
+    uint8_t* dst = ram_frame->data[0] + y * ram_frame->linesizes[0];
+    for (size_t x = 0; x < (size_t)rect->w; ++x) {
+      uint32_t color = palette[src[x]];
+      // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+      dst[4 * x + 0] = (uint8_t)(color >> 16);
+      dst[4 * x + 1] = (uint8_t)(color >> 8);
+      dst[4 * x + 2] = (uint8_t)(color >> 0);
+      dst[4 * x + 3] = (uint8_t)(color >> 24);
+      // NOLINTEND(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    }
+  }
+
+  return sve4_decode_success;
+}
+
+static sve4_decode_error_t
+add_subtitle(sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder,
+             const AVSubtitle* _Nonnull subtitle,
+             const AVPacket* _Nonnull packet, AVRational time_base) {
+  int64_t packet_pts = packet->pts != AV_NOPTS_VALUE
+                           ? av_rescale_q(packet->pts, time_base, ns_time_base)
+                           : 0;
+  int64_t base = subtitle->pts != AV_NOPTS_VALUE
+                     ? av_rescale_q(subtitle->pts, AV_TIME_BASE_Q, ns_time_base)
+                     : packet_pts;
+  int64_t start = base + (int64_t)subtitle->start_display_time * ns_per_ms;
+  int64_t end = SVE4_DECODE_SUBTITLE_END_UNKNOWN;
+  if (subtitle->end_display_time != UINT32_MAX &&
+      subtitle->end_display_time > subtitle->start_display_time)
+    end = base + (int64_t)subtitle->end_display_time * ns_per_ms;
+  else if (packet->duration > 0)
+    end = packet_pts + av_rescale_q(packet->duration, time_base, ns_time_base);
+
+  // bitmap formats (PGS, DVB) clear the screen by sending a new (possibly
+  // empty) event instead of giving each event a duration
+  sve4_decode_subtitle_track_close_open_cues(&decoder->track, start);
+
+  for (unsigned i = 0; i < subtitle->num_rects; ++i) {
+    const AVSubtitleRect* rect = subtitle->rects[i];
+    sve4_decode_error_t err = sve4_decode_success;
+    switch (rect->type) {
+    case SUBTITLE_BITMAP: {
+      if (rect->w <= 0 || rect->h <= 0)
+        break;
+      sve4_decode_frame_t bitmap = {0};
+      err = bitmap_to_frame(rect, decoder->frame_allocator, &bitmap);
+      if (!sve4_decode_error_is_success(err))
+        break;
+      bitmap.pts = start;
+      bitmap.duration =
+          end == SVE4_DECODE_SUBTITLE_END_UNKNOWN ? 0 : end - start;
+      err = sve4_decode_subtitle_track_add_bitmap(&decoder->track, start, end,
+                                                  rect->x, rect->y, &bitmap);
+      break;
+    }
+    case SUBTITLE_TEXT:
+      if (rect->text)
+        err = sve4_decode_subtitle_track_add_text(&decoder->track, start, end,
+                                                  rect->text, NULL);
+      break;
+    case SUBTITLE_ASS:
+      if (rect->ass)
+        err = sve4_decode_subtitle_track_add_text(&decoder->track, start, end,
+                                                  NULL, rect->ass);
+      break;
+    default:;
+    }
+
+    if (!sve4_decode_error_is_success(err))
+      return err;
+  }
+
+  return sve4_decode_success;
+}
+
+static sve4_decode_error_t
+decode_packet(sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder,
+              AVPacket* _Nonnull packet, AVRational time_base) {
+  AVSubtitle subtitle;
+  int got_subtitle = 0;
+  int ret = avcodec_decode_subtitle2(decoder->ctx, &subtitle, &got_subtitle,
+                                     packet);
+  if (ret < 0) {
+    // a broken event should not take the rest of the track down with it
+    sve4_log_warn("ffmpeg: subtitle decoder %p failed to decode packet "
+                  "(error %d), skipping",
+                  (void*)decoder, ret);
+    return sve4_decode_success;
+  }
+  if (!got_subtitle)
+    return sve4_decode_success;
+
+  sve4_decode_error_t err =
+      add_subtitle(decoder, &subtitle, packet, time_base);
+  avsubtitle_free(&subtitle);
+  return err;
+}
+
+static int subtitle_thread_main(void* user_ptr) {
+  sve4_decode_ffmpeg_subtitle_decoder_t* decoder = user_ptr;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  sve4_decode_ffmpeg_demuxer_t* demuxer =
+      (sve4_decode_ffmpeg_demuxer_t*)sve4_buffer_get_data(decoder->demuxer);
+#pragma GCC diagnostic pop
+  AVRational time_base =
+      demuxer->ctx->streams[decoder->stream_index]->time_base;
+
+  sve4_log_debug("ffmpeg: subtitle decoder %p started decoding stream %zu",
+                 (void*)decoder, decoder->stream_index);
+  sve4_decode_error_t err = sve4_decode_success;
+  AVPacket* packet = av_packet_alloc();
+  if (!packet) {
+    err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+    goto done;
+  }
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  while (atomic_load(&decoder->running)) {
+    int ret = av_read_frame(demuxer->ctx, packet);
+    if (ret == AVERROR_EOF)
+      break;
+    err = sve4_decode_ffmpegerr(ret);
+    if (!sve4_decode_error_is_success(err))
+      goto done;
+
+    if ((size_t)packet->stream_index == decoder->stream_index)
+      err = decode_packet(decoder, packet, time_base);
+    av_packet_unref(packet);
+    if (!sve4_decode_error_is_success(err))
+      goto done;
+  }
+
+  // drain decoders with delayed output
+  packet->data = NULL;
+  packet->size = 0;
+  err = decode_packet(decoder, packet, time_base);
+  if (!sve4_decode_error_is_success(err))
+    goto done;
+
+  err = sve4_decode_subtitle_track_finalize(&decoder->track);
+  sve4_log_debug("ffmpeg: subtitle decoder %p finished with %zu cues",
+                 (void*)decoder, decoder->track.nb_cues);
+
+done:
+  av_packet_free(&packet);
+  // waiters only look at result once done is set
+  decoder->result = err;
+  // NOLINTBEGIN(misc-include-cleaner)
+  // a mutex that cannot be locked here cannot be locked by waiters either,
+  // they give up instead of missing the broadcast
+  bool locked = mtx_lock(&decoder->mutex) == thrd_success;
+  if (!locked)
+    sve4_log_error("Failed to lock subtitle decoder mutex");
+  atomic_store(&decoder->done, true);
+  cnd_broadcast(&decoder->done_condvar);
+  if (locked)
+    mtx_unlock(&decoder->mutex);
+  // NOLINTEND(misc-include-cleaner)
+  return locked ? 0 : 1;
+}
+
+// decodes the packets the shared demuxer has queued for the stream so far
+static sve4_decode_error_t
+read_queued_packets(sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  sve4_decode_ffmpeg_demuxer_t* demuxer =
+      (sve4_decode_ffmpeg_demuxer_t*)sve4_buffer_get_data(
+          decoder->reader.demuxer);
+#pragma GCC diagnostic pop
+  AVRational time_base =
+      demuxer->ctx->streams[decoder->stream_index]->time_base;
+
+  // a deadline in the past only takes what is already there
+  struct timespec now;
+  timespec_get(&now, TIME_UTC);
+  while (true) {
+    AVPacket* packet = NULL;
+    sve4_decode_error_t err = sve4_decode_ffmpeg_demuxer_read_packet(
+        decoder->reader.demuxer, &decoder->reader, &packet, &now);
+    if (err.source == SVE4_DECODE_ERROR_SRC_DEFAULT &&
+        err.error_code == SVE4_DECODE_ERROR_DEFAULT_TIMEOUT)
+      return sve4_decode_success;
+    if (!sve4_decode_error_is_success(err))
+      return err;
+    if (!packet)
+      return sve4_decode_success;
+
+    if (!packet->data) {
+      // end of the stream: drain, then get ready for a seek back
+      err = decode_packet(decoder, packet, time_base);
+      avcodec_flush_buffers(decoder->ctx);
+    } else if (packet->pts == AV_NOPTS_VALUE ||
+               packet->pts > decoder->last_pts) {
+      if (packet->pts != AV_NOPTS_VALUE)
+        decoder->last_pts = packet->pts;
+      err = decode_packet(decoder, packet, time_base);
+    }
+    av_packet_free(&packet);
+    if (!sve4_decode_error_is_success(err))
+      return err;
+  }
+}
+
+static sve4_decode_error_t
+open_streaming(sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder,
+               sve4_buffer_ref_t _Nonnull demuxer_ref, size_t stream_index,
+               const sve4_decode_decoder_config_t* _Nonnull config) {
+  decoder->reader.sparse = true;
+  // closes the reader (and drops demuxer_ref) itself on failure
+  sve4_decode_error_t err = sve4_decode_ffmpeg_open_decoder_inner(
+      &decoder->reader, demuxer_ref, stream_index, config);
+  if (!sve4_decode_error_is_success(err))
+    return err;
+  decoder->streaming = true;
+  decoder->last_pts = INT64_MIN;
+
+  // the reader only receives packets, the codec context is ours
+  decoder->ctx = decoder->reader.ctx;
+  decoder->reader.ctx = NULL;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  sve4_decode_ffmpeg_demuxer_t* demuxer =
+      (sve4_decode_ffmpeg_demuxer_t*)sve4_buffer_get_data(demuxer_ref);
+  decoder->ctx->pkt_timebase = demuxer->ctx->streams[stream_index]->time_base;
+#pragma GCC diagnostic pop
+  sve4_log_debug("ffmpeg: subtitle decoder %p streams stream %zu along with "
+                 "the shared demuxer",
+                 (void*)decoder, stream_index);
+  return sve4_decode_success;
+}
+
+sve4_decode_error_t sve4_decode_ffmpeg_open_subtitle_decoder_inner(
+    sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder,
+    sve4_buffer_ref_t _Nonnull demuxer_ref, size_t stream_index,
+    bool streaming, const sve4_decode_decoder_config_t* _Nonnull config) {
+  memset(decoder, 0, sizeof *decoder);
+  decoder->stream_index = stream_index;
+  decoder->frame_allocator = config->frame_allocator;
+  decoder->result = sve4_decode_success;
+  sve4_decode_subtitle_track_init(&decoder->track, config->allocator);
+
+  sve4_decode_error_t err;
+  if (streaming) {
+    err = open_streaming(decoder, demuxer_ref, stream_index, config);
+    if (!sve4_decode_error_is_success(err))
+      goto fail;
+    return sve4_decode_success;
+  }
+
+  decoder->demuxer = demuxer_ref;
+  sve4_decode_ffmpeg_demuxer_t* demuxer =
+      (sve4_decode_ffmpeg_demuxer_t*)sve4_buffer_get_data(demuxer_ref);
+  if (stream_index >= demuxer->ctx->nb_streams) {
+    sve4_log_error("ffmpeg: subtitle stream %zu not found in private demuxer",
+                   stream_index);
+    err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_INVALID_FORMAT);
+    goto fail;
+  }
+
+  // let the private demuxer skip everything but our stream
+  for (size_t i = 0; i < demuxer->ctx->nb_streams; ++i)
+    if (i != stream_index)
+      demuxer->ctx->streams[i]->discard = AVDISCARD_ALL;
+
+  AVStream* stream = demuxer->ctx->streams[stream_index];
+  err = sve4_decode_ffmpeg_open_codec_context(&decoder->ctx, stream->codecpar,
+                                              stream_index, config);
+  if (!sve4_decode_error_is_success(err))
+    goto fail;
+  // used by avcodec_decode_subtitle2() to fill in AVSubtitle.pts
+  decoder->ctx->pkt_timebase = stream->time_base;
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (mtx_init(&decoder->mutex, mtx_timed) != thrd_success) {
+    err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_THREADS);
+    goto fail;
+  }
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (cnd_init(&decoder->done_condvar) != thrd_success) {
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_destroy(&decoder->mutex);
+    err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_THREADS);
+    goto fail;
+  }
+
+  atomic_store(&decoder->running, true);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (thrd_create(&decoder->thread, subtitle_thread_main, decoder) !=
+      thrd_success) {
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_destroy(&decoder->mutex);
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    cnd_destroy(&decoder->done_condvar);
+    err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_THREADS);
+    goto fail;
+  }
+  decoder->thread_started = true;
+
+  return sve4_decode_success;
+
+fail:
+  sve4_decode_ffmpeg_close_subtitle_decoder_inner(decoder);
+  return err;
+}
+
+sve4_decode_error_t sve4_decode_ffmpeg_subtitle_decoder_inner_get_cues(
+    sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder, int64_t pts,
+    const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues,
+    size_t* _Nonnull nb_cues, const struct timespec* _Nullable deadline) {
+  sve4_decode_error_t err;
+  if (decoder->streaming) {
+    // cues added now do not move the ones returned before
+    err = read_queued_packets(decoder);
+    if (sve4_decode_error_is_success(err))
+      err = sve4_decode_subtitle_track_finalize(&decoder->track);
+    if (!sve4_decode_error_is_success(err))
+      return err;
+    goto query;
+  }
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (mtx_lock(&decoder->mutex) != thrd_success)
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_THREADS);
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  while (!atomic_load(&decoder->done)) {
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    int ret = deadline ? cnd_timedwait(&decoder->done_condvar, &decoder->mutex,
+                                       deadline)
+                       // NOLINTNEXTLINE(misc-include-cleaner)
+                       : cnd_wait(&decoder->done_condvar, &decoder->mutex);
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    if (ret != thrd_success) {
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      mtx_unlock(&decoder->mutex);
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      return sve4_decode_defaulterr(ret == thrd_timedout
+                                        ? SVE4_DECODE_ERROR_DEFAULT_TIMEOUT
+                                        : SVE4_DECODE_ERROR_DEFAULT_THREADS);
+    }
+  }
+
+  err = decoder->result;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&decoder->mutex);
+  if (!sve4_decode_error_is_success(err))
+    return err;
+
+query:
+  // the background pass never modifies the track once it is done, streaming
+  // decoders only modify it above
+  *nb_cues = sve4_decode_subtitle_track_query(&decoder->track, pts, cues,
+                                              cues ? *nb_cues : 0);
+  return sve4_decode_success;
+}
+
+void sve4_decode_ffmpeg_close_subtitle_decoder_inner(
+    sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder) {
+  sve4_log_debug("ffmpeg: closing subtitle decoder %p", (void*)decoder);
+  if (decoder->thread_started) {
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    atomic_store(&decoder->running, false);
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    if (thrd_join(decoder->thread, NULL) != thrd_success)
+      sve4_log_error("Failed to join subtitle decoder thread");
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_destroy(&decoder->mutex);
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    cnd_destroy(&decoder->done_condvar);
+    decoder->thread_started = false;
+  }
+
+  if (decoder->streaming) {
+    sve4_decode_ffmpeg_close_decoder_inner(&decoder->reader);
+    decoder->streaming = false;
+  }
+  sve4_decode_subtitle_track_free(&decoder->track);
+  avcodec_free_context(&decoder->ctx);
+  sve4_buffer_free(&decoder->demuxer);
+  sve4_buffer_free(&decoder->shared_demuxer);
+}
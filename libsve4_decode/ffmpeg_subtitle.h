@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "sve4_decode_export.h"
+
+#include "libsve4_decode/decoder.h"
+#include "libsve4_decode/error.h"
+#include "libsve4_decode/ffmpeg_decoder.h"
+#include "libsve4_decode/subtitle.h"
+#include "libsve4_utils/allocator.h"
+#include "libsve4_utils/buffer.h"
+#include "libsve4_utils/defines.h"
+
+#include <libavcodec/avcodec.h>
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+// Subtitle streams are sparse, but a decoder attached to a shared demuxer
+// would still hold a packet queue that every other decoder has to wait on.
+// Instead, subtitle decoders read the whole stream once on a background thread
+// using a private demuxer (with every other stream discarded) and answer
+// queries from the resulting cue store.
+//
+// Inputs that cannot be opened twice (pipes, network streams, custom I/O) are
+// streamed instead: the decoder is attached to the shared demuxer as a sparse
+// reader, which never holds the other streams back, and decodes the packets
+// queued so far whenever it is queried. Only the cues read up to the
+// position of the shared demuxer are known then.
+typedef struct {
+  // demuxer shared with other decoders, only kept alive for
+  // sve4_decode_decoder_get_demuxer()
+  sve4_buffer_ref_t _Nullable shared_demuxer;
+  // private demuxer read by the background thread
+  sve4_buffer_ref_t _Nullable demuxer;
+  // attached to the shared demuxer when streaming, only used to receive the
+  // packets of the stream (ctx below does the decoding)
+  sve4_decode_ffmpeg_decoder_t reader;
+  bool streaming;
+  // pts of the last packet decoded while streaming, packets read again after
+  // the shared demuxer seeks back are skipped
+  int64_t last_pts;
+  AVCodecContext* _Nullable ctx;
+  size_t stream_index;
+  sve4_allocator_t* _Nullable frame_allocator;
+  sve4_decode_subtitle_track_t track;
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_t mutex;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_t done_condvar;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  atomic_bool done;
+  sve4_decode_error_t result;
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  thrd_t thread;
+  bool thread_started;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  atomic_bool running;
+} sve4_decode_ffmpeg_subtitle_decoder_t;
+
+// takes ownership of demuxer (even on failure). unless streaming, it must not
+// be shared with other decoders.
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_ffmpeg_open_subtitle_decoder_inner(
+    sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder,
+    sve4_buffer_ref_t _Nonnull demuxer, size_t stream_index, bool streaming,
+    const sve4_decode_decoder_config_t* _Nonnull config);
+
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_ffmpeg_subtitle_decoder_inner_get_cues(
+    sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder, int64_t pts,
+    const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues,
+    size_t* _Nonnull nb_cues, const struct timespec* _Nullable deadline);
+
+SVE4_DECODE_EXPORT
+void sve4_decode_ffmpeg_close_subtitle_decoder_inner(
+    sve4_decode_ffmpeg_subtitle_decoder_t* _Nonnull decoder);
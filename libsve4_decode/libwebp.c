@@ -11,6 +11,7 @@
 
 #include <libsve4_utils/allocator.h>
 #include <libsve4_utils/buffer.h>
+#include <libsve4_utils/buffer_pool.h>
 #include <libsve4_utils/formats.h>
 #include <webp/demux.h>
 
@@ -175,15 +176,17 @@ int64_t sve4_decode_libwebp_demux_get_total_duration(
 
 typedef struct {
   sve4_decode_libwebp_anim_t anim;
-  sve4_allocator_t* allocator;
   sve4_allocator_t* frame_allocator;
-  void* ptr;
+  sve4_buffer_pool_t* frame_pool;
+  // the whole file, which the demuxer reads from
+  sve4_buffer_view_t file;
 } decoder_inner_t;
 
 static void decoder_destructor(char* mem) {
   decoder_inner_t* inner = (decoder_inner_t*)mem;
   sve4_decode_libwebp_close_anim(&inner->anim);
-  sve4_free(inner->allocator, inner->ptr);
+  sve4_buffer_pool_unref(inner->frame_pool);
+  sve4_buffer_view_unref(&inner->file);
 }
 
 static bool is_frame_compatible(sve4_decode_libwebp_anim_t* anim,
@@ -223,8 +226,13 @@ webp_get_frame(struct sve4_decode_decoder_t* _Nonnull decoder,
         "%p is not compatible",
         (void*)decoder, (void*)frame);
     sve4_decode_frame_free(frame);
-    err = sve4_decode_libwebp_anim_alloc(&inner->anim, inner->frame_allocator,
-                                         frame);
+    err = inner->frame_pool
+              ? sve4_decode_alloc_ram_frame_pooled(
+                    frame, inner->frame_pool,
+                    sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8),
+                    inner->anim.width, inner->anim.height, (const size_t[]){1})
+              : sve4_decode_libwebp_anim_alloc(&inner->anim,
+                                               inner->frame_allocator, frame);
     if (!sve4_decode_error_is_success(err))
       return err;
   }
@@ -251,8 +259,6 @@ sve4_decode_error_t sve4_decode_libwebp_open_decoder(
     sve4_decode_decoder_t* _Nonnull decoder,
     const sve4_decode_decoder_config_t* _Nonnull config) {
   sve4_decode_error_t err;
-  char* buffer = NULL;
-  size_t size = SIZE_MAX;
 
   decoder->data = sve4_buffer_create(config->allocator, sizeof(decoder_inner_t),
                                      decoder_destructor);
@@ -260,20 +266,23 @@ sve4_decode_error_t sve4_decode_libwebp_open_decoder(
     err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
     goto fail;
   }
-  err = sve4_decode_read_url(config->allocator, &buffer, &size, config->url,
-                             true);
-  if (!sve4_decode_error_is_success(err))
-    goto fail;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
   decoder_inner_t* inner = sve4_buffer_get_data(decoder->data);
 #pragma GCC diagnostic pop
-  inner->allocator = config->allocator;
+  err = sve4_decode_read_url_view(config->allocator, &inner->file, config->url,
+                                  true);
+  if (!sve4_decode_error_is_success(err))
+    goto fail;
   inner->frame_allocator = config->frame_allocator;
-  inner->ptr = buffer;
+  inner->frame_pool = sve4_buffer_pool_ref(config->frame_pool);
 
-  err =
-      sve4_decode_libwebp_open_anim(&inner->anim, (const uint8_t*)buffer, size);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  err = sve4_decode_libwebp_open_anim(&inner->anim,
+                                      sve4_buffer_view_get_data(&inner->file),
+                                      inner->file.length);
+#pragma GCC diagnostic pop
   if (!sve4_decode_error_is_success(err))
     goto fail;
 
@@ -6,22 +6,26 @@
 
 #include <libsve4_utils/allocator.h>
 #include <libsve4_utils/buffer.h>
+#include <libsve4_utils/buffer_pool.h>
 #include <libsve4_utils/formats.h>
+#include <libsve4_utils/pixconv.h>
 
 #include "error.h"
 #include "frame.h"
 
-sve4_decode_error_t sve4_decode_alloc_ram_frame(sve4_decode_frame_t* frame,
-                                                sve4_allocator_t* allocator,
-                                                sve4_pixfmt_t fmt, size_t width,
-                                                size_t height,
-                                                const size_t* plane_align) {
+static sve4_decode_error_t
+alloc_ram_frame(sve4_decode_frame_t* _Nonnull frame,
+                sve4_allocator_t* _Nullable allocator,
+                sve4_buffer_pool_t* _Nullable pool, sve4_pixfmt_t fmt,
+                size_t width, size_t height,
+                const size_t* _Nonnull plane_align) {
   assert(width && height && plane_align);
 
   size_t num_planes = sve4_pixfmt_num_planes(fmt);
   assert(num_planes && num_planes <= SVE4_DECODE_RAM_FRAME_MAX_PLANES);
 
-  size_t align = 0;
+  // frames are handed between threads
+  size_t align = SVE4_BUFFER_CACHE_LINE;
   size_t size = sizeof(sve4_decode_ram_frame_t);
   size_t offsets[SVE4_DECODE_RAM_FRAME_MAX_PLANES] = {0};
   size_t linesizes[SVE4_DECODE_RAM_FRAME_MAX_PLANES] = {0};
@@ -32,15 +36,24 @@ sve4_decode_error_t sve4_decode_alloc_ram_frame(sve4_decode_frame_t* frame,
     offsets[i] = size;
     linesizes[i] = sve4_pixfmt_linesize(fmt, i, width, plane_align[i]);
     assert(linesizes[i]);
-    size += linesizes[i] * height;
+    size += linesizes[i] * sve4_pixfmt_plane_height(fmt, i, height);
   }
 
-  sve4_buffer_ref_t buffer = sve4_buffer_create(allocator, size, NULL);
+  sve4_buffer_pool_key_t key = {
+      .pixfmt = fmt, .width = width, .height = height, .alignment = align};
+  // plane offsets are relative to the start of the buffer, which has to be
+  // aligned as much as the most aligned plane
+  sve4_buffer_ref_t buffer =
+      pool ? sve4_buffer_pool_get(pool, &key, size, NULL)
+           : sve4_buffer_create_ex(allocator, size, align,
+                                   SVE4_BUFFER_FLAGS_NONE, NULL);
   if (!buffer) {
     return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
   }
 
   sve4_decode_ram_frame_t* ram_frame = sve4_buffer_get_data(buffer);
+  // recycled buffers still hold the header of their previous frame
+  memset(ram_frame, 0, sizeof(sve4_decode_ram_frame_t));
   memcpy(&ram_frame->linesizes, linesizes, sizeof(size_t) * num_planes);
 
   for (size_t i = 0; i < num_planes; ++i) {
@@ -54,3 +67,119 @@ sve4_decode_error_t sve4_decode_alloc_ram_frame(sve4_decode_frame_t* frame,
   frame->kind = SVE4_DECODE_FRAME_KIND_RAM_FRAME;
   return sve4_decode_success;
 }
+
+sve4_decode_error_t sve4_decode_alloc_ram_frame(sve4_decode_frame_t* frame,
+                                                sve4_allocator_t* allocator,
+                                                sve4_pixfmt_t fmt, size_t width,
+                                                size_t height,
+                                                const size_t* plane_align) {
+  return alloc_ram_frame(frame, allocator, NULL, fmt, width, height,
+                         plane_align);
+}
+
+sve4_decode_error_t sve4_decode_alloc_ram_frame_pooled(
+    sve4_decode_frame_t* frame, sve4_buffer_pool_t* pool, sve4_pixfmt_t fmt,
+    size_t width, size_t height, const size_t* plane_align) {
+  return alloc_ram_frame(frame, NULL, pool, fmt, width, height, plane_align);
+}
+
+sve4_decode_error_t
+sve4_decode_ram_frame_convert(sve4_decode_frame_t* dst,
+                              const sve4_decode_frame_t* src,
+                              const sve4_pixconv_options_t* options) {
+  if (src->kind != SVE4_DECODE_FRAME_KIND_RAM_FRAME ||
+      dst->kind != SVE4_DECODE_FRAME_KIND_RAM_FRAME ||
+      src->format.kind != SVE4_PIXFMT || dst->format.kind != SVE4_PIXFMT)
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_INVALID_FORMAT);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  const sve4_decode_ram_frame_t* src_frame = sve4_buffer_get_data(src->buffer);
+  sve4_decode_ram_frame_t* dst_frame = sve4_buffer_get_data(dst->buffer);
+#pragma GCC diagnostic pop
+
+  const uint8_t* src_data[SVE4_DECODE_RAM_FRAME_MAX_PLANES];
+  for (size_t i = 0; i < SVE4_DECODE_RAM_FRAME_MAX_PLANES; ++i)
+    src_data[i] = src_frame->data[i];
+
+  if (!sve4_pixconv_scale(dst->format.pixfmt, dst_frame->data,
+                          dst_frame->linesizes, dst->width, dst->height,
+                          src->format.pixfmt, src_data, src_frame->linesizes,
+                          src->width, src->height, options))
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_UNIMPLEMENTED);
+
+  dst->pts = src->pts;
+  dst->duration = src->duration;
+  return sve4_decode_success;
+}
+
+static void ram_frame_view_destructor(char* _Nonnull data) {
+  sve4_decode_ram_frame_t* ram_frame = (sve4_decode_ram_frame_t*)(void*)data;
+  sve4_buffer_unref(ram_frame->parent);
+}
+
+sve4_buffer_ref_t sve4_decode_ram_frame_create_view(sve4_allocator_t* allocator,
+                                                    sve4_buffer_ref_t parent) {
+  // views are handed between threads just like frames
+  sve4_buffer_ref_t buffer = sve4_buffer_create_ex(
+      allocator, sizeof(sve4_decode_ram_frame_t), SVE4_BUFFER_CACHE_LINE,
+      SVE4_BUFFER_FLAGS_NONE, ram_frame_view_destructor);
+  if (!buffer)
+    return NULL;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  sve4_decode_ram_frame_t* view = sve4_buffer_get_data(buffer);
+#pragma GCC diagnostic pop
+  view->parent = sve4_buffer_ref(parent);
+  return buffer;
+}
+
+sve4_decode_error_t sve4_decode_ram_frame_crop(sve4_decode_frame_t* dst,
+                                               sve4_allocator_t* allocator,
+                                               const sve4_decode_frame_t* src,
+                                               size_t x, size_t y, size_t width,
+                                               size_t height) {
+  if (src->kind != SVE4_DECODE_FRAME_KIND_RAM_FRAME ||
+      src->format.kind != SVE4_PIXFMT || !width || !height ||
+      x + width > src->width || y + height > src->height)
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_INVALID_FORMAT);
+
+  sve4_pixfmt_t fmt = src->format.pixfmt;
+  size_t shift_x = 0;
+  size_t shift_y = 0;
+  sve4_pixfmt_chroma_shift(fmt, &shift_x, &shift_y);
+  // a chroma sample can not be split between two views
+  if ((x & (((size_t)1 << shift_x) - 1)) || (y & (((size_t)1 << shift_y) - 1)))
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_INVALID_FORMAT);
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  const sve4_decode_ram_frame_t* src_frame = sve4_buffer_get_data(src->buffer);
+  // views of views reference the frame owning the pixels directly
+  sve4_buffer_ref_t buffer = sve4_decode_ram_frame_create_view(
+      allocator, src_frame->parent ? src_frame->parent : src->buffer);
+  if (!buffer)
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+  sve4_decode_ram_frame_t* view = sve4_buffer_get_data(buffer);
+#pragma GCC diagnostic pop
+
+  size_t num_planes = sve4_pixfmt_num_planes(fmt);
+  for (size_t i = 0; i < num_planes; ++i) {
+    if (!src_frame->data[i])
+      continue;
+    // byte offset of column x and index of row y in this plane
+    size_t col_offset = x ? sve4_pixfmt_linesize(fmt, i, x, 1) : 0;
+    size_t row = sve4_pixfmt_plane_height(fmt, i, y);
+    view->data[i] =
+        src_frame->data[i] + row * src_frame->linesizes[i] + col_offset;
+    view->linesizes[i] = src_frame->linesizes[i];
+  }
+
+  sve4_decode_frame_free(dst);
+  *dst = *src;
+  dst->buffer = buffer;
+  dst->width = width;
+  dst->height = height;
+  return sve4_decode_success;
+}
@@ -3,8 +3,10 @@
 #include <stdint.h>
 
 #include <libsve4_utils/buffer.h>
+#include <libsve4_utils/buffer_pool.h>
 #include <libsve4_utils/defines.h>
 #include <libsve4_utils/formats.h>
+#include <libsve4_utils/pixconv.h>
 #include <sve4_decode_export.h>
 
 #include "error.h"
@@ -15,6 +17,10 @@ enum { SVE4_DECODE_RAM_FRAME_MAX_PLANES = 8 };
 typedef struct {
   uint8_t* _Nullable data[SVE4_DECODE_RAM_FRAME_MAX_PLANES];
   size_t linesizes[SVE4_DECODE_RAM_FRAME_MAX_PLANES];
+  // for views (see sve4_decode_ram_frame_create_view()), the buffer owning
+  // the pixels, which is kept alive by this frame. NULL if the pixels are
+  // owned by this frame's buffer.
+  sve4_buffer_ref_t _Nullable parent;
   char contiguous_data[];
 } sve4_decode_ram_frame_t;
 
@@ -24,3 +30,39 @@ sve4_decode_alloc_ram_frame(sve4_decode_frame_t* _Nonnull frame,
                             sve4_allocator_t* _Nullable allocator,
                             sve4_pixfmt_t fmt, size_t width, size_t height,
                             const size_t* _Nonnull plane_align);
+
+// like sve4_decode_alloc_ram_frame(), but takes the buffer from pool, so it is
+// recycled once the frame is freed
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_alloc_ram_frame_pooled(
+    sve4_decode_frame_t* _Nonnull frame, sve4_buffer_pool_t* _Nonnull pool,
+    sve4_pixfmt_t fmt, size_t width, size_t height,
+    const size_t* _Nonnull plane_align);
+
+// converts the pixels of src into dst, both must be ram frames. src is
+// scaled if the sizes differ. dst is usually allocated by
+// sve4_decode_alloc_ram_frame() with the target format (RGBA8 or RGBA16F for
+// YUV sources, see libsve4_utils/pixconv.h)
+SVE4_DECODE_EXPORT
+sve4_decode_error_t
+sve4_decode_ram_frame_convert(sve4_decode_frame_t* _Nonnull dst,
+                              const sve4_decode_frame_t* _Nonnull src,
+                              const sve4_pixconv_options_t* _Nullable options);
+
+// creates the buffer of a ram frame whose pixels live in parent (e.g. a ram
+// frame or an external buffer wrapping memory of a decoder), which is
+// referenced until the view is freed. data and linesizes are left for the
+// caller to fill in.
+SVE4_DECODE_EXPORT
+sve4_buffer_ref_t _Nullable sve4_decode_ram_frame_create_view(
+    sve4_allocator_t* _Nullable allocator, sve4_buffer_ref_t _Nonnull parent);
+
+// creates a view of the width x height rectangle of src at (x, y), which
+// references the pixels of src instead of copying them. x and y must be
+// multiples of the chroma subsampling factors of the pixel format.
+SVE4_DECODE_EXPORT
+sve4_decode_error_t
+sve4_decode_ram_frame_crop(sve4_decode_frame_t* _Nonnull dst,
+                           sve4_allocator_t* _Nullable allocator,
+                           const sve4_decode_frame_t* _Nonnull src, size_t x,
+                           size_t y, size_t width, size_t height);
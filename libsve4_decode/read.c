@@ -12,12 +12,12 @@
 #include "libsve4_decode/error.h"
 #include "libsve4_log/api.h"
 #include "libsve4_utils/allocator.h"
+#include "libsve4_utils/arena.h"
+#include "libsve4_utils/buffer.h"
 // NOLINTNEXTLINE(misc-include-cleaner)
 #include "libsve4_utils/defines.h"
 
 #ifdef SVE4_DECODE_HAVE_FFMPEG
-#include "libsve4_utils/arena.h"
-
 #include <libavformat/avio.h>
 #include <libavutil/error.h>
 #endif
@@ -52,10 +52,22 @@ typedef struct page_t {
   unsigned char data[(1 << 12) - 64 - sizeof(struct page_t*)];
 } page_t;
 
+// allocates the result, as a refcounted buffer if owner is set
+static char* _Nullable alloc_result(
+    sve4_allocator_t* _Nullable alloc,
+    sve4_buffer_ref_t _Nullable* _Nullable owner, size_t size) {
+  if (!owner)
+    return sve4_malloc(alloc, size);
+  *owner = sve4_buffer_create(alloc, size, NULL);
+  return *owner ? sve4_buffer_get_data(*owner) : NULL;
+}
+
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
 static sve4_decode_error_t sve4_decode_read_file_common(
-    sve4_allocator_t* _Nullable alloc, char* _Nullable* _Nonnull buffer,
-    size_t* _Nonnull bufsize, const char* _Nonnull url, bool binary,
+    sve4_allocator_t* _Nullable alloc,
+    sve4_buffer_ref_t _Nullable* _Nullable owner,
+    char* _Nullable* _Nonnull buffer, size_t* _Nonnull bufsize,
+    const char* _Nonnull url, bool binary,
     sve4_decode_error_t (*open_func)(const char* _Nonnull url, bool binary,
                                      void** _Nonnull file),
     void (*close_func)(void* _Nonnull file),
@@ -86,7 +98,7 @@ static sve4_decode_error_t sve4_decode_read_file_common(
   bool needs_alloc = !buf;
   if (buf || to_read < SIZE_MAX) {
     if (!buf)
-      *buffer = buf = sve4_malloc(alloc, to_read);
+      *buffer = buf = alloc_result(alloc, owner, to_read);
     if (!buf) {
       close_func(file);
       return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
@@ -97,7 +109,9 @@ static sve4_decode_error_t sve4_decode_read_file_common(
         (err.source != SVE4_DECODE_ERROR_SRC_DEFAULT ||
          err.error_code != SVE4_DECODE_ERROR_DEFAULT_EOF)) {
       close_func(file);
-      if (needs_alloc)
+      if (needs_alloc && owner)
+        sve4_buffer_free(owner);
+      else if (needs_alloc)
         sve4_free(alloc, buf);
       return err;
     }
@@ -112,15 +126,21 @@ static sve4_decode_error_t sve4_decode_read_file_common(
   page_t* first_page = NULL;
   page_t* last_page = NULL;
 
-  sve4_allocator_t arena = sve4_allocator_arena_init;
-  sve4_allocator_impl_missing(&arena);
+  // pages are temporaries, the result may live in a scratch arena of the
+  // caller though
+  sve4_scratch_t scratch;
+  if (!sve4_scratch_begin(&scratch, alloc)) {
+    close_func(file);
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+  }
 
   while (true) {
-    page_t* page = sve4_calloc(&arena, sizeof(page_t));
+    page_t* page = sve4_malloc(scratch.arena, sizeof(page_t));
     if (!page) {
       err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
       goto fail_paged_read;
     }
+    page->next = NULL;
 
     size_t num_read = 0;
     err = read_func(file, (char*)page->data, sizeof(page->data), &num_read);
@@ -139,7 +159,7 @@ static sve4_decode_error_t sve4_decode_read_file_common(
     total_size += final_page_size;
   }
 
-  *buffer = sve4_malloc(alloc, total_size);
+  *buffer = alloc_result(alloc, owner, total_size);
   if (!*buffer) {
     err = sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
     goto fail_paged_read;
@@ -157,7 +177,7 @@ static sve4_decode_error_t sve4_decode_read_file_common(
 
 fail_paged_read:
   close_func(file);
-  sve4_allocator_arena_destroy(&arena);
+  sve4_scratch_end(&scratch);
   return err;
 }
 
@@ -194,16 +214,19 @@ static sve4_decode_error_t stdio_read_func(void* _Nonnull file,
 }
 
 static sve4_decode_error_t sve4_decode_read_file_stdio(
-    sve4_allocator_t* _Nullable alloc, char* _Nullable* _Nonnull buffer,
-    size_t* _Nonnull bufsize, const char* _Nonnull url, bool binary) {
+    sve4_allocator_t* _Nullable alloc,
+    sve4_buffer_ref_t _Nullable* _Nullable owner,
+    char* _Nullable* _Nonnull buffer, size_t* _Nonnull bufsize,
+    const char* _Nonnull url, bool binary) {
 #define FILE_PREFIX "file://"
 #define FILE_PREFIX_LEN (sizeof(FILE_PREFIX) - 1)
   if (strncmp(url, FILE_PREFIX, FILE_PREFIX_LEN) == 0)
     url += FILE_PREFIX_LEN;
 
-  return sve4_decode_read_file_common(alloc, buffer, bufsize, url, binary,
-                                      stdio_open_func, stdio_close_func,
-                                      stdio_get_size, stdio_read_func);
+  return sve4_decode_read_file_common(alloc, owner, buffer, bufsize, url,
+                                      binary, stdio_open_func,
+                                      stdio_close_func, stdio_get_size,
+                                      stdio_read_func);
 }
 
 #ifdef SVE4_DECODE_HAVE_FFMPEG
@@ -261,27 +284,60 @@ static sve4_decode_error_t ffmpeg_read_func(void* _Nonnull file,
 
 // NOLINTNEXTLINE(readability-function-cognitive-complexity)
 static sve4_decode_error_t sve4_decode_read_file_ffmpeg(
-    sve4_allocator_t* _Nullable alloc, char* _Nullable* _Nonnull buffer,
-    size_t* _Nonnull bufsize, const char* _Nonnull url) {
-  return sve4_decode_read_file_common(alloc, buffer, bufsize, url, true,
+    sve4_allocator_t* _Nullable alloc,
+    sve4_buffer_ref_t _Nullable* _Nullable owner,
+    char* _Nullable* _Nonnull buffer, size_t* _Nonnull bufsize,
+    const char* _Nonnull url) {
+  return sve4_decode_read_file_common(alloc, owner, buffer, bufsize, url, true,
                                       ffmpeg_open_func, ffmpeg_close_func,
                                       ffmpeg_get_size, ffmpeg_read_func);
 }
 #endif
 
-SVE4_DECODE_EXPORT
-sve4_decode_error_t sve4_decode_read_url(sve4_allocator_t* _Nullable alloc,
-                                         char* _Nullable* _Nonnull buffer,
-                                         size_t* _Nonnull bufsize,
-                                         const char* _Nonnull url,
-                                         bool binary) {
+static sve4_decode_error_t
+read_url(sve4_allocator_t* _Nullable alloc,
+         sve4_buffer_ref_t _Nullable* _Nullable owner,
+         char* _Nullable* _Nonnull buffer, size_t* _Nonnull bufsize,
+         const char* _Nonnull url, bool binary) {
 #ifdef SVE4_DECODE_HAVE_FFMPEG
   if (binary) {
     sve4_log_debug("Using ffmpeg to read binary url %s", url);
-    return sve4_decode_read_file_ffmpeg(alloc, buffer, bufsize, url);
+    return sve4_decode_read_file_ffmpeg(alloc, owner, buffer, bufsize, url);
   }
 #endif
 
   sve4_log_debug("Using stdio api to read binary url %s", url);
-  return sve4_decode_read_file_stdio(alloc, buffer, bufsize, url, binary);
+  return sve4_decode_read_file_stdio(alloc, owner, buffer, bufsize, url,
+                                     binary);
+}
+
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_read_url(sve4_allocator_t* _Nullable alloc,
+                                         char* _Nullable* _Nonnull buffer,
+                                         size_t* _Nonnull bufsize,
+                                         const char* _Nonnull url,
+                                         bool binary) {
+  return read_url(alloc, NULL, buffer, bufsize, url, binary);
+}
+
+SVE4_DECODE_EXPORT
+sve4_decode_error_t
+sve4_decode_read_url_view(sve4_allocator_t* _Nullable alloc,
+                          sve4_buffer_view_t* _Nonnull view,
+                          const char* _Nonnull url, bool binary) {
+  sve4_buffer_ref_t owner = NULL;
+  char* buffer = NULL;
+  size_t size = SIZE_MAX;
+  sve4_decode_error_t err =
+      read_url(alloc, &owner, &buffer, &size, url, binary);
+  if (!sve4_decode_error_is_success(err))
+    return err;
+  assert(owner);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  // the file may be shorter than announced
+  *view = sve4_buffer_view(owner, 0, size);
+#pragma GCC diagnostic pop
+  sve4_buffer_unref(owner);
+  return sve4_decode_success;
 }
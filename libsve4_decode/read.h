@@ -6,6 +6,7 @@
 
 #include "libsve4_decode/error.h"
 #include "libsve4_utils/allocator.h"
+#include "libsve4_utils/buffer.h"
 #include "libsve4_utils/defines.h"
 
 /**
@@ -42,3 +43,25 @@ sve4_decode_error_t sve4_decode_read_url(sve4_allocator_t* _Nullable alloc,
                                          char* _Nullable* _Nonnull buffer,
                                          size_t* _Nonnull bufsize,
                                          const char* _Nonnull url, bool binary);
+
+/**
+ * @brief Reads all data from a URL into a newly allocated refcounted buffer.
+ *
+ * Works like sve4_decode_read_url() with a `NULL` buffer, but the result is
+ * returned as a view of an ::sve4_buffer_t, so parts of it can be handed out
+ * (e.g. with sve4_buffer_view_slice()) without copying.
+ *
+ * @param alloc    Optional allocator used for the buffer.
+ * @param view     Set to a view of the data read on success. The caller owns
+ * the reference and releases it with sve4_buffer_view_unref().
+ * @param url      The URL to read from. Must not be `NULL`.
+ * @param binary   If `true`, data is read in binary mode; otherwise, in text
+ * mode.
+ *
+ * @return An ::sve4_decode_error_t indicating success or the type of failure.
+ */
+SVE4_DECODE_EXPORT
+sve4_decode_error_t
+sve4_decode_read_url_view(sve4_allocator_t* _Nullable alloc,
+                          sve4_buffer_view_t* _Nonnull view,
+                          const char* _Nonnull url, bool binary);
@@ -0,0 +1,346 @@
+#include "subtitle.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libsve4_utils/allocator.h"
+
+#include "error.h"
+#include "frame.h"
+
+void sve4_decode_subtitle_track_init(
+    sve4_decode_subtitle_track_t* _Nonnull track,
+    sve4_allocator_t* _Nullable allocator) {
+  memset(track, 0, sizeof *track);
+  track->allocator = allocator;
+}
+
+// reallocates an array of pointers to hold at least size of them
+static void* _Nullable grow(sve4_allocator_t* _Nullable allocator,
+                            void* _Nullable array, size_t* _Nonnull capacity,
+                            size_t size) {
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+  size_t new_capacity = *capacity ? *capacity * 2 : 16;
+  new_capacity = sve4_max(new_capacity, size);
+  void* new_array = sve4_realloc(allocator, array, *capacity * sizeof(void*),
+                                 new_capacity * sizeof(void*));
+  if (new_array)
+    *capacity = new_capacity;
+  return new_array;
+}
+
+static sve4_decode_subtitle_cue_t* _Nullable
+push_cue(sve4_decode_subtitle_track_t* _Nonnull track, int64_t end) {
+  if (track->nb_cues == track->capacity) {
+    sve4_decode_subtitle_cue_t** cues =
+        grow(track->allocator, track->cues, &track->capacity,
+             track->nb_cues + 1);
+    if (!cues)
+      return NULL;
+    track->cues = cues;
+  }
+  // so that the cue can be marked as open without failing once it is filled
+  if (end == SVE4_DECODE_SUBTITLE_END_UNKNOWN &&
+      track->nb_open == track->open_capacity) {
+    sve4_decode_subtitle_cue_t** open = grow(
+        track->allocator, track->open, &track->open_capacity,
+        track->nb_open + 1);
+    if (!open)
+      return NULL;
+    track->open = open;
+  }
+
+  sve4_decode_subtitle_cue_t* cue =
+      sve4_malloc(track->allocator, sizeof(sve4_decode_subtitle_cue_t));
+  if (!cue)
+    return NULL;
+  memset(cue, 0, sizeof *cue);
+  cue->end = end;
+  return cue;
+}
+
+// adds cue, filled in after push_cue(), to the track
+static void commit_cue(sve4_decode_subtitle_track_t* _Nonnull track,
+                       sve4_decode_subtitle_cue_t* _Nonnull cue) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  track->cues[track->nb_cues++] = cue;
+  if (cue->end == SVE4_DECODE_SUBTITLE_END_UNKNOWN)
+    track->open[track->nb_open++] = cue;
+#pragma GCC diagnostic pop
+  track->finalized = false;
+}
+
+static char* _Nullable copy_string(sve4_allocator_t* _Nullable allocator,
+                                   const char* _Nonnull str) {
+  size_t len = strlen(str);
+  char* copy = sve4_malloc(allocator, len + 1);
+  if (copy)
+    memcpy(copy, str, len + 1);
+  return copy;
+}
+
+// ASS events produced by FFmpeg are formatted as
+// ReadOrder,Layer,Style,Name,MarginL,MarginR,MarginV,Effect,Text
+// this extracts Text and drops override blocks ({...}) and escapes
+static char* _Nullable strip_ass(sve4_allocator_t* _Nullable allocator,
+                                 const char* _Nonnull ass) {
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+  for (int commas = 0; commas < 8 && *ass; ++ass)
+    if (*ass == ',')
+      ++commas;
+
+  char* text = sve4_malloc(allocator, strlen(ass) + 1);
+  if (!text)
+    return NULL;
+
+  char* out = text;
+  for (; *ass; ++ass) {
+    if (*ass == '{') {
+      const char* close = strchr(ass, '}');
+      if (close) {
+        ass = close;
+        continue;
+      }
+    }
+
+    if (ass[0] == '\\' && (ass[1] == 'N' || ass[1] == 'n')) {
+      *out++ = '\n';
+      ++ass;
+    } else if (ass[0] == '\\' && ass[1] == 'h') {
+      *out++ = ' ';
+      ++ass;
+    } else if (*ass != '\r') {
+      *out++ = *ass;
+    }
+  }
+
+  // trailing newlines are an artifact of the event line format
+  while (out != text && out[-1] == '\n')
+    --out;
+  *out = '\0';
+  return text;
+}
+
+sve4_decode_error_t sve4_decode_subtitle_track_add_text(
+    sve4_decode_subtitle_track_t* _Nonnull track, int64_t start, int64_t end,
+    const char* _Nullable text, const char* _Nullable ass) {
+  assert(text || ass);
+  sve4_decode_subtitle_cue_t* cue = push_cue(track, end);
+  if (!cue)
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+
+  cue->kind = SVE4_DECODE_SUBTITLE_CUE_TEXT;
+  cue->start = start;
+  if (ass && !(cue->ass = copy_string(track->allocator, ass)))
+    goto fail;
+  cue->text = text ? copy_string(track->allocator, text)
+                   : strip_ass(track->allocator, cue->ass);
+  if (!cue->text)
+    goto fail;
+
+  commit_cue(track, cue);
+  return sve4_decode_success;
+fail:
+  sve4_free(track->allocator, cue->ass);
+  sve4_free(track->allocator, cue);
+  return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+}
+
+sve4_decode_error_t sve4_decode_subtitle_track_add_bitmap(
+    sve4_decode_subtitle_track_t* _Nonnull track, int64_t start, int64_t end,
+    int32_t x, int32_t y, sve4_decode_frame_t* _Nonnull bitmap) {
+  sve4_decode_subtitle_cue_t* cue = push_cue(track, end);
+  if (!cue) {
+    sve4_decode_frame_free(bitmap);
+    return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+  }
+
+  cue->kind = SVE4_DECODE_SUBTITLE_CUE_BITMAP;
+  cue->start = start;
+  cue->x = x;
+  cue->y = y;
+  cue->bitmap = *bitmap;
+  bitmap->buffer = NULL;
+  commit_cue(track, cue);
+  return sve4_decode_success;
+}
+
+void sve4_decode_subtitle_track_close_open_cues(
+    sve4_decode_subtitle_track_t* _Nonnull track, int64_t pts) {
+  size_t nb_open = 0;
+  for (size_t i = 0; i < track->nb_open; ++i) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+    sve4_decode_subtitle_cue_t* cue = track->open[i];
+    if (cue->start < pts) {
+      cue->end = pts;
+      track->finalized = false;
+    } else {
+      track->open[nb_open++] = cue;
+    }
+#pragma GCC diagnostic pop
+  }
+  track->nb_open = nb_open;
+}
+
+static int compare_cues(const void* lhs, const void* rhs) {
+  const sve4_decode_subtitle_cue_t* a =
+      *(const sve4_decode_subtitle_cue_t* const*)lhs;
+  const sve4_decode_subtitle_cue_t* b =
+      *(const sve4_decode_subtitle_cue_t* const*)rhs;
+  if (a->start != b->start)
+    return a->start < b->start ? -1 : 1;
+  if (a->end != b->end)
+    return a->end < b->end ? -1 : 1;
+  return 0;
+}
+
+static int compare_timestamps(const void* lhs, const void* rhs) {
+  int64_t a = *(const int64_t*)lhs;
+  int64_t b = *(const int64_t*)rhs;
+  return a < b ? -1 : a > b;
+}
+
+static void free_segments(sve4_decode_subtitle_track_t* _Nonnull track) {
+  sve4_free(track->allocator, track->bounds);
+  sve4_free(track->allocator, track->segments);
+  sve4_free(track->allocator, track->active);
+  track->bounds = NULL;
+  track->segments = NULL;
+  track->active = NULL;
+  track->nb_bounds = 0;
+  track->active_capacity = 0;
+}
+
+// sweeps the cuts in order, the cues active during a segment are the ones of
+// the previous segment still displayed at its start, followed by the ones
+// starting there
+static bool build_segments(sve4_decode_subtitle_track_t* _Nonnull track) {
+  size_t nb_active = 0;
+  size_t next_cue = 0;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  for (size_t i = 0; i < track->nb_bounds; ++i) {
+    int64_t bound = track->bounds[i];
+    size_t first_starting = next_cue;
+    while (next_cue < track->nb_cues && track->cues[next_cue]->start == bound)
+      ++next_cue;
+
+    size_t prev = i > 0 ? track->segments[i - 1] : 0;
+    size_t needed = nb_active + (nb_active - prev) + next_cue - first_starting;
+    if (needed > track->active_capacity) {
+      const sve4_decode_subtitle_cue_t** active = grow(
+          track->allocator, track->active, &track->active_capacity, needed);
+      if (!active)
+        return false;
+      track->active = active;
+    }
+
+    track->segments[i] = nb_active;
+    for (size_t j = prev; j < track->segments[i]; ++j)
+      if (track->active[j]->end > bound)
+        track->active[nb_active++] = track->active[j];
+    for (size_t j = first_starting; j < next_cue; ++j)
+      if (track->cues[j]->end > bound)
+        track->active[nb_active++] = track->cues[j];
+  }
+  track->segments[track->nb_bounds] = nb_active;
+#pragma GCC diagnostic pop
+  return true;
+}
+
+sve4_decode_error_t sve4_decode_subtitle_track_finalize(
+    sve4_decode_subtitle_track_t* _Nonnull track) {
+  if (track->finalized)
+    return sve4_decode_success;
+
+  free_segments(track);
+  if (track->nb_cues == 0) {
+    track->finalized = true;
+    return sve4_decode_success;
+  }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  qsort(track->cues, track->nb_cues, sizeof(sve4_decode_subtitle_cue_t*),
+        compare_cues);
+
+  size_t max_bounds = 2 * track->nb_cues;
+  track->bounds = sve4_malloc(track->allocator, max_bounds * sizeof(int64_t));
+  track->segments =
+      sve4_malloc(track->allocator, (max_bounds + 1) * sizeof(size_t));
+  if (!track->bounds || !track->segments)
+    goto fail;
+
+  for (size_t i = 0; i < track->nb_cues; ++i) {
+    track->bounds[2 * i] = track->cues[i]->start;
+    track->bounds[2 * i + 1] = track->cues[i]->end;
+  }
+  qsort(track->bounds, max_bounds, sizeof(int64_t), compare_timestamps);
+  for (size_t i = 0; i < max_bounds; ++i)
+    if (track->nb_bounds == 0 ||
+        track->bounds[track->nb_bounds - 1] != track->bounds[i])
+      track->bounds[track->nb_bounds++] = track->bounds[i];
+#pragma GCC diagnostic pop
+
+  if (!build_segments(track))
+    goto fail;
+  track->finalized = true;
+  return sve4_decode_success;
+
+fail:
+  free_segments(track);
+  return sve4_decode_defaulterr(SVE4_DECODE_ERROR_DEFAULT_MEMORY);
+}
+
+size_t sve4_decode_subtitle_track_query(
+    const sve4_decode_subtitle_track_t* _Nonnull track, int64_t pts,
+    const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues,
+    size_t max_cues) {
+  assert(track->finalized);
+  // finds the last segment starting at or before pts
+  size_t lo = 0;
+  size_t hi = track->nb_bounds;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (track->bounds[mid] <= pts)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo == 0)
+    return 0;
+
+  size_t first = track->segments[lo - 1];
+  size_t count = track->segments[lo] - first;
+  if (cues)
+    memcpy((void*)cues, (const void*)&track->active[first],
+           sve4_min(count, max_cues) * sizeof *cues);
+#pragma GCC diagnostic pop
+  return count;
+}
+
+void sve4_decode_subtitle_track_free(
+    sve4_decode_subtitle_track_t* _Nonnull track) {
+  for (size_t i = 0; i < track->nb_cues; ++i) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+    sve4_decode_subtitle_cue_t* cue = track->cues[i];
+#pragma GCC diagnostic pop
+    sve4_free(track->allocator, cue->text);
+    sve4_free(track->allocator, cue->ass);
+    sve4_decode_frame_free(&cue->bitmap);
+    sve4_free(track->allocator, cue);
+  }
+  sve4_free(track->allocator, track->cues);
+  sve4_free(track->allocator, track->open);
+  free_segments(track);
+  sve4_decode_subtitle_track_init(track, track->allocator);
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sve4_decode_export.h"
+
+#include "libsve4_utils/allocator.h"
+#include "libsve4_utils/defines.h"
+
+#include "error.h"
+#include "frame.h"
+
+// end timestamp of cues whose display duration is not known
+#define SVE4_DECODE_SUBTITLE_END_UNKNOWN INT64_MAX
+
+typedef enum {
+  SVE4_DECODE_SUBTITLE_CUE_TEXT = 0,
+  SVE4_DECODE_SUBTITLE_CUE_BITMAP,
+} sve4_decode_subtitle_cue_kind_t;
+
+typedef struct {
+  sve4_decode_subtitle_cue_kind_t kind;
+  // display interval [start, end), in nanoseconds
+  int64_t start, end;
+  // TEXT cues: UTF-8 text with styling stripped, lines separated by '\n'
+  char* _Nullable text;
+  // TEXT cues: the original ASS event if the codec produced one
+  char* _Nullable ass;
+  // BITMAP cues: RGBA8 ram frame, positioned at (x, y) on the video frame
+  sve4_decode_frame_t bitmap;
+  int32_t x, y;
+} sve4_decode_subtitle_cue_t;
+
+// Time-indexed cue store. Cues are appended in any order, then
+// sve4_decode_subtitle_track_finalize() sorts them by start time and cuts the
+// timeline at every start and end time. Each segment between two consecutive
+// cuts keeps the list of cues active during it, so the cues active at a
+// given timestamp are found with a single O(log n) binary search. The lists
+// take as much memory as the sum over all segments of the cues on screen,
+// which stays a small multiple of n for subtitles. Cues are allocated one by
+// one and never move, so pointers to them stay valid while cues are added.
+typedef struct {
+  sve4_allocator_t* _Nullable allocator;
+  sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues;
+  size_t nb_cues, capacity;
+  // the cues whose end is still unknown, in no particular order
+  sve4_decode_subtitle_cue_t* _Nonnull* _Nullable open;
+  size_t nb_open, open_capacity;
+  // segment i spans [bounds[i], bounds[i + 1]) (the last one never ends),
+  // the cues active during it are active[segments[i]] to
+  // active[segments[i + 1] - 1], in start time order
+  int64_t* _Nullable bounds;
+  size_t* _Nullable segments;
+  const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable active;
+  size_t nb_bounds, active_capacity;
+  bool finalized;
+} sve4_decode_subtitle_track_t;
+
+SVE4_DECODE_EXPORT
+void sve4_decode_subtitle_track_init(
+    sve4_decode_subtitle_track_t* _Nonnull track,
+    sve4_allocator_t* _Nullable allocator);
+
+// text is copied, ass (if not NULL) is copied and stripped into the plain
+// text of the cue when text is NULL
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_subtitle_track_add_text(
+    sve4_decode_subtitle_track_t* _Nonnull track, int64_t start, int64_t end,
+    const char* _Nullable text, const char* _Nullable ass);
+
+// ownership of bitmap is transferred to the track (even on failure)
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_subtitle_track_add_bitmap(
+    sve4_decode_subtitle_track_t* _Nonnull track, int64_t start, int64_t end,
+    int32_t x, int32_t y, sve4_decode_frame_t* _Nonnull bitmap);
+
+// sets the end time of every cue whose end is still unknown and which starts
+// before pts, used by formats that clear the screen with a separate event
+SVE4_DECODE_EXPORT
+void sve4_decode_subtitle_track_close_open_cues(
+    sve4_decode_subtitle_track_t* _Nonnull track, int64_t pts);
+
+SVE4_DECODE_EXPORT
+sve4_decode_error_t sve4_decode_subtitle_track_finalize(
+    sve4_decode_subtitle_track_t* _Nonnull track);
+
+// writes up to max_cues pointers to the cues active at pts (in start time
+// order) and returns the total number of active cues, which may be larger
+// than max_cues. the track must be finalized.
+SVE4_DECODE_EXPORT
+size_t sve4_decode_subtitle_track_query(
+    const sve4_decode_subtitle_track_t* _Nonnull track, int64_t pts,
+    const sve4_decode_subtitle_cue_t* _Nonnull* _Nullable cues,
+    size_t max_cues);
+
+SVE4_DECODE_EXPORT
+void sve4_decode_subtitle_track_free(
+    sve4_decode_subtitle_track_t* _Nonnull track);
@@ -13,6 +13,7 @@
 #include <libsve4_decode/libwebp.h>
 #include <libsve4_decode/ram_frame.h>
 #include <libsve4_utils/allocator.h>
+#include <libsve4_utils/stats_allocator.h>
 #include <munit.h>
 
 #ifdef SVE4_DECODE_HAVE_FFMPEG
@@ -40,10 +41,8 @@ static uint32_t argb8(const uint8_t* ptr) {
                      SVE4_DECODE_ERROR_DEFAULT_SUCCESS);                       \
   } while (0);
 
-static MunitResult test_simple_webp(const MunitParameter params[],
-                                    void* user_data) {
-  (void)user_data;
-
+static sve4_decode_decoder_backend_t
+get_backend(const MunitParameter params[]) {
   sve4_decode_decoder_backend_t backend = SVE4_DECODE_DECODER_BACKEND_AUTO;
   for (; params->name; ++params) {
     if (strcmp(params->name, "backend") == 0) {
@@ -56,7 +55,14 @@ static MunitResult test_simple_webp(const MunitParameter params[],
       }
     }
   }
+  return backend;
+}
 
+static MunitResult test_simple_webp(const MunitParameter params[],
+                                    void* user_data) {
+  (void)user_data;
+
+  sve4_decode_decoder_backend_t backend = get_backend(params);
   const char* path = ASSETS_DIR "4x4.webp";
 
   sve4_decode_decoder_t decoder = {0};
@@ -130,6 +136,46 @@ static MunitResult test_simple_webp(const MunitParameter params[],
   return MUNIT_OK;
 }
 
+static MunitResult test_no_leaks(const MunitParameter params[],
+                                 void* user_data) {
+  (void)user_data;
+
+  sve4_allocator_t allocator;
+  sve4_allocator_t frame_allocator;
+  munit_assert_true(sve4_allocator_stats_init(&allocator, NULL, "decoder"));
+  munit_assert_true(
+      sve4_allocator_stats_init(&frame_allocator, NULL, "frames"));
+
+  sve4_decode_decoder_t decoder = {0};
+  sve4_decode_error_t err;
+  err = sve4_decode_decoder_open(&decoder, &(sve4_decode_decoder_config_t){
+                                               .url = ASSETS_DIR "4x4.webp",
+                                               .backend = get_backend(params),
+                                               .allocator = &allocator,
+                                               .frame_allocator =
+                                                   &frame_allocator,
+                                           });
+  assert_success(err);
+
+  sve4_decode_frame_t frame = {0};
+  err = sve4_decode_decoder_get_frame(&decoder, &frame, NULL);
+  assert_success(err);
+  munit_assert_size(sve4_allocator_stats_get(&frame_allocator).live_bytes, >,
+                    0);
+  sve4_decode_frame_free(&frame);
+  sve4_decode_decoder_close(&decoder);
+
+  sve4_allocator_stats_t stats = sve4_allocator_stats_get(&allocator);
+  munit_assert_size(stats.num_allocs, >, 0);
+  munit_assert_size(stats.live_bytes, ==, 0);
+  stats = sve4_allocator_stats_get(&frame_allocator);
+  munit_assert_size(stats.live_bytes, ==, 0);
+
+  sve4_allocator_stats_destroy(&allocator);
+  sve4_allocator_stats_destroy(&frame_allocator);
+  return MUNIT_OK;
+}
+
 #ifdef SVE4_DECODE_HAVE_FFMPEG
 static MunitResult test_multi_decode_webp(const MunitParameter params[],
                                           void* user_data) {
@@ -370,6 +416,66 @@ static MunitResult test_anim_seek(const MunitParameter params[],
 
   return MUNIT_OK;
 }
+
+static MunitResult test_subtitle_srt(const MunitParameter params[],
+                                     void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  const char* path = ASSETS_DIR "subtitles.srt";
+
+  sve4_decode_decoder_t decoder = {0};
+  sve4_decode_error_t err;
+  err = sve4_decode_decoder_open(
+      &decoder, &(sve4_decode_decoder_config_t){
+                    .url = path,
+                    .backend = SVE4_DECODE_DECODER_BACKEND_FFMPEG,
+                    .stream_chooser = sve4_decode_stream_chooser_typed(
+                        SVE4_DECODE_MEDIA_TYPE_SUBTITLE, 0),
+                });
+  assert_success(err);
+
+  const sve4_decode_subtitle_cue_t* cues[4];
+  size_t nb_cues = 4;
+  err = sve4_decode_decoder_get_subtitles(&decoder, (int64_t)500 ms, cues,
+                                          &nb_cues, NULL);
+  assert_success(err);
+  munit_assert_size(nb_cues, ==, 0);
+
+  nb_cues = 4;
+  err = sve4_decode_decoder_get_subtitles(&decoder, (int64_t)1500 ms, cues,
+                                          &nb_cues, NULL);
+  assert_success(err);
+  munit_assert_size(nb_cues, ==, 1);
+  munit_assert_int((int)cues[0]->kind, ==, SVE4_DECODE_SUBTITLE_CUE_TEXT);
+  munit_assert_string_equal(cues[0]->text, "Hello");
+
+  nb_cues = 4;
+  err = sve4_decode_decoder_get_subtitles(&decoder, (int64_t)2200 ms, cues,
+                                          &nb_cues, NULL);
+  assert_success(err);
+  munit_assert_size(nb_cues, ==, 2);
+  munit_assert_string_equal(cues[0]->text, "Hello");
+  munit_assert_string_equal(cues[1]->text, "world");
+  munit_assert_int64(cues[1]->start, ==, (int64_t)2000 ms);
+  munit_assert_int64(cues[1]->end, ==, (int64_t)4000 ms);
+
+  nb_cues = 4;
+  err = sve4_decode_decoder_get_subtitles(&decoder, (int64_t)5500 ms, cues,
+                                          &nb_cues, NULL);
+  assert_success(err);
+  munit_assert_size(nb_cues, ==, 1);
+  munit_assert_string_equal(cues[0]->text, "Two\nlines");
+
+  // subtitle decoders do not produce frames
+  sve4_decode_frame_t frame = {0};
+  err = sve4_decode_decoder_get_frame(&decoder, &frame, NULL);
+  munit_assert_int((int)err.error_code, ==,
+                   SVE4_DECODE_ERROR_DEFAULT_UNIMPLEMENTED);
+
+  sve4_decode_decoder_close(&decoder);
+  return MUNIT_OK;
+}
 #endif
 
 static const MunitSuite test_suite = {
@@ -388,6 +494,27 @@ static const MunitSuite test_suite = {
 #ifdef SVE4_DECODE_HAVE_WEBP
                      "LIBWEBP",
 #endif
+#ifdef SVE4_DECODE_HAVE_FFMPEG
+                     "FFMPEG",
+#endif
+                     NULL,
+                 }},
+                {NULL, NULL},
+            },
+        },
+        {
+            "/no_leaks",
+            test_no_leaks,
+            NULL,
+            NULL,
+            MUNIT_TEST_OPTION_NONE,
+            (MunitParameterEnum[]){
+                {"backend",
+                 (char*[]){
+                     "AUTO",
+#ifdef SVE4_DECODE_HAVE_WEBP
+                     "LIBWEBP",
+#endif
 #ifdef SVE4_DECODE_HAVE_FFMPEG
                      "FFMPEG",
 #endif
@@ -422,6 +549,7 @@ static const MunitSuite test_suite = {
             MUNIT_TEST_OPTION_NONE,
             NULL,
         },
+#ifdef SVE4_DECODE_HAVE_FFMPEG
         {
             "/anim/basic",
             test_anim_basic,
@@ -438,6 +566,15 @@ static const MunitSuite test_suite = {
             MUNIT_TEST_OPTION_NONE,
             NULL,
         },
+        {
+            "/subtitle/srt",
+            test_subtitle_srt,
+            NULL,
+            NULL,
+            MUNIT_TEST_OPTION_NONE,
+            NULL,
+        },
+#endif
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
          NULL} /* Mark the end of the array */
     },
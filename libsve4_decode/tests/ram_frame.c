@@ -0,0 +1,187 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "libsve4_log/init_test.h"
+
+#include <libsve4_decode/error.h>
+#include <libsve4_decode/frame.h>
+#include <libsve4_decode/ram_frame.h>
+#include <libsve4_utils/buffer.h>
+#include <libsve4_utils/buffer_pool.h>
+#include <libsve4_utils/formats.h>
+#include <libsve4_utils/pixconv.h>
+#include <munit.h>
+
+#define assert_success(expr)                                                   \
+  do {                                                                         \
+    sve4_decode_error_t err = (expr);                                          \
+    munit_assert_int((int)err.source, ==, SVE4_DECODE_ERROR_SRC_DEFAULT);      \
+    munit_assert_int((int)err.error_code, ==,                                  \
+                     SVE4_DECODE_ERROR_DEFAULT_SUCCESS);                       \
+  } while (0)
+
+static MunitResult test_convert(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  enum { WIDTH = 33, HEIGHT = 17 };
+  sve4_decode_frame_t yuv = {0};
+  sve4_decode_frame_t rgba = {0};
+  assert_success(sve4_decode_alloc_ram_frame(
+      &yuv, NULL, sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_NV12), WIDTH, HEIGHT,
+      (const size_t[]){16, 16}));
+  assert_success(sve4_decode_alloc_ram_frame(
+      &rgba, NULL, sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8), WIDTH,
+      HEIGHT, (const size_t[]){16}));
+
+  // limited range white
+  sve4_decode_ram_frame_t* yuv_frame = sve4_buffer_get_data(yuv.buffer);
+  memset(yuv_frame->data[0], 235, yuv_frame->linesizes[0] * HEIGHT);
+  memset(yuv_frame->data[1], 128, yuv_frame->linesizes[1] * (HEIGHT + 1) / 2);
+  yuv.pts = 42;
+
+  assert_success(sve4_decode_ram_frame_convert(&rgba, &yuv, NULL));
+  munit_assert_int64(rgba.pts, ==, 42);
+
+  sve4_decode_ram_frame_t* rgba_frame = sve4_buffer_get_data(rgba.buffer);
+  for (size_t row = 0; row < HEIGHT; ++row) {
+    const uint8_t* line = rgba_frame->data[0] + row * rgba_frame->linesizes[0];
+    for (size_t x = 0; x < WIDTH * 4; ++x)
+      munit_assert_uint8(line[x], ==, 255);
+  }
+
+  // conversions to YUV are not supported
+  sve4_decode_error_t err = sve4_decode_ram_frame_convert(&yuv, &rgba, NULL);
+  munit_assert_int((int)err.error_code, ==,
+                   SVE4_DECODE_ERROR_DEFAULT_UNIMPLEMENTED);
+
+  sve4_decode_frame_free(&yuv);
+  sve4_decode_frame_free(&rgba);
+  return MUNIT_OK;
+}
+
+static MunitResult test_crop(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  enum { WIDTH = 8, HEIGHT = 6 };
+  sve4_decode_frame_t frame = {0};
+  assert_success(sve4_decode_alloc_ram_frame(
+      &frame, NULL, sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV420P), WIDTH,
+      HEIGHT, (const size_t[]){16, 16, 16}));
+  frame.pts = 7;
+
+  // every sample holds its coordinates
+  sve4_decode_ram_frame_t* ram_frame = sve4_buffer_get_data(frame.buffer);
+  for (size_t i = 0; i < 3; ++i) {
+    size_t shift = i ? 1 : 0;
+    for (size_t row = 0; row < (size_t)HEIGHT >> shift; ++row)
+      for (size_t x = 0; x < (size_t)WIDTH >> shift; ++x)
+        ram_frame->data[i][row * ram_frame->linesizes[i] + x] =
+            (uint8_t)(i << 6 | row << 3 | x);
+  }
+
+  sve4_decode_frame_t view = {0};
+  assert_success(sve4_decode_ram_frame_crop(&view, NULL, &frame, 2, 4, 5, 2));
+  munit_assert_size(view.width, ==, 5);
+  munit_assert_size(view.height, ==, 2);
+  munit_assert_int64(view.pts, ==, 7);
+  munit_assert_ptr_not_equal(view.buffer, frame.buffer);
+
+  sve4_decode_ram_frame_t* view_frame = sve4_buffer_get_data(view.buffer);
+  munit_assert_ptr_equal(view_frame->parent, frame.buffer);
+  munit_assert_uint8(view_frame->data[0][0], ==, 4 << 3 | 2);
+  munit_assert_uint8(view_frame->data[0][view_frame->linesizes[0] + 4], ==,
+                     5 << 3 | 6);
+  munit_assert_uint8(view_frame->data[1][0], ==, 1 << 6 | 2 << 3 | 1);
+  munit_assert_uint8(view_frame->data[2][2], ==, 2 << 6 | 2 << 3 | 3);
+
+  // views of views reference the original frame
+  sve4_decode_frame_t nested = {0};
+  assert_success(sve4_decode_ram_frame_crop(&nested, NULL, &view, 2, 0, 2, 2));
+  sve4_decode_ram_frame_t* nested_frame = sve4_buffer_get_data(nested.buffer);
+  munit_assert_ptr_equal(nested_frame->parent, frame.buffer);
+  munit_assert_uint8(nested_frame->data[0][0], ==, 4 << 3 | 4);
+
+  // chroma samples can not be split, and views must stay inside the frame
+  sve4_decode_frame_t invalid = {0};
+  sve4_decode_error_t crop_err =
+      sve4_decode_ram_frame_crop(&invalid, NULL, &frame, 1, 0, 2, 2);
+  munit_assert_int((int)crop_err.error_code, ==,
+                   SVE4_DECODE_ERROR_DEFAULT_INVALID_FORMAT);
+  crop_err = sve4_decode_ram_frame_crop(&invalid, NULL, &frame, 4, 4, 6, 2);
+  munit_assert_int((int)crop_err.error_code, ==,
+                   SVE4_DECODE_ERROR_DEFAULT_INVALID_FORMAT);
+  munit_assert_null(invalid.buffer);
+
+  // the pixels outlive the original frame
+  sve4_decode_frame_free(&frame);
+  sve4_decode_frame_free(&view);
+
+  sve4_decode_frame_t rgba = {0};
+  assert_success(sve4_decode_alloc_ram_frame(
+      &rgba, NULL, sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8), 2, 2,
+      (const size_t[]){1}));
+  assert_success(sve4_decode_ram_frame_convert(&rgba, &nested, NULL));
+
+  sve4_decode_frame_free(&nested);
+  sve4_decode_frame_free(&rgba);
+  return MUNIT_OK;
+}
+
+static MunitResult test_pooled(const MunitParameter params[],
+                               void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_buffer_pool_t* pool = sve4_buffer_pool_create(NULL, 1, 2);
+  munit_assert_not_null(pool);
+  const sve4_pixfmt_t fmt = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV420P);
+
+  sve4_decode_frame_t frame = {0};
+  assert_success(sve4_decode_alloc_ram_frame_pooled(
+      &frame, pool, fmt, 16, 16, (const size_t[]){32, 32, 32}));
+  sve4_buffer_ref_t buffer = frame.buffer;
+  sve4_decode_ram_frame_t* ram_frame = sve4_buffer_get_data(buffer);
+  ram_frame->parent = sve4_buffer_ref(buffer);
+  sve4_buffer_unref(ram_frame->parent);
+  sve4_decode_frame_free(&frame);
+
+  // same layout, same buffer, with a clean header
+  assert_success(sve4_decode_alloc_ram_frame_pooled(
+      &frame, pool, fmt, 16, 16, (const size_t[]){32, 32, 32}));
+  munit_assert_ptr_equal(frame.buffer, buffer);
+  ram_frame = sve4_buffer_get_data(frame.buffer);
+  munit_assert_null(ram_frame->parent);
+  munit_assert_size(ram_frame->linesizes[1], ==, 32);
+
+  sve4_decode_frame_t other = {0};
+  assert_success(sve4_decode_alloc_ram_frame_pooled(
+      &other, pool, fmt, 32, 16, (const size_t[]){32, 32, 32}));
+  munit_assert_ptr_not_equal(other.buffer, buffer);
+
+  sve4_decode_frame_free(&frame);
+  sve4_decode_frame_free(&other);
+  sve4_buffer_pool_unref(pool);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {"/convert", test_convert, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/crop", test_crop, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/pooled", test_pooled, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {
+    "/ram_frame", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  sve4_log_test_setup();
+  int ret = munit_suite_main(&test_suite, NULL, argc, argv);
+  sve4_log_test_teardown();
+  return ret;
+}
@@ -13,6 +13,8 @@
 #include <libsve4_decode/libwebp.h>
 #include <libsve4_decode/ram_frame.h>
 #include <libsve4_utils/allocator.h>
+#include <libsve4_utils/arena.h>
+#include <libsve4_utils/buffer.h>
 #include <munit.h>
 
 #include "http.h"
@@ -259,6 +261,33 @@ static MunitResult test_binary_read_file_alloc(const MunitParameter params[],
   return MUNIT_OK;
 }
 
+static MunitResult test_binary_read_file_view(const MunitParameter params[],
+                                              void* user_data) {
+  (void)user_data;
+
+  const char* url = NULL;
+  for (const MunitParameter* par = params; par->name; ++par) {
+    if (strcmp(par->name, "url") == 0)
+      url = par->value;
+  }
+  munit_assert_not_null(url);
+
+  sve4_buffer_view_t view;
+  sve4_decode_error_t err = sve4_decode_read_url_view(NULL, &view, url, true);
+  assert_success(err);
+
+  size_t expected_size = is_dos_txt_file(url) ? 119 : 117;
+  munit_assert_size(view.length, ==, expected_size);
+  munit_assert_memory_equal(8, sve4_buffer_view_get_data(&view), "guys the");
+
+  // a slice shares the storage and outlives the view
+  sve4_buffer_view_t word = sve4_buffer_view_slice(&view, 5, 4);
+  sve4_buffer_view_unref(&view);
+  munit_assert_memory_equal(4, sve4_buffer_view_get_data(&word), "they");
+  sve4_buffer_view_unref(&word);
+  return MUNIT_OK;
+}
+
 static MunitResult
 test_binary_read_file_truncated(const MunitParameter params[],
                                 void* user_data) {
@@ -469,6 +498,62 @@ static MunitResult test_read_pipe_alloc(const MunitParameter params[],
 
   return MUNIT_OK;
 }
+
+enum { LARGE_PIPE_SIZE = 4 << 20 };
+
+static int test_read_pipe_large_write_thread(void* ptr) {
+  (void)ptr;
+  int fd = open(PIPE_FIFO_URL, O_WRONLY);
+  assert(fd >= 0);
+  char chunk[4096];
+  for (size_t i = 0; i < sizeof chunk; ++i)
+    chunk[i] = (char)('a' + i % 26);
+  for (size_t written = 0; written < LARGE_PIPE_SIZE;) {
+    ssize_t num_write = write(fd, chunk, sizeof chunk);
+    if (num_write <= 0)
+      exit(1);
+    written += (size_t)num_write;
+  }
+  close(fd);
+  return 0;
+}
+
+static MunitResult test_read_pipe_large(const MunitParameter params[],
+                                        void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  unlink(PIPE_FIFO_URL);
+  munit_assert_int(mkfifo(PIPE_FIFO_URL, 0666), ==, 0);
+
+  thrd_t write_thread;
+  int thrd_err =
+      thrd_create(&write_thread, test_read_pipe_large_write_thread, NULL);
+  munit_assert_int(thrd_err, ==, thrd_success);
+
+  char* buffer = NULL;
+  size_t bufsize = SIZE_MAX;
+  sve4_decode_error_t err =
+      sve4_decode_read_url(NULL, &buffer, &bufsize, PIPE_FIFO_URL, false);
+  assert_success(err);
+  munit_assert_size(bufsize, ==, LARGE_PIPE_SIZE);
+  munit_assert_int(buffer[bufsize - 1], ==, 'a' + 4095 % 26);
+  sve4_free(NULL, buffer);
+
+  int res = 0;
+  thrd_join(write_thread, &res);
+  munit_assert_int(res, ==, 0);
+  unlink(PIPE_FIFO_URL);
+
+  // the pages of the read do not stay on this thread
+  sve4_scratch_t scratch;
+  munit_assert_true(sve4_scratch_begin(&scratch, NULL));
+  munit_assert_size(sve4_allocator_arena_get_capacity(scratch.arena), <=,
+                    SVE4_ARENA_DEFAULT_REGION_SIZE);
+  sve4_scratch_end(&scratch);
+
+  return MUNIT_OK;
+}
 #endif
 
 static MunitResult test_read_http_basic(const MunitParameter params[],
@@ -646,6 +731,22 @@ static const MunitSuite test_suite = {
                 {NULL, NULL},
             },
         },
+        {
+            "/binary/read_file_view",
+            test_binary_read_file_view,
+            NULL,
+            NULL,
+            MUNIT_TEST_OPTION_NONE,
+            (MunitParameterEnum[]){
+                {"url",
+                 (char*[]){
+                     ASSETS_DIR "alice.unix.txt",
+                     ASSETS_DIR "alice.dos.txt",
+                     NULL,
+                 }},
+                {NULL, NULL},
+            },
+        },
         {
             "/binary/read_file_truncated",
             test_binary_read_file_truncated,
@@ -695,6 +796,14 @@ static const MunitSuite test_suite = {
             MUNIT_TEST_OPTION_NONE,
             NULL,
         },
+        {
+            "/text/fifo_large",
+            test_read_pipe_large,
+            NULL,
+            NULL,
+            MUNIT_TEST_OPTION_NONE,
+            NULL,
+        },
         {
             "/binary/dev_null",
             test_read_file_dev_null,
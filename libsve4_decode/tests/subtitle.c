@@ -0,0 +1,275 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libsve4_decode/subtitle.h"
+#include "libsve4_log/init_test.h"
+
+#include <libsve4_decode/error.h>
+#include <libsve4_decode/frame.h>
+#include <libsve4_decode/ram_frame.h>
+#include <libsve4_utils/formats.h>
+#include <munit.h>
+
+#define assert_success(expr)                                                   \
+  do {                                                                         \
+    sve4_decode_error_t err = (expr);                                          \
+    munit_assert_int((int)err.source, ==, SVE4_DECODE_ERROR_SRC_DEFAULT);      \
+    munit_assert_int((int)err.error_code, ==,                                  \
+                     SVE4_DECODE_ERROR_DEFAULT_SUCCESS);                       \
+  } while (0)
+
+static MunitResult test_query(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_decode_subtitle_track_t track;
+  sve4_decode_subtitle_track_init(&track, NULL);
+
+  // inserted out of order on purpose
+  assert_success(
+      sve4_decode_subtitle_track_add_text(&track, 50, 60, "third", NULL));
+  assert_success(
+      sve4_decode_subtitle_track_add_text(&track, 0, 10, "first", NULL));
+  assert_success(
+      sve4_decode_subtitle_track_add_text(&track, 5, 100, "long", NULL));
+  assert_success(
+      sve4_decode_subtitle_track_add_text(&track, 10, 20, "second", NULL));
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+
+  const sve4_decode_subtitle_cue_t* cues[4];
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, -1, cues, 4), ==,
+                    0);
+
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 0, cues, 4), ==,
+                    1);
+  munit_assert_string_equal(cues[0]->text, "first");
+
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 9, cues, 4), ==,
+                    2);
+  munit_assert_string_equal(cues[0]->text, "first");
+  munit_assert_string_equal(cues[1]->text, "long");
+
+  // end is exclusive
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 10, cues, 4), ==,
+                    2);
+  munit_assert_string_equal(cues[0]->text, "long");
+  munit_assert_string_equal(cues[1]->text, "second");
+
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 30, cues, 4), ==,
+                    1);
+  munit_assert_string_equal(cues[0]->text, "long");
+
+  // only the count is reported when there is no room
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 55, NULL, 0), ==,
+                    2);
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 55, cues, 1), ==,
+                    2);
+  munit_assert_string_equal(cues[0]->text, "long");
+
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 100, cues, 4), ==,
+                    0);
+
+  sve4_decode_subtitle_track_free(&track);
+  return MUNIT_OK;
+}
+
+static MunitResult test_many(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_decode_subtitle_track_t track;
+  sve4_decode_subtitle_track_init(&track, NULL);
+
+  enum { NB_CUES = 1000 };
+  for (int64_t i = NB_CUES - 1; i >= 0; --i)
+    assert_success(sve4_decode_subtitle_track_add_text(&track, i * 10,
+                                                       i * 10 + 15, "x", NULL));
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+
+  const sve4_decode_subtitle_cue_t* cues[4];
+  for (int64_t pts = 0; pts < NB_CUES * 10; ++pts) {
+    size_t count = sve4_decode_subtitle_track_query(&track, pts, cues, 4);
+    size_t expected = (pts % 10 < 5 && pts >= 10) ? 2 : 1;
+    munit_assert_size(count, ==, expected);
+    for (size_t i = 0; i < count; ++i) {
+      munit_assert_int64(cues[i]->start, <=, pts);
+      munit_assert_int64(cues[i]->end, >, pts);
+    }
+  }
+
+  sve4_decode_subtitle_track_free(&track);
+  return MUNIT_OK;
+}
+
+static MunitResult test_overlapping(const MunitParameter params[],
+                                    void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_decode_subtitle_track_t track;
+  sve4_decode_subtitle_track_init(&track, NULL);
+
+  enum { NB_CUES = 300, MAX_PTS = 200, MAX_COUNT = NB_CUES };
+  for (int i = 0; i < NB_CUES; ++i) {
+    int64_t start = munit_rand_int_range(0, MAX_PTS);
+    int64_t end = munit_rand_int_range(0, 7) == 0
+                      ? SVE4_DECODE_SUBTITLE_END_UNKNOWN
+                      : start + munit_rand_int_range(0, MAX_PTS / 4);
+    assert_success(
+        sve4_decode_subtitle_track_add_text(&track, start, end, "x", NULL));
+  }
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+
+  static const sve4_decode_subtitle_cue_t* cues[MAX_COUNT];
+  for (int64_t pts = -1; pts <= MAX_PTS * 2; ++pts) {
+    size_t expected = 0;
+    for (size_t i = 0; i < track.nb_cues; ++i)
+      expected += track.cues[i]->start <= pts && track.cues[i]->end > pts;
+    size_t count =
+        sve4_decode_subtitle_track_query(&track, pts, cues, MAX_COUNT);
+    munit_assert_size(count, ==, expected);
+    for (size_t i = 0; i < count; ++i) {
+      munit_assert_int64(cues[i]->start, <=, pts);
+      munit_assert_int64(cues[i]->end, >, pts);
+      if (i > 0)
+        munit_assert_int64(cues[i - 1]->start, <=, cues[i]->start);
+    }
+  }
+
+  sve4_decode_subtitle_track_free(&track);
+  return MUNIT_OK;
+}
+
+static MunitResult test_ass(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_decode_subtitle_track_t track;
+  sve4_decode_subtitle_track_init(&track, NULL);
+  assert_success(sve4_decode_subtitle_track_add_text(
+      &track, 0, 10, NULL,
+      "0,0,Default,,0,0,0,,{\\i1}Hello{\\i0},\\Nworld\\hagain"));
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+
+  const sve4_decode_subtitle_cue_t* cue = NULL;
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 0, &cue, 1), ==,
+                    1);
+  munit_assert_int((int)cue->kind, ==, SVE4_DECODE_SUBTITLE_CUE_TEXT);
+  munit_assert_string_equal(cue->text, "Hello,\nworld again");
+  munit_assert_not_null(cue->ass);
+
+  sve4_decode_subtitle_track_free(&track);
+  return MUNIT_OK;
+}
+
+static MunitResult test_open_cues(const MunitParameter params[],
+                                  void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_decode_subtitle_track_t track;
+  sve4_decode_subtitle_track_init(&track, NULL);
+
+  sve4_decode_frame_t bitmap = {0};
+  assert_success(sve4_decode_alloc_ram_frame(
+      &bitmap, NULL, sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8), 2, 2,
+      (const size_t[]){1}));
+  assert_success(sve4_decode_subtitle_track_add_bitmap(
+      &track, 100, SVE4_DECODE_SUBTITLE_END_UNKNOWN, 4, 8, &bitmap));
+  munit_assert_null(bitmap.buffer);
+
+  const sve4_decode_subtitle_cue_t* cue = NULL;
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, INT64_MAX - 1,
+                                                     &cue, 1),
+                    ==, 1);
+
+  sve4_decode_subtitle_track_close_open_cues(&track, 200);
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+  munit_assert_size(
+      sve4_decode_subtitle_track_query(&track, INT64_MAX - 1, &cue, 1), ==, 0);
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 150, &cue, 1), ==,
+                    1);
+  munit_assert_int((int)cue->kind, ==, SVE4_DECODE_SUBTITLE_CUE_BITMAP);
+  munit_assert_int64(cue->end, ==, 200);
+  munit_assert_int32(cue->x, ==, 4);
+  munit_assert_int32(cue->y, ==, 8);
+  munit_assert_not_null(cue->bitmap.buffer);
+
+  sve4_decode_subtitle_track_free(&track);
+  return MUNIT_OK;
+}
+
+static MunitResult test_close_later(const MunitParameter params[],
+                                    void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_decode_subtitle_track_t track;
+  sve4_decode_subtitle_track_init(&track, NULL);
+  assert_success(sve4_decode_subtitle_track_add_text(
+      &track, 50, SVE4_DECODE_SUBTITLE_END_UNKNOWN, "late", NULL));
+  assert_success(sve4_decode_subtitle_track_add_text(
+      &track, 10, SVE4_DECODE_SUBTITLE_END_UNKNOWN, "early", NULL));
+
+  // only the cues starting before pts are closed
+  sve4_decode_subtitle_track_close_open_cues(&track, 30);
+  munit_assert_size(track.nb_open, ==, 1);
+
+  // the cue that stays open is still found once the cues are sorted
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+  sve4_decode_subtitle_track_close_open_cues(&track, 80);
+  munit_assert_size(track.nb_open, ==, 0);
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+
+  const sve4_decode_subtitle_cue_t* cue = NULL;
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 20, &cue, 1), ==,
+                    1);
+  munit_assert_string_equal(cue->text, "early");
+  munit_assert_int64(cue->end, ==, 30);
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 60, &cue, 1), ==,
+                    1);
+  munit_assert_string_equal(cue->text, "late");
+  munit_assert_int64(cue->end, ==, 80);
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 80, &cue, 1), ==,
+                    0);
+
+  // cues found earlier outlive later additions
+  const sve4_decode_subtitle_cue_t* early = NULL;
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 20, &early, 1),
+                    ==, 1);
+  for (int64_t i = 0; i < 100; ++i)
+    assert_success(sve4_decode_subtitle_track_add_text(&track, 100 + i,
+                                                       101 + i, "more", NULL));
+  assert_success(sve4_decode_subtitle_track_finalize(&track));
+  munit_assert_string_equal(early->text, "early");
+  munit_assert_size(sve4_decode_subtitle_track_query(&track, 20, &cue, 1), ==,
+                    1);
+  munit_assert_ptr_equal(cue, early);
+
+  sve4_decode_subtitle_track_free(&track);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {"/query", test_query, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/many", test_many, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/overlapping", test_overlapping, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/ass", test_ass, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/open_cues", test_open_cues, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/close_later", test_close_later, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {
+    "/subtitle", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  sve4_log_test_setup();
+  int ret = munit_suite_main(&test_suite, NULL, argc, argv);
+  sve4_log_test_teardown();
+  return ret;
+}
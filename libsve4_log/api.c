@@ -7,6 +7,9 @@
 
 #include <libsve4_utils/defines.h>
 
+#include "async.h"
+#include "recorder.h"
+
 void sve4__flog(sve4_log_id_t log_id, const char* _Nonnull file, size_t line,
                 sve4_log_level_t level, const char* _Nonnull fmt, ...) {
   va_list args;
@@ -22,11 +25,14 @@ void sve4__panic(sve4_log_id_t log_id, const char* _Nonnull file, size_t line,
                  const char* _Nonnull fmt, ...) {
   va_list args;
   va_start(args, fmt);
+  // do not lose whatever the writer has not written yet
+  sve4_log_flush();
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
   sve4__flogv(log_id, file, line, SVE4_LOG_LEVEL_ERROR, fmt, args);
   va_end(args);
 #pragma GCC diagnostic pop
+  sve4_log_dump_recorders();
   exit(1);
 }
 
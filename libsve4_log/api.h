@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stddef.h>
 
@@ -24,6 +25,8 @@ typedef enum {
   SVE4_LOG_ID_DEFAULT_FFMPEG,
   SVE4_LOG_ID_DEFAULT_VULKAN,
   SVE4_LOG_ID_DEFAULT_GLFW,
+  // number of ids, which must fit in the bits of an unsigned int
+  SVE4_LOG_ID_MAX,
 } sve4_log_id_t;
 
 #ifndef SVE4_LOG_ID_MAIN
@@ -61,13 +64,120 @@ void sve4_glogv(sve4_log_id_t log_id, const char* _Nonnull file, size_t line,
                 bool endl, sve4_log_level_t level, const char* _Nonnull fmt,
                 va_list args) sve4_gnu_attribute((__format__(printf, 6, 0)));
 
-#define sve4_log(...)                                                          \
-  sve4_glog(SVE4_LOG_ID_MAIN, __FILE__, __LINE__, true, __VA_ARGS__)
+// LEVEL FILTERING
+//
+// Messages below SVE4_LOG_MIN_LEVEL are compiled out of the macros below, so
+// e.g. -DSVE4_LOG_MIN_LEVEL=SVE4_LOG_LEVEL_INFO removes every debug call site
+// (their arguments are not evaluated either). Past that, the macros check
+// whether any config accepts the level for SVE4_LOG_ID_MAIN before calling
+// into the library, so messages nobody listens to cost a relaxed atomic load.
+// Configs may set different levels for each id, e.g. to enable FFmpeg debug
+// logs without the ones of sve4_decode.
+#ifndef SVE4_LOG_MIN_LEVEL
+#define SVE4_LOG_MIN_LEVEL SVE4_LOG_LEVEL_DEBUG
+#endif
+
+// bit log_id of sve4__log_id_masks[level] is set if any config accepts
+// messages of log_id at level, all zero if there are no configs
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+SVE4_LOG_EXPORT extern atomic_uint sve4__log_id_masks[SVE4_LOG_LEVEL_MAX];
+
+static inline unsigned sve4__log_id_mask(sve4_log_level_t level) {
+  if (level < SVE4_LOG_MIN_LEVEL || level < SVE4_LOG_LEVEL_DEBUG)
+    return 0;
+  // higher levels are filtered like errors
+  int index = level < SVE4_LOG_LEVEL_MAX ? (int)level : SVE4_LOG_LEVEL_ERROR;
+  return atomic_load_explicit(&sve4__log_id_masks[index],
+                              memory_order_relaxed);
+}
+
+static inline bool sve4_log_id_enabled(sve4_log_id_t log_id,
+                                       sve4_log_level_t level) {
+  return (unsigned)log_id < SVE4_LOG_ID_MAX &&
+         (sve4__log_id_mask(level) >> log_id & 1U);
+}
+
+// whether messages of level are accepted for any log id
+static inline bool sve4_log_level_enabled(sve4_log_level_t level) {
+  return sve4__log_id_mask(level) != 0;
+}
+
+#define sve4_log(level, ...)                                                   \
+  do {                                                                         \
+    if (sve4_log_id_enabled(SVE4_LOG_ID_MAIN, level))                          \
+      sve4_glog(SVE4_LOG_ID_MAIN, __FILE__, __LINE__, true, (level),           \
+                __VA_ARGS__);                                                  \
+  } while (0)
 #define sve4_log_debug(...) sve4_log(SVE4_LOG_LEVEL_DEBUG, __VA_ARGS__)
 #define sve4_log_info(...) sve4_log(SVE4_LOG_LEVEL_INFO, __VA_ARGS__)
 #define sve4_log_warn(...) sve4_log(SVE4_LOG_LEVEL_WARNING, __VA_ARGS__)
 #define sve4_log_error(...) sve4_log(SVE4_LOG_LEVEL_ERROR, __VA_ARGS__)
 
+// RATE LIMITING
+//
+// For messages logged in hot loops. Every call site of the macros below has
+// its own token bucket: up to burst messages pass at once, then per_second.
+// The rest is dropped and counted, and the next message that passes is
+// preceded by the number of messages suppressed in the meantime. Counts no
+// message came after are reported by sve4_log_flush() and sve4_log_destroy().
+// A message that passes costs a clock read and a compare-and-swap more than
+// sve4_log().
+
+typedef struct sve4_log_rate_limit_t {
+  // theoretical arrival time of the next message, in monotonic nanoseconds
+  // (zero-initialized static storage is a full bucket)
+  atomic_llong next_time;
+  atomic_uint suppressed;
+  // call site, for the suppressed count reported on flush. level is set
+  // when the first message is suppressed, which also adds the limit to the
+  // list of call sites sve4_log_flush() looks at.
+  sve4_log_id_t id;
+  sve4_log_level_t level;
+  const char* _Nonnull file;
+  size_t line;
+  atomic_bool registered;
+  struct sve4_log_rate_limit_t* _Nullable next;
+} sve4_log_rate_limit_t;
+
+#define SVE4_LOG_RATE_LIMIT_PER_SECOND 5
+#define SVE4_LOG_RATE_LIMIT_BURST 10
+
+// returns whether the message may be logged, and in that case the number of
+// messages suppressed since the last one
+SVE4_LOG_EXPORT
+bool sve4__log_rate_limit(sve4_log_rate_limit_t* _Nonnull limit,
+                          sve4_log_level_t level, unsigned per_second,
+                          unsigned burst, unsigned* _Nonnull suppressed);
+
+#define sve4_log_ratelimited(level, per_second, burst, ...)                    \
+  do {                                                                         \
+    static sve4_log_rate_limit_t sve4__log_limit = {                           \
+        .id = SVE4_LOG_ID_MAIN, .file = __FILE__, .line = __LINE__};           \
+    unsigned sve4__log_suppressed = 0;                                         \
+    if (sve4_log_id_enabled(SVE4_LOG_ID_MAIN, level) &&                        \
+        sve4__log_rate_limit(&sve4__log_limit, (level), (per_second), (burst), \
+                             &sve4__log_suppressed)) {                         \
+      if (sve4__log_suppressed)                                                \
+        sve4_glog(SVE4_LOG_ID_MAIN, __FILE__, __LINE__, true, (level),         \
+                  "last message repeated %u more times",                       \
+                  sve4__log_suppressed);                                       \
+      sve4_glog(SVE4_LOG_ID_MAIN, __FILE__, __LINE__, true, (level),           \
+                __VA_ARGS__);                                                  \
+    }                                                                          \
+  } while (0)
+#define sve4_log_debug_ratelimited(...)                                        \
+  sve4_log_ratelimited(SVE4_LOG_LEVEL_DEBUG, SVE4_LOG_RATE_LIMIT_PER_SECOND,   \
+                       SVE4_LOG_RATE_LIMIT_BURST, __VA_ARGS__)
+#define sve4_log_info_ratelimited(...)                                         \
+  sve4_log_ratelimited(SVE4_LOG_LEVEL_INFO, SVE4_LOG_RATE_LIMIT_PER_SECOND,    \
+                       SVE4_LOG_RATE_LIMIT_BURST, __VA_ARGS__)
+#define sve4_log_warn_ratelimited(...)                                         \
+  sve4_log_ratelimited(SVE4_LOG_LEVEL_WARNING, SVE4_LOG_RATE_LIMIT_PER_SECOND, \
+                       SVE4_LOG_RATE_LIMIT_BURST, __VA_ARGS__)
+#define sve4_log_error_ratelimited(...)                                        \
+  sve4_log_ratelimited(SVE4_LOG_LEVEL_ERROR, SVE4_LOG_RATE_LIMIT_PER_SECOND,   \
+                       SVE4_LOG_RATE_LIMIT_BURST, __VA_ARGS__)
+
 // path shortening API
 SVE4_LOG_EXPORT
 const char* _Nonnull sve4_log_shorten_path(
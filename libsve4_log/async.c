@@ -0,0 +1,455 @@
+#include "async.h"
+
+#include <stdalign.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "libsve4_utils/allocator.h"
+#include "libsve4_utils/defines.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#include "api.h"
+#include "error.h"
+
+// records start on a cache line of their own, which also guarantees that a
+// padding record fits at the end of the ring
+#define RECORD_ALIGN 64
+#define MIN_RING_SIZE ((size_t)4096)
+// how long the writer sleeps when nobody wakes it up, in nanoseconds
+#define POLL_INTERVAL_NS 10000000L
+#define NS_PER_SEC 1000000000L
+// shorter messages are formatted once, on the stack
+#define STACK_MSG_SIZE 512
+
+typedef struct {
+  // bytes taken by the record, header included
+  size_t size;
+  // the rest of the ring is unused, the next record is at the beginning
+  bool padding;
+  bool endl;
+  sve4_log_level_t level;
+  sve4_log_id_t id;
+  size_t line;
+  const char* _Nonnull file;
+  struct timespec timestamp;
+  // followed by the NUL-terminated message
+} record_t;
+
+// single producer (the owning thread), single consumer (the writer) ring
+typedef struct ring_t {
+  // positions only ever increase, the offset in data is position & mask
+  alignas(RECORD_ALIGN) atomic_size_t head;
+  alignas(RECORD_ALIGN) atomic_size_t tail;
+  // the fields below are only written while the ring is created, or by the
+  // writer with the mutex held
+  alignas(RECORD_ALIGN) struct ring_t* _Nullable next;
+  // set once the owning thread exits, the writer frees the ring after
+  // draining it
+  atomic_bool orphaned;
+  char* _Nonnull data;
+} ring_t;
+
+typedef struct {
+  sve4_log_async_config_t config;
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_t mutex;
+  // wakes the writer up
+  cnd_t work_condvar;
+  // broadcast whenever the writer is done with a pass over the rings
+  cnd_t pass_condvar;
+  thrd_t writer;
+  tss_t thread_ring;
+  // NOLINTEND(misc-include-cleaner)
+
+  // guarded by mutex
+  ring_t* _Nullable rings;
+  bool stopping;
+  bool wake_requested;
+  uint64_t passes_started, passes_done;
+
+  // only used by the writer
+  size_t reported_drops;
+} async_t;
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static atomic_bool running = false;
+static atomic_size_t num_dropped = 0;
+static async_t async;
+static _Thread_local bool is_writer = false;
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+static size_t ring_mask(void) { return async.config.ring_size - 1; }
+
+static record_t* _Nonnull ring_at(const ring_t* _Nonnull ring, size_t pos) {
+  return (record_t*)(void*)(ring->data + (pos & ring_mask()));
+}
+
+static void free_ring(ring_t* _Nonnull ring) {
+  sve4_aligned_free(sve4__log_allocator(), ring, RECORD_ALIGN);
+}
+
+static void orphan_ring(void* _Nullable ring) {
+  if (ring)
+    atomic_store_explicit(&((ring_t*)ring)->orphaned, true,
+                          memory_order_release);
+}
+
+// must be called with the mutex held
+static void wake_writer_locked(void) {
+  async.wake_requested = true;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_signal(&async.work_condvar);
+}
+
+static void wake_writer(void) {
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&async.mutex);
+  wake_writer_locked();
+  mtx_unlock(&async.mutex);
+  // NOLINTEND(misc-include-cleaner)
+}
+
+static ring_t* _Nullable get_thread_ring(void) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  ring_t* ring = tss_get(async.thread_ring);
+  if (sve4_likely(ring))
+    return ring;
+
+  size_t offset = sve4_align_up(sizeof(ring_t), RECORD_ALIGN);
+  char* mem = sve4_aligned_calloc(sve4__log_allocator(),
+                                  offset + async.config.ring_size,
+                                  RECORD_ALIGN);
+  if (!mem)
+    return NULL;
+  ring = (ring_t*)(void*)mem;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->orphaned, false);
+  ring->data = mem + offset;
+  // NOLINTBEGIN(misc-include-cleaner)
+  if (tss_set(async.thread_ring, ring) != thrd_success) {
+    free_ring(ring);
+    return NULL;
+  }
+
+  mtx_lock(&async.mutex);
+  ring->next = async.rings;
+  async.rings = ring;
+  mtx_unlock(&async.mutex);
+  // NOLINTEND(misc-include-cleaner)
+  return ring;
+}
+
+static bool has_room(ring_t* _Nonnull ring, size_t head, size_t total) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  return async.config.ring_size - (head - tail) >= total;
+}
+
+// returns the number of bytes to reserve for a record of size bytes (more if
+// the ring has to be padded first), 0 if the message has to be dropped
+static size_t reserve(ring_t* _Nonnull ring, size_t size) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  size_t to_end = async.config.ring_size - (head & ring_mask());
+  size_t total = to_end < size ? to_end + size : size;
+  if (sve4_likely(has_room(ring, head, total)))
+    return total;
+  if (async.config.overflow == SVE4_LOG_OVERFLOW_DROP)
+    return 0;
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&async.mutex);
+  while (!has_room(ring, head, total)) {
+    wake_writer_locked();
+    cnd_wait(&async.pass_condvar, &async.mutex);
+  }
+  mtx_unlock(&async.mutex);
+  // NOLINTEND(misc-include-cleaner)
+  return total;
+}
+
+bool sve4__log_async_push(sve4_log_id_t log_id, const char* _Nonnull file,
+                          size_t line, bool endl, sve4_log_level_t level,
+                          const struct timespec* _Nonnull timestamp,
+                          const char* _Nonnull fmt, va_list args) {
+  // the writer logs synchronously, it would wait for itself otherwise
+  if (sve4_likely(!atomic_load_explicit(&running, memory_order_acquire)) ||
+      is_writer)
+    return false;
+  ring_t* ring = get_thread_ring();
+  if (!ring)
+    return false;
+
+  char stack_msg[STACK_MSG_SIZE];
+  va_list args_copy;
+  va_copy(args_copy, args);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  int len = vsnprintf(stack_msg, sizeof stack_msg, fmt, args_copy);
+#pragma GCC diagnostic pop
+  va_end(args_copy);
+  if (len < 0)
+    return false;
+
+  size_t max_len = async.config.ring_size / 4 - sizeof(record_t) - 1;
+  size_t msg_len = sve4_min((size_t)len, max_len);
+  size_t size = sve4_align_up(sizeof(record_t) + msg_len + 1, RECORD_ALIGN);
+  size_t total = reserve(ring, size);
+  if (!total) {
+    atomic_fetch_add_explicit(&num_dropped, 1, memory_order_relaxed);
+    return true;
+  }
+
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  if (total != size) {
+    *ring_at(ring, head) = (record_t){
+        .size = total - size,
+        .padding = true,
+        .file = file,
+    };
+    head += total - size;
+  }
+
+  record_t* record = ring_at(ring, head);
+  *record = (record_t){
+      .size = size,
+      .endl = endl,
+      .level = level,
+      .id = log_id,
+      .line = line,
+      .file = file,
+      .timestamp = *timestamp,
+  };
+  char* msg = (char*)(record + 1);
+  if ((size_t)len < sizeof stack_msg) {
+    memcpy(msg, stack_msg, msg_len + 1);
+  } else {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+    vsnprintf(msg, msg_len + 1, fmt, args);
+#pragma GCC diagnostic pop
+  }
+  atomic_store_explicit(&ring->head, head + size, memory_order_release);
+
+  // somebody is probably about to look at the output (or the process is
+  // about to crash), so do not wait for the next poll
+  if (level >= SVE4_LOG_LEVEL_WARNING)
+    wake_writer();
+  return true;
+}
+
+// returns the next record of ring, skipping padding, or NULL if it is empty
+static record_t* _Nullable peek(ring_t* _Nonnull ring) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+  size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+  while (tail != head) {
+    record_t* record = ring_at(ring, tail);
+    if (!record->padding)
+      return record;
+    tail += record->size;
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+  }
+  return NULL;
+}
+
+static bool timestamp_less(const struct timespec* _Nonnull lhs,
+                           const struct timespec* _Nonnull rhs) {
+  return lhs->tv_sec != rhs->tv_sec ? lhs->tv_sec < rhs->tv_sec
+                                    : lhs->tv_nsec < rhs->tv_nsec;
+}
+
+// passes the records of every ring to the callbacks, oldest first
+static void drain(ring_t* _Nullable rings) {
+  while (true) {
+    ring_t* oldest_ring = NULL;
+    record_t* oldest = NULL;
+    for (ring_t* ring = rings; ring; ring = ring->next) {
+      record_t* record = peek(ring);
+      if (record &&
+          (!oldest || timestamp_less(&record->timestamp, &oldest->timestamp))) {
+        oldest = record;
+        oldest_ring = ring;
+      }
+    }
+    if (!oldest || !oldest_ring)
+      return;
+
+    sve4__log_dispatch(oldest->id, oldest->file, oldest->line, oldest->endl,
+                       oldest->level, &oldest->timestamp, "%s",
+                       (const char*)(oldest + 1));
+    size_t tail =
+        atomic_load_explicit(&oldest_ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&oldest_ring->tail, tail + oldest->size,
+                          memory_order_release);
+  }
+}
+
+static void report_drops(void) {
+  size_t dropped = atomic_load_explicit(&num_dropped, memory_order_relaxed);
+  if (dropped == async.reported_drops)
+    return;
+  struct timespec now;
+  sve4__log_now(&now);
+  sve4__log_dispatch(SVE4_LOG_ID_DEFAULT_SVE4_LOG, __FILE__, __LINE__, true,
+                     SVE4_LOG_LEVEL_WARNING, &now,
+                     "dropped %zu log messages, the log rings were full",
+                     dropped - async.reported_drops);
+  async.reported_drops = dropped;
+}
+
+// frees the drained rings of exited threads, must be called with the mutex
+// held
+static void free_orphans(void) {
+  for (ring_t** it = &async.rings; *it;) {
+    ring_t* ring = *it;
+    if (atomic_load_explicit(&ring->orphaned, memory_order_acquire) &&
+        !peek(ring)) {
+      *it = ring->next;
+      free_ring(ring);
+    } else {
+      it = &ring->next;
+    }
+  }
+}
+
+static int writer_main(void* _Nullable arg) {
+  (void)arg;
+  is_writer = true;
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&async.mutex);
+  while (true) {
+    ++async.passes_started;
+    async.wake_requested = false;
+    bool stopping = async.stopping;
+    // rings are only ever added to the front and only removed by this
+    // thread, so the list can be walked without the mutex
+    ring_t* rings = async.rings;
+    mtx_unlock(&async.mutex);
+
+    drain(rings);
+    report_drops();
+
+    mtx_lock(&async.mutex);
+    ++async.passes_done;
+    cnd_broadcast(&async.pass_condvar);
+    free_orphans();
+    if (stopping)
+      break;
+    if (!async.wake_requested) {
+      struct timespec deadline;
+      timespec_get(&deadline, TIME_UTC);
+      deadline.tv_nsec += POLL_INTERVAL_NS;
+      if (deadline.tv_nsec >= NS_PER_SEC) {
+        deadline.tv_nsec -= NS_PER_SEC;
+        ++deadline.tv_sec;
+      }
+      cnd_timedwait(&async.work_condvar, &async.mutex, &deadline);
+    }
+  }
+  mtx_unlock(&async.mutex);
+  // NOLINTEND(misc-include-cleaner)
+  return 0;
+}
+
+sve4_log_error_t
+sve4_log_start_async(const sve4_log_async_config_t* _Nullable config) {
+  if (atomic_load_explicit(&running, memory_order_acquire))
+    return SVE4_LOG_ERROR_SUCCESS;
+
+  sve4_log_async_config_t conf =
+      config ? *config : (sve4_log_async_config_t){0};
+  size_t ring_size = MIN_RING_SIZE;
+  size_t wanted = conf.ring_size ? conf.ring_size
+                                 : SVE4_LOG_ASYNC_DEFAULT_RING_SIZE;
+  while (ring_size < wanted) {
+    if (ring_size > SIZE_MAX / 2)
+      return SVE4_LOG_ERROR_MEMORY;
+    ring_size *= 2;
+  }
+  conf.ring_size = ring_size;
+  async = (async_t){.config = conf};
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  if (mtx_init(&async.mutex, mtx_plain) != thrd_success)
+    goto fail_mutex;
+  if (cnd_init(&async.work_condvar) != thrd_success)
+    goto fail_work_condvar;
+  if (cnd_init(&async.pass_condvar) != thrd_success)
+    goto fail_pass_condvar;
+  if (tss_create(&async.thread_ring, orphan_ring) != thrd_success)
+    goto fail_tss;
+  if (thrd_create(&async.writer, writer_main, NULL) != thrd_success)
+    goto fail_writer;
+  // NOLINTEND(misc-include-cleaner)
+
+  atomic_store_explicit(&running, true, memory_order_release);
+  return SVE4_LOG_ERROR_SUCCESS;
+
+  // NOLINTBEGIN(misc-include-cleaner)
+fail_writer:
+  tss_delete(async.thread_ring);
+fail_tss:
+  cnd_destroy(&async.pass_condvar);
+fail_pass_condvar:
+  cnd_destroy(&async.work_condvar);
+fail_work_condvar:
+  mtx_destroy(&async.mutex);
+fail_mutex:
+  // NOLINTEND(misc-include-cleaner)
+  return SVE4_LOG_ERROR_THREADS;
+}
+
+void sve4_log_stop_async(void) {
+  if (!atomic_load_explicit(&running, memory_order_acquire))
+    return;
+  // from here on, messages are logged synchronously
+  atomic_store_explicit(&running, false, memory_order_release);
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&async.mutex);
+  async.stopping = true;
+  wake_writer_locked();
+  mtx_unlock(&async.mutex);
+  thrd_join(async.writer, NULL);
+
+  // rings of threads that are still alive are freed too, they get a new one
+  // if async logging is started again
+  tss_delete(async.thread_ring);
+  while (async.rings) {
+    ring_t* ring = async.rings;
+    async.rings = ring->next;
+    free_ring(ring);
+  }
+  cnd_destroy(&async.pass_condvar);
+  cnd_destroy(&async.work_condvar);
+  mtx_destroy(&async.mutex);
+  // NOLINTEND(misc-include-cleaner)
+}
+
+void sve4_log_flush(void) {
+  sve4__log_flush_suppressed();
+  if (atomic_load_explicit(&running, memory_order_acquire) && !is_writer) {
+    // NOLINTBEGIN(misc-include-cleaner)
+    mtx_lock(&async.mutex);
+    // the pass in progress may have missed the latest messages
+    uint64_t target = async.passes_started + 1;
+    wake_writer_locked();
+    while (async.passes_done < target)
+      cnd_wait(&async.pass_condvar, &async.mutex);
+    mtx_unlock(&async.mutex);
+    // NOLINTEND(misc-include-cleaner)
+  }
+  sve4__log_flush_callbacks();
+  fflush(NULL);
+}
+
+size_t sve4_log_async_num_dropped(void) {
+  return atomic_load_explicit(&num_dropped, memory_order_relaxed);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "sve4_log_export.h"
+
+#include "libsve4_utils/allocator.h"
+#include "libsve4_utils/defines.h"
+
+#include "api.h"
+#include "error.h"
+#include "init.h"
+
+// ASYNC LOGGING
+//
+// Once started, sve4_glog() (and the logging macros) only formats the message
+// into a ring buffer owned by the calling thread. A background writer thread
+// drains the rings of every thread and runs the callbacks, so hot threads
+// never take the log mutex or wait for the output. Messages of different
+// threads are passed to the callbacks in timestamp order.
+//
+// sve4__flog() stays synchronous, and sve4_panic() flushes the rings before
+// exiting.
+
+// default size of the ring of each thread, in bytes
+#define SVE4_LOG_ASYNC_DEFAULT_RING_SIZE ((size_t)64 * 1024)
+
+typedef enum {
+  // drop the message and count it, the writer reports the number of dropped
+  // messages once it catches up
+  SVE4_LOG_OVERFLOW_DROP,
+  // wait for the writer to make room
+  SVE4_LOG_OVERFLOW_BLOCK,
+} sve4_log_overflow_t;
+
+typedef struct {
+  // per thread, rounded up to a power of two. 0 means
+  // SVE4_LOG_ASYNC_DEFAULT_RING_SIZE. longer messages are truncated to a
+  // quarter of it.
+  size_t ring_size;
+  sve4_log_overflow_t overflow;
+} sve4_log_async_config_t;
+
+// must be called after sve4_log_init(), config may be NULL for the defaults
+SVE4_LOG_EXPORT
+sve4_log_error_t
+sve4_log_start_async(const sve4_log_async_config_t* _Nullable config);
+// writes everything still buffered and stops the writer. logging goes back to
+// being synchronous. no other thread may be logging concurrently.
+// sve4_log_destroy() calls this.
+SVE4_LOG_EXPORT
+void sve4_log_stop_async(void);
+
+// waits until the writer has passed everything logged so far to the
+// callbacks, then runs the flush hook of every callback and flushes every
+// stdio stream. only the latter two happen if logging is synchronous.
+SVE4_LOG_EXPORT
+void sve4_log_flush(void);
+
+// number of messages dropped because a ring was full
+SVE4_LOG_EXPORT
+size_t sve4_log_async_num_dropped(void);
+
+// internal, shared between the sources of sve4_log
+
+// returns false if logging is synchronous, the message is not logged then
+bool sve4__log_async_push(sve4_log_id_t log_id, const char* _Nonnull file,
+                          size_t line, bool endl, sve4_log_level_t level,
+                          const struct timespec* _Nonnull timestamp,
+                          const char* _Nonnull fmt, va_list args)
+    sve4_gnu_attribute((__format__(printf, 7, 0)));
+// runs the callbacks of every config accepting level
+void sve4__log_dispatch(sve4_log_id_t log_id, const char* _Nonnull file,
+                        size_t line, bool endl, sve4_log_level_t level,
+                        const struct timespec* _Nonnull timestamp,
+                        const char* _Nonnull fmt, ...)
+    sve4_gnu_attribute((__format__(printf, 7, 8)));
+sve4_allocator_t* _Nullable sve4__log_allocator(void);
+// current time on the clock set by sve4_log_set_clock()
+void sve4__log_now(struct timespec* _Nonnull timestamp);
+// runs the flush hook of every config
+void sve4__log_flush_callbacks(void);
+// logs the number of messages rate limited call sites suppressed since their
+// last message went through
+void sve4__log_flush_suppressed(void);
+// formats record like sve4_log_to_file() does, with snprintf() semantics:
+// returns the length of the whole line (including the newline if
+// record->endl), buf is truncated to size bytes including the NUL
+int sve4__log_format_record(char* _Nullable buf, size_t size,
+                            sve4_log_record_t* _Nonnull record,
+                            const sve4_log_config_t* _Nullable config,
+                            bool flog, bool ansi);
@@ -0,0 +1,1183 @@
+#include "binary.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdalign.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "libsve4_utils/allocator.h"
+#include "libsve4_utils/buffer.h"
+#include "libsve4_utils/defines.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#include "api.h"
+#include "async.h"
+#include "error.h"
+#include "init.h"
+
+// STREAM FORMAT
+//
+// "SVE4BLOG", uint32_t version, then a sequence of tagged entries:
+// - TAG_THREAD, uint32_t thread: the entries up to the next TAG_THREAD were
+//   logged by that thread. every thread has strings of its own, a stream
+//   starts with thread 0.
+// - TAG_STRING, uint64_t address, uint32_t size, size bytes: defines (or
+//   redefines) the string at address for the current thread
+// - TAG_RECORD, record_header_t, payload_size bytes of arguments, in the
+//   order of the format string: integers as int64_t/uint64_t, floating point
+//   as double, pointers as uint64_t, strings as uint32_t size then the bytes.
+//   * widths and precisions come first, as int64_t.
+
+#define MAGIC "SVE4BLOG"
+#define MAGIC_SIZE (sizeof MAGIC - 1)
+
+enum {
+  VERSION = 2,
+  TAG_STRING = 'S',
+  TAG_RECORD = 'R',
+  TAG_THREAD = 'T',
+  // strings already written by a thread, indexed by address
+  INTERN_CACHE_SIZE = 256,
+  // longer file names and format strings are truncated
+  MAX_STRING_SIZE = 8192,
+  MAX_MESSAGE_SIZE = 8192,
+  // the decoder gives up on streams with more threads than that
+  MAX_THREADS = 1 << 20,
+};
+
+// entries of each thread are buffered in a ring of this size (a power of
+// two), drained by the writer thread of the sink
+#define RING_SIZE ((size_t)64 * 1024)
+#define RING_ALIGN 64
+// how long the writer sleeps when nobody wakes it up, in nanoseconds
+#define POLL_INTERVAL_NS 10000000L
+#define NS_PER_SEC 1000000000L
+
+typedef struct {
+  uint64_t line;
+  uint64_t file;
+  uint64_t fmt;
+  int32_t year;
+  int32_t nsec;
+  int32_t level;
+  int32_t id;
+  uint16_t yday;
+  uint16_t payload_size;
+  uint8_t mon, mday, wday, hour, min, sec;
+  int8_t isdst;
+  uint8_t endl;
+  uint8_t clock;
+} record_header_t;
+
+// a record with the definitions of its file and format strings
+#define MAX_STRING_ENTRY_SIZE                                                  \
+  (1 + sizeof(uint64_t) + sizeof(uint32_t) + MAX_STRING_SIZE)
+#define MAX_ENTRY_SIZE                                                         \
+  (2 * MAX_STRING_ENTRY_SIZE + 1 + sizeof(record_header_t) +                   \
+   SVE4_LOG_BINARY_MAX_PAYLOAD)
+static_assert(MAX_ENTRY_SIZE <= RING_SIZE, "entries must fit in a ring");
+
+typedef enum {
+  LENGTH_NONE,
+  LENGTH_HH,
+  LENGTH_H,
+  LENGTH_L,
+  LENGTH_LL,
+  LENGTH_J,
+  LENGTH_Z,
+  LENGTH_T,
+  LENGTH_LONG_DOUBLE,
+} length_t;
+
+typedef enum {
+  // %%
+  ARG_NONE,
+  // %n, takes a pointer but nothing is stored
+  ARG_WRITEBACK,
+  ARG_SIGNED,
+  ARG_UNSIGNED,
+  ARG_CHAR,
+  ARG_DOUBLE,
+  ARG_STRING,
+  ARG_POINTER,
+  // formatting stops here
+  ARG_UNSUPPORTED,
+} arg_type_t;
+
+typedef struct {
+  // NUL-terminated
+  char flags[8];
+  bool width_star, precision_star;
+  // -1 if missing
+  int width, precision;
+  length_t length;
+  char conversion;
+  arg_type_t type;
+} spec_t;
+
+static const char* _Nonnull parse_int(const char* _Nonnull str,
+                                      int* _Nonnull value) {
+  if (*str < '0' || *str > '9')
+    return str;
+  *value = 0;
+  for (; *str >= '0' && *str <= '9'; ++str)
+    *value = sve4_min(*value * 10 + (*str - '0'), MAX_MESSAGE_SIZE);
+  return str;
+}
+
+static arg_type_t get_arg_type(const spec_t* _Nonnull spec) {
+  switch (spec->conversion) {
+  case '%':
+    return ARG_NONE;
+  case 'n':
+    return ARG_WRITEBACK;
+  case 'd':
+  case 'i':
+    return ARG_SIGNED;
+  case 'u':
+  case 'o':
+  case 'x':
+  case 'X':
+    return ARG_UNSIGNED;
+  case 'c':
+    return spec->length == LENGTH_NONE ? ARG_CHAR : ARG_UNSUPPORTED;
+  case 'f':
+  case 'F':
+  case 'e':
+  case 'E':
+  case 'g':
+  case 'G':
+  case 'a':
+  case 'A':
+    return ARG_DOUBLE;
+  case 's':
+    return spec->length == LENGTH_NONE ? ARG_STRING : ARG_UNSUPPORTED;
+  case 'p':
+    return ARG_POINTER;
+  default:
+    return ARG_UNSUPPORTED;
+  }
+}
+
+// parses the conversion specification after a '%', returns the first
+// character after it
+static const char* _Nonnull parse_spec(const char* _Nonnull fmt,
+                                       spec_t* _Nonnull spec) {
+  *spec = (spec_t){.width = -1, .precision = -1};
+  size_t num_flags = 0;
+  for (; *fmt && strchr("-+ #0", *fmt); ++fmt)
+    if (num_flags + 1 < sizeof spec->flags)
+      spec->flags[num_flags++] = *fmt;
+
+  if (*fmt == '*') {
+    spec->width_star = true;
+    ++fmt;
+  } else {
+    fmt = parse_int(fmt, &spec->width);
+  }
+
+  if (*fmt == '.') {
+    ++fmt;
+    if (*fmt == '*') {
+      spec->precision_star = true;
+      ++fmt;
+    } else {
+      spec->precision = 0;
+      fmt = parse_int(fmt, &spec->precision);
+    }
+  }
+
+  switch (*fmt) {
+  case 'h':
+    spec->length = fmt[1] == 'h' ? LENGTH_HH : LENGTH_H;
+    fmt += spec->length == LENGTH_HH ? 2 : 1;
+    break;
+  case 'l':
+    spec->length = fmt[1] == 'l' ? LENGTH_LL : LENGTH_L;
+    fmt += spec->length == LENGTH_LL ? 2 : 1;
+    break;
+  case 'j':
+    spec->length = LENGTH_J;
+    ++fmt;
+    break;
+  case 'z':
+    spec->length = LENGTH_Z;
+    ++fmt;
+    break;
+  case 't':
+    spec->length = LENGTH_T;
+    ++fmt;
+    break;
+  case 'L':
+    spec->length = LENGTH_LONG_DOUBLE;
+    ++fmt;
+    break;
+  default:
+    break;
+  }
+
+  spec->conversion = *fmt;
+  spec->type = get_arg_type(spec);
+  return *fmt ? fmt + 1 : fmt;
+}
+
+// ENCODING
+
+// a string written to the stream by the thread owning the cache. format and
+// file strings are almost always literals, so the address is checked first
+// and the text is only read again when it does not match
+typedef struct {
+  const char* _Nullable str;
+  // the first bytes of str (up to 8, zero padded): different text showing up
+  // at the same address (a buffer, a freed string) usually starts differently
+  uint64_t prefix;
+} interned_t;
+
+// single producer (the logging thread), single consumer (the writer) ring of
+// encoded entries
+typedef struct ring_t {
+  // positions only ever increase, the offset in data is position % RING_SIZE
+  alignas(RING_ALIGN) atomic_size_t head;
+  alignas(RING_ALIGN) atomic_size_t tail;
+  // only written while the ring is created, or by the writer with the mutex
+  // held
+  alignas(RING_ALIGN) struct ring_t* _Nullable next;
+  // set once the owning thread exits, the writer frees the ring after
+  // draining it
+  atomic_bool orphaned;
+  uint32_t thread;
+  // the fields below are only used by the owning thread
+  interned_t interned[INTERN_CACHE_SIZE];
+  // the entry being encoded
+  unsigned char entry[MAX_ENTRY_SIZE];
+  unsigned char data[RING_SIZE];
+} ring_t;
+
+typedef struct {
+  // NULL if the sink could not be initialized
+  FILE* _Nullable file;
+  bool close;
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_t mutex;
+  // wakes the writer up
+  cnd_t work_condvar;
+  // broadcast whenever the writer is done with a pass over the rings
+  cnd_t pass_condvar;
+  thrd_t writer;
+  tss_t thread_ring;
+  // NOLINTEND(misc-include-cleaner)
+
+  // guarded by mutex
+  ring_t* _Nullable rings;
+  uint32_t num_threads;
+  bool stopping;
+  bool wake_requested;
+  uint64_t passes_started, passes_done;
+
+  // only used by the writer: the thread whose entries were written last
+  uint32_t current_thread;
+} binary_sink_t;
+
+typedef struct {
+  unsigned char* _Nonnull data;
+  size_t size;
+  size_t capacity;
+} writer_t;
+
+static bool put(writer_t* _Nonnull writer, const void* _Nonnull data,
+                size_t size) {
+  if (writer->capacity - writer->size < size)
+    return false;
+  memcpy(writer->data + writer->size, data, size);
+  writer->size += size;
+  return true;
+}
+
+static bool put_signed(writer_t* _Nonnull writer, int64_t value) {
+  return put(writer, &value, sizeof value);
+}
+
+static bool put_unsigned(writer_t* _Nonnull writer, uint64_t value) {
+  return put(writer, &value, sizeof value);
+}
+
+static int64_t read_signed(length_t length, va_list* _Nonnull args) {
+  switch (length) {
+  case LENGTH_HH:
+    return (signed char)va_arg(*args, int);
+  case LENGTH_H:
+    return (short)va_arg(*args, int);
+  case LENGTH_L:
+    return va_arg(*args, long);
+  case LENGTH_LL:
+  case LENGTH_LONG_DOUBLE:
+    return va_arg(*args, long long);
+  case LENGTH_J:
+    return va_arg(*args, intmax_t);
+  case LENGTH_Z:
+  case LENGTH_T:
+    return va_arg(*args, ptrdiff_t);
+  case LENGTH_NONE:
+    break;
+  }
+  return va_arg(*args, int);
+}
+
+static uint64_t read_unsigned(length_t length, va_list* _Nonnull args) {
+  switch (length) {
+  case LENGTH_HH:
+    return (unsigned char)va_arg(*args, unsigned);
+  case LENGTH_H:
+    return (unsigned short)va_arg(*args, unsigned);
+  case LENGTH_L:
+    return va_arg(*args, unsigned long);
+  case LENGTH_LL:
+  case LENGTH_LONG_DOUBLE:
+    return va_arg(*args, unsigned long long);
+  case LENGTH_J:
+    return va_arg(*args, uintmax_t);
+  case LENGTH_Z:
+    return va_arg(*args, size_t);
+  case LENGTH_T:
+    return (size_t)va_arg(*args, ptrdiff_t);
+  case LENGTH_NONE:
+    break;
+  }
+  return va_arg(*args, unsigned);
+}
+
+// like strlen(), but stops after max_len characters
+static size_t string_length(const char* _Nonnull str, size_t max_len) {
+  size_t len = 0;
+  while (len < max_len && str[len])
+    ++len;
+  return len;
+}
+
+// returns false once the arguments cannot be stored anymore
+static bool encode_arg(writer_t* _Nonnull writer, const spec_t* _Nonnull spec,
+                       va_list* _Nonnull args) {
+  int precision = spec->precision;
+  if (spec->width_star && !put_signed(writer, va_arg(*args, int)))
+    return false;
+  if (spec->precision_star) {
+    precision = va_arg(*args, int);
+    if (!put_signed(writer, precision))
+      return false;
+  }
+
+  switch (spec->type) {
+  case ARG_NONE:
+    return true;
+  case ARG_WRITEBACK:
+    (void)va_arg(*args, void*);
+    return true;
+  case ARG_SIGNED:
+    return put_signed(writer, read_signed(spec->length, args));
+  case ARG_UNSIGNED:
+    return put_unsigned(writer, read_unsigned(spec->length, args));
+  case ARG_CHAR:
+    return put_signed(writer, va_arg(*args, int));
+  case ARG_DOUBLE: {
+    double value = spec->length == LENGTH_LONG_DOUBLE
+                       ? (double)va_arg(*args, long double)
+                       : va_arg(*args, double);
+    return put(writer, &value, sizeof value);
+  }
+  case ARG_STRING: {
+    const char* str = va_arg(*args, const char*);
+    if (!str)
+      str = "(null)";
+    if (writer->capacity - writer->size < sizeof(uint32_t))
+      return false;
+    size_t max_len = writer->capacity - writer->size - sizeof(uint32_t);
+    if (precision >= 0)
+      max_len = sve4_min(max_len, (size_t)precision);
+    uint32_t len = (uint32_t)string_length(str, max_len);
+    put(writer, &len, sizeof len);
+    put(writer, str, len);
+    return true;
+  }
+  case ARG_POINTER:
+    return put_unsigned(writer, (uintptr_t)va_arg(*args, void*));
+  case ARG_UNSUPPORTED:
+    break;
+  }
+  return false;
+}
+
+static uint64_t string_prefix(const char* _Nonnull str) {
+  uint64_t prefix = 0;
+  for (size_t i = 0; i < sizeof prefix && str[i]; ++i)
+    prefix |= (uint64_t)(unsigned char)str[i] << (i * CHAR_BIT);
+  return prefix;
+}
+
+// appends the definition of str to entry unless the thread already wrote it
+static void intern(ring_t* _Nonnull ring, writer_t* _Nonnull entry,
+                   const char* _Nonnull str) {
+  interned_t* cached =
+      &ring->interned[((uintptr_t)str / sizeof(void*)) % INTERN_CACHE_SIZE];
+  uint64_t prefix = string_prefix(str);
+  if (sve4_likely(cached->str == str && cached->prefix == prefix))
+    return;
+  *cached = (interned_t){.str = str, .prefix = prefix};
+
+  // the decoder replaces whatever string the thread had at this address
+  uint64_t address = (uintptr_t)str;
+  uint32_t size = (uint32_t)string_length(str, MAX_STRING_SIZE);
+  unsigned char tag = TAG_STRING;
+  put(entry, &tag, sizeof tag);
+  put(entry, &address, sizeof address);
+  put(entry, &size, sizeof size);
+  put(entry, str, size);
+}
+
+static void free_ring(ring_t* _Nonnull ring) {
+  sve4_aligned_free(sve4__log_allocator(), ring, RING_ALIGN);
+}
+
+static void orphan_ring(void* _Nullable ring) {
+  if (ring)
+    atomic_store_explicit(&((ring_t*)ring)->orphaned, true,
+                          memory_order_release);
+}
+
+// must be called with the mutex held
+static void wake_writer_locked(binary_sink_t* _Nonnull sink) {
+  sink->wake_requested = true;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_signal(&sink->work_condvar);
+}
+
+static ring_t* _Nullable get_thread_ring(binary_sink_t* _Nonnull sink) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  ring_t* ring = tss_get(sink->thread_ring);
+  if (sve4_likely(ring))
+    return ring;
+
+  ring = sve4_aligned_calloc(sve4__log_allocator(), sizeof(ring_t),
+                             RING_ALIGN);
+  if (!ring)
+    return NULL;
+  atomic_init(&ring->head, 0);
+  atomic_init(&ring->tail, 0);
+  atomic_init(&ring->orphaned, false);
+  // NOLINTBEGIN(misc-include-cleaner)
+  if (tss_set(sink->thread_ring, ring) != thrd_success) {
+    free_ring(ring);
+    return NULL;
+  }
+
+  mtx_lock(&sink->mutex);
+  ring->thread = sink->num_threads++;
+  ring->next = sink->rings;
+  sink->rings = ring;
+  mtx_unlock(&sink->mutex);
+  // NOLINTEND(misc-include-cleaner)
+  return ring;
+}
+
+static bool has_room(ring_t* _Nonnull ring, size_t head, size_t size) {
+  size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+  return RING_SIZE - (head - tail) >= size;
+}
+
+// copies the entry into the ring, waiting for the writer if it is full
+static void push(binary_sink_t* _Nonnull sink, ring_t* _Nonnull ring,
+                 size_t size, bool wake) {
+  size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+  if (sve4_unlikely(!has_room(ring, head, size))) {
+    // NOLINTBEGIN(misc-include-cleaner)
+    mtx_lock(&sink->mutex);
+    while (!has_room(ring, head, size)) {
+      wake_writer_locked(sink);
+      cnd_wait(&sink->pass_condvar, &sink->mutex);
+    }
+    mtx_unlock(&sink->mutex);
+    // NOLINTEND(misc-include-cleaner)
+  }
+
+  size_t offset = head % RING_SIZE;
+  size_t first = sve4_min(size, RING_SIZE - offset);
+  memcpy(ring->data + offset, ring->entry, first);
+  memcpy(ring->data, ring->entry + first, size - first);
+  atomic_store_explicit(&ring->head, head + size, memory_order_release);
+
+  if (wake) {
+    // NOLINTBEGIN(misc-include-cleaner)
+    mtx_lock(&sink->mutex);
+    wake_writer_locked(sink);
+    mtx_unlock(&sink->mutex);
+    // NOLINTEND(misc-include-cleaner)
+  }
+}
+
+static void binary_callback(sve4_log_record_t* _Nonnull record,
+                            const sve4_log_config_t* _Nonnull config) {
+  assert(config->callback.user_data);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  binary_sink_t* sink =
+      (binary_sink_t*)(void*)sve4_buffer_get_data(config->callback.user_data);
+#pragma GCC diagnostic pop
+  // records of a thread whose ring cannot be allocated are lost
+  ring_t* ring = get_thread_ring(sink);
+  if (!ring)
+    return;
+
+  writer_t entry = {.data = ring->entry, .capacity = sizeof ring->entry};
+  intern(ring, &entry, record->file);
+  intern(ring, &entry, record->msg);
+
+  unsigned char tag = TAG_RECORD;
+  put(&entry, &tag, sizeof tag);
+  // the arguments go after the header, which needs their size
+  unsigned char* header_data = entry.data + entry.size;
+  writer_t payload = {.data = header_data + sizeof(record_header_t),
+                      .capacity = SVE4_LOG_BINARY_MAX_PAYLOAD};
+  va_list args;
+  va_copy(args, record->args);
+  for (const char* fmt = record->msg; (fmt = strchr(fmt, '%'));) {
+    spec_t spec;
+    fmt = parse_spec(fmt + 1, &spec);
+    if (!encode_arg(&payload, &spec, &args))
+      break;
+  }
+  va_end(args);
+
+  record_header_t header;
+  // the padding is written too
+  memset(&header, 0, sizeof header);
+  header.line = record->line;
+  header.file = (uintptr_t)record->file;
+  header.fmt = (uintptr_t)record->msg;
+  header.year = record->timestamp->tm_year;
+  header.nsec = record->fractional_timestamp;
+  header.level = record->level;
+  header.id = (int32_t)record->id;
+  header.yday = (uint16_t)record->timestamp->tm_yday;
+  header.payload_size = (uint16_t)payload.size;
+  header.mon = (uint8_t)record->timestamp->tm_mon;
+  header.mday = (uint8_t)record->timestamp->tm_mday;
+  header.wday = (uint8_t)record->timestamp->tm_wday;
+  header.hour = (uint8_t)record->timestamp->tm_hour;
+  header.min = (uint8_t)record->timestamp->tm_min;
+  header.sec = (uint8_t)record->timestamp->tm_sec;
+  header.isdst = (int8_t)record->timestamp->tm_isdst;
+  header.endl = record->endl;
+  header.clock = (uint8_t)record->clock;
+  memcpy(header_data, &header, sizeof header);
+  entry.size += sizeof header + payload.size;
+
+  // somebody is probably about to look at the output (or the process is
+  // about to crash), so do not wait for the next poll
+  push(sink, ring, entry.size, record->level >= SVE4_LOG_LEVEL_WARNING);
+}
+
+// writes out what the rings hold, thread by thread
+static void drain(binary_sink_t* _Nonnull sink, ring_t* _Nullable rings) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  FILE* file = sink->file;
+#pragma GCC diagnostic pop
+  for (ring_t* ring = rings; ring; ring = ring->next) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (tail == head)
+      continue;
+
+    if (ring->thread != sink->current_thread) {
+      fputc(TAG_THREAD, file);
+      fwrite(&ring->thread, sizeof ring->thread, 1, file);
+      sink->current_thread = ring->thread;
+    }
+    size_t offset = tail % RING_SIZE;
+    size_t first = sve4_min(head - tail, RING_SIZE - offset);
+    fwrite(ring->data + offset, 1, first, file);
+    fwrite(ring->data, 1, head - tail - first, file);
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+  }
+}
+
+// frees the drained rings of exited threads, must be called with the mutex
+// held
+static void free_orphans(binary_sink_t* _Nonnull sink) {
+  for (ring_t** it = &sink->rings; *it;) {
+    ring_t* ring = *it;
+    if (atomic_load_explicit(&ring->orphaned, memory_order_acquire) &&
+        atomic_load_explicit(&ring->head, memory_order_acquire) ==
+            atomic_load_explicit(&ring->tail, memory_order_relaxed)) {
+      *it = ring->next;
+      free_ring(ring);
+    } else {
+      it = &ring->next;
+    }
+  }
+}
+
+static int writer_main(void* _Nullable arg) {
+  binary_sink_t* sink = arg;
+  assert(sink);
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&sink->mutex);
+  while (true) {
+    ++sink->passes_started;
+    sink->wake_requested = false;
+    bool stopping = sink->stopping;
+    // rings are only ever added to the front and only removed by this
+    // thread, so the list can be walked without the mutex
+    ring_t* rings = sink->rings;
+    mtx_unlock(&sink->mutex);
+
+    drain(sink, rings);
+
+    mtx_lock(&sink->mutex);
+    ++sink->passes_done;
+    cnd_broadcast(&sink->pass_condvar);
+    free_orphans(sink);
+    if (stopping)
+      break;
+    if (!sink->wake_requested) {
+      struct timespec deadline;
+      timespec_get(&deadline, TIME_UTC);
+      deadline.tv_nsec += POLL_INTERVAL_NS;
+      if (deadline.tv_nsec >= NS_PER_SEC) {
+        deadline.tv_nsec -= NS_PER_SEC;
+        ++deadline.tv_sec;
+      }
+      cnd_timedwait(&sink->work_condvar, &sink->mutex, &deadline);
+    }
+  }
+  mtx_unlock(&sink->mutex);
+  // NOLINTEND(misc-include-cleaner)
+  return 0;
+}
+
+// waits until the writer has written everything logged so far
+static void binary_flush(const sve4_log_config_t* _Nonnull config) {
+  assert(config->callback.user_data);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  binary_sink_t* sink =
+      (binary_sink_t*)(void*)sve4_buffer_get_data(config->callback.user_data);
+#pragma GCC diagnostic pop
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&sink->mutex);
+  // the pass in progress may have missed the latest records
+  uint64_t target = sink->passes_started + 1;
+  wake_writer_locked(sink);
+  while (sink->passes_done < target)
+    cnd_wait(&sink->pass_condvar, &sink->mutex);
+  mtx_unlock(&sink->mutex);
+  // NOLINTEND(misc-include-cleaner)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  fflush(sink->file);
+#pragma GCC diagnostic pop
+}
+
+static void binary_sink_free(char* _Nonnull data) {
+  binary_sink_t* sink = (binary_sink_t*)(void*)data;
+  if (!sink->file)
+    return;
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&sink->mutex);
+  sink->stopping = true;
+  wake_writer_locked(sink);
+  mtx_unlock(&sink->mutex);
+  // the last pass writes everything out
+  thrd_join(sink->writer, NULL);
+
+  tss_delete(sink->thread_ring);
+  while (sink->rings) {
+    ring_t* ring = sink->rings;
+    sink->rings = ring->next;
+    free_ring(ring);
+  }
+  sink->close ? fclose(sink->file) : fflush(sink->file);
+  cnd_destroy(&sink->pass_condvar);
+  cnd_destroy(&sink->work_condvar);
+  mtx_destroy(&sink->mutex);
+  // NOLINTEND(misc-include-cleaner)
+}
+
+sve4_log_error_t sve4_log_to_binary(sve4_log_callback_t* _Nonnull callback,
+                                    FILE* _Nonnull file, bool close) {
+  uint32_t version = VERSION;
+  if (fwrite(MAGIC, 1, MAGIC_SIZE, file) != MAGIC_SIZE ||
+      fwrite(&version, sizeof version, 1, file) != 1)
+    return SVE4_LOG_ERROR_IO;
+
+  callback->user_data = sve4_buffer_create(
+      sve4__log_allocator(), sizeof(binary_sink_t), binary_sink_free);
+  if (!callback->user_data)
+    return SVE4_LOG_ERROR_MEMORY;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  binary_sink_t* sink =
+      (binary_sink_t*)(void*)sve4_buffer_get_data(callback->user_data);
+#pragma GCC diagnostic pop
+  // a stream starts with thread 0
+  sink->current_thread = 0;
+  sink->file = file;
+  sink->close = close;
+  // NOLINTBEGIN(misc-include-cleaner)
+  if (mtx_init(&sink->mutex, mtx_plain) != thrd_success)
+    goto fail_mutex;
+  if (cnd_init(&sink->work_condvar) != thrd_success)
+    goto fail_work_condvar;
+  if (cnd_init(&sink->pass_condvar) != thrd_success)
+    goto fail_pass_condvar;
+  if (tss_create(&sink->thread_ring, orphan_ring) != thrd_success)
+    goto fail_tss;
+  if (thrd_create(&sink->writer, writer_main, sink) != thrd_success)
+    goto fail_writer;
+  // NOLINTEND(misc-include-cleaner)
+
+  callback->callback = binary_callback;
+  callback->flush = binary_flush;
+  return SVE4_LOG_ERROR_SUCCESS;
+
+  // NOLINTBEGIN(misc-include-cleaner)
+fail_writer:
+  tss_delete(sink->thread_ring);
+fail_tss:
+  cnd_destroy(&sink->pass_condvar);
+fail_pass_condvar:
+  cnd_destroy(&sink->work_condvar);
+fail_work_condvar:
+  mtx_destroy(&sink->mutex);
+fail_mutex:
+  // NOLINTEND(misc-include-cleaner)
+  // nothing to clean up for the destructor
+  sink->file = NULL;
+  sve4_buffer_free(&callback->user_data);
+  return SVE4_LOG_ERROR_THREADS;
+}
+
+// DECODING
+
+typedef struct {
+  uint64_t address;
+  char* _Nullable str;
+} string_entry_t;
+
+// open addressing, keyed by address
+typedef struct {
+  string_entry_t* _Nullable entries;
+  size_t size;
+  size_t capacity;
+} string_table_t;
+
+static string_entry_t* _Nonnull find_entry(string_entry_t* _Nonnull entries,
+                                           size_t capacity, uint64_t address) {
+  size_t i = (size_t)(address / sizeof(void*)) & (capacity - 1);
+  while (entries[i].str && entries[i].address != address)
+    i = (i + 1) & (capacity - 1);
+  return &entries[i];
+}
+
+static bool grow_table(string_table_t* _Nonnull table) {
+  size_t capacity = table->capacity ? table->capacity * 2 : 64;
+  string_entry_t* entries =
+      sve4_calloc(sve4__log_allocator(), capacity * sizeof *entries);
+  if (!entries)
+    return false;
+  for (size_t i = 0; i < table->capacity; ++i) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+    string_entry_t entry = table->entries[i];
+#pragma GCC diagnostic pop
+    if (entry.str)
+      *find_entry(entries, capacity, entry.address) = entry;
+  }
+  sve4_free(sve4__log_allocator(), table->entries);
+  table->entries = entries;
+  table->capacity = capacity;
+  return true;
+}
+
+static const char* _Nullable lookup(const string_table_t* _Nonnull table,
+                                    uint64_t address) {
+  if (!table->entries)
+    return NULL;
+  return find_entry(table->entries, table->capacity, address)->str;
+}
+
+static void free_table(string_table_t* _Nonnull table) {
+  for (size_t i = 0; i < table->capacity; ++i)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+    sve4_free(sve4__log_allocator(), table->entries[i].str);
+#pragma GCC diagnostic pop
+  sve4_free(sve4__log_allocator(), table->entries);
+}
+
+// the string tables of every thread seen so far, indexed by thread
+typedef struct {
+  string_table_t* _Nullable tables;
+  size_t num_tables;
+} thread_tables_t;
+
+static bool grow_threads(thread_tables_t* _Nonnull threads, uint32_t thread) {
+  if (thread < threads->num_tables)
+    return true;
+  size_t num_tables = sve4_max(threads->num_tables * 2, (size_t)thread + 1);
+  string_table_t* tables =
+      sve4_calloc(sve4__log_allocator(), num_tables * sizeof *tables);
+  if (!tables)
+    return false;
+  if (threads->tables)
+    memcpy(tables, threads->tables, threads->num_tables * sizeof *tables);
+  sve4_free(sve4__log_allocator(), threads->tables);
+  threads->tables = tables;
+  threads->num_tables = num_tables;
+  return true;
+}
+
+static void free_threads(thread_tables_t* _Nonnull threads) {
+  for (size_t i = 0; i < threads->num_tables; ++i)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+    free_table(&threads->tables[i]);
+#pragma GCC diagnostic pop
+  sve4_free(sve4__log_allocator(), threads->tables);
+}
+
+typedef enum {
+  READ_OK,
+  // the stream ended, possibly in the middle of an entry
+  READ_END,
+  READ_INVALID,
+  READ_NO_MEMORY,
+} read_result_t;
+
+static bool read_exact(FILE* _Nonnull in, void* _Nonnull data, size_t size) {
+  return fread(data, 1, size, in) == size;
+}
+
+static read_result_t read_thread(FILE* _Nonnull in,
+                                 thread_tables_t* _Nonnull threads,
+                                 uint32_t* _Nonnull current) {
+  uint32_t thread = 0;
+  if (!read_exact(in, &thread, sizeof thread))
+    return READ_END;
+  if (thread >= MAX_THREADS)
+    return READ_INVALID;
+  if (!grow_threads(threads, thread))
+    return READ_NO_MEMORY;
+  *current = thread;
+  return READ_OK;
+}
+
+static read_result_t read_string(FILE* _Nonnull in,
+                                 string_table_t* _Nonnull table) {
+  uint64_t address = 0;
+  uint32_t size = 0;
+  if (!read_exact(in, &address, sizeof address) ||
+      !read_exact(in, &size, sizeof size))
+    return READ_END;
+  if (size > MAX_STRING_SIZE)
+    return READ_INVALID;
+
+  char* str = sve4_malloc(sve4__log_allocator(), (size_t)size + 1);
+  if (!str)
+    return READ_NO_MEMORY;
+  if (!read_exact(in, str, size)) {
+    sve4_free(sve4__log_allocator(), str);
+    return READ_END;
+  }
+  str[size] = '\0';
+
+  if ((table->size + 1) * 2 > table->capacity && !grow_table(table)) {
+    sve4_free(sve4__log_allocator(), str);
+    return READ_NO_MEMORY;
+  }
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  string_entry_t* entry =
+      find_entry(table->entries, table->capacity, address);
+#pragma GCC diagnostic pop
+  if (entry->str)
+    sve4_free(sve4__log_allocator(), entry->str);
+  else
+    ++table->size;
+  *entry = (string_entry_t){.address = address, .str = str};
+  return READ_OK;
+}
+
+typedef struct {
+  const unsigned char* _Nonnull data;
+  size_t size;
+  size_t pos;
+} reader_t;
+
+static bool get(reader_t* _Nonnull reader, void* _Nonnull data, size_t size) {
+  if (reader->size - reader->pos < size)
+    return false;
+  memcpy(data, reader->data + reader->pos, size);
+  reader->pos += size;
+  return true;
+}
+
+typedef struct {
+  char* _Nonnull data;
+  size_t size;
+  size_t capacity;
+} text_t;
+
+static void append(text_t* _Nonnull text, const char* _Nonnull str,
+                   size_t len) {
+  len = sve4_min(len, text->capacity - 1 - text->size);
+  memcpy(text->data + text->size, str, len);
+  text->size += len;
+  text->data[text->size] = '\0';
+}
+
+static void appendf(text_t* _Nonnull text, const char* _Nonnull fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  int len = vsnprintf(text->data + text->size, text->capacity - text->size,
+                      fmt, args);
+#pragma GCC diagnostic pop
+  va_end(args);
+  if (len > 0)
+    text->size = sve4_min(text->size + (size_t)len, text->capacity - 1);
+}
+
+// returns false if the argument is missing from the payload
+static bool decode_arg(text_t* _Nonnull text, const spec_t* _Nonnull spec,
+                       reader_t* _Nonnull payload) {
+  int64_t width = spec->width;
+  int64_t precision = spec->precision;
+  if (spec->width_star && !get(payload, &width, sizeof width))
+    return false;
+  if (spec->precision_star && !get(payload, &precision, sizeof precision))
+    return false;
+
+  // rebuild the specification without '*' and with the stored types
+  char conv[32];
+  text_t conv_text = {.data = conv, .capacity = sizeof conv};
+  appendf(&conv_text, "%%%s", spec->flags);
+  // a negative width read from a '*' means left-justified
+  if (width < 0 && spec->width_star) {
+    append(&conv_text, "-", 1);
+    width = width == INT64_MIN ? 0 : -width;
+  }
+  if (width >= 0)
+    appendf(&conv_text, "%d", (int)sve4_min(width, (int64_t)MAX_MESSAGE_SIZE));
+  if (precision >= 0 && spec->type != ARG_STRING)
+    appendf(&conv_text, ".%d",
+            (int)sve4_min(precision, (int64_t)MAX_MESSAGE_SIZE));
+
+  switch (spec->type) {
+  case ARG_NONE:
+    append(text, "%", 1);
+    return true;
+  case ARG_WRITEBACK:
+    return true;
+  case ARG_SIGNED: {
+    int64_t value = 0;
+    if (!get(payload, &value, sizeof value))
+      return false;
+    appendf(&conv_text, "ll%c", spec->conversion);
+    appendf(text, conv, (long long)value);
+    return true;
+  }
+  case ARG_UNSIGNED: {
+    uint64_t value = 0;
+    if (!get(payload, &value, sizeof value))
+      return false;
+    appendf(&conv_text, "ll%c", spec->conversion);
+    appendf(text, conv, (unsigned long long)value);
+    return true;
+  }
+  case ARG_CHAR: {
+    int64_t value = 0;
+    if (!get(payload, &value, sizeof value))
+      return false;
+    append(&conv_text, "c", 1);
+    appendf(text, conv, (int)value);
+    return true;
+  }
+  case ARG_DOUBLE: {
+    double value = 0;
+    if (!get(payload, &value, sizeof value))
+      return false;
+    append(&conv_text, &spec->conversion, 1);
+    appendf(text, conv, value);
+    return true;
+  }
+  case ARG_STRING: {
+    uint32_t len = 0;
+    if (!get(payload, &len, sizeof len) || payload->size - payload->pos < len)
+      return false;
+    // the encoder already applied the precision
+    append(&conv_text, ".*s", 3);
+    appendf(text, conv, (int)len, payload->data + payload->pos);
+    payload->pos += len;
+    return true;
+  }
+  case ARG_POINTER: {
+    uint64_t value = 0;
+    if (!get(payload, &value, sizeof value))
+      return false;
+    append(&conv_text, "p", 1);
+    appendf(text, conv, (void*)(uintptr_t)value);
+    return true;
+  }
+  case ARG_UNSUPPORTED:
+    break;
+  }
+  return false;
+}
+
+static void format_message(text_t* _Nonnull text, const char* _Nonnull fmt,
+                           reader_t* _Nonnull payload) {
+  const char* literal = fmt;
+  for (const char* it; (it = strchr(literal, '%'));) {
+    append(text, literal, (size_t)(it - literal));
+    spec_t spec;
+    const char* next = parse_spec(it + 1, &spec);
+    if (!decode_arg(text, &spec, payload)) {
+      // print the rest as is
+      literal = it;
+      break;
+    }
+    literal = next;
+  }
+  append(text, literal, strlen(literal));
+}
+
+static void run_callback(const sve4_log_config_t* _Nonnull config,
+                         sve4_log_record_t* _Nonnull record, ...) {
+  va_start(record->args, record);
+  config->callback.callback(record, config);
+  va_end(record->args);
+}
+
+static read_result_t read_record(FILE* _Nonnull in,
+                                 const string_table_t* _Nonnull strings,
+                                 const sve4_log_config_t* _Nonnull config,
+                                 unsigned char* _Nonnull payload_data,
+                                 char* _Nonnull message) {
+  record_header_t header;
+  if (!read_exact(in, &header, sizeof header))
+    return READ_END;
+  if (header.payload_size > SVE4_LOG_BINARY_MAX_PAYLOAD)
+    return READ_INVALID;
+  if (!read_exact(in, payload_data, header.payload_size))
+    return READ_END;
+
+  const char* file = lookup(strings, header.file);
+  const char* fmt = lookup(strings, header.fmt);
+  if (!file || !fmt)
+    return READ_INVALID;
+
+  sve4_log_level_t level = (sve4_log_level_t)header.level;
+  if (sve4_log_config_get_level(config, (sve4_log_id_t)header.id) > level)
+    return READ_OK;
+
+  reader_t payload = {.data = payload_data, .size = header.payload_size};
+  text_t text = {.data = message, .capacity = MAX_MESSAGE_SIZE};
+  message[0] = '\0';
+  format_message(&text, fmt, &payload);
+
+  struct tm timestamp = {
+      .tm_year = header.year,
+      .tm_yday = header.yday,
+      .tm_mon = header.mon,
+      .tm_mday = header.mday,
+      .tm_wday = header.wday,
+      .tm_hour = header.hour,
+      .tm_min = header.min,
+      .tm_sec = header.sec,
+      .tm_isdst = header.isdst,
+  };
+  sve4_log_record_t record = {
+      .level = level,
+      // NOLINTNEXTLINE(clang-analyzer-optin.core.EnumCastOutOfRange)
+      .id = (sve4_log_id_t)header.id,
+      .msg = "%s",
+      .timestamp = &timestamp,
+      .fractional_timestamp = header.nsec,
+      .clock = (sve4_log_clock_t)header.clock,
+      .file = file,
+      .line = (size_t)header.line,
+      .endl = header.endl,
+  };
+  run_callback(config, &record, message);
+  return READ_OK;
+}
+
+sve4_log_error_t sve4_log_binary_decode(FILE* _Nonnull in,
+                                        const sve4_log_config_t* _Nonnull
+                                            config) {
+  char magic[MAGIC_SIZE];
+  uint32_t version = 0;
+  if (!read_exact(in, magic, sizeof magic) ||
+      memcmp(magic, MAGIC, MAGIC_SIZE) != 0 ||
+      !read_exact(in, &version, sizeof version) || version != VERSION)
+    return SVE4_LOG_ERROR_INVALID_DATA;
+
+  sve4_allocator_t* allocator = sve4__log_allocator();
+  thread_tables_t threads = {0};
+  uint32_t thread = 0;
+  unsigned char* payload = sve4_malloc(allocator, SVE4_LOG_BINARY_MAX_PAYLOAD);
+  char* message = sve4_malloc(allocator, MAX_MESSAGE_SIZE);
+  read_result_t result = payload && message && grow_threads(&threads, thread)
+                             ? READ_OK
+                             : READ_NO_MEMORY;
+
+  while (result == READ_OK) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+    string_table_t* strings = &threads.tables[thread];
+    switch (fgetc(in)) {
+    case TAG_THREAD:
+      result = read_thread(in, &threads, &thread);
+      break;
+    case TAG_STRING:
+      result = read_string(in, strings);
+      break;
+    case TAG_RECORD:
+      result = read_record(in, strings, config, payload, message);
+      break;
+#pragma GCC diagnostic pop
+    case EOF:
+      result = READ_END;
+      break;
+    default:
+      result = READ_INVALID;
+      break;
+    }
+  }
+
+  free_threads(&threads);
+  sve4_free(allocator, message);
+  sve4_free(allocator, payload);
+  switch (result) {
+  case READ_OK:
+  case READ_END:
+    break;
+  case READ_INVALID:
+    return SVE4_LOG_ERROR_INVALID_DATA;
+  case READ_NO_MEMORY:
+    return SVE4_LOG_ERROR_MEMORY;
+  }
+  return ferror(in) ? SVE4_LOG_ERROR_IO : SVE4_LOG_ERROR_SUCCESS;
+}
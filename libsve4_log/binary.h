@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "sve4_log_export.h"
+
+#include "error.h"
+#include "init.h"
+
+// BINARY LOGGING
+//
+// A sink that does not format messages. Each record stores the timestamp,
+// level, id, location, a reference to the format string and the raw arguments.
+// Records are encoded into a ring owned by the logging thread, without locks
+// or stdio, and a writer thread appends the rings to the file (it is waited
+// for when a ring is full, and by sve4_log_flush()). Records of one thread
+// stay in order, those of different threads are written a ring at a time.
+// sve4_log_binary_decode() formats the stream offline, e.g. through the
+// sve4_log_decode tool.
+//
+// The format and file strings are written once per thread and referenced by
+// address afterwards, as long as the text at that address starts the same
+// (its first 8 bytes are checked, not the whole string). String literals,
+// like every call site in this repository uses, are always fine; a buffer
+// whose text changes must change in those first bytes. Strings longer than
+// 8192 bytes are truncated.
+//
+// The stream uses the byte order and type sizes of the machine writing it.
+// Arguments of a record take at most SVE4_LOG_BINARY_MAX_PAYLOAD bytes:
+// longer strings are truncated, and arguments past the limit are dropped
+// (the rest of the format string is then printed as is). The same goes for
+// conversions without a portable argument type (%ls, %lc), and long double
+// arguments lose precision.
+
+enum { SVE4_LOG_BINARY_MAX_PAYLOAD = 4096 };
+
+// records are appended to file, which is closed when the callback is freed if
+// close is true
+SVE4_LOG_EXPORT
+sve4_log_error_t sve4_log_to_binary(sve4_log_callback_t* _Nonnull callback,
+                                    FILE* _Nonnull file, bool close);
+
+// passes every record of in to config->callback, formatting the messages
+// with the format strings stored in the stream. returns
+// SVE4_LOG_ERROR_INVALID_DATA if in is not a binary log (a truncated last
+// record is ignored).
+SVE4_LOG_EXPORT
+sve4_log_error_t sve4_log_binary_decode(FILE* _Nonnull in,
+                                        const sve4_log_config_t* _Nonnull
+                                            config);
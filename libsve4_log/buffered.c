@@ -0,0 +1,345 @@
+#include "buffered.h"
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "libsve4_utils/allocator.h"
+#include "libsve4_utils/buffer.h"
+#include "libsve4_utils/defines.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#include "api.h"
+#include "async.h"
+#include "error.h"
+#include "init.h"
+
+#if sve4_has_include(<sys/uio.h>)
+#include <sys/uio.h>
+#include <unistd.h>
+#define HAVE_WRITEV 1
+#endif
+
+#define NUM_CHUNKS SVE4_LOG_BUFFERED_NUM_CHUNKS
+#define NS_PER_MS 1000000L
+#define NS_PER_SEC 1000000000L
+#define MS_PER_SEC 1000U
+
+// so that a chunk holds more than a few records
+enum { MIN_CHUNK_SIZE = 4096 };
+
+typedef struct {
+  char* _Nonnull data;
+  size_t size;
+} chunk_t;
+
+typedef struct {
+  // NULL if the sink could not be initialized
+  FILE* _Nullable file;
+  bool close;
+  bool ansi;
+  unsigned flush_interval_ms;
+  size_t chunk_size;
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_t mutex;
+  // wakes the flusher up
+  cnd_t work_condvar;
+  // broadcast whenever the flusher is done writing
+  cnd_t written_condvar;
+  thrd_t flusher;
+  // NOLINTEND(misc-include-cleaner)
+  // the fields below are guarded by mutex
+  bool stopping;
+  // chunks are filled in turn, only ever increasing. chunks [num_written,
+  // num_queued) wait for the flusher, chunks[num_queued % NUM_CHUNKS] is
+  // being filled unless it is one of them.
+  size_t num_queued;
+  size_t num_written;
+  chunk_t chunks[NUM_CHUNKS];
+} buffered_sink_t;
+
+static chunk_t* _Nonnull current_chunk(buffered_sink_t* _Nonnull sink) {
+  return &sink->chunks[sink->num_queued % NUM_CHUNKS];
+}
+
+// must be called with the mutex held
+static void queue_current_locked(buffered_sink_t* _Nonnull sink) {
+  if (sink->num_queued - sink->num_written == NUM_CHUNKS ||
+      current_chunk(sink)->size == 0)
+    return;
+  ++sink->num_queued;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_signal(&sink->work_condvar);
+}
+
+// must be called with the mutex held, waits until the current chunk is not
+// being written anymore
+static void wait_current_locked(buffered_sink_t* _Nonnull sink) {
+  while (sink->num_queued - sink->num_written == NUM_CHUNKS)
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    cnd_wait(&sink->written_condvar, &sink->mutex);
+}
+
+// must be called with the mutex held, waits until everything logged so far
+// is written
+static void flush_locked(buffered_sink_t* _Nonnull sink) {
+  queue_current_locked(sink);
+  size_t target = sink->num_queued;
+  while (sink->num_written < target)
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    cnd_wait(&sink->written_condvar, &sink->mutex);
+}
+
+static void write_chunks(buffered_sink_t* _Nonnull sink, size_t first,
+                         size_t last) {
+#ifdef HAVE_WRITEV
+  struct iovec iovecs[NUM_CHUNKS];
+  int num_iovecs = 0;
+  for (size_t i = first; i < last; ++i) {
+    const chunk_t* chunk = &sink->chunks[i % NUM_CHUNKS];
+    iovecs[num_iovecs++] = (struct iovec){
+        .iov_base = chunk->data,
+        .iov_len = chunk->size,
+    };
+  }
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  int fd = fileno(sink->file);
+#pragma GCC diagnostic pop
+  struct iovec* it = iovecs;
+  while (num_iovecs > 0) {
+    ssize_t written = writev(fd, it, num_iovecs);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      sve4_flog(SVE4_LOG_ID_DEFAULT_SVE4_LOG, SVE4_LOG_LEVEL_ERROR,
+                "unable to write buffered logs: %s", strerror(errno));
+      return;
+    }
+
+    // skip whatever was written, the last chunk may be partially written
+    size_t rest = (size_t)written;
+    for (; num_iovecs > 0 && rest >= it->iov_len; ++it, --num_iovecs)
+      rest -= it->iov_len;
+    if (num_iovecs > 0) {
+      it->iov_base = (char*)it->iov_base + rest;
+      it->iov_len -= rest;
+    }
+  }
+#else
+  for (size_t i = first; i < last; ++i) {
+    const chunk_t* chunk = &sink->chunks[i % NUM_CHUNKS];
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+    fwrite(chunk->data, 1, chunk->size, sink->file);
+  }
+  fflush(sink->file);
+#pragma GCC diagnostic pop
+#endif
+}
+
+static int flusher_main(void* _Nullable arg) {
+  buffered_sink_t* sink = arg;
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&sink->mutex);
+  while (true) {
+    if (sink->num_written == sink->num_queued) {
+      if (sink->stopping)
+        break;
+      struct timespec deadline;
+      timespec_get(&deadline, TIME_UTC);
+      deadline.tv_sec += sink->flush_interval_ms / MS_PER_SEC;
+      deadline.tv_nsec += (long)(sink->flush_interval_ms % MS_PER_SEC) *
+                          NS_PER_MS;
+      if (deadline.tv_nsec >= NS_PER_SEC) {
+        deadline.tv_nsec -= NS_PER_SEC;
+        ++deadline.tv_sec;
+      }
+      if (cnd_timedwait(&sink->work_condvar, &sink->mutex, &deadline) ==
+          thrd_timedout)
+        queue_current_locked(sink);
+      continue;
+    }
+
+    // queued chunks are not touched by the callbacks
+    size_t first = sink->num_written;
+    size_t last = sink->num_queued;
+    mtx_unlock(&sink->mutex);
+    write_chunks(sink, first, last);
+    mtx_lock(&sink->mutex);
+
+    for (size_t i = first; i < last; ++i)
+      sink->chunks[i % NUM_CHUNKS].size = 0;
+    sink->num_written = last;
+    cnd_broadcast(&sink->written_condvar);
+  }
+  mtx_unlock(&sink->mutex);
+  // NOLINTEND(misc-include-cleaner)
+  return 0;
+}
+
+static buffered_sink_t* _Nonnull
+get_sink(const sve4_log_config_t* _Nonnull config) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  return (buffered_sink_t*)(void*)sve4_buffer_get_data(
+      config->callback.user_data);
+#pragma GCC diagnostic pop
+}
+
+// formats record at the end of the current chunk, returns the length of the
+// whole line, or a negative number on failure
+static int append_record(buffered_sink_t* _Nonnull sink,
+                         sve4_log_record_t* _Nonnull record,
+                         const sve4_log_config_t* _Nonnull config) {
+  chunk_t* chunk = current_chunk(sink);
+  return sve4__log_format_record(chunk->data + chunk->size,
+                                 sink->chunk_size - chunk->size, record,
+                                 config, false, sink->ansi);
+}
+
+static void buffered_callback(sve4_log_record_t* _Nonnull record,
+                              const sve4_log_config_t* _Nonnull config) {
+  buffered_sink_t* sink = get_sink(config);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&sink->mutex);
+  wait_current_locked(sink);
+  int len = append_record(sink, record, config);
+  chunk_t* chunk = current_chunk(sink);
+  while (len >= 0 && (size_t)len >= sink->chunk_size - chunk->size &&
+         chunk->size > 0) {
+    // continue in the next chunk, this one gets written. other callbacks may
+    // fill that one up while this one waits, hence the loop
+    queue_current_locked(sink);
+    wait_current_locked(sink);
+    len = append_record(sink, record, config);
+    chunk = current_chunk(sink);
+  }
+
+  if (len >= 0) {
+    size_t space = sink->chunk_size - chunk->size;
+    if ((size_t)len >= space) {
+      // longer than a chunk, keep the line ending at least
+      len = (int)space - 1;
+      if (record->endl)
+        chunk->data[chunk->size + (size_t)len - 1] = '\n';
+    }
+    chunk->size += (size_t)len;
+  }
+
+  if (record->level >= SVE4_LOG_LEVEL_ERROR)
+    flush_locked(sink);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&sink->mutex);
+}
+
+static void buffered_flush(const sve4_log_config_t* _Nonnull config) {
+  buffered_sink_t* sink = get_sink(config);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&sink->mutex);
+  flush_locked(sink);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&sink->mutex);
+}
+
+static void buffered_sink_free(char* _Nonnull data) {
+  buffered_sink_t* sink = (buffered_sink_t*)(void*)data;
+  if (!sink->file)
+    return;
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&sink->mutex);
+  wait_current_locked(sink);
+  queue_current_locked(sink);
+  sink->stopping = true;
+  cnd_signal(&sink->work_condvar);
+  mtx_unlock(&sink->mutex);
+  thrd_join(sink->flusher, NULL);
+
+  cnd_destroy(&sink->written_condvar);
+  cnd_destroy(&sink->work_condvar);
+  mtx_destroy(&sink->mutex);
+  // NOLINTEND(misc-include-cleaner)
+  sve4_free(sve4__log_allocator(), sink->chunks[0].data);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  sink->close ? fclose(sink->file) : fflush(sink->file);
+#pragma GCC diagnostic pop
+}
+
+sve4_log_error_t
+sve4_log_to_buffered_file(sve4_log_callback_t* _Nonnull callback,
+                          FILE* _Nonnull file, bool close,
+                          const sve4_log_buffered_config_t* _Nullable config) {
+  sve4_log_buffered_config_t conf =
+      config ? *config : (sve4_log_buffered_config_t){0};
+  size_t buffer_size =
+      conf.buffer_size ? conf.buffer_size : SVE4_LOG_BUFFERED_DEFAULT_SIZE;
+  size_t chunk_size = sve4_max(buffer_size / NUM_CHUNKS,
+                               (size_t)MIN_CHUNK_SIZE);
+
+  callback->user_data = sve4_buffer_create(
+      sve4__log_allocator(), sizeof(buffered_sink_t), buffered_sink_free);
+  if (!callback->user_data)
+    return SVE4_LOG_ERROR_MEMORY;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  buffered_sink_t* sink =
+      (buffered_sink_t*)(void*)sve4_buffer_get_data(callback->user_data);
+#pragma GCC diagnostic pop
+  sve4_log_error_t err = SVE4_LOG_ERROR_THREADS;
+  char* data = sve4_malloc(sve4__log_allocator(), chunk_size * NUM_CHUNKS);
+  if (!data) {
+    err = SVE4_LOG_ERROR_MEMORY;
+    goto fail_data;
+  }
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  if (mtx_init(&sink->mutex, mtx_plain) != thrd_success)
+    goto fail_mutex;
+  if (cnd_init(&sink->work_condvar) != thrd_success)
+    goto fail_work_condvar;
+  if (cnd_init(&sink->written_condvar) != thrd_success)
+    goto fail_written_condvar;
+
+  for (size_t i = 0; i < NUM_CHUNKS; ++i)
+    sink->chunks[i] = (chunk_t){.data = data + i * chunk_size};
+  sink->chunk_size = chunk_size;
+  sink->flush_interval_ms = conf.flush_interval_ms
+                                ? conf.flush_interval_ms
+                                : SVE4_LOG_BUFFERED_DEFAULT_FLUSH_INTERVAL_MS;
+  sink->close = close;
+  sink->ansi = conf.ansi;
+  // whatever stdio holds goes before the records
+  fflush(file);
+  sink->file = file;
+  if (thrd_create(&sink->flusher, flusher_main, sink) != thrd_success)
+    goto fail_thread;
+  // NOLINTEND(misc-include-cleaner)
+
+  callback->callback = buffered_callback;
+  callback->flush = buffered_flush;
+  return SVE4_LOG_ERROR_SUCCESS;
+
+  // NOLINTBEGIN(misc-include-cleaner)
+fail_thread:
+  sink->file = NULL;
+  cnd_destroy(&sink->written_condvar);
+fail_written_condvar:
+  cnd_destroy(&sink->work_condvar);
+fail_work_condvar:
+  mtx_destroy(&sink->mutex);
+  // NOLINTEND(misc-include-cleaner)
+fail_mutex:
+  sve4_free(sve4__log_allocator(), data);
+fail_data:
+  sve4_buffer_free(&callback->user_data);
+  return err;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "sve4_log_export.h"
+
+#include "error.h"
+#include "init.h"
+
+// BUFFERED FILE LOGGING
+//
+// Like sve4_log_to_file(), but records are formatted into a large private
+// buffer instead of going through stdio one call at a time. The buffer is
+// split into SVE4_LOG_BUFFERED_NUM_CHUNKS chunks. A background thread writes
+// out every full chunk, and the one being filled every flush interval, with a
+// single writev() call.
+//
+// Error records, sve4_log_flush() and sve4_panic() wait until everything
+// logged so far is written. The file is written through its descriptor, so
+// nothing else may write to it until the callback is freed.
+
+enum { SVE4_LOG_BUFFERED_NUM_CHUNKS = 4 };
+
+#define SVE4_LOG_BUFFERED_DEFAULT_SIZE ((size_t)256 * 1024)
+#define SVE4_LOG_BUFFERED_DEFAULT_FLUSH_INTERVAL_MS 100U
+
+typedef struct {
+  // total size of the chunks, 0 means SVE4_LOG_BUFFERED_DEFAULT_SIZE. longer
+  // records than a chunk are truncated.
+  size_t buffer_size;
+  // 0 means SVE4_LOG_BUFFERED_DEFAULT_FLUSH_INTERVAL_MS
+  unsigned flush_interval_ms;
+  bool ansi;
+} sve4_log_buffered_config_t;
+
+// file is closed when the callback is freed if close is true, config may be
+// NULL for the defaults
+SVE4_LOG_EXPORT
+sve4_log_error_t
+sve4_log_to_buffered_file(sve4_log_callback_t* _Nonnull callback,
+                          FILE* _Nonnull file, bool close,
+                          const sve4_log_buffered_config_t* _Nullable config);
@@ -8,6 +8,10 @@ const char* sve4_log_error_to_string(sve4_log_error_t err) {
     return "Threading error";
   case SVE4_LOG_ERROR_MEMORY:
     return "Memory allocation error";
+  case SVE4_LOG_ERROR_IO:
+    return "I/O error";
+  case SVE4_LOG_ERROR_INVALID_DATA:
+    return "Invalid data";
   }
 
   return "Unknown error";
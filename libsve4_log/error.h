@@ -8,6 +8,8 @@ typedef enum {
   SVE4_LOG_ERROR_SUCCESS = 0,
   SVE4_LOG_ERROR_THREADS,
   SVE4_LOG_ERROR_MEMORY,
+  SVE4_LOG_ERROR_IO,
+  SVE4_LOG_ERROR_INVALID_DATA,
 } sve4_log_error_t;
 
 SVE4_LOG_EXPORT
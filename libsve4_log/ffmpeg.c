@@ -1,18 +1,18 @@
 #include "ffmpeg.h"
 
-#include <assert.h>
 #include <stdarg.h>
-#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 
 #include "libsve4_log/api.h"
 #include "libsve4_utils/allocator.h"
-#include "libsve4_utils/arena.h"
+#include "libsve4_utils/defines.h"
 
-#include <libavutil/fifo.h>
 #include <libavutil/log.h>
-#include <tinycthread.h>
+
+#include "async.h"
 
 static sve4_log_level_t ffmpeg_level_to_sve4(int level) {
   switch (level) {
@@ -30,6 +30,54 @@ static sve4_log_level_t ffmpeg_level_to_sve4(int level) {
   }
 }
 
+enum { LINE_BUFFER_SIZE = 1024 };
+
+// the line being assembled by the current thread
+typedef struct {
+  char data[LINE_BUFFER_SIZE];
+  size_t size;
+} line_buffer_t;
+
+static void emit_line(sve4_log_level_t level, const char* _Nonnull line,
+                      size_t len, bool endl) {
+  sve4_glog(SVE4_LOG_ID_DEFAULT_FFMPEG, __FILE__, __LINE__, endl, level,
+            "%.*s", (int)len, line);
+}
+
+// formats into the free space of buffer, returns the number of bytes needed
+static size_t format_into(line_buffer_t* _Nonnull buffer,
+                          const char* _Nonnull fmt, va_list args) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  int len = vsnprintf(buffer->data + buffer->size,
+                      sizeof buffer->data - buffer->size, fmt, args);
+#pragma GCC diagnostic pop
+  return len < 0 ? 0 : (size_t)len;
+}
+
+// appends text to the pending line, passing on every line it completes. lines
+// longer than the buffer are truncated on their own, the rest of the text is
+// kept.
+static void append_text(line_buffer_t* _Nonnull buffer, sve4_log_level_t level,
+                        const char* _Nonnull text, size_t len) {
+  while (len > 0) {
+    const char* newline = memchr(text, '\n', len);
+    size_t line_len = newline ? (size_t)(newline + 1 - text) : len;
+    size_t copied =
+        sve4_min(line_len, sizeof buffer->data - 1 - buffer->size);
+    memcpy(buffer->data + buffer->size, text, copied);
+    buffer->size += copied;
+    if (newline || buffer->size == sizeof buffer->data - 1) {
+      // the newline is only in the buffer if the whole line fit
+      emit_line(level, buffer->data, buffer->size,
+                !newline || copied < line_len);
+      buffer->size = 0;
+    }
+    text += line_len;
+    len -= line_len;
+  }
+}
+
 // here, FFmpeg does not log its stuff in separated messages, but it can log a
 // message in multiple log calls like so:
 // ```c
@@ -37,69 +85,55 @@ static sve4_log_level_t ffmpeg_level_to_sve4(int level) {
 // sve3_ffmpeg_log_callback(..., "world!\n");
 // ````
 //
-// Hence, we need to manually group these messages into multiple lines.
+// Hence, we need to manually group these messages into multiple lines. Every
+// thread formats its messages once, into a fixed line buffer, and complete
+// lines are passed on straight from it. Longer lines are truncated, and text
+// that does not fit in the buffer at all is formatted again into a temporary
+// allocation, so that the lines after it are not lost.
 void sve4_log_ffmpeg_callback(void* avcl, int level, const char* fmt,
                               va_list args) {
   (void)avcl;
-  // Our approach uses an AVFifo object for every thread
-  static _Thread_local AVFifo* msg = NULL;
-  // along with a temporary buffer managed in an arena
-  static _Thread_local sve4_allocator_t arena;
-
-  // lazily initialize the AVFifo
-  if (!msg) {
-    msg = av_fifo_alloc2(0, sizeof(char), AV_FIFO_FLAG_AUTO_GROW);
-    arena = sve4_allocator_arena_init;
-  }
+  sve4_log_level_t sve4_level = ffmpeg_level_to_sve4(level);
+  if (level > av_log_get_level() ||
+      !sve4_log_id_enabled(SVE4_LOG_ID_DEFAULT_FFMPEG, sve4_level))
+    return;
 
-  va_list args2;
-  va_copy(args2, args);
+  static _Thread_local line_buffer_t buffer;
 
-  // first pass: use vsnprintf to figure out how much memory should be
-  // reserved...
+  va_list args_copy;
+  va_copy(args_copy, args);
+  size_t len = format_into(&buffer, fmt, args_copy);
+  va_end(args_copy);
+  if (buffer.size + len >= sizeof buffer.data) {
+    char* text = sve4_malloc(sve4__log_allocator(), len + 1);
+    if (text) {
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
-  int len = vsnprintf(NULL, 0, fmt, args2);
+      vsnprintf(text, len + 1, fmt, args);
 #pragma GCC diagnostic pop
-  va_end(args2);
-  assert(len >= 0);
-
-  // then allocate the temporary buffer for the message
-  char* data = sve4_malloc(&arena, (size_t)(len + 1));
-  if (!data) {
-    sve4_panic("sve4_malloc failed in sve4_log_ffmpeg_callback");
-  }
-
-  // second pass: actually format the message
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-  vsnprintf(data, (size_t)(len + 1), fmt, args);
-#pragma GCC diagnostic pop
-  // vsnprintf will add a handy \0 at the end of the message, but we will just
-  // ignore it
-
-  // now, split the message based on newline characters
-  // memchr is possible but here we use strchr to simplify things
-  for (char* ptr = strchr(data, '\n'); ptr;
-       data = ptr + 1, ptr = strchr(data, '\n')) {
-    // handle the case where
-    // add the rest of the line (from data to ptr + 1) to the fifo
-    av_fifo_write(msg, data, (size_t)(ptr + 1 - data));
-
-    size_t msg_fmt_len = av_fifo_can_read(msg);
-    char* msg_fmt = sve4_malloc(&arena, msg_fmt_len + 1);
-    if (!msg_fmt) {
-      sve4_panic("sve4_malloc failed in sve4_log_ffmpeg_callback");
+      append_text(&buffer, sve4_level, text, len);
+      sve4_free(sve4__log_allocator(), text);
+      return;
     }
-    av_fifo_read(msg, msg_fmt, msg_fmt_len);
-    msg_fmt[msg_fmt_len] = '\0';
-    sve4_glog(SVE4_LOG_ID_DEFAULT_FFMPEG, __FILE__, __LINE__, false,
-              ffmpeg_level_to_sve4(level), "%.*s", (int)msg_fmt_len, msg_fmt);
+    // out of memory, anything past the buffer is lost
+    len = sizeof buffer.data - 1 - buffer.size;
   }
 
-  // write the rest in the fifo
-  av_fifo_write(msg, data, strlen(data));
+  // split the new text into lines, in place
+  char* line = buffer.data;
+  char* end = buffer.data + buffer.size + len;
+  for (char* newline = memchr(buffer.data + buffer.size, '\n', len); newline;
+       newline = memchr(line, '\n', (size_t)(end - line))) {
+    emit_line(sve4_level, line, (size_t)(newline + 1 - line), false);
+    line = newline + 1;
+  }
 
-  // free temp buffer, in theory this can leak but whatever...
-  sve4_allocator_arena_reset(&arena);
+  buffer.size = (size_t)(end - line);
+  if (buffer.size == sizeof buffer.data - 1) {
+    // a full buffer without a newline
+    emit_line(sve4_level, line, buffer.size, true);
+    buffer.size = 0;
+  } else if (line != buffer.data) {
+    memmove(buffer.data, line, buffer.size);
+  }
 }
@@ -4,7 +4,9 @@
 
 #define __STDC_WANT_LIB_EXT1__ 1
 #include <assert.h>
+#include <stdalign.h>
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
@@ -13,16 +15,19 @@
 
 #include "libsve4_utils/allocator.h"
 #include "libsve4_utils/buffer.h"
+#include "libsve4_utils/defines.h"
 
 // NOLINTNEXTLINE(misc-include-cleaner)
 #include <tinycthread.h>
 
 #include "ansi.h"
 #include "api.h"
+#include "async.h"
 #include "error.h"
 #include "tty.h"
 
 #ifdef _WIN32
+#include <windows.h>
 #define localtime_r(t, tm) localtime_s(tm, t)
 #endif
 
@@ -34,6 +39,7 @@ sve4_log_callback_t sve4_log_callback_ref(sve4_log_callback_t src) {
   return (sve4_log_callback_t){
       .callback = src.callback,
       .user_data = sve4_buffer_ref(src.user_data),
+      .flush = src.flush,
   };
 }
 
@@ -80,6 +86,8 @@ static const char* _Nonnull get_log_id_name_default(
     return "VULKAN ";
   case SVE4_LOG_ID_DEFAULT_GLFW:
     return " GLFW  ";
+  case SVE4_LOG_ID_MAX:
+    break;
   }
 
   return "???";
@@ -99,48 +107,418 @@ void sve4_log_id_mapping_free(sve4_log_id_mapping_t* _Nullable mapping) {
 
 struct sve4_log_inner_t {
   sve4_log_config_t config;
-  sve4_log_t _Nullable prev, next;
 };
 
+// The logs are published as an immutable snapshot, replaced as a whole by
+// sve4_log_add_config() and sve4_log_remove_log(). Emitting a log only
+// registers the thread as a reader of the current generation, so it never
+// waits for other emitters or for configuration changes. A replaced snapshot
+// (and a removed log) is freed once every reader of the generations before
+// it is gone, so changing the configuration waits for the callbacks in
+// progress instead.
+typedef struct {
+  size_t num_logs;
+  sve4_log_t _Nonnull logs[];
+} log_snapshot_t;
+
+#define CACHE_LINE 64
+
+// every emitting thread counts itself in a reader_t of its own, so emitters
+// never write to the same cache line. a reader_t is given back when its
+// thread exits and reused by the next new thread.
+typedef struct reader_t {
+  // readers of even and odd generations. emits nest if a callback logs.
+  alignas(CACHE_LINE) atomic_uint counts[2];
+  atomic_bool in_use;
+  struct reader_t* _Nullable next;
+} reader_t;
+
 // NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+// serializes the writers of log_snapshot
 // NOLINTNEXTLINE(misc-include-cleaner)
 static mtx_t log_mutex;
 static sve4_allocator_t* _Nullable log_allocator = NULL;
-static sve4_log_t _Nullable log_first = NULL, log_last = NULL;
+static _Atomic(log_snapshot_t*) log_snapshot = NULL;
+static atomic_uint log_generation = 0;
+// every reader_t ever registered, they are never freed
+static _Atomic(reader_t*) log_readers = NULL;
+// shared by the threads that could not get a reader_t of their own
+static reader_t log_fallback_reader;
+// its destructor gives the reader_t of an exiting thread back
+// NOLINTNEXTLINE(misc-include-cleaner)
+static tss_t log_reader_key;
+static bool log_reader_key_valid = false;
+// writers waiting for readers to leave sleep on log_wait_condvar
+// NOLINTNEXTLINE(misc-include-cleaner)
+static mtx_t log_wait_mutex;
+// NOLINTNEXTLINE(misc-include-cleaner)
+static cnd_t log_wait_condvar;
+static atomic_bool log_writer_waiting = false;
 static bool stderr_ansi_supported = false;
+static atomic_int log_clock = SVE4_LOG_CLOCK_REALTIME;
+// monotonic time of sve4_log_init()
+static struct timespec log_epoch;
+// NULL for the system clock
+static _Atomic(sve4_log_time_source_t) log_monotonic_source = NULL;
+// rate limits with suppressed messages, see sve4__log_flush_suppressed()
+static _Atomic(sve4_log_rate_limit_t*) log_rate_limits = NULL;
+atomic_uint sve4__log_id_masks[SVE4_LOG_LEVEL_MAX];
 // NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
 
+#define NS_PER_SEC 1000000000L
+#define NS_PER_MS 1000000L
+#define SECS_PER_MIN 60
+#define SECS_PER_HOUR 3600
+#define SECS_PER_DAY 86400
+#define HOURS_PER_DAY 24
+
+static void monotonic_now(struct timespec* _Nonnull timestamp) {
+  sve4_log_time_source_t source =
+      atomic_load_explicit(&log_monotonic_source, memory_order_relaxed);
+  if (source) {
+    source(timestamp);
+    return;
+  }
+#ifdef _WIN32
+  LARGE_INTEGER frequency;
+  LARGE_INTEGER counter;
+  QueryPerformanceFrequency(&frequency);
+  QueryPerformanceCounter(&counter);
+  timestamp->tv_sec = (time_t)(counter.QuadPart / frequency.QuadPart);
+  timestamp->tv_nsec = (long)(counter.QuadPart % frequency.QuadPart *
+                              NS_PER_SEC / frequency.QuadPart);
+#else
+  clock_gettime(CLOCK_MONOTONIC, timestamp);
+#endif
+}
+
+void sve4__log_now(struct timespec* _Nonnull timestamp) {
+  if (atomic_load_explicit(&log_clock, memory_order_relaxed) !=
+      SVE4_LOG_CLOCK_MONOTONIC) {
+    timespec_get(timestamp, TIME_UTC);
+    return;
+  }
+
+  monotonic_now(timestamp);
+  timestamp->tv_sec -= log_epoch.tv_sec;
+  timestamp->tv_nsec -= log_epoch.tv_nsec;
+  if (timestamp->tv_nsec < 0) {
+    timestamp->tv_nsec += NS_PER_SEC;
+    --timestamp->tv_sec;
+  }
+}
+
+// localtime() is not thread-safe and localtime_r() is slow (it may even lock
+// to read the timezone), so every thread converts each second only once
+static const struct tm* _Nonnull local_time(time_t seconds) {
+  static _Thread_local struct tm cached_tm;
+  static _Thread_local time_t cached_seconds;
+  static _Thread_local bool cached = false;
+  if (!cached || cached_seconds != seconds) {
+    localtime_r(&seconds, &cached_tm);
+    cached_seconds = seconds;
+    cached = true;
+  }
+  return &cached_tm;
+}
+
+static void to_broken_down_time(time_t seconds, sve4_log_clock_t clock,
+                                struct tm* _Nonnull out) {
+  if (clock != SVE4_LOG_CLOCK_MONOTONIC) {
+    *out = *local_time(seconds);
+    return;
+  }
+
+  *out = (struct tm){
+      .tm_sec = (int)(seconds % SECS_PER_MIN),
+      .tm_min = (int)(seconds / SECS_PER_MIN % SECS_PER_MIN),
+      .tm_hour = (int)(seconds / SECS_PER_HOUR % HOURS_PER_DAY),
+      .tm_yday = (int)(seconds / SECS_PER_DAY),
+  };
+}
+
+// call sites are added once and never removed, their limits have static
+// storage duration
+static void register_rate_limit(sve4_log_rate_limit_t* _Nonnull limit,
+                                sve4_log_level_t level) {
+  if (atomic_exchange_explicit(&limit->registered, true, memory_order_relaxed))
+    return;
+  limit->level = level;
+  limit->next = atomic_load_explicit(&log_rate_limits, memory_order_relaxed);
+  while (!atomic_compare_exchange_weak_explicit(&log_rate_limits, &limit->next,
+                                                limit, memory_order_release,
+                                                memory_order_relaxed))
+    ;
+}
+
+bool sve4__log_rate_limit(sve4_log_rate_limit_t* _Nonnull limit,
+                          sve4_log_level_t level, unsigned per_second,
+                          unsigned burst, unsigned* _Nonnull suppressed) {
+  // generic cell rate algorithm, i.e. a token bucket in a single atomic
+  long long interval = NS_PER_SEC / sve4_max(per_second, 1U);
+  long long max_ahead = interval * sve4_max(burst, 1U);
+  struct timespec timestamp;
+  monotonic_now(&timestamp);
+  long long now = (long long)timestamp.tv_sec * NS_PER_SEC + timestamp.tv_nsec;
+
+  long long next_time =
+      atomic_load_explicit(&limit->next_time, memory_order_relaxed);
+  long long new_next_time = 0;
+  do {
+    new_next_time = sve4_max(next_time, now) + interval;
+    if (new_next_time - now > max_ahead) {
+      atomic_fetch_add_explicit(&limit->suppressed, 1, memory_order_relaxed);
+      register_rate_limit(limit, level);
+      return false;
+    }
+  } while (!atomic_compare_exchange_weak_explicit(
+      &limit->next_time, &next_time, new_next_time, memory_order_relaxed,
+      memory_order_relaxed));
+
+  *suppressed = atomic_exchange_explicit(&limit->suppressed, 0,
+                                         memory_order_relaxed);
+  return true;
+}
+
+void sve4__log_flush_suppressed(void) {
+  for (sve4_log_rate_limit_t* limit =
+           atomic_load_explicit(&log_rate_limits, memory_order_acquire);
+       limit; limit = limit->next) {
+    unsigned suppressed =
+        atomic_exchange_explicit(&limit->suppressed, 0, memory_order_relaxed);
+    if (suppressed)
+      sve4_glog(limit->id, limit->file, limit->line, true, limit->level,
+                "last message repeated %u more times", suppressed);
+  }
+}
+
+void sve4_log_set_clock(sve4_log_clock_t clock) {
+  atomic_store_explicit(&log_clock, clock, memory_order_relaxed);
+}
+
+void sve4_log_set_monotonic_source(sve4_log_time_source_t _Nullable source) {
+  atomic_store_explicit(&log_monotonic_source, source, memory_order_relaxed);
+}
+
+static void release_reader(void* _Nullable data) {
+  reader_t* reader = data;
+  if (reader)
+    atomic_store_explicit(&reader->in_use, false, memory_order_release);
+}
+
+static void create_reader_key(void) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  log_reader_key_valid =
+      tss_create(&log_reader_key, release_reader) == thrd_success;
+}
+
+static reader_t* _Nonnull claim_reader(void) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  static once_flag once = ONCE_FLAG_INIT;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  call_once(&once, create_reader_key);
+  // without noticing thread exits, every thread would leak a reader_t
+  if (!log_reader_key_valid)
+    return &log_fallback_reader;
+
+  reader_t* reader = atomic_load_explicit(&log_readers, memory_order_acquire);
+  for (; reader; reader = reader->next) {
+    bool expected = false;
+    if (atomic_compare_exchange_strong_explicit(&reader->in_use, &expected,
+                                                true, memory_order_acquire,
+                                                memory_order_relaxed))
+      break;
+  }
+
+  if (!reader) {
+    // libc, as readers outlive log_allocator
+    reader = sve4_aligned_calloc(NULL, sizeof(reader_t), CACHE_LINE);
+    if (!reader)
+      return &log_fallback_reader;
+    atomic_init(&reader->in_use, true);
+    reader->next = atomic_load_explicit(&log_readers, memory_order_relaxed);
+    while (!atomic_compare_exchange_weak(&log_readers, &reader->next, reader))
+      ;
+  }
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (tss_set(log_reader_key, reader) != thrd_success) {
+    release_reader(reader);
+    return &log_fallback_reader;
+  }
+  return reader;
+}
+
+// returns the counter to pass to read_unlock(), log_snapshot can be read
+// until then
+static atomic_uint* _Nonnull read_lock(void) {
+  static _Thread_local reader_t* reader = NULL;
+  if (sve4_unlikely(!reader))
+    reader = claim_reader();
+
+  for (;;) {
+    unsigned generation =
+        atomic_load_explicit(&log_generation, memory_order_relaxed);
+    // a read-modify-write, as the fallback reader (and a reader used by a
+    // thread past its destructor) is shared
+    atomic_uint* count = &reader->counts[generation % 2];
+    atomic_fetch_add_explicit(count, 1, memory_order_relaxed);
+    // pairs with the fence in synchronize(): either the writer sees the
+    // increment or this sees the new generation
+    atomic_thread_fence(memory_order_seq_cst);
+    if (sve4_likely(atomic_load_explicit(&log_generation,
+                                         memory_order_relaxed) == generation))
+      return count;
+    atomic_fetch_sub_explicit(count, 1, memory_order_relaxed);
+  }
+}
+
+static void read_unlock(atomic_uint* _Nonnull count) {
+  if (atomic_fetch_sub_explicit(count, 1, memory_order_release) != 1 ||
+      sve4_likely(!atomic_load_explicit(&log_writer_waiting,
+                                        memory_order_relaxed)))
+    return;
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&log_wait_mutex);
+  cnd_broadcast(&log_wait_condvar);
+  mtx_unlock(&log_wait_mutex);
+  // NOLINTEND(misc-include-cleaner)
+}
+
+// must be called with log_mutex held
+static void wait_for_reader(reader_t* _Nonnull reader, unsigned generation) {
+  atomic_uint* count = &reader->counts[generation % 2];
+  if (sve4_likely(!atomic_load_explicit(count, memory_order_acquire)))
+    return;
+
+  atomic_store_explicit(&log_writer_waiting, true, memory_order_relaxed);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&log_wait_mutex);
+  while (atomic_load_explicit(count, memory_order_acquire)) {
+    // readers check for writers without locking and may miss this one, so
+    // it sleeps for a millisecond at most
+    struct timespec deadline;
+    timespec_get(&deadline, TIME_UTC);
+    deadline.tv_nsec += NS_PER_MS;
+    if (deadline.tv_nsec >= NS_PER_SEC) {
+      deadline.tv_nsec -= NS_PER_SEC;
+      ++deadline.tv_sec;
+    }
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    cnd_timedwait(&log_wait_condvar, &log_wait_mutex, &deadline);
+  }
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&log_wait_mutex);
+  atomic_store_explicit(&log_writer_waiting, false, memory_order_relaxed);
+}
+
+// must be called with log_mutex held, after log_snapshot is replaced. returns
+// once no reader can still access the previous snapshot.
+static void synchronize(void) {
+  unsigned generation =
+      atomic_fetch_add_explicit(&log_generation, 1, memory_order_relaxed);
+  // pairs with the fence in read_lock()
+  atomic_thread_fence(memory_order_seq_cst);
+  // new readers count towards the other generation, so these only decrease
+  wait_for_reader(&log_fallback_reader, generation);
+  for (reader_t* reader =
+           atomic_load_explicit(&log_readers, memory_order_acquire);
+       reader; reader = reader->next)
+    wait_for_reader(reader, generation);
+}
+
+// must be called with log_mutex held
+static void update_id_masks(const log_snapshot_t* _Nullable snapshot) {
+  unsigned masks[SVE4_LOG_LEVEL_MAX] = {0};
+  for (size_t i = 0; snapshot && i < snapshot->num_logs; ++i) {
+    const sve4_log_config_t* config = &snapshot->logs[i]->config;
+    for (int log_id = 0; log_id < SVE4_LOG_ID_MAX; ++log_id) {
+      sve4_log_level_t config_level =
+          sve4_log_config_get_level(config, (sve4_log_id_t)log_id);
+      int min_level = sve4_max((int)config_level, (int)SVE4_LOG_LEVEL_DEBUG);
+      for (int level = min_level; level < SVE4_LOG_LEVEL_MAX; ++level)
+        masks[level] |= 1U << log_id;
+    }
+  }
+  for (int level = 0; level < SVE4_LOG_LEVEL_MAX; ++level)
+    atomic_store_explicit(&sve4__log_id_masks[level], masks[level],
+                          memory_order_relaxed);
+}
+
+// must be called with log_mutex held. takes ownership of snapshot (NULL if
+// there is no log left) and frees the previous one.
+static void publish(log_snapshot_t* _Nullable snapshot) {
+  log_snapshot_t* old_snapshot = atomic_exchange(&log_snapshot, snapshot);
+  update_id_masks(snapshot);
+  synchronize();
+  sve4_free(log_allocator, old_snapshot);
+}
+
+static log_snapshot_t* _Nullable alloc_snapshot(size_t num_logs) {
+  log_snapshot_t* snapshot = sve4_malloc(
+      log_allocator, sizeof(log_snapshot_t) + num_logs * sizeof(sve4_log_t));
+  if (snapshot)
+    snapshot->num_logs = num_logs;
+  return snapshot;
+}
+
 sve4_log_config_t sve4_log_config_ref(const sve4_log_config_t* src) {
-  return (sve4_log_config_t){
+  sve4_log_config_t config = {
       .level = src->level,
       .callback = sve4_log_callback_ref(src->callback),
       .id_mapping = sve4_log_id_mapping_ref(src->id_mapping),
       .path_shorten = sve4_log_shorten_path_config_ref(src->path_shorten),
+      .id_level_mask = src->id_level_mask,
   };
+  memcpy(config.id_levels, src->id_levels, sizeof config.id_levels);
+  return config;
 }
 
 sve4_log_error_t sve4_log_init(sve4_allocator_t* allocator) {
   log_allocator = allocator;
+  monotonic_now(&log_epoch);
   // NOLINTNEXTLINE(misc-include-cleaner)
   int err = mtx_init(&log_mutex, mtx_plain);
   // NOLINTNEXTLINE(misc-include-cleaner)
-  if (err != thrd_success) {
-    sve4_flog(SVE4_LOG_ID_APPLICATION, SVE4_LOG_LEVEL_ERROR,
-              "unable to initialize mutex: %d", err);
-    return SVE4_LOG_ERROR_THREADS;
-  }
+  if (err != thrd_success)
+    goto fail_mutex;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  err = mtx_init(&log_wait_mutex, mtx_plain);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (err != thrd_success)
+    goto fail_wait_mutex;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  err = cnd_init(&log_wait_condvar);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (err != thrd_success)
+    goto fail_wait_condvar;
 
   return SVE4_LOG_ERROR_SUCCESS;
+
+fail_wait_condvar:
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&log_wait_mutex);
+fail_wait_mutex:
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&log_mutex);
+fail_mutex:
+  sve4_flog(SVE4_LOG_ID_APPLICATION, SVE4_LOG_LEVEL_ERROR,
+            "unable to initialize mutex: %d", err);
+  return SVE4_LOG_ERROR_THREADS;
 }
 
+sve4_allocator_t* _Nullable sve4__log_allocator(void) { return log_allocator; }
+
 void sve4_log_destroy(void) {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
-  while (log_first)
-    sve4_log_remove_log(log_first);
-#pragma GCC diagnostic pop
-  // NOLINTNEXTLINE(misc-include-cleaner)
+  sve4__log_flush_suppressed();
+  sve4_log_stop_async();
+  for (log_snapshot_t* snapshot; (snapshot = atomic_load(&log_snapshot));)
+    sve4_log_remove_log(snapshot->logs[snapshot->num_logs - 1]);
+  // NOLINTBEGIN(misc-include-cleaner)
+  cnd_destroy(&log_wait_condvar);
+  mtx_destroy(&log_wait_mutex);
   mtx_destroy(&log_mutex);
+  // NOLINTEND(misc-include-cleaner)
 }
 
 sve4_log_error_t sve4_log_add_config(sve4_log_config_t* _Nonnull config,
@@ -149,11 +527,6 @@ sve4_log_error_t sve4_log_add_config(sve4_log_config_t* _Nonnull config,
       sve4_malloc(log_allocator, sizeof(struct sve4_log_inner_t));
   if (!log_handle)
     return SVE4_LOG_ERROR_MEMORY;
-  memcpy(&log_handle->config, config, sizeof *config);
-  memset(config, 0, sizeof *config);
-
-  log_handle->prev = log_last;
-  log_handle->next = NULL;
 
   // NOLINTNEXTLINE(misc-include-cleaner)
   int err = mtx_lock(&log_mutex);
@@ -165,8 +538,22 @@ sve4_log_error_t sve4_log_add_config(sve4_log_config_t* _Nonnull config,
     return SVE4_LOG_ERROR_THREADS;
   }
 
-  log_last ? (log_last->next = log_handle) : (log_first = log_handle);
-  log_last = log_handle;
+  const log_snapshot_t* old_snapshot =
+      atomic_load_explicit(&log_snapshot, memory_order_relaxed);
+  size_t num_logs = old_snapshot ? old_snapshot->num_logs : 0;
+  log_snapshot_t* snapshot = alloc_snapshot(num_logs + 1);
+  if (!snapshot) {
+    mtx_unlock(&log_mutex);
+    sve4_free(log_allocator, log_handle);
+    return SVE4_LOG_ERROR_MEMORY;
+  }
+
+  memcpy(&log_handle->config, config, sizeof *config);
+  memset(config, 0, sizeof *config);
+  if (old_snapshot)
+    memcpy(snapshot->logs, old_snapshot->logs, num_logs * sizeof(sve4_log_t));
+  snapshot->logs[num_logs] = log_handle;
+  publish(snapshot);
 
   // NOLINTNEXTLINE(misc-include-cleaner)
   err = mtx_unlock(&log_mutex);
@@ -189,13 +576,26 @@ sve4_log_error_t sve4_log_remove_log(sve4_log_t _Nonnull log) {
     return SVE4_LOG_ERROR_THREADS;
   }
 
+  const log_snapshot_t* old_snapshot =
+      atomic_load_explicit(&log_snapshot, memory_order_relaxed);
+  assert(old_snapshot);
+  size_t num_logs = old_snapshot->num_logs - 1;
+  log_snapshot_t* snapshot = NULL;
+  if (num_logs > 0 && !(snapshot = alloc_snapshot(num_logs))) {
+    mtx_unlock(&log_mutex);
+    return SVE4_LOG_ERROR_MEMORY;
+  }
+
+  for (size_t i = 0, j = 0; snapshot && i <= num_logs; ++i) {
+    if (old_snapshot->logs[i] != log)
+      snapshot->logs[j++] = old_snapshot->logs[i];
+  }
+  // the callback may still be running until then
+  publish(snapshot);
+
   sve4_log_callback_free(&log->config.callback);
   sve4_shorten_path_config_free(&log->config.path_shorten);
   sve4_log_id_mapping_free(&log->config.id_mapping);
-
-  log->prev ? (log->prev->next = log->next) : (log_first = log->next);
-  log->next ? (log->next->prev = log->prev) : (log_last = log->prev);
-
   sve4_free(log_allocator, log);
 
   err = mtx_unlock(&log_mutex);
@@ -211,17 +611,67 @@ typedef struct {
   FILE* file;
   bool close;
   bool ansi;
+  // keeps the lines of concurrent records apart
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_t mutex;
 } log_file_t;
 
 static void log_file_free(char* _Nonnull data) {
   log_file_t* log_file = (log_file_t*)(void*)data;
-  if (log_file->close && log_file->file)
+  // NULL if the mutex could not be initialized
+  if (!log_file->file)
+    return;
+  if (log_file->close)
     fclose(log_file->file);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&log_file->mutex);
 }
 
-static void log_to_file(sve4_log_record_t* _Nonnull record,
-                        const sve4_log_config_t* _Nullable config,
-                        FILE* _Nonnull out, bool flog, bool ansi) {
+// writes value (clamped to 0) as exactly num_digits digits
+static char* _Nonnull put_digits(char* _Nonnull out, long long value,
+                                 int num_digits) {
+  value = sve4_max(value, 0LL);
+  for (int i = num_digits - 1; i >= 0; --i) {
+    out[i] = (char)('0' + value % 10);
+    value /= 10;
+  }
+  return out + num_digits;
+}
+
+enum { TIMESTAMP_BUF_MAX_SIZE = 32 };
+
+// HH:MM:SS.mmm, or HH:MM:SS.nnnnnnnnn for monotonic time (where the hours
+// count the days too and may take more digits). strftime() is not needed for
+// these and costs more than the rest of the prefix.
+static void format_timestamp(char* _Nonnull buf,
+                             const sve4_log_record_t* _Nonnull record) {
+  const struct tm* timestamp = record->timestamp;
+  long long hours = timestamp->tm_hour;
+  long long fraction = record->fractional_timestamp / NS_PER_MS;
+  int fraction_digits = 3;
+  if (record->clock == SVE4_LOG_CLOCK_MONOTONIC) {
+    hours += (long long)timestamp->tm_yday * HOURS_PER_DAY;
+    fraction = record->fractional_timestamp;
+    fraction_digits = 9;
+  }
+
+  int hour_digits = 2;
+  for (long long rest = hours; rest >= 100; rest /= 10)
+    ++hour_digits;
+  char* out = put_digits(buf, hours, hour_digits);
+  *out++ = ':';
+  out = put_digits(out, timestamp->tm_min, 2);
+  *out++ = ':';
+  out = put_digits(out, timestamp->tm_sec, 2);
+  *out++ = '.';
+  out = put_digits(out, fraction, fraction_digits);
+  *out = '\0';
+}
+
+int sve4__log_format_record(char* _Nullable buf, size_t size,
+                            sve4_log_record_t* _Nonnull record,
+                            const sve4_log_config_t* _Nullable config,
+                            bool flog, bool ansi) {
   static const char* log_level_names[] = {
       [SVE4_LOG_LEVEL_DEBUG] = "DEBUG",
       [SVE4_LOG_LEVEL_INFO] = "INFO",
@@ -234,9 +684,8 @@ static void log_to_file(sve4_log_record_t* _Nonnull record,
       [SVE4_LOG_LEVEL_WARNING] = SVE4_LOG_ANSI_FG_BRIGHT_YELLOW,
       [SVE4_LOG_LEVEL_ERROR] = SVE4_LOG_ANSI_FG_BRIGHT_RED,
   };
-#define TIMESTAMP_BUF_MAX_SIZE 16
-  char timestamp_buf[TIMESTAMP_BUF_MAX_SIZE] = {0};
-  strftime(timestamp_buf, sizeof(timestamp_buf), "%H:%M:%S", record->timestamp);
+  char timestamp_buf[TIMESTAMP_BUF_MAX_SIZE];
+  format_timestamp(timestamp_buf, record);
 
   const char* ansi_timestamp = "";
   const char* ansi_level = "";
@@ -264,33 +713,80 @@ static void log_to_file(sve4_log_record_t* _Nonnull record,
   const char* file = sve4_log_shorten_path(
       file_buf, config ? config->path_shorten.max_length + 1 : 0, record->file,
       config ? config->path_shorten.root_prefix : SVE4_ROOT_DIR);
-  //             TIME  LOGLEVEL LOGGERID FILE:LINE  FLOG
-  fprintf(out, "%s%s%s %s%-5s%s %s[%s]%s %s%s:%zu: %s%s%s %s",
-          // timestamp
-          ansi_timestamp, timestamp_buf, ansi_reset,
-          // log level
-          ansi_level,
-          record->level >= 0 && record->level < SVE4_LOG_LEVEL_MAX
-              ? log_level_names[record->level]
-              : "???",
-          ansi_reset,
-          // logger id
-          ansi_id,
-          config ? config->id_mapping.get_log_id_name(
-                       record->id, config->id_mapping.user_data)
-                 : "???",
-          ansi_reset,
-          // file:line
-          ansi_location, file, record->line, ansi_reset,
-          // flog
-          ansi_flog, flog_text, ansi_reset);
+  //                  TIME  LOGLEVEL LOGGERID FILE:LINE  FLOG
+  int prefix_len =
+      snprintf(buf, size, "%s%s%s %s%-5s%s %s[%s]%s %s%s:%zu: %s%s%s %s",
+               // timestamp
+               ansi_timestamp, timestamp_buf, ansi_reset,
+               // log level
+               ansi_level,
+               record->level >= 0 && record->level < SVE4_LOG_LEVEL_MAX
+                   ? log_level_names[record->level]
+                   : "???",
+               ansi_reset,
+               // logger id
+               ansi_id,
+               config ? config->id_mapping.get_log_id_name(
+                            record->id, config->id_mapping.user_data)
+                      : "???",
+               ansi_reset,
+               // file:line
+               ansi_location, file, record->line, ansi_reset,
+               // flog
+               ansi_flog, flog_text, ansi_reset);
+  if (prefix_len < 0)
+    return prefix_len;
+
+  size_t len = (size_t)prefix_len;
+  va_list args;
+  va_copy(args, record->args);
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wformat-nonliteral"
-  vfprintf(out, record->msg, record->args);
+  int msg_len = vsnprintf(len < size ? buf + len : NULL,
+                          len < size ? size - len : 0, record->msg, args);
 #pragma GCC diagnostic pop
+  va_end(args);
+  if (msg_len < 0)
+    return msg_len;
+
+  len += (size_t)msg_len;
   if (record->endl) {
-    fputc('\n', out);
+    if (len + 1 < size) {
+      buf[len] = '\n';
+      buf[len + 1] = '\0';
+    }
+    ++len;
   }
+  return (int)len;
+}
+
+enum { LINE_BUF_SIZE = 1024 };
+
+static void log_to_file(sve4_log_record_t* _Nonnull record,
+                        const sve4_log_config_t* _Nullable config,
+                        FILE* _Nonnull out, bool flog, bool ansi) {
+  // a single write per record
+  char line_buf[LINE_BUF_SIZE];
+  int len = sve4__log_format_record(line_buf, sizeof line_buf, record, config,
+                                    flog, ansi);
+  if (len < 0)
+    return;
+
+  char* line = line_buf;
+  if ((size_t)len >= sizeof line_buf) {
+    char* long_line = sve4_malloc(log_allocator, (size_t)len + 1);
+    // otherwise, the truncated line is better than nothing
+    if (long_line) {
+      sve4__log_format_record(long_line, (size_t)len + 1, record, config, flog,
+                              ansi);
+      line = long_line;
+    } else {
+      len = (int)sizeof line_buf - 1;
+    }
+  }
+  fwrite(line, 1, (size_t)len, out);
+  if (line != line_buf)
+    sve4_free(log_allocator, line);
 
   // flush after important messages
   if (record->level >= SVE4_LOG_LEVEL_WARNING) {
@@ -306,7 +802,11 @@ static void log_file_callback(sve4_log_record_t* _Nonnull record,
   log_file_t* log_file =
       (log_file_t*)sve4_buffer_get_data(conf->callback.user_data);
 #pragma GCC diagnostic pop
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&log_file->mutex);
   log_to_file(record, conf, log_file->file, false, log_file->ansi);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&log_file->mutex);
 }
 
 sve4_log_error_t sve4_log_to_file(sve4_log_callback_t* callback, FILE* file,
@@ -321,10 +821,16 @@ sve4_log_error_t sve4_log_to_file(sve4_log_callback_t* callback, FILE* file,
   log_file_t* log_file = (log_file_t*)sve4_buffer_get_data(callback->user_data);
 #pragma GCC diagnostic pop
 
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (mtx_init(&log_file->mutex, mtx_plain) != thrd_success) {
+    sve4_buffer_free(&callback->user_data);
+    return SVE4_LOG_ERROR_THREADS;
+  }
   log_file->file = file;
   log_file->ansi = ansi;
   log_file->close = close;
   callback->callback = log_file_callback;
+  callback->flush = NULL;
   return SVE4_LOG_ERROR_SUCCESS;
 }
 
@@ -342,35 +848,36 @@ sve4_log_error_t sve4_log_to_stderr(sve4_log_callback_t* callback,
                           force_ansi || stderr_ansi_supported);
 }
 
-void sve4_glogv(sve4_log_id_t log_id, const char* _Nonnull file, size_t line,
-                bool endl, sve4_log_level_t level, const char* _Nonnull fmt,
-                va_list args) {
-  struct timespec log_timestamp;
-  timespec_get(&log_timestamp, TIME_UTC);
-
-  int err = 0;
-  err = mtx_lock(&log_mutex);
-  if (err != thrd_success) {
-    sve4_flog(SVE4_LOG_ID_DEFAULT_SVE4_LOG, SVE4_LOG_LEVEL_ERROR,
-              "unable to lock mutex: %d", err);
+static void dispatchv(sve4_log_id_t log_id, const char* _Nonnull file,
+                      size_t line, bool endl, sve4_log_level_t level,
+                      const struct timespec* _Nonnull log_timestamp,
+                      const char* _Nonnull fmt, va_list args) {
+  atomic_uint* reader = read_lock();
+  const log_snapshot_t* snapshot = atomic_load(&log_snapshot);
+  if (!snapshot) {
+    read_unlock(reader);
     return;
   }
 
-  // NOTE: this is not thread-safe
-  struct tm* timestamp = localtime(&(time_t){log_timestamp.tv_sec});
+  sve4_log_clock_t clock = atomic_load_explicit(&log_clock,
+                                                memory_order_relaxed);
+  struct tm timestamp;
+  to_broken_down_time(log_timestamp->tv_sec, clock, &timestamp);
 
-  for (sve4_log_t log = log_first; log; log = log->next) {
+  for (size_t i = 0; i < snapshot->num_logs; ++i) {
+    sve4_log_t log = snapshot->logs[i];
     sve4_log_record_t record = {
         .id = log_id,
         .level = level,
         .msg = fmt,
-        .timestamp = timestamp,
-        .fractional_timestamp = (int32_t)log_timestamp.tv_nsec,
+        .timestamp = &timestamp,
+        .fractional_timestamp = (int32_t)log_timestamp->tv_nsec,
+        .clock = clock,
         .file = file,
         .line = line,
         .endl = endl,
     };
-    if (log->config.level > level)
+    if (sve4_log_config_get_level(&log->config, log_id) > level)
       continue;
 
     va_copy(record.args, args);
@@ -378,11 +885,50 @@ void sve4_glogv(sve4_log_id_t log_id, const char* _Nonnull file, size_t line,
     va_end(record.args);
   }
 
-  err = mtx_unlock(&log_mutex);
-  if (err != thrd_success) {
-    sve4_flog(SVE4_LOG_ID_DEFAULT_SVE4_LOG, SVE4_LOG_LEVEL_ERROR,
-              "unable to unlock mutex, silently failing: %d", err);
+  read_unlock(reader);
+}
+
+void sve4__log_flush_callbacks(void) {
+  atomic_uint* reader = read_lock();
+  const log_snapshot_t* snapshot = atomic_load(&log_snapshot);
+  for (size_t i = 0; snapshot && i < snapshot->num_logs; ++i) {
+    const sve4_log_config_t* config = &snapshot->logs[i]->config;
+    if (config->callback.flush)
+      config->callback.flush(config);
   }
+  read_unlock(reader);
+}
+
+void sve4__log_dispatch(sve4_log_id_t log_id, const char* _Nonnull file,
+                        size_t line, bool endl, sve4_log_level_t level,
+                        const struct timespec* _Nonnull timestamp,
+                        const char* _Nonnull fmt, ...) {
+  va_list args;
+  va_start(args, fmt);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  dispatchv(log_id, file, line, endl, level, timestamp, fmt, args);
+#pragma GCC diagnostic pop
+  va_end(args);
+}
+
+void sve4_glogv(sve4_log_id_t log_id, const char* _Nonnull file, size_t line,
+                bool endl, sve4_log_level_t level, const char* _Nonnull fmt,
+                va_list args) {
+  // callers outside of the macros (e.g. the FFmpeg callback) skip the
+  // timestamp and the async rings too
+  if (!sve4_log_id_enabled(log_id, level))
+    return;
+
+  struct timespec log_timestamp;
+  sve4__log_now(&log_timestamp);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  if (sve4__log_async_push(log_id, file, line, endl, level, &log_timestamp, fmt,
+                           args))
+    return;
+  dispatchv(log_id, file, line, endl, level, &log_timestamp, fmt, args);
+#pragma GCC diagnostic pop
 }
 
 void sve4__flogv(sve4_log_id_t log_id, const char* file, size_t line,
@@ -397,9 +943,11 @@ void sve4__flogv(sve4_log_id_t log_id, const char* file, size_t line,
       .id_mapping = sve4_log_id_mapping_default(),
   };
   struct timespec log_timestamp;
-  timespec_get(&log_timestamp, TIME_UTC);
-  struct tm timestamp = {0};
-  localtime_r(&(time_t){log_timestamp.tv_sec}, &timestamp);
+  sve4__log_now(&log_timestamp);
+  sve4_log_clock_t clock = atomic_load_explicit(&log_clock,
+                                                memory_order_relaxed);
+  struct tm timestamp;
+  to_broken_down_time(log_timestamp.tv_sec, clock, &timestamp);
 
   sve4_log_record_t record = {
       .id = log_id,
@@ -407,6 +955,7 @@ void sve4__flogv(sve4_log_id_t log_id, const char* file, size_t line,
       .msg = fmt,
       .timestamp = &timestamp,
       .fractional_timestamp = (int32_t)log_timestamp.tv_nsec,
+      .clock = clock,
       .file = file,
       .line = line,
       .endl = true,
@@ -453,6 +1002,7 @@ static void log_munit_callback(sve4_log_record_t* _Nonnull record,
 sve4_log_error_t sve4_log_to_munit(sve4_log_callback_t* _Nonnull callback) {
   callback->callback = log_munit_callback;
   callback->user_data = NULL;
+  callback->flush = NULL;
   return SVE4_LOG_ERROR_SUCCESS;
 }
 #endif
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdio.h>
+#include <time.h>
 
 #include "sve4_log_export.h"
 
@@ -13,25 +14,41 @@
 #include "api.h"
 #include "error.h"
 
+typedef enum {
+  // local wall clock time, printed with millisecond resolution
+  SVE4_LOG_CLOCK_REALTIME,
+  // time elapsed since sve4_log_init() on a monotonic clock, printed with
+  // nanosecond resolution. the days are in tm_yday.
+  SVE4_LOG_CLOCK_MONOTONIC,
+} sve4_log_clock_t;
+
 typedef struct {
   sve4_log_level_t level;
   sve4_log_id_t id;
   const char* _Nonnull msg;
   va_list args;
   const struct tm* _Nonnull timestamp;
+  // nanoseconds
   int32_t fractional_timestamp;
+  sve4_log_clock_t clock;
   const char* _Nonnull file;
   size_t line;
   bool endl;
 } sve4_log_record_t;
 
 typedef struct sve4_log_config_t sve4_log_config_t;
+// may be called from several threads at once, and until
+// sve4_log_remove_log() returns
 typedef void (*sve4_log_callback_fn_t)(sve4_log_record_t* _Nonnull record,
                                        const sve4_log_config_t* _Nonnull conf);
+typedef void (*sve4_log_flush_fn_t)(const sve4_log_config_t* _Nonnull conf);
 
 typedef struct {
   sve4_log_callback_fn_t _Nonnull callback;
   sve4_buffer_ref_t _Nullable user_data;
+  // writes out whatever the callback holds back, called by sve4_log_flush().
+  // may be NULL.
+  sve4_log_flush_fn_t _Nullable flush;
 } sve4_log_callback_t;
 SVE4_LOG_EXPORT
 sve4_log_callback_t sve4_log_callback_ref(sve4_log_callback_t src);
@@ -70,14 +87,51 @@ struct sve4_log_config_t {
   sve4_log_callback_t callback;
   sve4_log_shorten_path_config_t path_shorten;
   sve4_log_id_mapping_t id_mapping;
+  // levels of single log ids, replacing level for the ids whose bit is set in
+  // id_level_mask (so that zero-initialized configs use level everywhere).
+  // see sve4_log_config_set_id_level().
+  unsigned id_level_mask;
+  sve4_log_level_t id_levels[SVE4_LOG_ID_MAX];
 };
 
+static inline void
+sve4_log_config_set_id_level(sve4_log_config_t* _Nonnull config,
+                             sve4_log_id_t log_id, sve4_log_level_t level) {
+  if ((unsigned)log_id >= SVE4_LOG_ID_MAX)
+    return;
+  config->id_levels[log_id] = level;
+  config->id_level_mask |= 1U << log_id;
+}
+
+// the lowest level config accepts for messages of log_id
+static inline sve4_log_level_t
+sve4_log_config_get_level(const sve4_log_config_t* _Nonnull config,
+                          sve4_log_id_t log_id) {
+  return (unsigned)log_id < SVE4_LOG_ID_MAX &&
+                 (config->id_level_mask >> log_id & 1U)
+             ? config->id_levels[log_id]
+             : config->level;
+}
+
 SVE4_LOG_EXPORT
 sve4_log_config_t sve4_log_config_ref(const sve4_log_config_t* _Nonnull src);
+// allocator is used as is, wrap it in a stats allocator (see
+// libsve4_utils/stats_allocator.h) to measure the logger
 SVE4_LOG_EXPORT
 sve4_log_error_t sve4_log_init(sve4_allocator_t* _Nullable allocator);
 SVE4_LOG_EXPORT
 void sve4_log_destroy(void);
+// SVE4_LOG_CLOCK_REALTIME by default. should be set before anything is
+// logged, records of both clocks are not ordered relative to each other.
+SVE4_LOG_EXPORT
+void sve4_log_set_clock(sve4_log_clock_t clock);
+
+typedef void (*sve4_log_time_source_t)(struct timespec* _Nonnull now);
+// replaces the monotonic clock behind rate limiting and
+// SVE4_LOG_CLOCK_MONOTONIC timestamps, NULL restores the system clock. meant
+// for tests, which can then step time by hand.
+SVE4_LOG_EXPORT
+void sve4_log_set_monotonic_source(sve4_log_time_source_t _Nullable source);
 
 typedef struct sve4_log_inner_t* sve4_log_t;
 
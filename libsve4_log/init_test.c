@@ -1,9 +1,11 @@
 #include "init_test.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "libsve4_log/api.h"
+#include "libsve4_utils/stats_allocator.h"
 
 #include "init.h"
 
@@ -19,8 +21,13 @@
 #include "glfw.h"
 #endif
 
+// tracks what the logger allocates, so that teardown can check for leaks
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static sve4_allocator_t log_allocator;
+
 void sve4_log_test_setup(void) {
-  if (sve4_log_init(NULL))
+  if (!sve4_allocator_stats_init(&log_allocator, NULL, "log") ||
+      sve4_log_init(&log_allocator))
     sve4_panic("Failed to initialize sve4 logging");
 
   char* log_level_str = getenv("SVE4_LOG_LEVEL");
@@ -69,6 +76,13 @@ void sve4_log_test_setup(void) {
 
 void sve4_log_test_teardown(void) {
   sve4_log_destroy();
+  sve4_allocator_stats_t stats = sve4_allocator_stats_get(&log_allocator);
+  sve4_allocator_stats_destroy(&log_allocator);
+  // logging is gone, so this cannot go through sve4_panic
+  if (stats.live_bytes != 0) {
+    fprintf(stderr, "sve4 logging leaked %zu bytes\n", stats.live_bytes);
+    abort();
+  }
 }
 
 #ifdef SVE4_LOG_HAVE_MUNIT
@@ -0,0 +1,236 @@
+#include "recorder.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsve4_utils/allocator.h"
+#include "libsve4_utils/buffer.h"
+#include "libsve4_utils/defines.h"
+
+#include "api.h"
+#include "async.h"
+#include "error.h"
+#include "init.h"
+
+#if sve4_has_include(<unistd.h>)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#define write _write
+#define fileno _fileno
+#endif
+
+enum {
+  // longer records are truncated
+  MAX_RECORD_SIZE = 1024,
+  MIN_SIZE = 4 * MAX_RECORD_SIZE,
+  MAX_SIGNALS = 8,
+};
+
+typedef struct {
+  // NULL if the recorder could not be initialized
+  char* _Nullable data;
+  // the size is a power of two, the offset of a position is position & mask
+  size_t mask;
+  // total number of bytes ever written, only ever increasing
+  atomic_size_t head;
+  FILE* _Nonnull file;
+  int fd;
+  bool close;
+  size_t slot;
+} recorder_t;
+
+typedef void (*signal_handler_t)(int);
+
+typedef struct {
+  int signum;
+  signal_handler_t _Nullable previous;
+} signal_entry_t;
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+// read by the signal handlers, so no lock
+static _Atomic(recorder_t*) recorders[SVE4_LOG_MAX_RECORDERS];
+static signal_entry_t signal_entries[MAX_SIGNALS];
+static atomic_size_t num_signal_entries = 0;
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+// only uses async-signal-safe functions where there are file descriptors
+static void write_all(int fd, const char* _Nonnull data, size_t size) {
+  while (size > 0) {
+    long written = (long)write(fd, data, (unsigned)sve4_min(size, INT32_MAX));
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return;
+    }
+    data += written;
+    size -= (size_t)written;
+  }
+}
+
+static void dump(const recorder_t* _Nonnull recorder) {
+  static const char header[] = "---- sve4_log flight recorder dump ----\n";
+  write_all(recorder->fd, header, sizeof header - 1);
+
+  size_t size = recorder->mask + 1;
+  size_t end = atomic_load_explicit(&recorder->head, memory_order_acquire);
+  size_t start = end > size ? end - size : 0;
+  if (start > 0) {
+    // the oldest record is partially overwritten
+    while (start < end && recorder->data[start & recorder->mask] != '\n')
+      ++start;
+    start = sve4_min(start + 1, end);
+  }
+
+  // at most two pieces, as the buffer wraps around
+  while (start < end) {
+    size_t offset = start & recorder->mask;
+    size_t len = sve4_min(end - start, size - offset);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+    write_all(recorder->fd, recorder->data + offset, len);
+#pragma GCC diagnostic pop
+    start += len;
+  }
+}
+
+void sve4_log_dump_recorders(void) {
+  for (size_t i = 0; i < SVE4_LOG_MAX_RECORDERS; ++i) {
+    const recorder_t* recorder = atomic_load(&recorders[i]);
+    if (recorder)
+      dump(recorder);
+  }
+}
+
+static void dump_on_signal(int signum) {
+  sve4_log_dump_recorders();
+  size_t num_entries = sve4_min(atomic_load(&num_signal_entries),
+                                (size_t)MAX_SIGNALS);
+  signal_handler_t previous = SIG_DFL;
+  for (size_t i = 0; i < num_entries; ++i) {
+    if (signal_entries[i].signum == signum && signal_entries[i].previous)
+      previous = signal_entries[i].previous;
+  }
+  signal(signum, previous);
+  raise(signum);
+}
+
+bool sve4_log_dump_recorders_on_signal(int signum) {
+  size_t index = atomic_fetch_add(&num_signal_entries, 1);
+  if (index >= MAX_SIGNALS)
+    return false;
+
+  signal_handler_t previous = signal(signum, dump_on_signal);
+  if (previous == SIG_ERR)
+    return false;
+  // until then, the handler falls back to the default handler
+  signal_entries[index] = (signal_entry_t){
+      .signum = signum,
+      .previous = previous,
+  };
+  return true;
+}
+
+static void recorder_callback(sve4_log_record_t* _Nonnull record,
+                              const sve4_log_config_t* _Nonnull config) {
+  assert(config->callback.user_data);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  recorder_t* recorder =
+      (recorder_t*)(void*)sve4_buffer_get_data(config->callback.user_data);
+#pragma GCC diagnostic pop
+
+  char line[MAX_RECORD_SIZE];
+  int len = sve4__log_format_record(line, sizeof line, record, config, false,
+                                    false);
+  if (len <= 0)
+    return;
+  if ((size_t)len >= sizeof line) {
+    len = (int)sizeof line - 1;
+    if (record->endl)
+      line[len - 1] = '\n';
+  }
+
+  // concurrent records take consecutive ranges
+  size_t start = atomic_fetch_add_explicit(&recorder->head, (size_t)len,
+                                           memory_order_relaxed);
+  size_t offset = start & recorder->mask;
+  size_t first_len = sve4_min((size_t)len, recorder->mask + 1 - offset);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  memcpy(recorder->data + offset, line, first_len);
+  memcpy(recorder->data, line + first_len, (size_t)len - first_len);
+#pragma GCC diagnostic pop
+}
+
+static void recorder_free(char* _Nonnull data) {
+  recorder_t* recorder = (recorder_t*)(void*)data;
+  if (!recorder->data)
+    return;
+  atomic_store(&recorders[recorder->slot], NULL);
+  sve4_free(sve4__log_allocator(), recorder->data);
+  if (recorder->close)
+    fclose(recorder->file);
+}
+
+sve4_log_error_t sve4_log_to_recorder(sve4_log_callback_t* _Nonnull callback,
+                                      size_t size, FILE* _Nonnull dump_file,
+                                      bool close) {
+  size_t buffer_size = MIN_SIZE;
+  size_t wanted = size ? size : SVE4_LOG_RECORDER_DEFAULT_SIZE;
+  while (buffer_size < wanted) {
+    if (buffer_size > SIZE_MAX / 2)
+      return SVE4_LOG_ERROR_MEMORY;
+    buffer_size *= 2;
+  }
+
+  callback->user_data = sve4_buffer_create(sve4__log_allocator(),
+                                           sizeof(recorder_t), recorder_free);
+  if (!callback->user_data)
+    return SVE4_LOG_ERROR_MEMORY;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  recorder_t* recorder =
+      (recorder_t*)(void*)sve4_buffer_get_data(callback->user_data);
+#pragma GCC diagnostic pop
+  char* data = sve4_calloc(sve4__log_allocator(), buffer_size);
+  if (!data)
+    goto fail_data;
+
+  recorder->data = data;
+  recorder->mask = buffer_size - 1;
+  recorder->file = dump_file;
+  recorder->close = close;
+  // whatever stdio holds goes before the dumps
+  fflush(dump_file);
+  recorder->fd = fileno(dump_file);
+  for (recorder->slot = 0; recorder->slot < SVE4_LOG_MAX_RECORDERS;
+       ++recorder->slot) {
+    recorder_t* expected = NULL;
+    if (atomic_compare_exchange_strong(&recorders[recorder->slot], &expected,
+                                       recorder))
+      break;
+  }
+  if (recorder->slot == SVE4_LOG_MAX_RECORDERS)
+    goto fail_slot;
+
+  callback->callback = recorder_callback;
+  callback->flush = NULL;
+  return SVE4_LOG_ERROR_SUCCESS;
+
+fail_slot:
+  // recorder_free() must not see it
+  recorder->data = NULL;
+  sve4_free(sve4__log_allocator(), data);
+fail_data:
+  sve4_buffer_free(&callback->user_data);
+  return SVE4_LOG_ERROR_MEMORY;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "sve4_log_export.h"
+
+#include "error.h"
+#include "init.h"
+
+// FLIGHT RECORDER
+//
+// A sink keeping the most recent records in memory, formatted like
+// sve4_log_to_file() into a circular buffer. Logging costs the formatting,
+// an atomic add and a copy, no lock and no I/O. The buffer is only written
+// out on demand (sve4_log_dump_recorders()), by sve4_panic(), and from the
+// handlers installed with sve4_log_dump_recorders_on_signal(). This keeps
+// every detail of the last moments before a stall or a crash, even at the
+// debug level, without paying for the output.
+//
+// Dumps write the dump file through its descriptor, with a line marking the
+// start of each dump. A record being logged while the buffer is dumped may
+// be cut.
+
+#define SVE4_LOG_RECORDER_DEFAULT_SIZE ((size_t)1024 * 1024)
+// at most that many recorders exist at once
+enum { SVE4_LOG_MAX_RECORDERS = 8 };
+
+// size is rounded up to a power of two, 0 means
+// SVE4_LOG_RECORDER_DEFAULT_SIZE. dump_file is closed when the callback is
+// freed if close is true. returns SVE4_LOG_ERROR_MEMORY if there are
+// SVE4_LOG_MAX_RECORDERS recorders already.
+SVE4_LOG_EXPORT
+sve4_log_error_t sve4_log_to_recorder(sve4_log_callback_t* _Nonnull callback,
+                                      size_t size, FILE* _Nonnull dump_file,
+                                      bool close);
+
+// writes the buffer of every recorder to its dump file. must not run
+// concurrently with the removal of a recorder log.
+SVE4_LOG_EXPORT
+void sve4_log_dump_recorders(void);
+
+// dumps the recorders once signum is raised, then passes the signal on to the
+// previous handler (e.g. the default one, terminating the process). returns
+// false if the handler could not be installed.
+SVE4_LOG_EXPORT
+bool sve4_log_dump_recorders_on_signal(int signum);
@@ -0,0 +1,158 @@
+#include "libsve4_log/async.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "libsve4_log/init.h"
+#include "libsve4_utils/buffer.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#include "counter.h"
+#include "munit.h"
+
+#define assert_success(err)                                                    \
+  munit_assert_int((int)err, ==, SVE4_LOG_ERROR_SUCCESS)
+
+enum { NUM_THREADS = 4, LOGS_PER_THREAD = 2000, NUM_DROP_LOGS = 500 };
+
+static int logger_main(void* arg) {
+  (void)arg;
+  for (int i = 0; i < LOGS_PER_THREAD; ++i)
+    sve4_log_info("message %d from a worker thread", i);
+  return 0;
+}
+
+static MunitResult test_threads(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  atomic_int num_logs = 0;
+  assert_success(sve4_log_add_config(
+      (sve4_log_config_t[]){counter_log_config(&num_logs)}, NULL));
+  // small enough for the workers to wait for the writer regularly
+  assert_success(sve4_log_start_async(&(sve4_log_async_config_t){
+      .ring_size = 4096,
+      .overflow = SVE4_LOG_OVERFLOW_BLOCK,
+  }));
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  thrd_t threads[NUM_THREADS];
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    munit_assert_int(thrd_create(&threads[i], logger_main, NULL), ==,
+                     thrd_success);
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    thrd_join(threads[i], NULL);
+  // NOLINTEND(misc-include-cleaner)
+
+  sve4_log_flush();
+  munit_assert_int(atomic_load(&num_logs), ==, NUM_THREADS * LOGS_PER_THREAD);
+  munit_assert_size(sve4_log_async_num_dropped(), ==, 0);
+
+  // once stopped, logging is synchronous again
+  sve4_log_stop_async();
+  sve4_log_info("synchronous message");
+  munit_assert_int(atomic_load(&num_logs), ==,
+                   NUM_THREADS * LOGS_PER_THREAD + 1);
+
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+typedef struct {
+  atomic_bool open;
+  atomic_int num_info_logs;
+  atomic_int num_warnings;
+} gate_t;
+
+// blocks the writer until the gate is opened
+static void gate_callback(sve4_log_record_t* record,
+                          const sve4_log_config_t* config) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  gate_t* gate = *(gate_t**)sve4_buffer_get_data(config->callback.user_data);
+#pragma GCC diagnostic pop
+  while (!atomic_load(&gate->open))
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    thrd_yield();
+  if (record->level == SVE4_LOG_LEVEL_INFO)
+    atomic_fetch_add(&gate->num_info_logs, 1);
+  else if (record->level == SVE4_LOG_LEVEL_WARNING)
+    atomic_fetch_add(&gate->num_warnings, 1);
+}
+
+static MunitResult test_drop(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  gate_t gate = {0};
+  sve4_log_config_t conf = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+      .callback =
+          {
+              .callback = gate_callback,
+              .user_data = sve4_buffer_create(NULL, sizeof(gate_t*), NULL),
+          },
+  };
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  munit_assert_not_null(conf.callback.user_data);
+  *(gate_t**)sve4_buffer_get_data(conf.callback.user_data) = &gate;
+#pragma GCC diagnostic pop
+  assert_success(sve4_log_add_config(&conf, NULL));
+  assert_success(sve4_log_start_async(&(sve4_log_async_config_t){
+      .ring_size = 4096,
+      .overflow = SVE4_LOG_OVERFLOW_DROP,
+  }));
+
+  // the writer is stuck on the first message, so the ring fills up
+  for (int i = 0; i < NUM_DROP_LOGS; ++i)
+    sve4_log_info("message %d", i);
+  size_t dropped = sve4_log_async_num_dropped();
+  munit_assert_size(dropped, >, 0);
+
+  atomic_store(&gate.open, true);
+  sve4_log_flush();
+  munit_assert_int(atomic_load(&gate.num_info_logs) + (int)dropped, ==,
+                   NUM_DROP_LOGS);
+  // the drops are reported once the writer catches up
+  munit_assert_int(atomic_load(&gate.num_warnings), ==, 1);
+
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/threads",
+        test_threads,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/drop",
+        test_drop,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/async", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
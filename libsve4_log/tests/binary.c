@@ -0,0 +1,344 @@
+#include "libsve4_log/binary.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsve4_log/init.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#include "munit.h"
+
+#define assert_success(err)                                                    \
+  munit_assert_int((int)err, ==, SVE4_LOG_ERROR_SUCCESS)
+
+enum { MAX_CASES = 16, MAX_LINE = 512 };
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static char expected[MAX_CASES][MAX_LINE];
+static size_t num_expected = 0;
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+#define log_and_expect(...)                                                    \
+  do {                                                                         \
+    sve4_log_info(__VA_ARGS__);                                                \
+    snprintf(expected[num_expected++], MAX_LINE, __VA_ARGS__);                 \
+  } while (0)
+
+static sve4_log_config_t text_config(FILE* file) {
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+      .path_shorten =
+          {
+              .max_length = 10,
+              .root_prefix = SVE4_ROOT_DIR,
+          },
+  };
+  assert_success(sve4_log_to_file(&config.callback, file, false, false));
+  return config;
+}
+
+static MunitResult test_roundtrip(const MunitParameter params[],
+                                  void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* bin = tmpfile();
+  munit_assert_not_null(bin);
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+  };
+  assert_success(sve4_log_to_binary(&config.callback, bin, false));
+  sve4_log_t log;
+  assert_success(sve4_log_add_config(&config, &log));
+
+  num_expected = 0;
+  log_and_expect("plain message, 100%%");
+  log_and_expect("ints: %d %i %u %x %X %o", -42, 7, 42U, 255U, 255U, 8U);
+  log_and_expect("lengths: %hhd %hu %ld %lld %zu %jd", (signed char)-3,
+                 (unsigned short)65535, -123456789L, -1234567890123LL,
+                 (size_t)SIZE_MAX, (intmax_t)-5);
+  log_and_expect("flags: [%-6d] [%+d] [%05d] [%#x]", 12, 12, 12, 0x2aU);
+  log_and_expect("stars: [%*d] [%-*d] [%.*f]", 6, 1, 4, 2, 3, 3.14159);
+  log_and_expect("floats: %f %.2e %g %5.1f", 1.5, 12345.678, 0.0001, -2.25);
+  log_and_expect("strings: [%s] [%8s] [%.3s] [%.*s] %c", "abc", "right",
+                 "truncated", 2, "xyz", 'q');
+  // repeated format strings reuse the interned string
+  for (int i = 0; i < 3; ++i)
+    log_and_expect("loop %d", i);
+  assert_success(sve4_log_remove_log(log));
+
+  rewind(bin);
+  FILE* text = tmpfile();
+  munit_assert_not_null(text);
+  sve4_log_config_t decode_config = text_config(text);
+  assert_success(sve4_log_binary_decode(bin, &decode_config));
+  sve4_log_callback_free(&decode_config.callback);
+  fclose(bin);
+
+  rewind(text);
+  char line[MAX_LINE * 2];
+  size_t num_lines = 0;
+  while (fgets(line, sizeof line, text)) {
+    munit_assert_size(num_lines, <, num_expected);
+    // the message is preceded by the usual timestamp, level and location
+    munit_assert_not_null(strstr(line, "INFO"));
+    munit_assert_not_null(strstr(line, "binary"));
+    size_t len = strlen(line);
+    munit_assert_size(len, >, strlen(expected[num_lines]));
+    line[len - 1] = '\0';
+    munit_assert_string_equal(line + len - 1 - strlen(expected[num_lines]),
+                              expected[num_lines]);
+    ++num_lines;
+  }
+  munit_assert_size(num_lines, ==, num_expected);
+  fclose(text);
+
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+static MunitResult test_truncated(const MunitParameter params[],
+                                  void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* bin = tmpfile();
+  munit_assert_not_null(bin);
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+  };
+  assert_success(sve4_log_to_binary(&config.callback, bin, false));
+  sve4_log_t log;
+  assert_success(sve4_log_add_config(&config, &log));
+
+  static char long_str[SVE4_LOG_BINARY_MAX_PAYLOAD * 2];
+  memset(long_str, 'a', sizeof long_str - 1);
+  // the string fills the payload, so the integer is dropped
+  sve4_log_info("%s %d", long_str, 42);
+  assert_success(sve4_log_remove_log(log));
+
+  rewind(bin);
+  FILE* text = tmpfile();
+  munit_assert_not_null(text);
+  sve4_log_config_t decode_config = text_config(text);
+  assert_success(sve4_log_binary_decode(bin, &decode_config));
+  sve4_log_callback_free(&decode_config.callback);
+  fclose(bin);
+
+  rewind(text);
+  static char line[SVE4_LOG_BINARY_MAX_PAYLOAD * 2];
+  munit_assert_not_null(fgets(line, sizeof line, text));
+  munit_assert_not_null(strstr(line, "aaaa %d"));
+  fclose(text);
+
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+static MunitResult test_reused_format(const MunitParameter params[],
+                                      void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* bin = tmpfile();
+  munit_assert_not_null(bin);
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+  };
+  assert_success(sve4_log_to_binary(&config.callback, bin, false));
+  sve4_log_t log;
+  assert_success(sve4_log_add_config(&config, &log));
+
+  // the same buffer holds a different format string each time
+  char fmt[32];
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
+  static const char* const formats[] = {"first %d", "second %d", "third %d",
+                                        "fourth %d"};
+  for (size_t i = 0; i < sizeof formats / sizeof formats[0]; ++i) {
+    strcpy(fmt, formats[i]);
+    sve4_log_info(fmt, (int)i);
+  }
+  // same length, different contents
+  strcpy(fmt, "fifth %d");
+  sve4_log_info(fmt, 4);
+#pragma GCC diagnostic pop
+  assert_success(sve4_log_remove_log(log));
+
+  rewind(bin);
+  FILE* text = tmpfile();
+  munit_assert_not_null(text);
+  sve4_log_config_t decode_config = text_config(text);
+  assert_success(sve4_log_binary_decode(bin, &decode_config));
+  sve4_log_callback_free(&decode_config.callback);
+  fclose(bin);
+
+  rewind(text);
+  static const char* const messages[] = {"first 0", "second 1", "third 2",
+                                         "fourth 3", "fifth 4"};
+  char line[MAX_LINE];
+  for (size_t i = 0; i < sizeof messages / sizeof messages[0]; ++i) {
+    munit_assert_not_null(fgets(line, sizeof line, text));
+    munit_assert_not_null(strstr(line, messages[i]));
+  }
+  munit_assert_null(fgets(line, sizeof line, text));
+  fclose(text);
+
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+enum { NUM_THREADS = 4, RECORDS_PER_THREAD = 2000 };
+
+static int log_records(void* arg) {
+  int thread = *(const int*)arg;
+  // more than a ring holds, so the threads wait for the writer too
+  for (int i = 0; i < RECORDS_PER_THREAD; ++i)
+    sve4_log_info("thread %d record %d", thread, i);
+  return 0;
+}
+
+static MunitResult test_threads(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* bin = tmpfile();
+  munit_assert_not_null(bin);
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+  };
+  assert_success(sve4_log_to_binary(&config.callback, bin, false));
+  sve4_log_t log;
+  assert_success(sve4_log_add_config(&config, &log));
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  thrd_t threads[NUM_THREADS];
+  int indices[NUM_THREADS];
+  for (int i = 0; i < NUM_THREADS; ++i) {
+    indices[i] = i;
+    munit_assert_int(thrd_create(&threads[i], log_records, &indices[i]), ==,
+                     thrd_success);
+  }
+  for (int i = 0; i < NUM_THREADS; ++i)
+    thrd_join(threads[i], NULL);
+  // NOLINTEND(misc-include-cleaner)
+  assert_success(sve4_log_remove_log(log));
+
+  rewind(bin);
+  FILE* text = tmpfile();
+  munit_assert_not_null(text);
+  sve4_log_config_t decode_config = text_config(text);
+  assert_success(sve4_log_binary_decode(bin, &decode_config));
+  sve4_log_callback_free(&decode_config.callback);
+  fclose(bin);
+
+  // the records of each thread come in order
+  rewind(text);
+  int next[NUM_THREADS] = {0};
+  char line[MAX_LINE];
+  while (fgets(line, sizeof line, text)) {
+    const char* msg = strstr(line, "thread ");
+    munit_assert_not_null(msg);
+    int thread = -1;
+    int record = -1;
+    munit_assert_int(sscanf(msg, "thread %d record %d", &thread, &record), ==,
+                     2);
+    munit_assert_int(thread, >=, 0);
+    munit_assert_int(thread, <, NUM_THREADS);
+    munit_assert_int(record, ==, next[thread]++);
+  }
+  for (int i = 0; i < NUM_THREADS; ++i)
+    munit_assert_int(next[i], ==, RECORDS_PER_THREAD);
+  fclose(text);
+
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+static MunitResult test_invalid(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  FILE* bin = tmpfile();
+  munit_assert_not_null(bin);
+  fputs("definitely not a binary log", bin);
+  rewind(bin);
+  FILE* text = tmpfile();
+  munit_assert_not_null(text);
+  sve4_log_config_t decode_config = text_config(text);
+  munit_assert_int(sve4_log_binary_decode(bin, &decode_config), ==,
+                   SVE4_LOG_ERROR_INVALID_DATA);
+  sve4_log_callback_free(&decode_config.callback);
+  fclose(text);
+  fclose(bin);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/roundtrip",
+        test_roundtrip,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/truncated",
+        test_truncated,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/reused_format",
+        test_reused_format,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/threads",
+        test_threads,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/invalid",
+        test_invalid,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/binary", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
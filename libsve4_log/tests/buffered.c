@@ -0,0 +1,192 @@
+#include "libsve4_log/buffered.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsve4_log/async.h"
+#include "libsve4_log/init.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#include "munit.h"
+
+#define assert_success(err)                                                    \
+  munit_assert_int((int)err, ==, SVE4_LOG_ERROR_SUCCESS)
+
+enum {
+  NUM_THREADS = 4,
+  LOGS_PER_THREAD = 2000,
+  MAX_LINE = 256,
+  // small enough for the chunks to fill up quickly
+  BUFFER_SIZE = 16 * 1024,
+  // long enough for the flusher not to write anything on its own
+  LONG_INTERVAL_MS = 60 * 1000,
+};
+
+#define MESSAGE "message from a worker thread"
+
+static sve4_log_t add_buffered_log(FILE* _Nonnull file, size_t buffer_size,
+                                   unsigned flush_interval_ms) {
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+  };
+  assert_success(sve4_log_to_buffered_file(
+      &config.callback, file, false,
+      &(sve4_log_buffered_config_t){
+          .buffer_size = buffer_size,
+          .flush_interval_ms = flush_interval_ms,
+      }));
+  sve4_log_t log;
+  assert_success(sve4_log_add_config(&config, &log));
+  return log;
+}
+
+// the sink writes at the end of the file, so seeking there is harmless
+static long file_size(FILE* _Nonnull file) {
+  munit_assert_int(fseek(file, 0, SEEK_END), ==, 0);
+  return ftell(file);
+}
+
+static int logger_main(void* arg) {
+  (void)arg;
+  for (int i = 0; i < LOGS_PER_THREAD; ++i)
+    sve4_log_info(MESSAGE);
+  return 0;
+}
+
+static MunitResult test_threads(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* file = tmpfile();
+  munit_assert_not_null(file);
+  add_buffered_log(file, BUFFER_SIZE, 0);
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  thrd_t threads[NUM_THREADS];
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    munit_assert_int(thrd_create(&threads[i], logger_main, NULL), ==,
+                     thrd_success);
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    thrd_join(threads[i], NULL);
+  // NOLINTEND(misc-include-cleaner)
+  // writes out the rest
+  sve4_log_destroy();
+
+  rewind(file);
+  char line[MAX_LINE];
+  size_t num_lines = 0;
+  while (fgets(line, sizeof line, file)) {
+    size_t len = strlen(line);
+    munit_assert_size(len, >, strlen(MESSAGE "\n"));
+    munit_assert_string_equal(line + len - strlen(MESSAGE "\n"),
+                              MESSAGE "\n");
+    ++num_lines;
+  }
+  munit_assert_size(num_lines, ==, NUM_THREADS * LOGS_PER_THREAD);
+  fclose(file);
+  return MUNIT_OK;
+}
+
+static MunitResult test_flush(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* file = tmpfile();
+  munit_assert_not_null(file);
+  sve4_log_t log = add_buffered_log(file, 0, LONG_INTERVAL_MS);
+
+  sve4_log_info("buffered");
+  munit_assert_long(file_size(file), ==, 0);
+  sve4_log_flush();
+  long size = file_size(file);
+  munit_assert_long(size, >, 0);
+
+  // errors are written right away
+  sve4_log_warn("still buffered");
+  munit_assert_long(file_size(file), ==, size);
+  sve4_log_error("written");
+  munit_assert_long(file_size(file), >, size);
+
+  // so is the rest when the log is removed
+  size = file_size(file);
+  sve4_log_debug("last");
+  assert_success(sve4_log_remove_log(log));
+  munit_assert_long(file_size(file), >, size);
+
+  sve4_log_destroy();
+  fclose(file);
+  return MUNIT_OK;
+}
+
+static MunitResult test_long_record(const MunitParameter params[],
+                                    void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* file = tmpfile();
+  munit_assert_not_null(file);
+  add_buffered_log(file, BUFFER_SIZE, 0);
+
+  static char long_str[BUFFER_SIZE];
+  memset(long_str, 'a', sizeof long_str - 1);
+  sve4_log_info("%s", long_str);
+  sve4_log_info("after");
+  sve4_log_destroy();
+
+  // truncated to a chunk, but still a line of its own
+  rewind(file);
+  static char line[BUFFER_SIZE];
+  munit_assert_not_null(fgets(line, sizeof line, file));
+  munit_assert_size(strlen(line), <=, BUFFER_SIZE / 4);
+  munit_assert_int(line[strlen(line) - 1], ==, '\n');
+  munit_assert_not_null(fgets(line, sizeof line, file));
+  munit_assert_not_null(strstr(line, "after"));
+  fclose(file);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/threads",
+        test_threads,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/flush",
+        test_flush,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/long_record",
+        test_long_record,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/buffered", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
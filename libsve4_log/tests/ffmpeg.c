@@ -4,6 +4,7 @@
 #include <stdatomic.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "libsve4_log/init.h"
 
@@ -78,7 +79,47 @@ static MunitResult test_ignored_log(const MunitParameter params[],
   av_log(NULL, AV_LOG_TRACE, "Hello, %s\n", "World!!");
   av_log(NULL, AV_LOG_TRACE, "Hello, %s\n", "World!!");
   av_log(NULL, AV_LOG_TRACE, "Hello, %s\n", "World!!");
+  // below av_log_get_level()
+  munit_assert_int(atomic_load(&num_logs), ==, 0);
+  assert_success(sve4_log_remove_log(log));
+  return MUNIT_OK;
+}
+
+static MunitResult test_split_lines(const MunitParameter params[],
+                                    void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_log_t log;
+  atomic_int num_logs = 0;
+  sve4_log_add_config((sve4_log_config_t[]){counter_log_config(&num_logs)},
+                      &log);
+  // one line over several calls
+  av_log(NULL, AV_LOG_ERROR, "Hello, ");
+  av_log(NULL, AV_LOG_ERROR, "%s", "World");
+  munit_assert_int(atomic_load(&num_logs), ==, 0);
+  av_log(NULL, AV_LOG_ERROR, "!!\n");
+  munit_assert_int(atomic_load(&num_logs), ==, 1);
+
+  // several lines in one call
+  av_log(NULL, AV_LOG_ERROR, "first\nsecond\nthird");
+  munit_assert_int(atomic_load(&num_logs), ==, 3);
+  av_log(NULL, AV_LOG_ERROR, "\n");
   munit_assert_int(atomic_load(&num_logs), ==, 4);
+
+  // lines longer than the buffer are truncated
+  static char long_line[4096];
+  memset(long_line, 'a', sizeof long_line - 1);
+  av_log(NULL, AV_LOG_ERROR, "%s\n", long_line);
+  munit_assert_int(atomic_load(&num_logs), ==, 5);
+
+  // each on its own, the lines after a truncated one come through
+  av_log(NULL, AV_LOG_ERROR, "pending ");
+  av_log(NULL, AV_LOG_ERROR, "%s\nafter\n%s\nlast\nnext", long_line,
+         long_line);
+  munit_assert_int(atomic_load(&num_logs), ==, 9);
+  av_log(NULL, AV_LOG_ERROR, " line\n");
+  munit_assert_int(atomic_load(&num_logs), ==, 10);
   assert_success(sve4_log_remove_log(log));
   return MUNIT_OK;
 }
@@ -102,6 +143,14 @@ static const MunitSuite test_suite = {
             MUNIT_TEST_OPTION_NONE,
             NULL,
         },
+        {
+            "/split_lines",
+            test_split_lines,
+            setup_log,
+            teardown_log,
+            MUNIT_TEST_OPTION_NONE,
+            NULL,
+        },
         {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
          NULL} /* Mark the end of the array */
     },
@@ -111,7 +160,7 @@ static const MunitSuite test_suite = {
 };
 
 int main(int argc, char* argv[]) {
-  av_log_set_level(AV_LOG_ERROR); // does not matter
+  av_log_set_level(AV_LOG_ERROR);
   av_log_set_callback(sve4_log_ffmpeg_callback);
   return munit_suite_main(&test_suite, NULL, argc, argv);
 }
@@ -0,0 +1,165 @@
+// debug messages are compiled out of this file
+#define SVE4_LOG_MIN_LEVEL SVE4_LOG_LEVEL_INFO
+
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#include "libsve4_log/init.h"
+
+#include "counter.h"
+#include "munit.h"
+
+#define assert_success(err)                                                    \
+  munit_assert_int((int)err, ==, SVE4_LOG_ERROR_SUCCESS)
+
+static int num_evaluated = 0;
+
+static int evaluate(void) { return ++num_evaluated; }
+
+static MunitResult test_runtime(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  // nobody is listening yet
+  munit_assert_false(sve4_log_level_enabled(SVE4_LOG_LEVEL_ERROR));
+  sve4_log_error("ignored %d", evaluate());
+  munit_assert_int(num_evaluated, ==, 0);
+
+  atomic_int num_logs = 0;
+  sve4_log_config_t conf = counter_log_config(&num_logs);
+  conf.level = SVE4_LOG_LEVEL_WARNING;
+  sve4_log_t warn_log;
+  assert_success(sve4_log_add_config(&conf, &warn_log));
+  munit_assert_false(sve4_log_level_enabled(SVE4_LOG_LEVEL_INFO));
+  munit_assert_true(sve4_log_level_enabled(SVE4_LOG_LEVEL_WARNING));
+  sve4_log_info("ignored %d", evaluate());
+  sve4_log_warn("logged %d", evaluate());
+  munit_assert_int(num_evaluated, ==, 1);
+  munit_assert_int(atomic_load(&num_logs), ==, 1);
+
+  conf = counter_log_config(&num_logs);
+  conf.level = SVE4_LOG_LEVEL_INFO;
+  sve4_log_t info_log;
+  assert_success(sve4_log_add_config(&conf, &info_log));
+  munit_assert_true(sve4_log_level_enabled(SVE4_LOG_LEVEL_INFO));
+  sve4_log_info("logged %d", evaluate());
+  munit_assert_int(num_evaluated, ==, 2);
+  munit_assert_int(atomic_load(&num_logs), ==, 2);
+
+  // the minimum follows the remaining configs
+  assert_success(sve4_log_remove_log(info_log));
+  munit_assert_false(sve4_log_level_enabled(SVE4_LOG_LEVEL_INFO));
+  assert_success(sve4_log_remove_log(warn_log));
+  munit_assert_false(sve4_log_level_enabled(SVE4_LOG_LEVEL_ERROR));
+
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+static MunitResult test_compile_time(const MunitParameter params[],
+                                     void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  atomic_int num_logs = 0;
+  assert_success(sve4_log_add_config(
+      (sve4_log_config_t[]){counter_log_config(&num_logs)}, NULL));
+
+  munit_assert_false(sve4_log_level_enabled(SVE4_LOG_LEVEL_DEBUG));
+  sve4_log_debug("compiled out %d", evaluate());
+  munit_assert_int(num_evaluated, ==, 0);
+  munit_assert_int(atomic_load(&num_logs), ==, 0);
+
+  // calling the library directly is still possible
+  sve4_glog(SVE4_LOG_ID_APPLICATION, __FILE__, __LINE__, true,
+            SVE4_LOG_LEVEL_DEBUG, "direct");
+  munit_assert_int(atomic_load(&num_logs), ==, 1);
+
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+static MunitResult test_per_id(const MunitParameter params[],
+                               void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  atomic_int num_logs = 0;
+  sve4_log_config_t conf = counter_log_config(&num_logs);
+  conf.level = SVE4_LOG_LEVEL_ERROR;
+  sve4_log_config_set_id_level(&conf, SVE4_LOG_ID_DEFAULT_FFMPEG,
+                               SVE4_LOG_LEVEL_INFO);
+  sve4_log_t log;
+  assert_success(sve4_log_add_config(&conf, &log));
+
+  munit_assert_true(
+      sve4_log_id_enabled(SVE4_LOG_ID_DEFAULT_FFMPEG, SVE4_LOG_LEVEL_INFO));
+  munit_assert_false(
+      sve4_log_id_enabled(SVE4_LOG_ID_APPLICATION, SVE4_LOG_LEVEL_INFO));
+  munit_assert_true(
+      sve4_log_id_enabled(SVE4_LOG_ID_APPLICATION, SVE4_LOG_LEVEL_ERROR));
+
+  // the other ids are not slowed down
+  sve4_log_info("ignored %d", evaluate());
+  munit_assert_int(num_evaluated, ==, 0);
+  sve4_glog(SVE4_LOG_ID_DEFAULT_SVE4_DECODE, __FILE__, __LINE__, true,
+            SVE4_LOG_LEVEL_INFO, "ignored");
+  munit_assert_int(atomic_load(&num_logs), ==, 0);
+  sve4_glog(SVE4_LOG_ID_DEFAULT_FFMPEG, __FILE__, __LINE__, true,
+            SVE4_LOG_LEVEL_INFO, "logged");
+  sve4_log_error("logged %d", evaluate());
+  munit_assert_int(atomic_load(&num_logs), ==, 2);
+
+  assert_success(sve4_log_remove_log(log));
+  munit_assert_false(
+      sve4_log_id_enabled(SVE4_LOG_ID_DEFAULT_FFMPEG, SVE4_LOG_LEVEL_ERROR));
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+static void* reset_counter(const MunitParameter params[], void* user_data) {
+  (void)params;
+  num_evaluated = 0;
+  return user_data;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/runtime",
+        test_runtime,
+        reset_counter,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/compile_time",
+        test_compile_time,
+        reset_counter,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/per_id",
+        test_per_id,
+        reset_counter,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/level", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
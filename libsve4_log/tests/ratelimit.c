@@ -0,0 +1,131 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "libsve4_log/async.h"
+#include "libsve4_log/init.h"
+
+#include "counter.h"
+#include "munit.h"
+
+#define assert_success(err)                                                    \
+  munit_assert_int((int)err, ==, SVE4_LOG_ERROR_SUCCESS)
+
+enum { BURST = 5, PER_SECOND = 50, NUM_LOGS = 100 };
+
+#define INTERVAL_NS (1000000000L / PER_SECOND)
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static struct timespec fake_now;
+
+static void fake_clock(struct timespec* now) { *now = fake_now; }
+
+static void advance(long nanoseconds) {
+  fake_now.tv_nsec += nanoseconds;
+  fake_now.tv_sec += fake_now.tv_nsec / 1000000000L;
+  fake_now.tv_nsec %= 1000000000L;
+}
+
+static void log_once(int i) {
+  sve4_log_ratelimited(SVE4_LOG_LEVEL_INFO, PER_SECOND, BURST, "message %d",
+                       i);
+}
+
+static MunitResult test_burst(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  fake_now = (struct timespec){.tv_sec = 1000};
+  sve4_log_set_monotonic_source(fake_clock);
+  assert_success(sve4_log_init(NULL));
+  atomic_int num_logs = 0;
+  assert_success(sve4_log_add_config(
+      (sve4_log_config_t[]){counter_log_config(&num_logs)}, NULL));
+
+  // no time passes, so only the burst goes through
+  for (int i = 0; i < NUM_LOGS; ++i)
+    log_once(i);
+  munit_assert_int(atomic_load(&num_logs), ==, BURST);
+
+  // one token comes back per interval
+  advance(INTERVAL_NS);
+  log_once(NUM_LOGS);
+  // the message comes with the number of suppressed messages
+  munit_assert_int(atomic_load(&num_logs), ==, BURST + 2);
+  log_once(NUM_LOGS + 1);
+  munit_assert_int(atomic_load(&num_logs), ==, BURST + 2);
+
+  // other call sites have their own bucket
+  sve4_log_ratelimited(SVE4_LOG_LEVEL_INFO, PER_SECOND, BURST, "other site");
+  munit_assert_int(atomic_load(&num_logs), ==, BURST + 3);
+
+  // a full bucket again after burst intervals
+  advance(BURST * INTERVAL_NS);
+  for (int i = 0; i < NUM_LOGS; ++i)
+    log_once(i);
+  munit_assert_int(atomic_load(&num_logs), ==, 2 * BURST + 4);
+
+  sve4_log_destroy();
+  sve4_log_set_monotonic_source(NULL);
+  return MUNIT_OK;
+}
+
+static MunitResult test_flush(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  fake_now = (struct timespec){.tv_sec = 2000};
+  sve4_log_set_monotonic_source(fake_clock);
+  assert_success(sve4_log_init(NULL));
+  atomic_int num_logs = 0;
+  assert_success(sve4_log_add_config(
+      (sve4_log_config_t[]){counter_log_config(&num_logs)}, NULL));
+
+  for (int i = 0; i < NUM_LOGS; ++i)
+    log_once(i);
+  munit_assert_int(atomic_load(&num_logs), ==, BURST);
+
+  // nothing else is logged at this call site, the count still comes out
+  sve4_log_flush();
+  munit_assert_int(atomic_load(&num_logs), ==, BURST + 1);
+  sve4_log_flush();
+  munit_assert_int(atomic_load(&num_logs), ==, BURST + 1);
+
+  // and so does it on shutdown
+  log_once(NUM_LOGS);
+  munit_assert_int(atomic_load(&num_logs), ==, BURST + 1);
+  sve4_log_destroy();
+  munit_assert_int(atomic_load(&num_logs), ==, BURST + 2);
+
+  sve4_log_set_monotonic_source(NULL);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/burst",
+        test_burst,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/flush",
+        test_flush,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/ratelimit", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
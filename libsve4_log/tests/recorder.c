@@ -0,0 +1,142 @@
+#include "libsve4_log/recorder.h"
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsve4_log/init.h"
+
+#include "munit.h"
+
+#define assert_success(err)                                                    \
+  munit_assert_int((int)err, ==, SVE4_LOG_ERROR_SUCCESS)
+
+enum { RECORDER_SIZE = 4096, NUM_LOGS = 200, MAX_LINE = 256 };
+
+#define HEADER "---- sve4_log flight recorder dump ----\n"
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static volatile sig_atomic_t signal_received = 0;
+
+static void on_signal(int signum) {
+  (void)signum;
+  signal_received = 1;
+}
+
+static sve4_log_t add_recorder_log(FILE* _Nonnull file) {
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+  };
+  assert_success(
+      sve4_log_to_recorder(&config.callback, RECORDER_SIZE, file, false));
+  sve4_log_t log;
+  assert_success(sve4_log_add_config(&config, &log));
+  return log;
+}
+
+// checks that file holds a single dump of complete records, ending with the
+// last one. returns the number of records.
+static size_t check_dump(FILE* _Nonnull file) {
+  rewind(file);
+  char line[MAX_LINE];
+  munit_assert_not_null(fgets(line, sizeof line, file));
+  munit_assert_string_equal(line, HEADER);
+
+  size_t num_lines = 0;
+  char last[MAX_LINE] = "";
+  while (fgets(line, sizeof line, file)) {
+    munit_assert_not_null(strstr(line, "DEBUG"));
+    munit_assert_not_null(strstr(line, "message "));
+    munit_assert_int(line[strlen(line) - 1], ==, '\n');
+    memcpy(last, line, sizeof line);
+    ++num_lines;
+  }
+  char expected[MAX_LINE];
+  snprintf(expected, sizeof expected, "message %d\n", NUM_LOGS);
+  munit_assert_not_null(strstr(last, expected));
+  return num_lines;
+}
+
+static MunitResult test_dump(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* file = tmpfile();
+  munit_assert_not_null(file);
+  add_recorder_log(file);
+
+  for (int i = 1; i <= NUM_LOGS; ++i)
+    sve4_log_debug("message %d", i);
+  // nothing is written until the dump
+  munit_assert_int(fseek(file, 0, SEEK_END), ==, 0);
+  munit_assert_long(ftell(file), ==, 0);
+
+  sve4_log_dump_recorders();
+  size_t num_records = check_dump(file);
+  // only the most recent ones fit
+  munit_assert_size(num_records, >, 0);
+  munit_assert_size(num_records, <, NUM_LOGS);
+
+  sve4_log_destroy();
+  fclose(file);
+  return MUNIT_OK;
+}
+
+static MunitResult test_signal(const MunitParameter params[],
+                               void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* file = tmpfile();
+  munit_assert_not_null(file);
+  add_recorder_log(file);
+
+  signal(SIGINT, on_signal);
+  munit_assert_true(sve4_log_dump_recorders_on_signal(SIGINT));
+  for (int i = 1; i <= NUM_LOGS; ++i)
+    sve4_log_debug("message %d", i);
+  raise(SIGINT);
+
+  // the dump comes before the previous handler
+  munit_assert_true(signal_received);
+  check_dump(file);
+
+  signal(SIGINT, SIG_DFL);
+  sve4_log_destroy();
+  fclose(file);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/dump",
+        test_dump,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/signal",
+        test_signal,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/recorder", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,140 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsve4_log/init.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#include "counter.h"
+#include "munit.h"
+
+#define assert_success(err)                                                    \
+  munit_assert_int((int)err, ==, SVE4_LOG_ERROR_SUCCESS)
+
+enum { NUM_THREADS = 4, LOGS_PER_THREAD = 2000, MAX_LINE = 256 };
+
+#define MESSAGE "message from a worker thread"
+
+// NOLINTBEGIN(cppcoreguidelines-avoid-non-const-global-variables)
+static atomic_int num_running = 0;
+// NOLINTEND(cppcoreguidelines-avoid-non-const-global-variables)
+
+static int logger_main(void* arg) {
+  (void)arg;
+  for (int i = 0; i < LOGS_PER_THREAD; ++i)
+    sve4_log_info(MESSAGE);
+  atomic_fetch_sub(&num_running, 1);
+  return 0;
+}
+
+static void start_loggers(thrd_t* _Nonnull threads) {
+  atomic_store(&num_running, NUM_THREADS);
+  // NOLINTBEGIN(misc-include-cleaner)
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    munit_assert_int(thrd_create(&threads[i], logger_main, NULL), ==,
+                     thrd_success);
+  // NOLINTEND(misc-include-cleaner)
+}
+
+static void join_loggers(thrd_t* _Nonnull threads) {
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    thrd_join(threads[i], NULL);
+}
+
+static MunitResult test_churn(const MunitParameter params[],
+                              void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  atomic_int num_logs = 0;
+  assert_success(sve4_log_add_config(
+      (sve4_log_config_t[]){counter_log_config(&num_logs)}, NULL));
+
+  thrd_t threads[NUM_THREADS];
+  start_loggers(threads);
+  // logs come and go while the workers are logging
+  atomic_int num_churn_logs = 0;
+  while (atomic_load(&num_running) > 0) {
+    sve4_log_t log;
+    assert_success(sve4_log_add_config(
+        (sve4_log_config_t[]){counter_log_config(&num_churn_logs)}, &log));
+    assert_success(sve4_log_remove_log(log));
+  }
+  join_loggers(threads);
+
+  munit_assert_int(atomic_load(&num_logs), ==, NUM_THREADS * LOGS_PER_THREAD);
+  munit_assert_int(atomic_load(&num_churn_logs), <=,
+                   NUM_THREADS * LOGS_PER_THREAD);
+  sve4_log_destroy();
+  return MUNIT_OK;
+}
+
+static MunitResult test_file(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  assert_success(sve4_log_init(NULL));
+  FILE* file = tmpfile();
+  munit_assert_not_null(file);
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+  };
+  assert_success(sve4_log_to_file(&config.callback, file, false, false));
+  assert_success(sve4_log_add_config(&config, NULL));
+
+  thrd_t threads[NUM_THREADS];
+  start_loggers(threads);
+  join_loggers(threads);
+  sve4_log_destroy();
+
+  // records of concurrent threads do not interleave
+  rewind(file);
+  char line[MAX_LINE];
+  size_t num_lines = 0;
+  while (fgets(line, sizeof line, file)) {
+    size_t len = strlen(line);
+    munit_assert_size(len, >, strlen(MESSAGE "\n"));
+    munit_assert_string_equal(line + len - strlen(MESSAGE "\n"),
+                              MESSAGE "\n");
+    ++num_lines;
+  }
+  munit_assert_size(num_lines, ==, NUM_THREADS * LOGS_PER_THREAD);
+  fclose(file);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/churn",
+        test_churn,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/file",
+        test_file,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/registry", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
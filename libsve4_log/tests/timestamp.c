@@ -0,0 +1,115 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libsve4_log/init.h"
+
+#include "munit.h"
+
+#define assert_success(err)                                                    \
+  munit_assert_int((int)err, ==, SVE4_LOG_ERROR_SUCCESS)
+
+enum { NUM_LOGS = 4, MAX_LINE = 256 };
+
+// checks that line starts with a timestamp like pattern, where 'd' is a digit
+static void assert_timestamp(const char* line, const char* pattern) {
+  for (size_t i = 0; pattern[i]; ++i) {
+    if (pattern[i] == 'd')
+      munit_assert_true(isdigit((unsigned char)line[i]));
+    else
+      munit_assert_int(line[i], ==, pattern[i]);
+  }
+}
+
+// logs a few messages to a temporary file with the given clock, returns it
+// rewound
+static FILE* log_to_tmpfile(sve4_log_clock_t clock) {
+  assert_success(sve4_log_init(NULL));
+  sve4_log_set_clock(clock);
+  FILE* file = tmpfile();
+  munit_assert_not_null(file);
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+      .path_shorten =
+          {
+              .max_length = 10,
+              .root_prefix = SVE4_ROOT_DIR,
+          },
+  };
+  assert_success(sve4_log_to_file(&config.callback, file, false, false));
+  assert_success(sve4_log_add_config(&config, NULL));
+  for (int i = 0; i < NUM_LOGS; ++i)
+    sve4_log_info("message %d", i);
+  sve4_log_destroy();
+  sve4_log_set_clock(SVE4_LOG_CLOCK_REALTIME);
+  rewind(file);
+  return file;
+}
+
+static MunitResult test_realtime(const MunitParameter params[],
+                                 void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  FILE* file = log_to_tmpfile(SVE4_LOG_CLOCK_REALTIME);
+  char line[MAX_LINE];
+  for (int i = 0; i < NUM_LOGS; ++i) {
+    munit_assert_not_null(fgets(line, sizeof line, file));
+    assert_timestamp(line, "dd:dd:dd.ddd INFO");
+  }
+  fclose(file);
+  return MUNIT_OK;
+}
+
+static MunitResult test_monotonic(const MunitParameter params[],
+                                  void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  FILE* file = log_to_tmpfile(SVE4_LOG_CLOCK_MONOTONIC);
+  char line[MAX_LINE];
+  char prev[MAX_LINE] = "";
+  for (int i = 0; i < NUM_LOGS; ++i) {
+    munit_assert_not_null(fgets(line, sizeof line, file));
+    // elapsed since sve4_log_init(), so the test takes less than an hour
+    assert_timestamp(line, "00:dd:dd.ddddddddd INFO");
+    // fixed width, so the timestamps compare as strings
+    munit_assert_int(strncmp(prev, line, strlen("00:00:00.000000000")), <=,
+                     0);
+    memcpy(prev, line, sizeof line);
+  }
+  fclose(file);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/realtime",
+        test_realtime,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/monotonic",
+        test_monotonic,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/timestamp", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
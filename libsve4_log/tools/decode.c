@@ -0,0 +1,43 @@
+#include <stdio.h>
+
+#include "libsve4_log/binary.h"
+#include "libsve4_log/error.h"
+#include "libsve4_log/init.h"
+
+// formats a log written by sve4_log_to_binary() to stdout
+int main(int argc, char* argv[]) {
+  if (argc > 2) {
+    fprintf(stderr, "usage: %s [binary log, stdin by default]\n", argv[0]);
+    return 1;
+  }
+
+  FILE* in = argc == 2 ? fopen(argv[1], "rb") : stdin;
+  if (!in) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  sve4_log_config_t config = {
+      .level = SVE4_LOG_LEVEL_DEFAULT,
+      .id_mapping = sve4_log_id_mapping_default(),
+      .path_shorten =
+          {
+              .max_length = SVE4_LOG_SHORTEN_PATH_MAX_LENGTH,
+              .root_prefix = SVE4_ROOT_DIR,
+          },
+  };
+  sve4_log_error_t err = sve4_log_to_file(&config.callback, stdout, false,
+                                          false);
+  if (err == SVE4_LOG_ERROR_SUCCESS)
+    err = sve4_log_binary_decode(in, &config);
+  sve4_log_callback_free(&config.callback);
+  if (in != stdin)
+    fclose(in);
+
+  if (err != SVE4_LOG_ERROR_SUCCESS) {
+    fprintf(stderr, "unable to decode the log: %s\n",
+            sve4_log_error_to_string(err));
+    return 1;
+  }
+  return 0;
+}
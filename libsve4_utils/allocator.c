@@ -14,7 +14,8 @@ static void* libc_alloc(sve4_allocator_t* _Nonnull self, size_t size,
   (void)self;
   if (sve4_likely(alignment <= SVE4_MAX_ALIGN))
     return malloc(size);
-  return aligned_alloc(alignment, size);
+  // C11 requires the size to be a multiple of the alignment
+  return aligned_alloc(alignment, sve4_align_up(size, alignment));
 }
 
 static void* libc_calloc(sve4_allocator_t* _Nonnull self, size_t size,
@@ -22,7 +23,7 @@ static void* libc_calloc(sve4_allocator_t* _Nonnull self, size_t size,
   (void)self;
   if (sve4_likely(alignment <= SVE4_MAX_ALIGN))
     return calloc(1, size);
-  void* ptr = aligned_alloc(alignment, size);
+  void* ptr = aligned_alloc(alignment, sve4_align_up(size, alignment));
   if (ptr)
     memset(ptr, 0, size);
   return ptr;
@@ -51,7 +52,7 @@ static void* libc_grow(sve4_allocator_t* _Nonnull self, void* _Nullable ptr,
   (void)old_size;
   return _aligned_realloc(ptr, new_size, alignment);
 #else
-  void* new_ptr = aligned_alloc(alignment, new_size);
+  void* new_ptr = aligned_alloc(alignment, sve4_align_up(new_size, alignment));
   if (new_ptr) {
     size_t copy_size = old_size < new_size ? old_size : new_size;
     if (ptr)
@@ -63,7 +64,7 @@ static void* libc_grow(sve4_allocator_t* _Nonnull self, void* _Nullable ptr,
 }
 
 static const sve4_allocator_t libc_allocator = {
-    {NULL, NULL}, libc_alloc, libc_calloc, libc_grow, libc_free};
+    {NULL, NULL, 0, 0}, libc_alloc, libc_calloc, libc_grow, libc_free};
 
 static inline sve4_allocator_t* _Nonnull sve4_allocator_get_or_default(
     sve4_allocator_t* _Nullable allocator) {
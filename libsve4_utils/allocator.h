@@ -19,10 +19,12 @@
 #define SVE4_MAX_ALIGN alignof(max_align_t)
 #endif
 
-// current implementation of arena stores two pointers as its state
-// this
+// inline state of stateful allocators, so that they can be initialized
+// statically. the arena stores its first and current region and its
+// configuration here, other allocators a pointer to their own state.
 typedef struct {
   void* _Nullable p1, * _Nullable p2;
+  size_t n1, n2;
 } sve4_allocator_state_t;
 
 typedef struct sve4_allocator_t {
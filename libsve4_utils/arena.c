@@ -1,37 +1,124 @@
 #include "arena.h"
 
 #include <assert.h>
+#include <stdalign.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <string.h>
 
-#define ARENA_IMPLEMENTATION
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wmissing-prototypes"
-#pragma GCC diagnostic ignored "-Wformat-nonliteral"
-#pragma GCC diagnostic ignored "-Wsign-conversion"
-#include <arena/arena.h>
-#pragma GCC diagnostic pop
-
 #include "allocator.h"
+#include "defines.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+// state.p1 is the first region, state.p2 the one allocations are served from.
+// regions after the current one are empty, they are left over from before the
+// last reset or skipped by a large allocation.
+typedef struct region_t {
+  struct region_t* _Nullable next;
+  // bytes used and available in data
+  size_t count, capacity;
+  alignas(SVE4_MAX_ALIGN) char data[];
+} region_t;
+
+static size_t region_size(const sve4_allocator_t* _Nonnull self) {
+  return self->state.n1 ? self->state.n1 : SVE4_ARENA_DEFAULT_REGION_SIZE;
+}
+
+// returns the offset of a size byte allocation in region, or SIZE_MAX if it
+// does not fit
+static size_t fit(const region_t* _Nonnull region, size_t size,
+                  size_t alignment) {
+  uintptr_t begin = (uintptr_t)region->data;
+  size_t offset = (size_t)(sve4_align_up(begin + region->count, alignment) -
+                           begin);
+  if (offset > region->capacity || region->capacity - offset < size)
+    return SIZE_MAX;
+  return offset;
+}
+
+static region_t* _Nullable new_region(sve4_allocator_t* _Nonnull self,
+                                      size_t size, size_t alignment) {
+  region_t* last = self->state.p1;
+  while (last && last->next)
+    last = last->next;
+
+  size_t capacity = region_size(self);
+  if (last && self->state.n2 == SVE4_ARENA_GROWTH_DOUBLE &&
+      last->capacity <= SIZE_MAX / 2)
+    capacity = sve4_max(capacity, last->capacity * 2);
+  // data is only SVE4_MAX_ALIGN aligned, leave room for padding
+  size_t padding = alignment > SVE4_MAX_ALIGN ? alignment - 1 : 0;
+  if (size > SIZE_MAX - sizeof(region_t) - padding)
+    return NULL;
+  capacity = sve4_max(capacity, size + padding);
+  if (capacity > SIZE_MAX - sizeof(region_t))
+    return NULL;
+
+  region_t* region = sve4_malloc(NULL, sizeof(region_t) + capacity);
+  if (!region)
+    return NULL;
+  region->next = NULL;
+  region->count = 0;
+  region->capacity = capacity;
+  if (last)
+    last->next = region;
+  else
+    self->state.p1 = region;
+  return region;
+}
 
 void* sve4__allocator_arena_alloc(sve4_allocator_t* _Nonnull self, size_t size,
                                   size_t alignment) {
-  Arena* arena = (Arena*)&self->state;
-  if (alignment > SVE4_MAX_ALIGN)
-    return NULL;
-  return arena_alloc(arena, size);
+  region_t* region = self->state.p2 ? self->state.p2 : self->state.p1;
+  size_t offset = SIZE_MAX;
+  for (; region; region = region->next)
+    if ((offset = fit(region, size, alignment)) != SIZE_MAX)
+      break;
+  if (!region) {
+    region = new_region(self, size, alignment);
+    if (!region)
+      return NULL;
+    offset = fit(region, size, alignment);
+    assert(offset != SIZE_MAX);
+  }
+
+  self->state.p2 = region;
+  region->count = offset + size;
+  return &region->data[offset];
+}
+
+void* sve4__allocator_arena_calloc(sve4_allocator_t* _Nonnull self,
+                                   size_t size, size_t alignment) {
+  // regions are reused after a reset, so memory may not be zero
+  void* ptr = sve4__allocator_arena_alloc(self, size, alignment);
+  if (ptr)
+    memset(ptr, 0, size);
+  return ptr;
 }
 
 void* sve4__allocator_arena_grow(sve4_allocator_t* _Nonnull self,
                                  void* _Nullable ptr, size_t old_size,
                                  size_t new_size, size_t alignment) {
-  Arena* arena = (Arena*)&self->state;
-  if (alignment > SVE4_MAX_ALIGN)
-    return NULL;
-  // arena_realloc can't handle NULL as old_ptr
   if (!ptr)
-    return arena_alloc(arena, new_size);
-  return arena_realloc(arena, ptr, old_size, new_size);
+    return sve4__allocator_arena_alloc(self, new_size, alignment);
+
+  // the most recent allocation can be resized in place
+  region_t* region = self->state.p2;
+  if (region && (char*)ptr + old_size == &region->data[region->count] &&
+      (uintptr_t)ptr % alignment == 0) {
+    size_t offset = (size_t)((char*)ptr - region->data);
+    if (region->capacity - offset >= new_size) {
+      region->count = offset + new_size;
+      return ptr;
+    }
+  }
+
+  void* new_ptr = sve4__allocator_arena_alloc(self, new_size, alignment);
+  if (new_ptr)
+    memcpy(new_ptr, ptr, sve4_min(old_size, new_size));
+  return new_ptr;
 }
 
 void sve4__allocator_arena_free(sve4_allocator_t* _Nonnull self,
@@ -42,9 +129,154 @@ void sve4__allocator_arena_free(sve4_allocator_t* _Nonnull self,
 }
 
 void sve4_allocator_arena_destroy(sve4_allocator_t* arena) {
-  arena_free((Arena*)&arena->state);
+  for (region_t* region = arena->state.p1; region;) {
+    region_t* next = region->next;
+    sve4_free(NULL, region);
+    region = next;
+  }
+  arena->state.p1 = NULL;
+  arena->state.p2 = NULL;
 }
 
 void sve4_allocator_arena_reset(sve4_allocator_t* arena) {
-  arena_reset((Arena*)&arena->state);
+  for (region_t* region = arena->state.p1; region; region = region->next)
+    region->count = 0;
+  arena->state.p2 = arena->state.p1;
+}
+
+size_t
+sve4_allocator_arena_get_capacity(const sve4_allocator_t* _Nonnull arena) {
+  size_t capacity = 0;
+  for (const region_t* region = arena->state.p1; region;
+       region = region->next)
+    capacity += region->capacity;
+  return capacity;
+}
+
+sve4_arena_mark_t
+sve4_allocator_arena_mark(const sve4_allocator_t* _Nonnull arena) {
+  const region_t* region = arena->state.p2;
+  return (sve4_arena_mark_t){
+      .region = arena->state.p2,
+      .count = region ? region->count : 0,
+  };
+}
+
+void sve4_allocator_arena_rewind(sve4_allocator_t* _Nonnull arena,
+                                 sve4_arena_mark_t mark) {
+  region_t* marked = mark.region;
+  region_t* current = arena->state.p2;
+  if (marked == current) {
+    if (marked)
+      marked->count = mark.count;
+    return;
+  }
+
+  // regions between the marked one and the current one were all filled after
+  // the mark, the ones after the current one are empty already
+  for (region_t* region = marked ? marked->next : arena->state.p1; region;
+       region = region->next) {
+    region->count = 0;
+    if (region == current)
+      break;
+  }
+  if (marked)
+    marked->count = mark.count;
+  arena->state.p2 = marked ? marked : arena->state.p1;
+}
+
+enum { NUM_SCRATCH_ARENAS = 2 };
+
+typedef struct {
+  sve4_allocator_t arenas[NUM_SCRATCH_ARENAS];
+} scratch_arenas_t;
+
+// NOLINTBEGIN(misc-include-cleaner,cppcoreguidelines-avoid-non-const-global-variables)
+static tss_t scratch_key;
+static bool scratch_key_valid = false;
+static once_flag scratch_once = ONCE_FLAG_INIT;
+// NOLINTEND(misc-include-cleaner,cppcoreguidelines-avoid-non-const-global-variables)
+
+static void scratch_destructor(void* _Nullable ptr) {
+  scratch_arenas_t* scratch = ptr;
+  if (!scratch)
+    return;
+  for (size_t i = 0; i < NUM_SCRATCH_ARENAS; ++i)
+    sve4_allocator_arena_destroy(&scratch->arenas[i]);
+  sve4_free(NULL, scratch);
+}
+
+static void scratch_init(void) {
+  // NOLINTBEGIN(misc-include-cleaner)
+  scratch_key_valid =
+      tss_create(&scratch_key, scratch_destructor) == thrd_success;
+  // NOLINTEND(misc-include-cleaner)
+}
+
+static scratch_arenas_t* _Nullable get_scratch_arenas(void) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  call_once(&scratch_once, scratch_init);
+  if (sve4_unlikely(!scratch_key_valid))
+    return NULL;
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  scratch_arenas_t* scratch = tss_get(scratch_key);
+  if (sve4_likely(scratch))
+    return scratch;
+
+  scratch = sve4_malloc(NULL, sizeof(scratch_arenas_t));
+  if (!scratch)
+    return NULL;
+  for (size_t i = 0; i < NUM_SCRATCH_ARENAS; ++i)
+    scratch->arenas[i] =
+        sve4_allocator_arena_init_ex(0, SVE4_ARENA_GROWTH_DOUBLE);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (tss_set(scratch_key, scratch) != thrd_success) {
+    sve4_free(NULL, scratch);
+    return NULL;
+  }
+  return scratch;
+}
+
+bool sve4_scratch_begin(sve4_scratch_t* _Nonnull scratch,
+                        const sve4_allocator_t* _Nullable conflict) {
+  scratch_arenas_t* arenas = get_scratch_arenas();
+  if (!arenas)
+    return false;
+
+  sve4_allocator_t* arena = &arenas->arenas[0];
+  if (arena == conflict)
+    arena = &arenas->arenas[1];
+  scratch->arena = arena;
+  scratch->mark = sve4_allocator_arena_mark(arena);
+  return true;
+}
+
+// releases every region of an empty arena but the first one, and the first
+// one as well if a large allocation made it larger than a regular region
+static void trim_empty(sve4_allocator_t* _Nonnull arena) {
+  region_t* first = arena->state.p1;
+  if (!first)
+    return;
+  for (region_t* region = first->next; region;) {
+    region_t* next = region->next;
+    sve4_free(NULL, region);
+    region = next;
+  }
+  first->next = NULL;
+  if (first->capacity > region_size(arena)) {
+    sve4_free(NULL, first);
+    arena->state.p1 = NULL;
+  }
+  arena->state.p2 = arena->state.p1;
+}
+
+void sve4_scratch_end(const sve4_scratch_t* _Nonnull scratch) {
+  sve4_allocator_arena_rewind(scratch->arena, scratch->mark);
+  // the scope began with the arena empty, so it is empty again: drop whatever
+  // its temporaries grew the arena to
+  const region_t* marked = scratch->mark.region;
+  if (!marked ||
+      (marked == scratch->arena->state.p1 && scratch->mark.count == 0))
+    trim_empty(scratch->arena);
 }
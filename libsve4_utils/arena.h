@@ -1,25 +1,56 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "allocator.h"
 #include "defines.h"
 
-// ARENA API (currently using tsoding/arena implementation)
+// ARENA API
+//
+// Allocations are bumped out of a linked list of regions, individual frees
+// are no-ops and everything is released at once by
+// sve4_allocator_arena_reset() (keeping the regions for reuse) or
+// sve4_allocator_arena_destroy(). Any power-of-two alignment is supported.
+// Growing the most recent allocation happens in place when its region has
+// room left.
+//
+// sve4_allocator_arena_mark() and sve4_allocator_arena_rewind() release
+// everything allocated after a save-point, and sve4_scratch_begin() hands
+// out thread-local arenas for short-lived temporaries.
 
-// this being a macro allows static initialization
-#define sve4_allocator_arena_init                                              \
+// default size of a region, regions are larger if a single allocation needs it
+#define SVE4_ARENA_DEFAULT_REGION_SIZE ((size_t)64 * 1024)
+
+typedef enum {
+  // every new region has the configured region size
+  SVE4_ARENA_GROWTH_FIXED = 0,
+  // every new region is twice as large as the previous one, which keeps the
+  // number of regions logarithmic for arenas that grow large
+  SVE4_ARENA_GROWTH_DOUBLE,
+} sve4_arena_growth_t;
+
+// region_size of 0 means SVE4_ARENA_DEFAULT_REGION_SIZE. being a macro allows
+// static initialization
+#define sve4_allocator_arena_init_ex(region_size, growth)                      \
   ((sve4_allocator_t){                                                         \
-      .state = {NULL, NULL},                                                   \
+      .state = {NULL, NULL, (region_size), (size_t)(growth)},                  \
       .alloc = sve4__allocator_arena_alloc,                                    \
+      .calloc = sve4__allocator_arena_calloc,                                  \
       .grow = sve4__allocator_arena_grow,                                      \
       .free = sve4__allocator_arena_free,                                      \
   })
 
+#define sve4_allocator_arena_init                                              \
+  sve4_allocator_arena_init_ex(0, SVE4_ARENA_GROWTH_FIXED)
+
 SVE4_UTILS_EXPORT
 void* _Nullable sve4__allocator_arena_alloc(sve4_allocator_t* _Nonnull self,
                                             size_t size, size_t alignment);
 SVE4_UTILS_EXPORT
+void* _Nullable sve4__allocator_arena_calloc(sve4_allocator_t* _Nonnull self,
+                                             size_t size, size_t alignment);
+SVE4_UTILS_EXPORT
 void* _Nullable sve4__allocator_arena_grow(sve4_allocator_t* _Nonnull self,
                                            void* _Nullable ptr, size_t old_size,
                                            size_t new_size, size_t alignment);
@@ -32,3 +63,51 @@ void sve4_allocator_arena_destroy(sve4_allocator_t* _Nonnull arena);
 
 SVE4_UTILS_EXPORT
 void sve4_allocator_arena_reset(sve4_allocator_t* _Nonnull arena);
+
+// total size of the regions of the arena, used or not
+SVE4_UTILS_EXPORT
+size_t
+sve4_allocator_arena_get_capacity(const sve4_allocator_t* _Nonnull arena);
+
+// save-point of an arena, see sve4_allocator_arena_mark()
+typedef struct {
+  void* _Nullable region;
+  size_t count;
+} sve4_arena_mark_t;
+
+// returns a save-point that sve4_allocator_arena_rewind() can go back to
+SVE4_UTILS_EXPORT
+sve4_arena_mark_t
+sve4_allocator_arena_mark(const sve4_allocator_t* _Nonnull arena);
+
+// releases every allocation made after mark was taken, keeping the regions
+// for reuse. marks taken after mark are invalidated, so marks must be rewound
+// to in LIFO order.
+SVE4_UTILS_EXPORT
+void sve4_allocator_arena_rewind(sve4_allocator_t* _Nonnull arena,
+                                 sve4_arena_mark_t mark);
+
+// SCRATCH ARENAS
+//
+// Every thread owns two lazily created arenas for temporaries. A scope is
+// opened with sve4_scratch_begin() and everything allocated from
+// scratch.arena in it is released by sve4_scratch_end(). Scopes nest as long
+// as they are ended in LIFO order. Once a scope leaves its arena empty, the
+// arena is trimmed back to one region, so a thread does not keep the memory
+// of its largest temporaries forever.
+//
+// If a function allocates its result from a caller-provided allocator that
+// may itself be a scratch arena, pass it as conflict: the other arena is then
+// picked, so rewinding the temporaries does not release the result.
+typedef struct {
+  sve4_allocator_t* _Nonnull arena;
+  sve4_arena_mark_t mark;
+} sve4_scratch_t;
+
+// returns false if the thread-local arenas could not be created
+SVE4_UTILS_EXPORT
+bool sve4_scratch_begin(sve4_scratch_t* _Nonnull scratch,
+                        const sve4_allocator_t* _Nullable conflict);
+
+SVE4_UTILS_EXPORT
+void sve4_scratch_end(const sve4_scratch_t* _Nonnull scratch);
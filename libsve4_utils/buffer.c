@@ -1,38 +1,130 @@
 #include "buffer.h"
 
+#include <assert.h>
 #include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "allocator.h"
+#include "defines.h"
+
+#ifdef SVE4_UTILS_HAVE_FFMPEG
+#include <libavutil/buffer.h>
+#endif
 
 sve4_buffer_ref_t sve4_buffer_create(sve4_allocator_t* _Nullable allocator,
                                      size_t size,
                                      sve4_destructor_t _Nullable destructor) {
-  sve4_buffer_t* buffer = sve4_calloc(allocator, sizeof(sve4_buffer_t) + size);
-  if (!buffer)
+  return sve4_buffer_create_ex(allocator, size, 0, SVE4_BUFFER_FLAGS_NONE,
+                               destructor);
+}
+
+sve4_buffer_ref_t
+sve4_buffer_create_ex(sve4_allocator_t* _Nullable allocator, size_t size,
+                      size_t alignment, unsigned flags,
+                      sve4_destructor_t _Nullable destructor) {
+  alignment = sve4_max(alignment, (size_t)SVE4_BUFFER_ALIGNMENT);
+  size_t offset = sve4__buffer_header_offset(alignment);
+  if (size > SIZE_MAX - offset - sizeof(sve4_buffer_t))
+    return NULL;
+  char* mem = sve4_aligned_calloc(
+      allocator, offset + sizeof(sve4_buffer_t) + size, alignment);
+  if (!mem)
     return NULL;
+  sve4_buffer_t* buffer = (sve4_buffer_t*)(void*)(mem + offset);
   buffer->destructor = destructor;
   buffer->allocator = allocator;
-  atomic_init(&buffer->ref_count, 1);
+  buffer->ptr = buffer->data;
+  buffer->size = size;
+  buffer->alignment = alignment;
+  buffer->flags = flags;
+  atomic_init(sve4__buffer_ref_count(buffer), 1);
   return buffer;
 }
 
+// kept in the data of external buffers
+typedef struct {
+  sve4_buffer_release_t _Nullable release;
+  void* _Nullable opaque;
+  void* _Nullable data;
+} external_t;
+
+static void external_destructor(char* _Nonnull mem) {
+  external_t* external = (external_t*)(void*)mem;
+  if (external->release)
+    external->release(external->opaque, external->data);
+}
+
+sve4_buffer_ref_t sve4_buffer_create_external(
+    sve4_allocator_t* _Nullable allocator, void* _Nullable data, size_t size,
+    sve4_buffer_release_t _Nullable release, void* _Nullable opaque) {
+  sve4_buffer_t* buffer =
+      sve4_buffer_create(allocator, sizeof(external_t), external_destructor);
+  if (!buffer)
+    return NULL;
+  *(external_t*)(void*)buffer->data = (external_t){release, opaque, data};
+  buffer->ptr = data;
+  buffer->size = size;
+  return buffer;
+}
+
+#ifdef SVE4_UTILS_HAVE_FFMPEG
+static void release_av_buffer(void* _Nullable opaque, void* _Nullable data) {
+  (void)data;
+  AVBufferRef* ref = opaque;
+  av_buffer_unref(&ref);
+}
+
+sve4_buffer_ref_t sve4_buffer_from_av_buffer(
+    sve4_allocator_t* _Nullable allocator, AVBufferRef* _Nonnull ref) {
+  return sve4_buffer_create_external(allocator, ref->data, ref->size,
+                                     release_av_buffer, ref);
+}
+#endif
+
 sve4_buffer_ref_t sve4_buffer_ref(sve4_buffer_ref_t buffer) {
   if (!buffer)
     return NULL;
-  atomic_fetch_add_explicit(&buffer->ref_count, 1, memory_order_relaxed);
+  atomic_size_t* ref_count = sve4__buffer_ref_count(buffer);
+  if (buffer->flags & SVE4_BUFFER_SINGLE_OWNER) {
+    // relaxed loads and stores compile to plain moves
+    size_t count = atomic_load_explicit(ref_count, memory_order_relaxed);
+    atomic_store_explicit(ref_count, count + 1, memory_order_relaxed);
+  } else {
+    atomic_fetch_add_explicit(ref_count, 1, memory_order_relaxed);
+  }
   return buffer;
 }
 
+// drops one reference, returns whether it was the last one
+static bool release_ref(sve4_buffer_t* _Nonnull buffer) {
+  atomic_size_t* ref_count = sve4__buffer_ref_count(buffer);
+  if (buffer->flags & SVE4_BUFFER_SINGLE_OWNER) {
+    size_t count = atomic_load_explicit(ref_count, memory_order_relaxed);
+    atomic_store_explicit(ref_count, count - 1, memory_order_relaxed);
+    return count == 1;
+  }
+
+  // a count of 1 does not mean the count can not change: whoever borrows the
+  // pointer may take a reference concurrently, so the decrement must be a
+  // read-modify-write
+  if (atomic_fetch_sub_explicit(ref_count, 1, memory_order_release) != 1)
+    return false;
+  // synchronizes with the releases of every other reference
+  atomic_thread_fence(memory_order_acquire);
+  return true;
+}
+
 void sve4_buffer_unref(sve4_buffer_ref_t buffer) {
-  if (!buffer)
+  if (!buffer || !release_ref(buffer))
     return;
-  if (atomic_fetch_sub_explicit(&buffer->ref_count, 1, memory_order_acq_rel) ==
-      1) {
-    if (buffer->destructor)
-      buffer->destructor(buffer->data);
-    sve4_free(buffer->allocator, buffer);
-  }
+  if (buffer->destructor)
+    buffer->destructor(buffer->data);
+  size_t offset = sve4__buffer_header_offset(buffer->alignment);
+  sve4_aligned_free(buffer->allocator, (char*)buffer - offset,
+                    buffer->alignment);
 }
 
 void sve4_buffer_free(sve4_buffer_ref_t* buffer) {
@@ -43,5 +135,52 @@ void sve4_buffer_free(sve4_buffer_ref_t* buffer) {
 }
 
 void* sve4_buffer_get_data(sve4_buffer_ref_t _Nonnull buffer) {
-  return buffer->data;
+  return buffer->ptr;
+}
+
+size_t sve4_buffer_get_size(sve4_buffer_ref_t _Nonnull buffer) {
+  return buffer->size;
+}
+
+sve4_buffer_view_t sve4_buffer_view(sve4_buffer_ref_t _Nonnull parent,
+                                    size_t offset, size_t length) {
+  assert(offset <= parent->size && length <= parent->size - offset &&
+         "View out of the buffer's bounds");
+  return (sve4_buffer_view_t){
+      .parent = sve4_buffer_ref(parent),
+      .offset = offset,
+      .length = length,
+  };
+}
+
+sve4_buffer_view_t sve4_buffer_view_all(sve4_buffer_ref_t _Nonnull parent) {
+  return sve4_buffer_view(parent, 0, parent->size);
+}
+
+sve4_buffer_view_t
+sve4_buffer_view_slice(const sve4_buffer_view_t* _Nonnull view, size_t offset,
+                       size_t length) {
+  assert(offset <= view->length && length <= view->length - offset &&
+         "Slice out of the view's bounds");
+  return (sve4_buffer_view_t){
+      .parent = sve4_buffer_ref(view->parent),
+      .offset = view->offset + offset,
+      .length = length,
+  };
+}
+
+sve4_buffer_view_t
+sve4_buffer_view_ref(const sve4_buffer_view_t* _Nonnull view) {
+  return sve4_buffer_view_slice(view, 0, view->length);
+}
+
+void sve4_buffer_view_unref(sve4_buffer_view_t* _Nonnull view) {
+  sve4_buffer_free(&view->parent);
+  view->offset = 0;
+  view->length = 0;
+}
+
+void* sve4_buffer_view_get_data(const sve4_buffer_view_t* _Nonnull view) {
+  return view->parent && view->parent->ptr ? view->parent->ptr + view->offset
+                                           : NULL;
 }
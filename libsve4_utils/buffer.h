@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdalign.h>
 #include <stdatomic.h>
 #include <stddef.h>
 
@@ -10,11 +11,38 @@
 
 typedef void (*sve4_destructor_t)(char* _Nonnull data);
 
+// default (and minimum) alignment of data, enough for any type
+#define SVE4_BUFFER_ALIGNMENT SVE4_MAX_ALIGN
+// buffers created with at least this alignment (see sve4_buffer_create_ex())
+// keep their reference count on a cache line of its own, so threads passing
+// references around do not invalidate the header or data for readers
+#define SVE4_BUFFER_CACHE_LINE 64
+
+typedef enum {
+  SVE4_BUFFER_FLAGS_NONE = 0,
+  // the buffer and every reference to it stay on one thread, so reference
+  // counting does not need atomic read-modify-writes
+  SVE4_BUFFER_SINGLE_OWNER = 1 << 0,
+} sve4_buffer_flags_t;
+
 typedef struct SVE4_UTILS_EXPORT {
+  // called with data (not ptr) once the last reference is gone
   sve4_destructor_t _Nullable destructor;
   sve4_allocator_t* _Nullable allocator;
+  // the contents: data for regular buffers, the wrapped memory for external
+  // ones (see sve4_buffer_create_external())
+  char* _Nullable ptr;
+  // size of the contents, in bytes
+  size_t size;
+  // alignment of data, at least SVE4_BUFFER_ALIGNMENT
+  size_t alignment;
+  // sve4_buffer_flags_t
+  unsigned flags;
+  // only used by buffers aligned to less than SVE4_BUFFER_CACHE_LINE. the
+  // others keep their count in front of the header, see
+  // sve4__buffer_ref_count().
   atomic_size_t ref_count;
-  char data[];
+  alignas(SVE4_BUFFER_ALIGNMENT) char data[];
 } sve4_buffer_t;
 
 typedef sve4_buffer_t* sve4_buffer_ref_t;
@@ -24,6 +52,61 @@ sve4_buffer_ref_t _Nullable sve4_buffer_create(
     sve4_allocator_t* _Nullable allocator, size_t size,
     sve4_destructor_t _Nullable destructor);
 
+// like sve4_buffer_create(), but data is aligned to alignment (a power of
+// two, 0 for SVE4_BUFFER_ALIGNMENT). pass SVE4_BUFFER_CACHE_LINE or more for
+// buffers shared between threads, such as frames. flags is a combination of
+// sve4_buffer_flags_t.
+SVE4_UTILS_EXPORT
+sve4_buffer_ref_t _Nullable sve4_buffer_create_ex(
+    sve4_allocator_t* _Nullable allocator, size_t size, size_t alignment,
+    unsigned flags, sve4_destructor_t _Nullable destructor);
+
+// buffers aligned to more than the header size are preceded by padding, and
+// those aligned to SVE4_BUFFER_CACHE_LINE or more by a cache line holding the
+// reference count. this is where the header starts in the allocation.
+// alignment is the one stored in the buffer.
+static inline size_t sve4__buffer_header_offset(size_t alignment) {
+  size_t count_line =
+      alignment >= SVE4_BUFFER_CACHE_LINE ? SVE4_BUFFER_CACHE_LINE : 0;
+  return sve4_align_up(count_line + sizeof(sve4_buffer_t), alignment) -
+         sizeof(sve4_buffer_t);
+}
+
+// the reference count of buffer: in the header for small alignments, at the
+// start of the allocation otherwise, away from ptr and size which every
+// reader loads
+static inline atomic_size_t* _Nonnull sve4__buffer_ref_count(
+    sve4_buffer_t* _Nonnull buffer) {
+  if (buffer->alignment < SVE4_BUFFER_CACHE_LINE)
+    return &buffer->ref_count;
+  return (atomic_size_t*)(void*)((char*)buffer - sve4__buffer_header_offset(
+                                                     buffer->alignment));
+}
+
+// called once the last reference to an external buffer is gone
+typedef void (*sve4_buffer_release_t)(void* _Nullable opaque,
+                                      void* _Nullable data);
+
+// wraps size bytes of memory owned by someone else (e.g. an AVBufferRef, a
+// mmap region or imported host-visible GPU memory) without copying. only the
+// header is allocated from allocator. release, if set, is called with opaque
+// and data when the buffer is freed. on failure, release is not called and
+// the memory stays with the caller.
+SVE4_UTILS_EXPORT
+sve4_buffer_ref_t _Nullable sve4_buffer_create_external(
+    sve4_allocator_t* _Nullable allocator, void* _Nullable data, size_t size,
+    sve4_buffer_release_t _Nullable release, void* _Nullable opaque);
+
+#ifdef SVE4_UTILS_HAVE_FFMPEG
+struct AVBufferRef;
+
+// wraps the data of ref, taking over the reference. on failure, ref is left
+// untouched.
+SVE4_UTILS_EXPORT
+sve4_buffer_ref_t _Nullable sve4_buffer_from_av_buffer(
+    sve4_allocator_t* _Nullable allocator, struct AVBufferRef* _Nonnull ref);
+#endif
+
 SVE4_UTILS_EXPORT
 sve4_buffer_ref_t _Nullable sve4_buffer_ref(sve4_buffer_ref_t _Nullable buffer);
 SVE4_UTILS_EXPORT
@@ -33,3 +116,40 @@ void sve4_buffer_free(sve4_buffer_ref_t _Nullable* _Nullable buffer);
 
 SVE4_UTILS_EXPORT
 void* _Nonnull sve4_buffer_get_data(sve4_buffer_ref_t _Nonnull buffer);
+
+SVE4_UTILS_EXPORT
+size_t sve4_buffer_get_size(sve4_buffer_ref_t _Nonnull buffer);
+
+// a byte range of a buffer, e.g. one plane of a frame or one packet of a read
+// buffer. a view holds a reference to its parent, so slices can be handed out
+// without copying and the storage lives as long as any of them.
+typedef struct {
+  sve4_buffer_ref_t _Nullable parent;
+  size_t offset;
+  size_t length;
+} sve4_buffer_view_t;
+
+// creates a view of length bytes of parent starting at offset, taking a new
+// reference to parent. the range must lie within the buffer.
+SVE4_UTILS_EXPORT
+sve4_buffer_view_t sve4_buffer_view(sve4_buffer_ref_t _Nonnull parent,
+                                    size_t offset, size_t length);
+// view of the whole buffer
+SVE4_UTILS_EXPORT
+sve4_buffer_view_t sve4_buffer_view_all(sve4_buffer_ref_t _Nonnull parent);
+// creates a view of length bytes of view starting at offset (relative to the
+// view), which references the same parent
+SVE4_UTILS_EXPORT
+sve4_buffer_view_t sve4_buffer_view_slice(
+    const sve4_buffer_view_t* _Nonnull view, size_t offset, size_t length);
+SVE4_UTILS_EXPORT
+sve4_buffer_view_t
+sve4_buffer_view_ref(const sve4_buffer_view_t* _Nonnull view);
+// drops the reference to the parent and empties the view
+SVE4_UTILS_EXPORT
+void sve4_buffer_view_unref(sve4_buffer_view_t* _Nonnull view);
+
+// NULL for empty views
+SVE4_UTILS_EXPORT
+void* _Nullable sve4_buffer_view_get_data(
+    const sve4_buffer_view_t* _Nonnull view);
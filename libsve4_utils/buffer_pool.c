@@ -0,0 +1,266 @@
+#include "buffer_pool.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "allocator.h"
+#include "buffer.h"
+#include "formats.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+// free buffers are linked through their own memory, starting at the
+// beginning of the allocation (which may be padding before the header)
+typedef struct free_buffer_t {
+  struct free_buffer_t* _Nullable next;
+  // alignment the buffer was allocated with
+  size_t alignment;
+} free_buffer_t;
+
+typedef struct bucket_t {
+  // allocator of every buffer of this bucket: allocations go to the pool's
+  // allocator, frees put the buffer on the free list. state.p1 points back to
+  // the bucket.
+  sve4_allocator_t recycler;
+  struct bucket_t* _Nullable next;
+  sve4_buffer_pool_t* _Nonnull pool;
+  sve4_buffer_pool_key_t key;
+  size_t size;
+  free_buffer_t* _Nullable free_list;
+  size_t num_free;
+  // buffers of this bucket, in use or free
+  size_t num_buffers;
+  // value of pool->num_gets when this bucket was last requested
+  size_t last_get;
+} bucket_t;
+
+struct sve4_buffer_pool_t {
+  sve4_allocator_t* _Nullable allocator;
+  // references from users, plus one per buffer in use
+  atomic_size_t ref_count;
+  size_t low_watermark, high_watermark;
+  // guards everything below
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_t mutex;
+  bucket_t* _Nullable buckets;
+  // sve4_buffer_pool_get() calls so far
+  size_t num_gets;
+  sve4_buffer_pool_stats_t stats;
+};
+
+static bool key_eq(const sve4_buffer_pool_key_t* _Nonnull lhs,
+                   const sve4_buffer_pool_key_t* _Nonnull rhs) {
+  return sve4_pixfmt_eq(lhs->pixfmt, rhs->pixfmt) &&
+         lhs->width == rhs->width && lhs->height == rhs->height &&
+         lhs->alignment == rhs->alignment;
+}
+
+// must be called with the mutex held
+static void release_free(sve4_buffer_pool_t* _Nonnull pool,
+                         bucket_t* _Nonnull bucket, size_t keep) {
+  while (bucket->num_free > keep) {
+    free_buffer_t* buffer = bucket->free_list;
+    assert(buffer);
+    bucket->free_list = buffer->next;
+    --bucket->num_free;
+    --bucket->num_buffers;
+    --pool->stats.num_free;
+    --pool->stats.num_buffers;
+    sve4_aligned_free(pool->allocator, buffer, buffer->alignment);
+  }
+}
+
+// a bucket is idle once the pool served more than high_watermark requests
+// since it was last requested
+static bool is_idle(const sve4_buffer_pool_t* _Nonnull pool,
+                    const bucket_t* _Nonnull bucket) {
+  return pool->num_gets - bucket->last_get > pool->high_watermark;
+}
+
+// releases free buffers down to keep (of idle buckets only if idle_only is
+// true) and drops buckets that are left without any buffer. must be called
+// with the mutex held.
+static void trim_buckets(sve4_buffer_pool_t* _Nonnull pool, size_t keep,
+                         bool idle_only) {
+  for (bucket_t** it = &pool->buckets; *it;) {
+    bucket_t* bucket = *it;
+    if (!idle_only || is_idle(pool, bucket))
+      release_free(pool, bucket, keep);
+    if (bucket->num_buffers == 0) {
+      *it = bucket->next;
+      sve4_free(pool->allocator, bucket);
+    } else {
+      it = &bucket->next;
+    }
+  }
+}
+
+static void* _Nullable recycler_calloc(sve4_allocator_t* _Nonnull self,
+                                       size_t size, size_t alignment) {
+  bucket_t* bucket = self->state.p1;
+  return sve4_aligned_calloc(bucket->pool->allocator, size, alignment);
+}
+
+static void recycler_free(sve4_allocator_t* _Nonnull self, void* _Nullable ptr,
+                          size_t alignment) {
+  if (!ptr)
+    return;
+  bucket_t* bucket = self->state.p1;
+  sve4_buffer_pool_t* pool = bucket->pool;
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&pool->mutex);
+  free_buffer_t* buffer = ptr;
+  buffer->next = bucket->free_list;
+  buffer->alignment = alignment;
+  bucket->free_list = buffer;
+  ++bucket->num_free;
+  ++pool->stats.num_free;
+  if (bucket->num_free > pool->high_watermark)
+    release_free(pool, bucket, pool->low_watermark);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&pool->mutex);
+
+  sve4_buffer_pool_unref(pool);
+}
+
+sve4_buffer_pool_t* _Nullable sve4_buffer_pool_create(
+    sve4_allocator_t* _Nullable allocator, size_t low_watermark,
+    size_t high_watermark) {
+  assert(low_watermark <= high_watermark);
+  sve4_buffer_pool_t* pool =
+      sve4_calloc(allocator, sizeof(sve4_buffer_pool_t));
+  if (!pool)
+    return NULL;
+  pool->allocator = allocator;
+  pool->low_watermark = low_watermark;
+  pool->high_watermark = high_watermark;
+  atomic_init(&pool->ref_count, 1);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (mtx_init(&pool->mutex, mtx_plain) != thrd_success) {
+    sve4_free(allocator, pool);
+    return NULL;
+  }
+  return pool;
+}
+
+sve4_buffer_pool_t* _Nullable sve4_buffer_pool_ref(
+    sve4_buffer_pool_t* _Nullable pool) {
+  if (pool)
+    atomic_fetch_add_explicit(&pool->ref_count, 1, memory_order_relaxed);
+  return pool;
+}
+
+void sve4_buffer_pool_unref(sve4_buffer_pool_t* _Nullable pool) {
+  if (!pool || atomic_fetch_sub_explicit(&pool->ref_count, 1,
+                                         memory_order_acq_rel) != 1)
+    return;
+
+  // no buffer is in use anymore, so every bucket can go
+  trim_buckets(pool, 0, false);
+  assert(!pool->buckets);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&pool->mutex);
+  sve4_free(pool->allocator, pool);
+}
+
+sve4_buffer_ref_t _Nullable sve4_buffer_pool_get(
+    sve4_buffer_pool_t* _Nonnull pool,
+    const sve4_buffer_pool_key_t* _Nonnull key, size_t size,
+    sve4_destructor_t _Nullable destructor) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&pool->mutex);
+  bucket_t* bucket = pool->buckets;
+  while (bucket && !(bucket->size == size && key_eq(&bucket->key, key)))
+    bucket = bucket->next;
+
+  if (!bucket) {
+    bucket = sve4_calloc(pool->allocator, sizeof(bucket_t));
+    if (!bucket) {
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      mtx_unlock(&pool->mutex);
+      return NULL;
+    }
+    bucket->recycler = (sve4_allocator_t){
+        .state = {bucket, NULL},
+        .calloc = recycler_calloc,
+        .free = recycler_free,
+    };
+    sve4_allocator_impl_missing(&bucket->recycler);
+    bucket->pool = pool;
+    bucket->key = *key;
+    bucket->size = size;
+    bucket->next = pool->buckets;
+    pool->buckets = bucket;
+  }
+  bucket->last_get = ++pool->num_gets;
+
+  free_buffer_t* free_buffer = bucket->free_list;
+  sve4_buffer_t* buffer = NULL;
+  if (free_buffer) {
+    // the rest of the header is still intact
+    buffer = (sve4_buffer_t*)(void*)((char*)free_buffer +
+                                     sve4__buffer_header_offset(
+                                         free_buffer->alignment));
+    bucket->free_list = free_buffer->next;
+    --bucket->num_free;
+    --pool->stats.num_free;
+    ++pool->stats.num_reused;
+  } else {
+    // reserve the slot so the bucket stays alive while unlocked
+    ++bucket->num_buffers;
+    ++pool->stats.num_buffers;
+    ++pool->stats.num_allocated;
+  }
+  // layouts nobody asked for in a while (e.g. after a resolution change) are
+  // unlikely to be requested again. other layouts still in use, such as those
+  // of another decoder sharing the pool, keep their buffers. walking every
+  // bucket is only done once per high_watermark + 1 requests.
+  if (pool->num_gets % (pool->high_watermark + 1) == 0)
+    trim_buckets(pool, 0, true);
+  sve4_buffer_pool_ref(pool);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&pool->mutex);
+
+  if (buffer) {
+    buffer->destructor = destructor;
+    buffer->allocator = &bucket->recycler;
+    atomic_init(sve4__buffer_ref_count(buffer), 1);
+    return buffer;
+  }
+
+  buffer = sve4_buffer_create_ex(&bucket->recycler, size, key->alignment,
+                                 SVE4_BUFFER_FLAGS_NONE, destructor);
+  if (!buffer) {
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_lock(&pool->mutex);
+    --bucket->num_buffers;
+    --pool->stats.num_buffers;
+    --pool->stats.num_allocated;
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_unlock(&pool->mutex);
+    sve4_buffer_pool_unref(pool);
+  }
+  return buffer;
+}
+
+void sve4_buffer_pool_trim(sve4_buffer_pool_t* _Nonnull pool, size_t keep) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&pool->mutex);
+  trim_buckets(pool, keep, false);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&pool->mutex);
+}
+
+sve4_buffer_pool_stats_t
+sve4_buffer_pool_get_stats(sve4_buffer_pool_t* _Nonnull pool) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&pool->mutex);
+  sve4_buffer_pool_stats_t stats = pool->stats;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&pool->mutex);
+  return stats;
+}
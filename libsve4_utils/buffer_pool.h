@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "sve4_utils_export.h"
+
+#include "allocator.h"
+#include "buffer.h"
+#include "defines.h"
+#include "formats.h"
+
+// BUFFER POOL
+//
+// Recycles buffers of identical layout, such as decoded frames. A buffer
+// handed out by sve4_buffer_pool_get() goes back to the pool when its last
+// reference is dropped, and the next request with the same key gets it back
+// instead of a fresh allocation.
+//
+// At most high_watermark free buffers are kept per key, going over it releases
+// free buffers down to low_watermark. A key that was not requested during the
+// last high_watermark requests to the pool (e.g. the old layout after a
+// resolution change) is idle and its free buffers are released, so streams
+// of different layouts can share a pool. Idle keys are looked for once every
+// high_watermark + 1 requests, so this happens at most twice as late. The
+// pool and its buffers may be used from any thread.
+
+typedef struct sve4_buffer_pool_t sve4_buffer_pool_t;
+
+typedef struct {
+  sve4_pixfmt_t pixfmt;
+  size_t width, height;
+  // largest plane alignment. the alignment of the other planes is not needed:
+  // users place the planes themselves, relative to the start of a buffer that
+  // is aligned to this, so any buffer of the same size fits every layout.
+  size_t alignment;
+} sve4_buffer_pool_key_t;
+
+typedef struct {
+  // buffers allocated by the pool, in use or free
+  size_t num_buffers;
+  size_t num_free;
+  // sve4_buffer_pool_get() calls served by a free buffer/a new allocation
+  size_t num_reused, num_allocated;
+} sve4_buffer_pool_stats_t;
+
+SVE4_UTILS_EXPORT
+sve4_buffer_pool_t* _Nullable sve4_buffer_pool_create(
+    sve4_allocator_t* _Nullable allocator, size_t low_watermark,
+    size_t high_watermark);
+
+SVE4_UTILS_EXPORT
+sve4_buffer_pool_t* _Nullable sve4_buffer_pool_ref(
+    sve4_buffer_pool_t* _Nullable pool);
+// the pool is destroyed once every reference is dropped and every buffer it
+// handed out is released
+SVE4_UTILS_EXPORT
+void sve4_buffer_pool_unref(sve4_buffer_pool_t* _Nullable pool);
+
+// returns a buffer with size bytes of data aligned to key->alignment. buffers
+// are only reused for the same key and size, their contents are not cleared.
+SVE4_UTILS_EXPORT
+sve4_buffer_ref_t _Nullable sve4_buffer_pool_get(
+    sve4_buffer_pool_t* _Nonnull pool,
+    const sve4_buffer_pool_key_t* _Nonnull key, size_t size,
+    sve4_destructor_t _Nullable destructor);
+
+// releases free buffers until at most keep are left per key
+SVE4_UTILS_EXPORT
+void sve4_buffer_pool_trim(sve4_buffer_pool_t* _Nonnull pool, size_t keep);
+
+SVE4_UTILS_EXPORT
+sve4_buffer_pool_stats_t
+sve4_buffer_pool_get_stats(sve4_buffer_pool_t* _Nonnull pool);
@@ -31,6 +31,24 @@ const char* _Nonnull sve4_pixfmt_to_string(sve4_pixfmt_t pixfmt) {
       return "rgba";
     case SVE4_PIXFMT_DEFAULT_ARGB8:
       return "argb";
+    case SVE4_PIXFMT_DEFAULT_YUV420P:
+      return "yuv420p";
+    case SVE4_PIXFMT_DEFAULT_YUV422P:
+      return "yuv422p";
+    case SVE4_PIXFMT_DEFAULT_YUV444P:
+      return "yuv444p";
+    case SVE4_PIXFMT_DEFAULT_YUV420P10:
+      return "yuv420p10le";
+    case SVE4_PIXFMT_DEFAULT_YUV422P10:
+      return "yuv422p10le";
+    case SVE4_PIXFMT_DEFAULT_YUV444P10:
+      return "yuv444p10le";
+    case SVE4_PIXFMT_DEFAULT_NV12:
+      return "nv12";
+    case SVE4_PIXFMT_DEFAULT_P010:
+      return "p010le";
+    case SVE4_PIXFMT_DEFAULT_RGBA16F:
+      return "rgbaf16le";
     }
     break;
   case SVE4_FMT_SRC_FFMPEG:
@@ -89,7 +107,18 @@ size_t sve4_pixfmt_num_planes(sve4_pixfmt_t pixfmt) {
       return 0;
     case SVE4_PIXFMT_DEFAULT_RGBA8:
     case SVE4_PIXFMT_DEFAULT_ARGB8:
+    case SVE4_PIXFMT_DEFAULT_RGBA16F:
       return 1;
+    case SVE4_PIXFMT_DEFAULT_NV12:
+    case SVE4_PIXFMT_DEFAULT_P010:
+      return 2;
+    case SVE4_PIXFMT_DEFAULT_YUV420P:
+    case SVE4_PIXFMT_DEFAULT_YUV422P:
+    case SVE4_PIXFMT_DEFAULT_YUV444P:
+    case SVE4_PIXFMT_DEFAULT_YUV420P10:
+    case SVE4_PIXFMT_DEFAULT_YUV422P10:
+    case SVE4_PIXFMT_DEFAULT_YUV444P10:
+      return 3;
     }
   case SVE4_FMT_SRC_FFMPEG:
 #ifdef SVE4_UTILS_HAVE_FFMPEG
@@ -103,17 +132,99 @@ size_t sve4_pixfmt_num_planes(sve4_pixfmt_t pixfmt) {
   return 0;
 }
 
+void sve4_pixfmt_chroma_shift(sve4_pixfmt_t pixfmt, size_t* _Nonnull shift_x,
+                              size_t* _Nonnull shift_y) {
+  *shift_x = *shift_y = 0;
+  switch (pixfmt.source) {
+  case SVE4_FMT_SRC_DEFAULT:
+    switch ((sve4_pixfmt_default_t)pixfmt.pixfmt) {
+    case SVE4_PIXFMT_DEFAULT_YUV420P:
+    case SVE4_PIXFMT_DEFAULT_YUV420P10:
+    case SVE4_PIXFMT_DEFAULT_NV12:
+    case SVE4_PIXFMT_DEFAULT_P010:
+      *shift_y = 1;
+      // fallthrough
+    case SVE4_PIXFMT_DEFAULT_YUV422P:
+    case SVE4_PIXFMT_DEFAULT_YUV422P10:
+      *shift_x = 1;
+      break;
+    default:
+      break;
+    }
+    break;
+  case SVE4_FMT_SRC_FFMPEG:
+#ifdef SVE4_UTILS_HAVE_FFMPEG
+  {
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixfmt.pixfmt);
+    if (desc) {
+      *shift_x = desc->log2_chroma_w;
+      *shift_y = desc->log2_chroma_h;
+    }
+  }
+#else
+    sve4_panic("FFmpeg pixfmt used but libsve4_utils is not compiled with "
+               "FFmpeg support");
+#endif
+    break;
+  }
+}
+
+// rounds up, so that odd-sized frames keep their last column/row of chroma
+static size_t chroma_size(size_t size, size_t shift) {
+  return (size + ((size_t)1 << shift) - 1) >> shift;
+}
+
+size_t sve4_pixfmt_plane_height(sve4_pixfmt_t pixfmt, size_t plane,
+                                size_t height) {
+  if (plane >= sve4_pixfmt_num_planes(pixfmt))
+    return 0;
+
+  size_t shift_x = 0;
+  size_t shift_y = 0;
+  sve4_pixfmt_chroma_shift(pixfmt, &shift_x, &shift_y);
+  // alpha planes (plane 3) are never subsampled
+  return plane == 1 || plane == 2 ? chroma_size(height, shift_y) : height;
+}
+
 size_t sve4_pixfmt_linesize(sve4_pixfmt_t pixfmt, size_t plane, size_t width,
                             size_t align) {
   switch (pixfmt.source) {
-  case SVE4_FMT_SRC_DEFAULT:
+  case SVE4_FMT_SRC_DEFAULT: {
+    size_t shift_x = 0;
+    size_t shift_y = 0;
+    sve4_pixfmt_chroma_shift(pixfmt, &shift_x, &shift_y);
+    size_t chroma_width = chroma_size(width, shift_x);
+    size_t linesize = 0;
     switch ((sve4_pixfmt_default_t)pixfmt.pixfmt) {
     case SVE4_PIXFMT_DEFAULT_UNKNOWN:
       return 0;
     case SVE4_PIXFMT_DEFAULT_RGBA8:
     case SVE4_PIXFMT_DEFAULT_ARGB8:
-      return plane ? 0 : sve4_align_up(width * 4, align);
+      linesize = plane ? 0 : width * 4;
+      break;
+    case SVE4_PIXFMT_DEFAULT_RGBA16F:
+      // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+      linesize = plane ? 0 : width * 8;
+      break;
+    case SVE4_PIXFMT_DEFAULT_YUV420P:
+    case SVE4_PIXFMT_DEFAULT_YUV422P:
+    case SVE4_PIXFMT_DEFAULT_YUV444P:
+      linesize = plane == 0 ? width : plane < 3 ? chroma_width : 0;
+      break;
+    case SVE4_PIXFMT_DEFAULT_YUV420P10:
+    case SVE4_PIXFMT_DEFAULT_YUV422P10:
+    case SVE4_PIXFMT_DEFAULT_YUV444P10:
+      linesize = plane == 0 ? width * 2 : plane < 3 ? chroma_width * 2 : 0;
+      break;
+    case SVE4_PIXFMT_DEFAULT_NV12:
+      linesize = plane == 0 ? width : plane == 1 ? chroma_width * 2 : 0;
+      break;
+    case SVE4_PIXFMT_DEFAULT_P010:
+      linesize = plane == 0 ? width * 2 : plane == 1 ? chroma_width * 4 : 0;
+      break;
     }
+    return linesize ? sve4_align_up(linesize, align) : 0;
+  }
   case SVE4_FMT_SRC_FFMPEG:
 #ifdef SVE4_UTILS_HAVE_FFMPEG
     return sve4_align_up(
@@ -139,6 +250,26 @@ sve4_pixfmt_t sve4_pixfmt_canonicalize(sve4_pixfmt_t pixfmt) {
       return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8);
     case AV_PIX_FMT_ARGB:
       return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_ARGB8);
+    case AV_PIX_FMT_YUV420P:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV420P);
+    case AV_PIX_FMT_YUV422P:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV422P);
+    case AV_PIX_FMT_YUV444P:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV444P);
+    case AV_PIX_FMT_YUV420P10LE:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV420P10);
+    case AV_PIX_FMT_YUV422P10LE:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV422P10);
+    case AV_PIX_FMT_YUV444P10LE:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV444P10);
+    case AV_PIX_FMT_NV12:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_NV12);
+    case AV_PIX_FMT_P010LE:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_P010);
+#ifdef AV_PIX_FMT_RGBAF16
+    case AV_PIX_FMT_RGBAF16LE:
+      return sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA16F);
+#endif
     default:;
     }
 #else
@@ -17,6 +17,20 @@ typedef enum {
   SVE4_PIXFMT_DEFAULT_UNKNOWN = 0,
   SVE4_PIXFMT_DEFAULT_RGBA8,
   SVE4_PIXFMT_DEFAULT_ARGB8,
+  // 8-bit planar YUV
+  SVE4_PIXFMT_DEFAULT_YUV420P,
+  SVE4_PIXFMT_DEFAULT_YUV422P,
+  SVE4_PIXFMT_DEFAULT_YUV444P,
+  // 10-bit planar YUV, little-endian 16-bit samples (value in the low bits)
+  SVE4_PIXFMT_DEFAULT_YUV420P10,
+  SVE4_PIXFMT_DEFAULT_YUV422P10,
+  SVE4_PIXFMT_DEFAULT_YUV444P10,
+  // 8-bit Y plane followed by an interleaved UV plane, 4:2:0
+  SVE4_PIXFMT_DEFAULT_NV12,
+  // NV12 with little-endian 16-bit samples (value in the high 10 bits)
+  SVE4_PIXFMT_DEFAULT_P010,
+  // little-endian IEEE 754 half-precision floats
+  SVE4_PIXFMT_DEFAULT_RGBA16F,
 } sve4_pixfmt_default_t;
 
 typedef struct SVE4_UTILS_EXPORT {
@@ -87,6 +101,15 @@ size_t sve4_pixfmt_num_planes(sve4_pixfmt_t pixfmt);
 SVE4_UTILS_EXPORT
 size_t sve4_pixfmt_linesize(sve4_pixfmt_t pixfmt, size_t plane, size_t width,
                             size_t align);
+// number of rows of the given plane of a frame with the given height
+SVE4_UTILS_EXPORT
+size_t sve4_pixfmt_plane_height(sve4_pixfmt_t pixfmt, size_t plane,
+                                size_t height);
+// log2 of the horizontal/vertical chroma subsampling factors (0 for formats
+// without chroma planes)
+SVE4_UTILS_EXPORT
+void sve4_pixfmt_chroma_shift(sve4_pixfmt_t pixfmt, size_t* _Nonnull shift_x,
+                              size_t* _Nonnull shift_y);
 SVE4_UTILS_EXPORT
 sve4_pixfmt_t sve4_pixfmt_canonicalize(sve4_pixfmt_t pixfmt);
 
@@ -0,0 +1,289 @@
+// mremap() is a GNU extension
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#include "large_allocator.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "defines.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#define HAVE_MMAP
+#endif
+
+// size of huge pages on x86-64 and (with 4K base pages) aarch64
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+// MPOL_PREFERRED from <linux/mempolicy.h>
+#define NUMA_MPOL_PREFERRED 1
+#define NUMA_MAX_NODES 1024
+
+// stored right before every returned pointer
+typedef struct {
+  // length of the mapping starting offset bytes before the pointer, 0 if the
+  // allocation comes from the fallback allocator
+  size_t map_length;
+  // page size of the mapping, map_length is a multiple of it
+  size_t granularity;
+  size_t offset;
+  // alignment of the fallback allocation
+  size_t alignment;
+} header_t;
+
+static sve4_allocator_t* _Nullable get_fallback(
+    const sve4_allocator_t* _Nonnull self) {
+  return self->state.p1;
+}
+
+static size_t get_threshold(const sve4_allocator_t* _Nonnull self) {
+  return self->state.n1 ? self->state.n1 : SVE4_LARGE_ALLOC_DEFAULT_THRESHOLD;
+}
+
+static header_t* _Nonnull get_header(void* _Nonnull ptr) {
+  return (header_t*)((char*)ptr - sizeof(header_t));
+}
+
+#ifdef HAVE_MMAP
+static size_t page_size(void) {
+  long size = sysconf(_SC_PAGESIZE);
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+  return size > 0 ? (size_t)size : 4096;
+}
+
+static void bind_to_local_node(void* _Nonnull addr, size_t length) {
+  unsigned cpu = 0;
+  unsigned node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0 || node >= NUMA_MAX_NODES)
+    return;
+
+  enum { BITS = sizeof(unsigned long) * 8 };
+  unsigned long mask[NUMA_MAX_NODES / BITS] = {0};
+  mask[node / BITS] = 1UL << (node % BITS);
+  // only a preference, so this fails gracefully when the node runs out of
+  // memory. errors (e.g. no NUMA support in the kernel) are ignored.
+  (void)syscall(SYS_mbind, addr, length, NUMA_MPOL_PREFERRED, mask,
+                (unsigned long)NUMA_MAX_NODES + 1, 0);
+}
+
+static void prefault(char* _Nonnull addr, size_t length) {
+#ifdef MADV_POPULATE_WRITE
+  if (madvise(addr, length, MADV_POPULATE_WRITE) == 0)
+    return;
+#endif
+  // mappings start zeroed, so writing zeroes only faults the pages in
+  size_t step = page_size();
+  for (size_t i = 0; i < length; i += step)
+    ((volatile char*)addr)[i] = 0;
+}
+
+static char* _Nullable map_pages(size_t length, size_t flags,
+                                 size_t* _Nonnull map_length,
+                                 size_t* _Nonnull granularity) {
+  const int prot = PROT_READ | PROT_WRITE;
+  const int map_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  char* base = NULL;
+
+  if (flags & SVE4_LARGE_ALLOC_HUGETLB) {
+    *map_length = sve4_align_up(length, HUGE_PAGE_SIZE);
+    *granularity = HUGE_PAGE_SIZE;
+    base = mmap(NULL, *map_length, prot, map_flags | MAP_HUGETLB, -1, 0);
+    if (base != MAP_FAILED)
+      return base;
+  }
+
+  if (flags & SVE4_LARGE_ALLOC_THP) {
+    // only huge page aligned ranges can be backed by transparent huge pages,
+    // so map one more and trim the ends
+    size_t aligned_length = sve4_align_up(length, HUGE_PAGE_SIZE);
+    size_t padded_length = aligned_length + HUGE_PAGE_SIZE;
+    base = mmap(NULL, padded_length, prot, map_flags, -1, 0);
+    if (base == MAP_FAILED)
+      return NULL;
+    char* aligned = (char*)sve4_align_up((uintptr_t)base, HUGE_PAGE_SIZE);
+    if (aligned != base)
+      munmap(base, (size_t)(aligned - base));
+    char* end = aligned + aligned_length;
+    if (end != base + padded_length)
+      munmap(end, (size_t)(base + padded_length - end));
+    // fails if THP is disabled, the mapping is still usable
+    (void)madvise(aligned, aligned_length, MADV_HUGEPAGE);
+    *map_length = aligned_length;
+    *granularity = HUGE_PAGE_SIZE;
+    return aligned;
+  }
+
+  *granularity = page_size();
+  *map_length = sve4_align_up(length, *granularity);
+  base = mmap(NULL, *map_length, prot, map_flags, -1, 0);
+  return base != MAP_FAILED ? base : NULL;
+}
+
+static void init_pages(size_t flags, char* _Nonnull addr, size_t length) {
+  // must happen before the pages are faulted in
+  if (flags & SVE4_LARGE_ALLOC_NUMA_LOCAL)
+    bind_to_local_node(addr, length);
+  if (flags & SVE4_LARGE_ALLOC_PREFAULT)
+    prefault(addr, length);
+}
+
+static void* _Nullable map_alloc(sve4_allocator_t* _Nonnull self, size_t size,
+                                 size_t offset) {
+  size_t flags = self->state.n2;
+  size_t map_length = 0;
+  size_t granularity = 0;
+  char* base = map_pages(size + offset, flags, &map_length, &granularity);
+  if (!base)
+    return NULL;
+  init_pages(flags, base, map_length);
+
+  void* ptr = base + offset;
+  *get_header(ptr) = (header_t){map_length, granularity, offset, 0};
+  return ptr;
+}
+
+// resizes the mapping of ptr to map_length bytes, returns NULL and leaves ptr
+// intact if the kernel refuses
+static void* _Nullable remap(sve4_allocator_t* _Nonnull self,
+                             void* _Nonnull ptr, size_t old_size,
+                             size_t new_size, size_t map_length) {
+  header_t header = *get_header(ptr);
+  char* base = (char*)ptr - header.offset;
+  base = mremap(base, header.map_length, map_length, MREMAP_MAYMOVE);
+  if (base == MAP_FAILED)
+    return NULL;
+  ptr = base + header.offset;
+  get_header(ptr)->map_length = map_length;
+
+  // a moved mapping is only page aligned, so transparent huge pages would
+  // no longer back it. keep the unaligned one if remapping fails.
+  if (header.granularity == HUGE_PAGE_SIZE &&
+      (uintptr_t)base % HUGE_PAGE_SIZE != 0) {
+    void* new_ptr = map_alloc(self, new_size, header.offset);
+    if (new_ptr) {
+      memcpy(new_ptr, ptr, sve4_min(old_size, new_size));
+      munmap(base, map_length);
+      return new_ptr;
+    }
+  }
+
+  // the grown range gets the same treatment as a fresh mapping
+  if (map_length > header.map_length) {
+    char* tail = base + header.map_length;
+    size_t tail_length = map_length - header.map_length;
+    size_t flags = self->state.n2;
+    if (flags & SVE4_LARGE_ALLOC_THP)
+      (void)madvise(tail, tail_length, MADV_HUGEPAGE);
+    init_pages(flags, tail, tail_length);
+  }
+  return ptr;
+}
+#endif
+
+static void* _Nullable large_alloc_common(sve4_allocator_t* _Nonnull self,
+                                          size_t size, size_t alignment,
+                                          bool zero) {
+  alignment = sve4_max(alignment, SVE4_MAX_ALIGN);
+  size_t offset = sve4_align_up(sizeof(header_t), alignment);
+  // leaves room for rounding up to huge pages as well
+  if (size > SIZE_MAX - offset - HUGE_PAGE_SIZE)
+    return NULL;
+
+#ifdef HAVE_MMAP
+  if (size >= get_threshold(self) && alignment <= page_size()) {
+    // mappings are zeroed already
+    void* ptr = map_alloc(self, size, offset);
+    if (ptr)
+      return ptr;
+  }
+#endif
+
+  sve4_allocator_t* fallback = get_fallback(self);
+  char* base = zero ? sve4_aligned_calloc(fallback, size + offset, alignment)
+                    : sve4_aligned_alloc(fallback, size + offset, alignment);
+  if (!base)
+    return NULL;
+  void* ptr = base + offset;
+  *get_header(ptr) = (header_t){0, 0, offset, alignment};
+  return ptr;
+}
+
+void* sve4__allocator_large_alloc(sve4_allocator_t* _Nonnull self, size_t size,
+                                  size_t alignment) {
+  return large_alloc_common(self, size, alignment, false);
+}
+
+void* sve4__allocator_large_calloc(sve4_allocator_t* _Nonnull self,
+                                   size_t size, size_t alignment) {
+  return large_alloc_common(self, size, alignment, true);
+}
+
+void* sve4__allocator_large_grow(sve4_allocator_t* _Nonnull self,
+                                 void* _Nullable ptr, size_t old_size,
+                                 size_t new_size, size_t alignment) {
+  if (!ptr)
+    return sve4__allocator_large_alloc(self, new_size, alignment);
+
+  header_t header = *get_header(ptr);
+  char* base = (char*)ptr - header.offset;
+  bool large = new_size >= get_threshold(self);
+  bool same_offset =
+      header.offset ==
+      sve4_align_up(sizeof(header_t), sve4_max(alignment, SVE4_MAX_ALIGN));
+
+#ifdef HAVE_MMAP
+  // mappings can be resized without copying
+  if (header.map_length && large && same_offset &&
+      new_size <= SIZE_MAX - header.offset - header.granularity) {
+    size_t map_length =
+        sve4_align_up(new_size + header.offset, header.granularity);
+    if (map_length == header.map_length)
+      return ptr;
+    void* new_ptr = remap(self, ptr, old_size, new_size, map_length);
+    if (new_ptr)
+      return new_ptr;
+    // mremap() of hugetlb mappings fails with EINVAL on older kernels, so
+    // fall back to copying
+  }
+#endif
+
+  if (!header.map_length && !large && same_offset &&
+      new_size <= SIZE_MAX - header.offset) {
+    base = sve4_aligned_realloc(get_fallback(self), base,
+                                old_size + header.offset,
+                                new_size + header.offset, header.alignment);
+    return base ? base + header.offset : NULL;
+  }
+
+  // moving between a mapping and the fallback allocator, or a mapping that
+  // could not be resized
+  void* new_ptr = sve4__allocator_large_alloc(self, new_size, alignment);
+  if (new_ptr) {
+    memcpy(new_ptr, ptr, sve4_min(old_size, new_size));
+    sve4__allocator_large_free(self, ptr, alignment);
+  }
+  return new_ptr;
+}
+
+void sve4__allocator_large_free(sve4_allocator_t* _Nonnull self,
+                                void* _Nullable ptr, size_t alignment) {
+  (void)alignment;
+  if (!ptr)
+    return;
+  header_t header = *get_header(ptr);
+  char* base = (char*)ptr - header.offset;
+#ifdef HAVE_MMAP
+  if (header.map_length) {
+    munmap(base, header.map_length);
+    return;
+  }
+#endif
+  sve4_aligned_free(get_fallback(self), base, header.alignment);
+}
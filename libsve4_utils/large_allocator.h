@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "sve4_utils_export.h"
+
+#include "allocator.h"
+#include "defines.h"
+
+// LARGE OBJECT ALLOCATOR
+//
+// Meant for frame buffers and planes, which are tens of megabytes at 4K/8K.
+// Allocations of at least the threshold get their own anonymous mapping,
+// optionally backed by huge pages (less TLB pressure when converting),
+// pre-faulted (no page fault storm on first touch) and bound to the NUMA node
+// of the allocating thread. Smaller allocations and allocations aligned to
+// more than a page go to the fallback allocator.
+//
+// Mappings are only available on Linux, elsewhere everything goes to the
+// fallback allocator. Pointers must be freed through the allocator that
+// returned them.
+
+// default threshold, in bytes
+#define SVE4_LARGE_ALLOC_DEFAULT_THRESHOLD ((size_t)1 << 20)
+
+typedef enum {
+  // use explicit huge pages (MAP_HUGETLB), falling back to regular pages when
+  // none are reserved
+  SVE4_LARGE_ALLOC_HUGETLB = 1 << 0,
+  // ask for transparent huge pages
+  SVE4_LARGE_ALLOC_THP = 1 << 1,
+  // fault every page in at allocation time
+  SVE4_LARGE_ALLOC_PREFAULT = 1 << 2,
+  // prefer the NUMA node of the CPU the allocating thread runs on. best
+  // combined with PREFAULT, otherwise pages are placed when first touched
+  // instead, and the thread touching them may run on another node by then.
+  SVE4_LARGE_ALLOC_NUMA_LOCAL = 1 << 3,
+} sve4_large_alloc_flags_t;
+
+// fallback is NULL for libc, threshold 0 means
+// SVE4_LARGE_ALLOC_DEFAULT_THRESHOLD and flags is a combination of
+// sve4_large_alloc_flags_t. being a macro allows static initialization, the
+// allocator does not need to be destroyed.
+#define sve4_allocator_large_init(fallback, threshold, flags)                  \
+  ((sve4_allocator_t){                                                         \
+      .state = {(fallback), NULL, (threshold), (size_t)(flags)},               \
+      .alloc = sve4__allocator_large_alloc,                                    \
+      .calloc = sve4__allocator_large_calloc,                                  \
+      .grow = sve4__allocator_large_grow,                                      \
+      .free = sve4__allocator_large_free,                                      \
+  })
+
+SVE4_UTILS_EXPORT
+void* _Nullable sve4__allocator_large_alloc(sve4_allocator_t* _Nonnull self,
+                                            size_t size, size_t alignment);
+SVE4_UTILS_EXPORT
+void* _Nullable sve4__allocator_large_calloc(sve4_allocator_t* _Nonnull self,
+                                             size_t size, size_t alignment);
+SVE4_UTILS_EXPORT
+void* _Nullable sve4__allocator_large_grow(sve4_allocator_t* _Nonnull self,
+                                           void* _Nullable ptr, size_t old_size,
+                                           size_t new_size, size_t alignment);
+SVE4_UTILS_EXPORT
+void sve4__allocator_large_free(sve4_allocator_t* _Nonnull self,
+                                void* _Nullable ptr, size_t alignment);
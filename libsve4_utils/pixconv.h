@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sve4_utils_export.h"
+
+#include "allocator.h"
+#include "defines.h"
+#include "formats.h"
+#include "thread_pool.h"
+
+// PIXEL FORMAT CONVERSION
+//
+// Supported conversions are YUV420P/YUV422P/YUV444P (8 and 10-bit), NV12 and
+// P010 to RGBA8 and RGBA16F, plus plain copies between identical formats.
+// Chroma is upsampled by sample replication, sve4_pixconv_scale() resizes
+// with a bilinear filter.
+//
+// Work is split into cache-sized tiles of whole chroma rows and at most 1024
+// columns, which run on options->thread_pool when given.
+
+typedef enum {
+  // BT.709 for frames taller than 576 rows, BT.601 otherwise
+  SVE4_PIXCONV_MATRIX_AUTO = 0,
+  SVE4_PIXCONV_MATRIX_BT601,
+  SVE4_PIXCONV_MATRIX_BT709,
+  SVE4_PIXCONV_MATRIX_BT2020,
+} sve4_pixconv_matrix_t;
+
+typedef enum {
+  SVE4_PIXCONV_RANGE_LIMITED = 0,
+  SVE4_PIXCONV_RANGE_FULL,
+} sve4_pixconv_range_t;
+
+typedef enum {
+  // best backend supported by the running CPU
+  SVE4_PIXCONV_BACKEND_AUTO = 0,
+  SVE4_PIXCONV_BACKEND_SCALAR,
+  SVE4_PIXCONV_BACKEND_SSE41,
+  // AVX2 + F16C
+  SVE4_PIXCONV_BACKEND_AVX2,
+  SVE4_PIXCONV_BACKEND_NEON,
+} sve4_pixconv_backend_t;
+
+typedef struct {
+  sve4_pixconv_matrix_t matrix;
+  sve4_pixconv_range_t range;
+  sve4_pixconv_backend_t backend;
+  // NULL runs on the calling thread, see sve4_thread_pool_shared()
+  sve4_thread_pool_t* _Nullable thread_pool;
+  // used for per-call temporary buffers (cache line aligned), e.g. an arena
+  // that is reset once per frame
+  sve4_allocator_t* _Nullable scratch_allocator;
+} sve4_pixconv_options_t;
+
+SVE4_UTILS_EXPORT
+const char* _Nonnull sve4_pixconv_backend_to_string(
+    sve4_pixconv_backend_t backend);
+SVE4_UTILS_EXPORT
+bool sve4_pixconv_backend_supported(sve4_pixconv_backend_t backend);
+
+SVE4_UTILS_EXPORT
+bool sve4_pixconv_supported(sve4_pixfmt_t dst_fmt, sve4_pixfmt_t src_fmt);
+
+// converts a width x height image, planes are given as in
+// sve4_decode_ram_frame_t. options may be NULL (limited range, automatic
+// matrix and backend, single-threaded). returns false if the conversion is
+// not supported or the requested backend is not available.
+SVE4_UTILS_EXPORT
+bool sve4_pixconv_convert(sve4_pixfmt_t dst_fmt,
+                          uint8_t* _Nullable const* _Nonnull dst,
+                          const size_t* _Nonnull dst_linesizes,
+                          sve4_pixfmt_t src_fmt,
+                          const uint8_t* _Nullable const* _Nonnull src,
+                          const size_t* _Nonnull src_linesizes, size_t width,
+                          size_t height,
+                          const sve4_pixconv_options_t* _Nullable options);
+
+// like sve4_pixconv_convert(), but also resizes the image. only YUV sources
+// can be scaled. returns false if the conversion is not supported or scratch
+// memory could not be allocated.
+SVE4_UTILS_EXPORT
+bool sve4_pixconv_scale(sve4_pixfmt_t dst_fmt,
+                        uint8_t* _Nullable const* _Nonnull dst,
+                        const size_t* _Nonnull dst_linesizes, size_t dst_width,
+                        size_t dst_height, sve4_pixfmt_t src_fmt,
+                        const uint8_t* _Nullable const* _Nonnull src,
+                        const size_t* _Nonnull src_linesizes, size_t src_width,
+                        size_t src_height,
+                        const sve4_pixconv_options_t* _Nullable options);
@@ -0,0 +1,851 @@
+#include "pixconv_kernels.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#if SVE4_PIXCONV_HAVE_X86
+#include <immintrin.h>
+#endif
+#if SVE4_PIXCONV_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+static inline float clamp(float x, float max) {
+  return x < 0.0F ? 0.0F : x > max ? max : x;
+}
+
+// round to nearest even, like _mm_cvtps_epi32() and vcvtnq_u32_f32() do (in
+// the default rounding mode). adding 2^23 leaves no fractional bits, so the
+// addition itself rounds, and x must be in [0, 2^23).
+static inline uint8_t round_to_u8(float x) {
+  const float magic = 8388608.0F;
+  return (uint8_t)(x + magic - magic);
+}
+
+// the SIMD kernels do the same operations in the same order (without FMA),
+// so every backend gives bit-identical results
+static inline void yuv_to_rgb(const sve4_pixconv_coeffs_t* _Nonnull c,
+                              uint16_t y, uint16_t u, uint16_t v,
+                              float* _Nonnull rgb) {
+  float yy = ((float)y - c->y_offset) * c->y_scale;
+  float uu = (float)u - c->c_offset;
+  float vv = (float)v - c->c_offset;
+  rgb[0] = clamp(yy + c->r_v * vv, c->max);
+  rgb[1] = clamp(yy + c->g_u * uu + c->g_v * vv, c->max);
+  rgb[2] = clamp(yy + c->b_u * uu, c->max);
+}
+
+// round to nearest even, like F16C and NEON do
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+static uint16_t float_to_half(float f) {
+  uint32_t x = 0;
+  memcpy(&x, &f, sizeof x);
+  uint32_t sign = (x >> 16) & 0x8000U;
+  uint32_t biased = (x >> 23) & 0xffU;
+  uint32_t mant = x & 0x7fffffU;
+  if (biased == 0xff)
+    return (uint16_t)(sign | 0x7c00U | (mant ? 0x200U : 0));
+
+  int32_t exp = (int32_t)biased - 127 + 15;
+  if (exp >= 31)
+    return (uint16_t)(sign | 0x7c00U);
+
+  uint32_t half = 0;
+  uint32_t shift = 13;
+  if (exp <= 0) {
+    // subnormal half (or zero)
+    if (exp < -10)
+      return (uint16_t)sign;
+    mant |= 0x800000U;
+    shift = (uint32_t)(14 - exp);
+    half = mant >> shift;
+  } else {
+    half = ((uint32_t)exp << 10) | (mant >> 13);
+  }
+
+  // a carry out of the mantissa correctly bumps the exponent
+  uint32_t rem = mant & ((1U << shift) - 1);
+  uint32_t mid = 1U << (shift - 1);
+  if (rem > mid || (rem == mid && (half & 1)))
+    ++half;
+  return (uint16_t)(sign | half);
+}
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+void sve4__pixconv_yuv_to_rgba8_scalar(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst) {
+  for (size_t i = 0; i < n; ++i) {
+    float rgb[3];
+    yuv_to_rgb(coeffs, y[i], u[i], v[i], rgb);
+    dst[i * 4 + 0] = round_to_u8(rgb[0]);
+    dst[i * 4 + 1] = round_to_u8(rgb[1]);
+    dst[i * 4 + 2] = round_to_u8(rgb[2]);
+    dst[i * 4 + 3] = (uint8_t)coeffs->max;
+  }
+}
+
+void sve4__pixconv_yuv_to_rgba16f_scalar(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst) {
+  for (size_t i = 0; i < n; ++i) {
+    float rgb[3];
+    yuv_to_rgb(coeffs, y[i], u[i], v[i], rgb);
+    uint16_t px[4] = {float_to_half(rgb[0]), float_to_half(rgb[1]),
+                      float_to_half(rgb[2]), float_to_half(coeffs->max)};
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    memcpy(&dst[i * 8], px, sizeof px);
+  }
+}
+
+enum { FRAC_ONE = 1 << SVE4_PIXCONV_FRAC_BITS };
+
+static inline uint16_t load_sample(const uint8_t* _Nonnull row, size_t index,
+                                   size_t bytes, uint32_t shift) {
+  if (bytes == 1)
+    return row[index];
+  const uint8_t* sample = &row[index * 2];
+  // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+  return (uint16_t)((uint32_t)(sample[0] | (sample[1] << 8)) >> shift);
+}
+
+static void unpack_scalar(const uint8_t* _Nonnull row, size_t x0, size_t n,
+                          size_t shift_x, size_t bytes, uint32_t shift,
+                          uint16_t* _Nonnull out) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = load_sample(row, (x0 + i) >> shift_x, bytes, shift);
+}
+
+static void deinterleave_scalar(const uint8_t* _Nonnull row, size_t x0,
+                                size_t n, size_t shift_x, size_t bytes,
+                                uint32_t shift, uint16_t* _Nonnull u,
+                                uint16_t* _Nonnull v) {
+  for (size_t i = 0; i < n; ++i) {
+    size_t index = ((x0 + i) >> shift_x) * 2;
+    u[i] = load_sample(row, index, bytes, shift);
+    v[i] = load_sample(row, index + 1, bytes, shift);
+  }
+}
+
+static void lerp_scalar(const uint16_t* _Nonnull top,
+                        const uint16_t* _Nonnull bottom, uint32_t frac,
+                        size_t n, uint16_t* _Nonnull out) {
+  for (size_t i = 0; i < n; ++i)
+    out[i] = (uint16_t)(top[i] * (FRAC_ONE - frac) + bottom[i] * frac);
+}
+
+static void filter_scalar(const uint16_t* _Nonnull in, size_t base,
+                          const uint32_t* _Nonnull index,
+                          const uint32_t* _Nonnull weights, size_t n,
+                          uint16_t* _Nonnull out) {
+  for (size_t i = 0; i < n; ++i) {
+    const uint16_t* pair = &in[index[i] - base];
+    uint32_t weight = weights[i];
+    // NOLINTNEXTLINE(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+    uint32_t sum = pair[0] * (weight & 0xffffU) + pair[1] * (weight >> 16);
+    out[i] = (uint16_t)((sum + FRAC_ONE / 2) >> SVE4_PIXCONV_FRAC_BITS);
+  }
+}
+
+const sve4_pixconv_loaders_t sve4__pixconv_loaders_scalar = {
+    .unpack = unpack_scalar,
+    .deinterleave = deinterleave_scalar,
+    .lerp = lerp_scalar,
+    .filter = filter_scalar,
+};
+
+// the SIMD loaders handle an odd first pixel of subsampled rows and the
+// last (partial) vector with the scalar ones
+
+#if SVE4_PIXCONV_HAVE_X86
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+#define SVE4_PIXCONV_SSE41_LOAD(ptr)                                           \
+  _mm_cvtepi32_ps(_mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i*)(ptr))))
+
+// computes 4 pixels, clamped to [0, max]
+#define SVE4_PIXCONV_SSE41_YUV_TO_RGB(i, r, g, b)                              \
+  __m128 r, g, b;                                                              \
+  do {                                                                         \
+    __m128 yy = _mm_mul_ps(                                                    \
+        _mm_sub_ps(SVE4_PIXCONV_SSE41_LOAD(&y[i]), y_offset), y_scale);        \
+    __m128 uu = _mm_sub_ps(SVE4_PIXCONV_SSE41_LOAD(&u[i]), c_offset);          \
+    __m128 vv = _mm_sub_ps(SVE4_PIXCONV_SSE41_LOAD(&v[i]), c_offset);          \
+    r = _mm_add_ps(yy, _mm_mul_ps(r_v, vv));                                   \
+    g = _mm_add_ps(_mm_add_ps(yy, _mm_mul_ps(g_u, uu)), _mm_mul_ps(g_v, vv));  \
+    b = _mm_add_ps(yy, _mm_mul_ps(b_u, uu));                                   \
+    r = _mm_min_ps(_mm_max_ps(r, zero), max);                                  \
+    g = _mm_min_ps(_mm_max_ps(g, zero), max);                                  \
+    b = _mm_min_ps(_mm_max_ps(b, zero), max);                                  \
+  } while (0)
+
+#define SVE4_PIXCONV_SSE41_CONSTANTS                                           \
+  const __m128 y_offset = _mm_set1_ps(coeffs->y_offset);                      \
+  const __m128 c_offset = _mm_set1_ps(coeffs->c_offset);                      \
+  const __m128 y_scale = _mm_set1_ps(coeffs->y_scale);                        \
+  const __m128 r_v = _mm_set1_ps(coeffs->r_v);                                \
+  const __m128 g_u = _mm_set1_ps(coeffs->g_u);                                \
+  const __m128 g_v = _mm_set1_ps(coeffs->g_v);                                \
+  const __m128 b_u = _mm_set1_ps(coeffs->b_u);                                \
+  const __m128 zero = _mm_setzero_ps();                                       \
+  const __m128 max = _mm_set1_ps(coeffs->max)
+
+sve4_gnu_attribute((target("sse4.1"))) void sve4__pixconv_yuv_to_rgba8_sse41(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst) {
+  SVE4_PIXCONV_SSE41_CONSTANTS;
+  const __m128i alpha = _mm_set1_epi32((int)0xff000000U);
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    SVE4_PIXCONV_SSE41_YUV_TO_RGB(i, r, g, b);
+    __m128i px = _mm_or_si128(
+        _mm_or_si128(_mm_cvtps_epi32(r), _mm_slli_epi32(_mm_cvtps_epi32(g), 8)),
+        _mm_or_si128(_mm_slli_epi32(_mm_cvtps_epi32(b), 16), alpha));
+    _mm_storeu_si128((__m128i*)&dst[i * 4], px);
+  }
+
+  sve4__pixconv_yuv_to_rgba8_scalar(&y[i], &u[i], &v[i], n - i, coeffs,
+                                    &dst[i * 4]);
+}
+
+// x must be in [0, 1], rounds to nearest even like F16C. normal halves are
+// the rebiased float bits, subnormal ones are rounded by adding 0.5F.
+sve4_gnu_attribute((target("sse4.1"))) static inline __m128i
+sse41_float_to_half(__m128 x) {
+  const __m128i bits = _mm_castps_si128(x);
+  const __m128 half = _mm_set1_ps(0.5F);
+  __m128i subnormal = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(x, half)),
+                                    _mm_castps_si128(half));
+  __m128i odd = _mm_and_si128(_mm_srli_epi32(bits, 13), _mm_set1_epi32(1));
+  __m128i normal = _mm_add_epi32(bits, _mm_set1_epi32(-(112 << 23) + 0xfff));
+  normal = _mm_srli_epi32(_mm_add_epi32(normal, odd), 13);
+  // 2^-14 is the smallest normal half
+  __m128i is_subnormal = _mm_cmplt_epi32(bits, _mm_set1_epi32(113 << 23));
+  return _mm_blendv_epi8(normal, subnormal, is_subnormal);
+}
+
+sve4_gnu_attribute((target("sse4.1"))) void
+sve4__pixconv_yuv_to_rgba16f_sse41(const uint16_t* _Nonnull y,
+                                   const uint16_t* _Nonnull u,
+                                   const uint16_t* _Nonnull v, size_t n,
+                                   const sve4_pixconv_coeffs_t* _Nonnull coeffs,
+                                   uint8_t* _Nonnull dst) {
+  SVE4_PIXCONV_SSE41_CONSTANTS;
+  const __m128i alpha = _mm_set1_epi32(0x3c000000); // 1.0
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    SVE4_PIXCONV_SSE41_YUV_TO_RGB(i, r, g, b);
+    __m128i rg = _mm_or_si128(sse41_float_to_half(r),
+                              _mm_slli_epi32(sse41_float_to_half(g), 16));
+    __m128i ba = _mm_or_si128(sse41_float_to_half(b), alpha);
+    __m128i* out = (__m128i*)&dst[i * 8];
+    _mm_storeu_si128(&out[0], _mm_unpacklo_epi32(rg, ba));
+    _mm_storeu_si128(&out[1], _mm_unpackhi_epi32(rg, ba));
+  }
+
+  sve4__pixconv_yuv_to_rgba16f_scalar(&y[i], &u[i], &v[i], n - i, coeffs,
+                                      &dst[i * 8]);
+}
+
+sve4_gnu_attribute((target("sse4.1"))) static void unpack_sse41(
+    const uint8_t* _Nonnull row, size_t x0, size_t n, size_t shift_x,
+    size_t bytes, uint32_t shift, uint16_t* _Nonnull out) {
+  const __m128i count = _mm_cvtsi32_si128((int)shift);
+  size_t i = sve4_min(x0 & shift_x, n);
+  unpack_scalar(row, x0, i, shift_x, bytes, shift, out);
+
+  if (bytes == 1 && !shift_x) {
+    for (; i + 16 <= n; i += 16) {
+      __m128i s = _mm_loadu_si128((const __m128i*)&row[x0 + i]);
+      _mm_storeu_si128((__m128i*)&out[i], _mm_cvtepu8_epi16(s));
+      _mm_storeu_si128((__m128i*)&out[i + 8],
+                       _mm_cvtepu8_epi16(_mm_srli_si128(s, 8)));
+    }
+  } else if (bytes == 1) {
+    for (; i + 16 <= n; i += 16) {
+      __m128i s = _mm_cvtepu8_epi16(
+          _mm_loadl_epi64((const __m128i*)&row[(x0 + i) >> 1]));
+      _mm_storeu_si128((__m128i*)&out[i], _mm_unpacklo_epi16(s, s));
+      _mm_storeu_si128((__m128i*)&out[i + 8], _mm_unpackhi_epi16(s, s));
+    }
+  } else if (!shift_x) {
+    for (; i + 8 <= n; i += 8) {
+      __m128i s = _mm_loadu_si128((const __m128i*)&row[(x0 + i) * 2]);
+      _mm_storeu_si128((__m128i*)&out[i], _mm_srl_epi16(s, count));
+    }
+  } else {
+    for (; i + 16 <= n; i += 16) {
+      __m128i s = _mm_srl_epi16(
+          _mm_loadu_si128((const __m128i*)&row[x0 + i]), count);
+      _mm_storeu_si128((__m128i*)&out[i], _mm_unpacklo_epi16(s, s));
+      _mm_storeu_si128((__m128i*)&out[i + 8], _mm_unpackhi_epi16(s, s));
+    }
+  }
+
+  unpack_scalar(row, x0 + i, n - i, shift_x, bytes, shift, &out[i]);
+}
+
+sve4_gnu_attribute((target("sse4.1"))) static void deinterleave_sse41(
+    const uint8_t* _Nonnull row, size_t x0, size_t n, size_t shift_x,
+    size_t bytes, uint32_t shift, uint16_t* _Nonnull u,
+    uint16_t* _Nonnull v) {
+  const __m128i count = _mm_cvtsi32_si128((int)shift);
+  const __m128i low_byte = _mm_set1_epi16(0xff);
+  const __m128i low_half = _mm_set1_epi32(0xffff);
+  size_t i = sve4_min(x0 & shift_x, n);
+  deinterleave_scalar(row, x0, i, shift_x, bytes, shift, u, v);
+
+  if (bytes == 1 && !shift_x) {
+    for (; i + 8 <= n; i += 8) {
+      __m128i s = _mm_loadu_si128((const __m128i*)&row[(x0 + i) * 2]);
+      _mm_storeu_si128((__m128i*)&u[i], _mm_and_si128(s, low_byte));
+      _mm_storeu_si128((__m128i*)&v[i], _mm_srli_epi16(s, 8));
+    }
+  } else if (bytes == 1) {
+    // 16 pixels share 8 pairs, the shuffles pick and repeat every sample
+    const __m128i u_lo =
+        _mm_setr_epi8(0, -1, 0, -1, 2, -1, 2, -1, 4, -1, 4, -1, 6, -1, 6, -1);
+    const __m128i u_hi = _mm_add_epi8(u_lo, _mm_set1_epi16(8));
+    const __m128i v_lo = _mm_add_epi8(u_lo, _mm_set1_epi16(1));
+    const __m128i v_hi = _mm_add_epi8(u_lo, _mm_set1_epi16(9));
+    for (; i + 16 <= n; i += 16) {
+      __m128i s = _mm_loadu_si128((const __m128i*)&row[x0 + i]);
+      _mm_storeu_si128((__m128i*)&u[i], _mm_shuffle_epi8(s, u_lo));
+      _mm_storeu_si128((__m128i*)&u[i + 8], _mm_shuffle_epi8(s, u_hi));
+      _mm_storeu_si128((__m128i*)&v[i], _mm_shuffle_epi8(s, v_lo));
+      _mm_storeu_si128((__m128i*)&v[i + 8], _mm_shuffle_epi8(s, v_hi));
+    }
+  } else if (!shift_x) {
+    for (; i + 8 <= n; i += 8) {
+      const __m128i* pairs = (const __m128i*)&row[(x0 + i) * 4];
+      __m128i a = _mm_srl_epi16(_mm_loadu_si128(&pairs[0]), count);
+      __m128i b = _mm_srl_epi16(_mm_loadu_si128(&pairs[1]), count);
+      _mm_storeu_si128((__m128i*)&u[i],
+                       _mm_packus_epi32(_mm_and_si128(a, low_half),
+                                        _mm_and_si128(b, low_half)));
+      _mm_storeu_si128(
+          (__m128i*)&v[i],
+          _mm_packus_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16)));
+    }
+  } else {
+    for (; i + 8 <= n; i += 8) {
+      __m128i s = _mm_srl_epi16(
+          _mm_loadu_si128((const __m128i*)&row[(x0 + i) * 2]), count);
+      __m128i uu = _mm_and_si128(s, low_half);
+      __m128i vv = _mm_srli_epi32(s, 16);
+      _mm_storeu_si128((__m128i*)&u[i],
+                       _mm_or_si128(uu, _mm_slli_epi32(uu, 16)));
+      _mm_storeu_si128((__m128i*)&v[i],
+                       _mm_or_si128(vv, _mm_slli_epi32(vv, 16)));
+    }
+  }
+
+  deinterleave_scalar(row, x0 + i, n - i, shift_x, bytes, shift, &u[i],
+                      &v[i]);
+}
+
+sve4_gnu_attribute((target("sse4.1"))) static void lerp_sse41(
+    const uint16_t* _Nonnull top, const uint16_t* _Nonnull bottom,
+    uint32_t frac, size_t n, uint16_t* _Nonnull out) {
+  const __m128i top_weight = _mm_set1_epi16((short)(FRAC_ONE - frac));
+  const __m128i bottom_weight = _mm_set1_epi16((short)frac);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i t = _mm_loadu_si128((const __m128i*)&top[i]);
+    __m128i b = _mm_loadu_si128((const __m128i*)&bottom[i]);
+    _mm_storeu_si128((__m128i*)&out[i],
+                     _mm_add_epi16(_mm_mullo_epi16(t, top_weight),
+                                   _mm_mullo_epi16(b, bottom_weight)));
+  }
+  lerp_scalar(&top[i], &bottom[i], frac, n - i, &out[i]);
+}
+
+// loads in[j] and in[j + 1] into the low and high half of each lane
+sve4_gnu_attribute((target("sse4.1"))) static inline __m128i
+sse41_load_pairs(const uint16_t* _Nonnull in, size_t base,
+                 const uint32_t* _Nonnull index) {
+  uint32_t pairs[4];
+  for (size_t k = 0; k < 4; ++k)
+    memcpy(&pairs[k], &in[index[k] - base], sizeof pairs[k]);
+  return _mm_loadu_si128((const __m128i*)pairs);
+}
+
+// the weighted sums fit in 16-bit signed products, see lerp
+sve4_gnu_attribute((target("sse4.1"))) static void filter_sse41(
+    const uint16_t* _Nonnull in, size_t base, const uint32_t* _Nonnull index,
+    const uint32_t* _Nonnull weights, size_t n, uint16_t* _Nonnull out) {
+  const __m128i round = _mm_set1_epi32(FRAC_ONE / 2);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m128i lo =
+        _mm_madd_epi16(sse41_load_pairs(in, base, &index[i]),
+                       _mm_loadu_si128((const __m128i*)&weights[i]));
+    __m128i hi =
+        _mm_madd_epi16(sse41_load_pairs(in, base, &index[i + 4]),
+                       _mm_loadu_si128((const __m128i*)&weights[i + 4]));
+    lo = _mm_srli_epi32(_mm_add_epi32(lo, round), SVE4_PIXCONV_FRAC_BITS);
+    hi = _mm_srli_epi32(_mm_add_epi32(hi, round), SVE4_PIXCONV_FRAC_BITS);
+    _mm_storeu_si128((__m128i*)&out[i], _mm_packus_epi32(lo, hi));
+  }
+  filter_scalar(in, base, &index[i], &weights[i], n - i, &out[i]);
+}
+
+const sve4_pixconv_loaders_t sve4__pixconv_loaders_sse41 = {
+    .unpack = unpack_sse41,
+    .deinterleave = deinterleave_sse41,
+    .lerp = lerp_sse41,
+    .filter = filter_sse41,
+};
+
+#define SVE4_PIXCONV_AVX2_LOAD(ptr)                                            \
+  _mm256_cvtepi32_ps(                                                          \
+      _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)(ptr))))
+
+// computes 8 pixels, clamped to [0, max]
+#define SVE4_PIXCONV_AVX2_YUV_TO_RGB(i, r, g, b)                               \
+  __m256 r, g, b;                                                              \
+  do {                                                                         \
+    __m256 yy = _mm256_mul_ps(                                                 \
+        _mm256_sub_ps(SVE4_PIXCONV_AVX2_LOAD(&y[i]), y_offset), y_scale);      \
+    __m256 uu = _mm256_sub_ps(SVE4_PIXCONV_AVX2_LOAD(&u[i]), c_offset);        \
+    __m256 vv = _mm256_sub_ps(SVE4_PIXCONV_AVX2_LOAD(&v[i]), c_offset);        \
+    r = _mm256_add_ps(yy, _mm256_mul_ps(r_v, vv));                             \
+    g = _mm256_add_ps(_mm256_add_ps(yy, _mm256_mul_ps(g_u, uu)),               \
+                      _mm256_mul_ps(g_v, vv));                                 \
+    b = _mm256_add_ps(yy, _mm256_mul_ps(b_u, uu));                             \
+    r = _mm256_min_ps(_mm256_max_ps(r, zero), max);                            \
+    g = _mm256_min_ps(_mm256_max_ps(g, zero), max);                            \
+    b = _mm256_min_ps(_mm256_max_ps(b, zero), max);                            \
+  } while (0)
+
+#define SVE4_PIXCONV_AVX2_CONSTANTS                                            \
+  const __m256 y_offset = _mm256_set1_ps(coeffs->y_offset);                   \
+  const __m256 c_offset = _mm256_set1_ps(coeffs->c_offset);                   \
+  const __m256 y_scale = _mm256_set1_ps(coeffs->y_scale);                     \
+  const __m256 r_v = _mm256_set1_ps(coeffs->r_v);                             \
+  const __m256 g_u = _mm256_set1_ps(coeffs->g_u);                             \
+  const __m256 g_v = _mm256_set1_ps(coeffs->g_v);                             \
+  const __m256 b_u = _mm256_set1_ps(coeffs->b_u);                             \
+  const __m256 zero = _mm256_setzero_ps();                                    \
+  const __m256 max = _mm256_set1_ps(coeffs->max)
+
+sve4_gnu_attribute((target("avx2"))) void sve4__pixconv_yuv_to_rgba8_avx2(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst) {
+  SVE4_PIXCONV_AVX2_CONSTANTS;
+  const __m256i alpha = _mm256_set1_epi32((int)0xff000000U);
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    SVE4_PIXCONV_AVX2_YUV_TO_RGB(i, r, g, b);
+    __m256i px = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cvtps_epi32(r),
+                        _mm256_slli_epi32(_mm256_cvtps_epi32(g), 8)),
+        _mm256_or_si256(_mm256_slli_epi32(_mm256_cvtps_epi32(b), 16), alpha));
+    _mm256_storeu_si256((__m256i*)&dst[i * 4], px);
+  }
+
+  sve4__pixconv_yuv_to_rgba8_scalar(&y[i], &u[i], &v[i], n - i, coeffs,
+                                    &dst[i * 4]);
+}
+
+sve4_gnu_attribute((target("avx2,f16c"))) void
+sve4__pixconv_yuv_to_rgba16f_avx2(const uint16_t* _Nonnull y,
+                                  const uint16_t* _Nonnull u,
+                                  const uint16_t* _Nonnull v, size_t n,
+                                  const sve4_pixconv_coeffs_t* _Nonnull coeffs,
+                                  uint8_t* _Nonnull dst) {
+  SVE4_PIXCONV_AVX2_CONSTANTS;
+  const __m128i alpha = _mm_set1_epi16((short)0x3c00); // 1.0
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    SVE4_PIXCONV_AVX2_YUV_TO_RGB(i, r, g, b);
+    __m128i rh = _mm256_cvtps_ph(r, _MM_FROUND_TO_NEAREST_INT);
+    __m128i gh = _mm256_cvtps_ph(g, _MM_FROUND_TO_NEAREST_INT);
+    __m128i bh = _mm256_cvtps_ph(b, _MM_FROUND_TO_NEAREST_INT);
+    __m128i rg_lo = _mm_unpacklo_epi16(rh, gh);
+    __m128i rg_hi = _mm_unpackhi_epi16(rh, gh);
+    __m128i ba_lo = _mm_unpacklo_epi16(bh, alpha);
+    __m128i ba_hi = _mm_unpackhi_epi16(bh, alpha);
+    __m128i* out = (__m128i*)&dst[i * 8];
+    _mm_storeu_si128(&out[0], _mm_unpacklo_epi32(rg_lo, ba_lo));
+    _mm_storeu_si128(&out[1], _mm_unpackhi_epi32(rg_lo, ba_lo));
+    _mm_storeu_si128(&out[2], _mm_unpacklo_epi32(rg_hi, ba_hi));
+    _mm_storeu_si128(&out[3], _mm_unpackhi_epi32(rg_hi, ba_hi));
+  }
+
+  sve4__pixconv_yuv_to_rgba16f_scalar(&y[i], &u[i], &v[i], n - i, coeffs,
+                                      &dst[i * 8]);
+}
+
+sve4_gnu_attribute((target("avx2"))) static void unpack_avx2(
+    const uint8_t* _Nonnull row, size_t x0, size_t n, size_t shift_x,
+    size_t bytes, uint32_t shift, uint16_t* _Nonnull out) {
+  const __m128i count = _mm_cvtsi32_si128((int)shift);
+  size_t i = sve4_min(x0 & shift_x, n);
+  unpack_scalar(row, x0, i, shift_x, bytes, shift, out);
+
+  // upsampling widens every sample to 32 bits and copies it to the high half
+  if (bytes == 1 && !shift_x) {
+    for (; i + 16 <= n; i += 16)
+      _mm256_storeu_si256((__m256i*)&out[i],
+                          _mm256_cvtepu8_epi16(_mm_loadu_si128(
+                              (const __m128i*)&row[x0 + i])));
+  } else if (bytes == 1) {
+    for (; i + 16 <= n; i += 16) {
+      __m256i s = _mm256_cvtepu16_epi32(_mm_cvtepu8_epi16(
+          _mm_loadl_epi64((const __m128i*)&row[(x0 + i) >> 1])));
+      _mm256_storeu_si256((__m256i*)&out[i],
+                          _mm256_or_si256(s, _mm256_slli_epi32(s, 16)));
+    }
+  } else if (!shift_x) {
+    for (; i + 16 <= n; i += 16) {
+      __m256i s = _mm256_loadu_si256((const __m256i*)&row[(x0 + i) * 2]);
+      _mm256_storeu_si256((__m256i*)&out[i], _mm256_srl_epi16(s, count));
+    }
+  } else {
+    for (; i + 16 <= n; i += 16) {
+      __m256i s = _mm256_cvtepu16_epi32(_mm_srl_epi16(
+          _mm_loadu_si128((const __m128i*)&row[x0 + i]), count));
+      _mm256_storeu_si256((__m256i*)&out[i],
+                          _mm256_or_si256(s, _mm256_slli_epi32(s, 16)));
+    }
+  }
+
+  unpack_scalar(row, x0 + i, n - i, shift_x, bytes, shift, &out[i]);
+}
+
+sve4_gnu_attribute((target("avx2"))) static void deinterleave_avx2(
+    const uint8_t* _Nonnull row, size_t x0, size_t n, size_t shift_x,
+    size_t bytes, uint32_t shift, uint16_t* _Nonnull u,
+    uint16_t* _Nonnull v) {
+  const __m128i count = _mm_cvtsi32_si128((int)shift);
+  const __m256i low_half = _mm256_set1_epi32(0xffff);
+  size_t i = sve4_min(x0 & shift_x, n);
+  deinterleave_scalar(row, x0, i, shift_x, bytes, shift, u, v);
+
+  if (bytes == 1 && !shift_x) {
+    const __m256i low_byte = _mm256_set1_epi16(0xff);
+    for (; i + 16 <= n; i += 16) {
+      __m256i s = _mm256_loadu_si256((const __m256i*)&row[(x0 + i) * 2]);
+      _mm256_storeu_si256((__m256i*)&u[i], _mm256_and_si256(s, low_byte));
+      _mm256_storeu_si256((__m256i*)&v[i], _mm256_srli_epi16(s, 8));
+    }
+  } else if (bytes == 1) {
+    const __m128i low_byte = _mm_set1_epi16(0xff);
+    for (; i + 16 <= n; i += 16) {
+      __m128i s = _mm_loadu_si128((const __m128i*)&row[x0 + i]);
+      __m256i uu = _mm256_cvtepu16_epi32(_mm_and_si128(s, low_byte));
+      __m256i vv = _mm256_cvtepu16_epi32(_mm_srli_epi16(s, 8));
+      _mm256_storeu_si256((__m256i*)&u[i],
+                          _mm256_or_si256(uu, _mm256_slli_epi32(uu, 16)));
+      _mm256_storeu_si256((__m256i*)&v[i],
+                          _mm256_or_si256(vv, _mm256_slli_epi32(vv, 16)));
+    }
+  } else if (!shift_x) {
+    for (; i + 16 <= n; i += 16) {
+      const __m256i* pairs = (const __m256i*)&row[(x0 + i) * 4];
+      __m256i a = _mm256_srl_epi16(_mm256_loadu_si256(&pairs[0]), count);
+      __m256i b = _mm256_srl_epi16(_mm256_loadu_si256(&pairs[1]), count);
+      // packing works within 128-bit lanes, the permutation restores order
+      __m256i uu = _mm256_packus_epi32(_mm256_and_si256(a, low_half),
+                                       _mm256_and_si256(b, low_half));
+      __m256i vv = _mm256_packus_epi32(_mm256_srli_epi32(a, 16),
+                                       _mm256_srli_epi32(b, 16));
+      _mm256_storeu_si256((__m256i*)&u[i], _mm256_permute4x64_epi64(uu, 0xd8));
+      _mm256_storeu_si256((__m256i*)&v[i], _mm256_permute4x64_epi64(vv, 0xd8));
+    }
+  } else {
+    for (; i + 16 <= n; i += 16) {
+      __m256i s = _mm256_srl_epi16(
+          _mm256_loadu_si256((const __m256i*)&row[(x0 + i) * 2]), count);
+      __m256i uu = _mm256_and_si256(s, low_half);
+      __m256i vv = _mm256_srli_epi32(s, 16);
+      _mm256_storeu_si256((__m256i*)&u[i],
+                          _mm256_or_si256(uu, _mm256_slli_epi32(uu, 16)));
+      _mm256_storeu_si256((__m256i*)&v[i],
+                          _mm256_or_si256(vv, _mm256_slli_epi32(vv, 16)));
+    }
+  }
+
+  deinterleave_scalar(row, x0 + i, n - i, shift_x, bytes, shift, &u[i],
+                      &v[i]);
+}
+
+sve4_gnu_attribute((target("avx2"))) static void lerp_avx2(
+    const uint16_t* _Nonnull top, const uint16_t* _Nonnull bottom,
+    uint32_t frac, size_t n, uint16_t* _Nonnull out) {
+  const __m256i top_weight = _mm256_set1_epi16((short)(FRAC_ONE - frac));
+  const __m256i bottom_weight = _mm256_set1_epi16((short)frac);
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    __m256i t = _mm256_loadu_si256((const __m256i*)&top[i]);
+    __m256i b = _mm256_loadu_si256((const __m256i*)&bottom[i]);
+    _mm256_storeu_si256((__m256i*)&out[i],
+                        _mm256_add_epi16(_mm256_mullo_epi16(t, top_weight),
+                                         _mm256_mullo_epi16(b, bottom_weight)));
+  }
+  lerp_scalar(&top[i], &bottom[i], frac, n - i, &out[i]);
+}
+
+// every gathered lane holds in[j] and in[j + 1]
+sve4_gnu_attribute((target("avx2"))) static void filter_avx2(
+    const uint16_t* _Nonnull in, size_t base, const uint32_t* _Nonnull index,
+    const uint32_t* _Nonnull weights, size_t n, uint16_t* _Nonnull out) {
+  const __m256i round = _mm256_set1_epi32(FRAC_ONE / 2);
+  const __m256i first = _mm256_set1_epi32((int)base);
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i j = _mm256_sub_epi32(
+        _mm256_loadu_si256((const __m256i*)&index[i]), first);
+    __m256i sum = _mm256_madd_epi16(
+        _mm256_i32gather_epi32((const int*)(const void*)in, j, 2),
+        _mm256_loadu_si256((const __m256i*)&weights[i]));
+    sum = _mm256_srli_epi32(_mm256_add_epi32(sum, round),
+                            SVE4_PIXCONV_FRAC_BITS);
+    _mm_storeu_si128((__m128i*)&out[i],
+                     _mm_packus_epi32(_mm256_castsi256_si128(sum),
+                                      _mm256_extracti128_si256(sum, 1)));
+  }
+  filter_scalar(in, base, &index[i], &weights[i], n - i, &out[i]);
+}
+
+const sve4_pixconv_loaders_t sve4__pixconv_loaders_avx2 = {
+    .unpack = unpack_avx2,
+    .deinterleave = deinterleave_avx2,
+    .lerp = lerp_avx2,
+    .filter = filter_avx2,
+};
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+#endif
+
+#if SVE4_PIXCONV_HAVE_NEON
+// NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+typedef struct {
+  float32x4_t r, g, b;
+} rgb_x4_t;
+
+static inline rgb_x4_t neon_yuv_to_rgb(const sve4_pixconv_coeffs_t* _Nonnull c,
+                                       uint16x4_t y, uint16x4_t u,
+                                       uint16x4_t v) {
+  const float32x4_t zero = vdupq_n_f32(0.0F);
+  const float32x4_t max = vdupq_n_f32(c->max);
+  float32x4_t yy = vmulq_n_f32(
+      vsubq_f32(vcvtq_f32_u32(vmovl_u16(y)), vdupq_n_f32(c->y_offset)),
+      c->y_scale);
+  float32x4_t uu =
+      vsubq_f32(vcvtq_f32_u32(vmovl_u16(u)), vdupq_n_f32(c->c_offset));
+  float32x4_t vv =
+      vsubq_f32(vcvtq_f32_u32(vmovl_u16(v)), vdupq_n_f32(c->c_offset));
+  rgb_x4_t rgb = {
+      .r = vaddq_f32(yy, vmulq_n_f32(vv, c->r_v)),
+      .g = vaddq_f32(vaddq_f32(yy, vmulq_n_f32(uu, c->g_u)),
+                     vmulq_n_f32(vv, c->g_v)),
+      .b = vaddq_f32(yy, vmulq_n_f32(uu, c->b_u)),
+  };
+  rgb.r = vminq_f32(vmaxq_f32(rgb.r, zero), max);
+  rgb.g = vminq_f32(vmaxq_f32(rgb.g, zero), max);
+  rgb.b = vminq_f32(vmaxq_f32(rgb.b, zero), max);
+  return rgb;
+}
+
+static inline uint8x8_t neon_narrow_u8(float32x4_t lo, float32x4_t hi) {
+  return vmovn_u16(vcombine_u16(vmovn_u32(vcvtnq_u32_f32(lo)),
+                                vmovn_u32(vcvtnq_u32_f32(hi))));
+}
+
+static inline uint16x8_t neon_narrow_f16(float32x4_t lo, float32x4_t hi) {
+  return vcombine_u16(vreinterpret_u16_f16(vcvt_f16_f32(lo)),
+                      vreinterpret_u16_f16(vcvt_f16_f32(hi)));
+}
+
+void sve4__pixconv_yuv_to_rgba8_neon(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint16x8_t y8 = vld1q_u16(&y[i]);
+    uint16x8_t u8 = vld1q_u16(&u[i]);
+    uint16x8_t v8 = vld1q_u16(&v[i]);
+    rgb_x4_t lo = neon_yuv_to_rgb(coeffs, vget_low_u16(y8), vget_low_u16(u8),
+                                  vget_low_u16(v8));
+    rgb_x4_t hi = neon_yuv_to_rgb(coeffs, vget_high_u16(y8),
+                                  vget_high_u16(u8), vget_high_u16(v8));
+    uint8x8x4_t px = {{
+        neon_narrow_u8(lo.r, hi.r),
+        neon_narrow_u8(lo.g, hi.g),
+        neon_narrow_u8(lo.b, hi.b),
+        vdup_n_u8(0xff),
+    }};
+    vst4_u8(&dst[i * 4], px);
+  }
+
+  sve4__pixconv_yuv_to_rgba8_scalar(&y[i], &u[i], &v[i], n - i, coeffs,
+                                    &dst[i * 4]);
+}
+
+void sve4__pixconv_yuv_to_rgba16f_neon(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint16x8_t y8 = vld1q_u16(&y[i]);
+    uint16x8_t u8 = vld1q_u16(&u[i]);
+    uint16x8_t v8 = vld1q_u16(&v[i]);
+    rgb_x4_t lo = neon_yuv_to_rgb(coeffs, vget_low_u16(y8), vget_low_u16(u8),
+                                  vget_low_u16(v8));
+    rgb_x4_t hi = neon_yuv_to_rgb(coeffs, vget_high_u16(y8),
+                                  vget_high_u16(u8), vget_high_u16(v8));
+    uint16x8x4_t px = {{
+        neon_narrow_f16(lo.r, hi.r),
+        neon_narrow_f16(lo.g, hi.g),
+        neon_narrow_f16(lo.b, hi.b),
+        vdupq_n_u16(0x3c00), // 1.0
+    }};
+    vst4q_u16((uint16_t*)(void*)&dst[i * 8], px);
+  }
+
+  sve4__pixconv_yuv_to_rgba16f_scalar(&y[i], &u[i], &v[i], n - i, coeffs,
+                                      &dst[i * 8]);
+}
+
+// 16-bit rows may be misaligned, they are loaded as bytes
+static inline uint16x8_t neon_load_u16(const uint8_t* _Nonnull ptr) {
+  return vreinterpretq_u16_u8(vld1q_u8(ptr));
+}
+
+static void unpack_neon(const uint8_t* _Nonnull row, size_t x0, size_t n,
+                        size_t shift_x, size_t bytes, uint32_t shift,
+                        uint16_t* _Nonnull out) {
+  const int16x8_t count = vdupq_n_s16((int16_t)-(int32_t)shift);
+  size_t i = sve4_min(x0 & shift_x, n);
+  unpack_scalar(row, x0, i, shift_x, bytes, shift, out);
+
+  // storing a sample as both halves of a pair repeats it
+  if (bytes == 1 && !shift_x) {
+    for (; i + 16 <= n; i += 16) {
+      uint8x16_t s = vld1q_u8(&row[x0 + i]);
+      vst1q_u16(&out[i], vmovl_u8(vget_low_u8(s)));
+      vst1q_u16(&out[i + 8], vmovl_u8(vget_high_u8(s)));
+    }
+  } else if (bytes == 1) {
+    for (; i + 16 <= n; i += 16) {
+      uint16x8_t s = vmovl_u8(vld1_u8(&row[(x0 + i) >> 1]));
+      vst2q_u16(&out[i], (uint16x8x2_t){{s, s}});
+    }
+  } else if (!shift_x) {
+    for (; i + 8 <= n; i += 8)
+      vst1q_u16(&out[i], vshlq_u16(neon_load_u16(&row[(x0 + i) * 2]), count));
+  } else {
+    for (; i + 16 <= n; i += 16) {
+      uint16x8_t s = vshlq_u16(neon_load_u16(&row[x0 + i]), count);
+      vst2q_u16(&out[i], (uint16x8x2_t){{s, s}});
+    }
+  }
+
+  unpack_scalar(row, x0 + i, n - i, shift_x, bytes, shift, &out[i]);
+}
+
+static void deinterleave_neon(const uint8_t* _Nonnull row, size_t x0,
+                              size_t n, size_t shift_x, size_t bytes,
+                              uint32_t shift, uint16_t* _Nonnull u,
+                              uint16_t* _Nonnull v) {
+  const int16x8_t count = vdupq_n_s16((int16_t)-(int32_t)shift);
+  size_t i = sve4_min(x0 & shift_x, n);
+  deinterleave_scalar(row, x0, i, shift_x, bytes, shift, u, v);
+
+  if (bytes == 1 && !shift_x) {
+    for (; i + 16 <= n; i += 16) {
+      uint8x16x2_t s = vld2q_u8(&row[(x0 + i) * 2]);
+      vst1q_u16(&u[i], vmovl_u8(vget_low_u8(s.val[0])));
+      vst1q_u16(&u[i + 8], vmovl_u8(vget_high_u8(s.val[0])));
+      vst1q_u16(&v[i], vmovl_u8(vget_low_u8(s.val[1])));
+      vst1q_u16(&v[i + 8], vmovl_u8(vget_high_u8(s.val[1])));
+    }
+  } else if (bytes == 1) {
+    for (; i + 16 <= n; i += 16) {
+      uint8x8x2_t s = vld2_u8(&row[x0 + i]);
+      uint16x8_t uu = vmovl_u8(s.val[0]);
+      uint16x8_t vv = vmovl_u8(s.val[1]);
+      vst2q_u16(&u[i], (uint16x8x2_t){{uu, uu}});
+      vst2q_u16(&v[i], (uint16x8x2_t){{vv, vv}});
+    }
+  } else if (!shift_x) {
+    for (; i + 8 <= n; i += 8) {
+      const uint8_t* pairs = &row[(x0 + i) * 4];
+      uint16x8x2_t s =
+          vuzpq_u16(neon_load_u16(pairs), neon_load_u16(&pairs[16]));
+      vst1q_u16(&u[i], vshlq_u16(s.val[0], count));
+      vst1q_u16(&v[i], vshlq_u16(s.val[1], count));
+    }
+  } else {
+    for (; i + 16 <= n; i += 16) {
+      const uint8_t* pairs = &row[(x0 + i) * 2];
+      uint16x8x2_t s =
+          vuzpq_u16(neon_load_u16(pairs), neon_load_u16(&pairs[16]));
+      uint16x8_t uu = vshlq_u16(s.val[0], count);
+      uint16x8_t vv = vshlq_u16(s.val[1], count);
+      vst2q_u16(&u[i], (uint16x8x2_t){{uu, uu}});
+      vst2q_u16(&v[i], (uint16x8x2_t){{vv, vv}});
+    }
+  }
+
+  deinterleave_scalar(row, x0 + i, n - i, shift_x, bytes, shift, &u[i],
+                      &v[i]);
+}
+
+static void lerp_neon(const uint16_t* _Nonnull top,
+                      const uint16_t* _Nonnull bottom, uint32_t frac, size_t n,
+                      uint16_t* _Nonnull out) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    uint16x8_t t = vmulq_n_u16(vld1q_u16(&top[i]), (uint16_t)(FRAC_ONE - frac));
+    vst1q_u16(&out[i], vmlaq_n_u16(t, vld1q_u16(&bottom[i]), (uint16_t)frac));
+  }
+  lerp_scalar(&top[i], &bottom[i], frac, n - i, &out[i]);
+}
+
+// loads in[j] and in[j + 1] into the low and high half of each lane
+static inline uint16x8_t neon_load_pairs(const uint16_t* _Nonnull in,
+                                         size_t base,
+                                         const uint32_t* _Nonnull index) {
+  uint32_t pairs[4];
+  for (size_t k = 0; k < 4; ++k)
+    memcpy(&pairs[k], &in[index[k] - base], sizeof pairs[k]);
+  return vreinterpretq_u16_u32(vld1q_u32(pairs));
+}
+
+static void filter_neon(const uint16_t* _Nonnull in, size_t base,
+                        const uint32_t* _Nonnull index,
+                        const uint32_t* _Nonnull weights, size_t n,
+                        uint16_t* _Nonnull out) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    uint16x8_t pairs = neon_load_pairs(in, base, &index[i]);
+    uint16x8_t w = vreinterpretq_u16_u32(vld1q_u32(&weights[i]));
+    // adds the two products of every pair
+    uint32x4_t sum =
+        vpaddq_u32(vmull_u16(vget_low_u16(pairs), vget_low_u16(w)),
+                   vmull_high_u16(pairs, w));
+    vst1_u16(&out[i], vmovn_u32(vrshrq_n_u32(sum, SVE4_PIXCONV_FRAC_BITS)));
+  }
+  filter_scalar(in, base, &index[i], &weights[i], n - i, &out[i]);
+}
+
+const sve4_pixconv_loaders_t sve4__pixconv_loaders_neon = {
+    .unpack = unpack_neon,
+    .deinterleave = deinterleave_neon,
+    .lerp = lerp_neon,
+    .filter = filter_neon,
+};
+// NOLINTEND(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+#endif
@@ -0,0 +1,118 @@
+#pragma once
+
+// internal header of pixconv.c, not installed
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "defines.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) &&                              \
+    (defined(__x86_64__) || defined(__i386__))
+#define SVE4_PIXCONV_HAVE_X86 1
+#else
+#define SVE4_PIXCONV_HAVE_X86 0
+#endif
+
+#if defined(__aarch64__)
+#define SVE4_PIXCONV_HAVE_NEON 1
+#else
+#define SVE4_PIXCONV_HAVE_NEON 0
+#endif
+
+// the kernels compute, for every pixel,
+//   y' = (y - y_offset) * y_scale, u' = u - c_offset, v' = v - c_offset
+//   r = y' + r_v * v', g = y' + g_u * u' + g_v * v', b = y' + b_u * u'
+// clamped to [0, max], alpha is always max.
+// scales already include the normalization to [0, max].
+typedef struct {
+  float y_offset, c_offset, y_scale;
+  float r_v, g_u, g_v, b_u;
+  float max;
+} sve4_pixconv_coeffs_t;
+
+// y, u, v hold n unpacked samples each (chroma already upsampled), dst is
+// the (possibly unaligned) output position of the first pixel
+typedef void (*sve4_pixconv_kernel_t)(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+
+void sve4__pixconv_yuv_to_rgba8_scalar(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+void sve4__pixconv_yuv_to_rgba16f_scalar(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+
+#if SVE4_PIXCONV_HAVE_X86
+void sve4__pixconv_yuv_to_rgba8_sse41(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+// SSE4.1 has no half-float conversion, it is done with integer operations
+void sve4__pixconv_yuv_to_rgba16f_sse41(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+void sve4__pixconv_yuv_to_rgba8_avx2(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+void sve4__pixconv_yuv_to_rgba16f_avx2(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+#endif
+
+#if SVE4_PIXCONV_HAVE_NEON
+void sve4__pixconv_yuv_to_rgba8_neon(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+void sve4__pixconv_yuv_to_rgba16f_neon(
+    const uint16_t* _Nonnull y, const uint16_t* _Nonnull u,
+    const uint16_t* _Nonnull v, size_t n,
+    const sve4_pixconv_coeffs_t* _Nonnull coeffs, uint8_t* _Nonnull dst);
+#endif
+
+// bilinear filter weights have SVE4_PIXCONV_FRAC_BITS bits
+enum { SVE4_PIXCONV_FRAC_BITS = 4 };
+
+// samples are 8-bit (bytes == 1) or little-endian 16-bit, shifted right by
+// shift (MSB-aligned formats). every sample covers 1 << shift_x pixels,
+// shift_x is 0 or 1. rows are only read up to the last sample used.
+typedef struct {
+  // loads n samples starting at pixel x0 of a plane row
+  void (*_Nonnull unpack)(const uint8_t* _Nonnull row, size_t x0, size_t n,
+                          size_t shift_x, size_t bytes, uint32_t shift,
+                          uint16_t* _Nonnull out);
+  // like unpack, for a row of interleaved U and V samples (NV12, P010)
+  void (*_Nonnull deinterleave)(const uint8_t* _Nonnull row, size_t x0,
+                                size_t n, size_t shift_x, size_t bytes,
+                                uint32_t shift, uint16_t* _Nonnull u,
+                                uint16_t* _Nonnull v);
+  // out[i] = top[i] * (FRAC_ONE - frac) + bottom[i] * frac, the result must
+  // fit in 15 bits
+  void (*_Nonnull lerp)(const uint16_t* _Nonnull top,
+                        const uint16_t* _Nonnull bottom, uint32_t frac,
+                        size_t n, uint16_t* _Nonnull out);
+  // with j = index[i] - base and weights[i] = (frac << 16) | (FRAC_ONE -
+  // frac), out[i] = (in[j] * (FRAC_ONE - frac) + in[j + 1] * frac +
+  // FRAC_ONE / 2) >> FRAC_BITS. in[j + 1] is read even if frac is 0.
+  void (*_Nonnull filter)(const uint16_t* _Nonnull in, size_t base,
+                          const uint32_t* _Nonnull index,
+                          const uint32_t* _Nonnull weights, size_t n,
+                          uint16_t* _Nonnull out);
+} sve4_pixconv_loaders_t;
+
+extern const sve4_pixconv_loaders_t sve4__pixconv_loaders_scalar;
+#if SVE4_PIXCONV_HAVE_X86
+extern const sve4_pixconv_loaders_t sve4__pixconv_loaders_sse41;
+extern const sve4_pixconv_loaders_t sve4__pixconv_loaders_avx2;
+#endif
+#if SVE4_PIXCONV_HAVE_NEON
+extern const sve4_pixconv_loaders_t sve4__pixconv_loaders_neon;
+#endif
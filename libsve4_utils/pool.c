@@ -0,0 +1,457 @@
+#include "pool.h"
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "defines.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+// slabs are aligned to their size, so the header of the slab containing any
+// pointer is found by masking off the low bits
+#define SLAB_SIZE ((size_t)1 << 16)
+// slabs are carved out of chunks of this many slabs, so aligning them wastes
+// at most one slab per chunk
+#define CHUNK_SLABS 16
+// 16-byte steps up to 128, then four classes per power of two up to 16384
+#define NUM_SIZE_CLASSES 36
+#define NUM_LINEAR_CLASSES 8
+#define LARGE_CLASS SIZE_MAX
+// roughly how many bytes move between a thread cache and the shared lists at
+// once
+#define BATCH_BYTES 8192
+#define MIN_BATCH 4
+#define MAX_BATCH 64
+
+typedef struct free_block_t {
+  struct free_block_t* _Nullable next;
+} free_block_t;
+
+// header of slabs and large blocks
+typedef struct slab_t {
+  size_t size_class;
+  // block size of the size class, or the usable size of large blocks
+  size_t size;
+} slab_t;
+
+typedef struct {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_t mutex;
+  free_block_t* _Nullable free_list;
+  // unused tail of the newest slab
+  char* _Nullable bump;
+  char* _Nullable bump_end;
+} size_class_t;
+
+// start of every chunk allocated from the backing allocator
+typedef struct chunk_t {
+  struct chunk_t* _Nullable next;
+} chunk_t;
+
+typedef struct {
+  free_block_t* _Nullable head;
+  size_t count;
+} free_list_t;
+
+struct pool_t;
+
+typedef struct thread_cache_t {
+  struct pool_t* _Nonnull pool;
+  struct thread_cache_t* _Nullable prev;
+  struct thread_cache_t* _Nullable next;
+  free_list_t lists[NUM_SIZE_CLASSES];
+} thread_cache_t;
+
+typedef struct pool_t {
+  sve4_allocator_t* _Nullable backing;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  tss_t cache_key;
+  // guards caches
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_t caches_mutex;
+  thread_cache_t* _Nullable caches;
+  // guards chunks and the slabs left in the newest one
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_t chunks_mutex;
+  chunk_t* _Nullable chunks;
+  char* _Nullable next_slab;
+  size_t slabs_left;
+  size_class_t classes[NUM_SIZE_CLASSES];
+} pool_t;
+
+static size_t slab_header_size(void) {
+  return sve4_align_up(sizeof(slab_t), SVE4_POOL_MAX_ALIGN);
+}
+
+static slab_t* _Nonnull slab_of(void* _Nonnull ptr) {
+  return (slab_t*)((uintptr_t)ptr & ~(uintptr_t)(SLAB_SIZE - 1));
+}
+
+static size_t class_size(size_t index) {
+  // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+  if (index < NUM_LINEAR_CLASSES)
+    return (index + 1) * 16;
+  size_t group = (index - NUM_LINEAR_CLASSES) / 4;
+  size_t step = (size_t)32 << group;
+  return ((size_t)128 << group) + ((index - NUM_LINEAR_CLASSES) % 4 + 1) * step;
+  // NOLINTEND(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+}
+
+static size_t size_class_index(size_t size, size_t alignment) {
+  size = sve4_align_up(size ? size : 1, alignment);
+  size_t index = 0;
+  // NOLINTBEGIN(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+  if (size <= 128) {
+    index = (size + 15) / 16 - 1;
+  } else {
+    size_t group = 0;
+    while (size > (size_t)256 << group)
+      ++group;
+    size_t step = (size_t)32 << group;
+    index = NUM_LINEAR_CLASSES + group * 4 +
+            (size - ((size_t)128 << group) + step - 1) / step - 1;
+  }
+  // NOLINTEND(cppcoreguidelines-avoid-magic-numbers,readability-magic-numbers)
+
+  // blocks are laid out back to back from an SVE4_POOL_MAX_ALIGN aligned
+  // offset, so a class is suitably aligned iff its size is a multiple of the
+  // alignment. this terminates since SVE4_POOL_MAX_SIZE is such a multiple.
+  while (class_size(index) % alignment != 0)
+    ++index;
+  return index;
+}
+
+// hands out a SLAB_SIZE aligned slab. a single aligned allocation per slab
+// could cost the backing allocator up to a slab of padding each time, so
+// chunks are allocated unaligned and slabs carved out of them.
+static slab_t* _Nullable new_slab(pool_t* _Nonnull pool) {
+  slab_t* slab = NULL;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&pool->chunks_mutex);
+  if (pool->slabs_left == 0) {
+    chunk_t* chunk = sve4_malloc(
+        pool->backing, sizeof(chunk_t) + (CHUNK_SLABS + 1) * SLAB_SIZE);
+    if (!chunk)
+      goto unlock;
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    // leaves room for CHUNK_SLABS slabs after the header wherever the chunk
+    // starts
+    pool->next_slab = (char*)sve4_align_up(
+        (uintptr_t)chunk + sizeof(chunk_t), SLAB_SIZE);
+    pool->slabs_left = CHUNK_SLABS;
+  }
+  slab = (slab_t*)(void*)pool->next_slab;
+  pool->next_slab += SLAB_SIZE;
+  --pool->slabs_left;
+unlock:
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&pool->chunks_mutex);
+  return slab;
+}
+
+static size_t batch_size(size_t index) {
+  size_t batch = BATCH_BYTES / class_size(index);
+  return sve4_max(sve4_min(batch, (size_t)MAX_BATCH), (size_t)MIN_BATCH);
+}
+
+// moves up to count blocks of the given class from the shared lists (or fresh
+// slabs) to the front of *list, returns how many were moved
+static size_t take_blocks(pool_t* _Nonnull pool, size_t index,
+                          free_block_t* _Nullable* _Nonnull list,
+                          size_t count) {
+  size_class_t* cls = &pool->classes[index];
+  size_t size = class_size(index);
+  size_t taken = 0;
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&cls->mutex);
+  for (; taken < count && cls->free_list; ++taken) {
+    free_block_t* block = cls->free_list;
+    cls->free_list = block->next;
+    block->next = *list;
+    *list = block;
+  }
+
+  for (; taken < count; ++taken) {
+    if (!cls->bump || (size_t)(cls->bump_end - cls->bump) < size) {
+      slab_t* slab = new_slab(pool);
+      if (!slab)
+        break;
+      slab->size_class = index;
+      slab->size = size;
+      cls->bump = (char*)slab + slab_header_size();
+      cls->bump_end = (char*)slab + SLAB_SIZE;
+    }
+    free_block_t* block = (free_block_t*)cls->bump;
+    cls->bump += size;
+    block->next = *list;
+    *list = block;
+  }
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&cls->mutex);
+  return taken;
+}
+
+// prepends the chain first..last to the shared list of the given class
+static void give_blocks(pool_t* _Nonnull pool, size_t index,
+                        free_block_t* _Nonnull first,
+                        free_block_t* _Nonnull last) {
+  size_class_t* cls = &pool->classes[index];
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&cls->mutex);
+  last->next = cls->free_list;
+  cls->free_list = first;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&cls->mutex);
+}
+
+// returns the first count blocks of a thread cache list to the shared list
+static void flush_blocks(pool_t* _Nonnull pool, size_t index,
+                         free_list_t* _Nonnull list, size_t count) {
+  assert(count > 0 && count <= list->count);
+  free_block_t* first = list->head;
+  free_block_t* last = first;
+  for (size_t i = 1; i < count; ++i)
+    last = last->next;
+  list->head = last->next;
+  list->count -= count;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  give_blocks(pool, index, first, last);
+#pragma GCC diagnostic pop
+}
+
+static void cache_destructor(void* _Nullable data) {
+  thread_cache_t* cache = data;
+  if (!cache)
+    return;
+  pool_t* pool = cache->pool;
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i)
+    if (cache->lists[i].count > 0)
+      flush_blocks(pool, i, &cache->lists[i], cache->lists[i].count);
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&pool->caches_mutex);
+  if (cache->prev)
+    cache->prev->next = cache->next;
+  else
+    pool->caches = cache->next;
+  if (cache->next)
+    cache->next->prev = cache->prev;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&pool->caches_mutex);
+  sve4_free(pool->backing, cache);
+}
+
+static thread_cache_t* _Nullable get_cache(pool_t* _Nonnull pool) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  thread_cache_t* cache = tss_get(pool->cache_key);
+  if (sve4_likely(cache))
+    return cache;
+
+  cache = sve4_calloc(pool->backing, sizeof(thread_cache_t));
+  if (!cache)
+    return NULL;
+  cache->pool = pool;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  if (tss_set(pool->cache_key, cache) != thrd_success) {
+    sve4_free(pool->backing, cache);
+    return NULL;
+  }
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&pool->caches_mutex);
+  cache->next = pool->caches;
+  if (pool->caches)
+    pool->caches->prev = cache;
+  pool->caches = cache;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&pool->caches_mutex);
+  return cache;
+}
+
+static void* _Nullable large_alloc(pool_t* _Nonnull pool, size_t size,
+                                   size_t alignment) {
+  // the data must start inside the first SLAB_SIZE bytes for slab_of()
+  if (alignment >= SLAB_SIZE)
+    return NULL;
+  size_t offset = sve4_align_up(sizeof(slab_t), alignment);
+  if (size > SIZE_MAX - offset - SLAB_SIZE)
+    return NULL;
+  // no padding here, the backing allocator rounds the size up if it must
+  slab_t* slab = sve4_aligned_alloc(pool->backing, offset + size, SLAB_SIZE);
+  if (!slab)
+    return NULL;
+  slab->size_class = LARGE_CLASS;
+  slab->size = size;
+  return (char*)slab + offset;
+}
+
+static void* _Nullable pool_alloc(sve4_allocator_t* _Nonnull self, size_t size,
+                                  size_t alignment) {
+  pool_t* pool = self->state.p1;
+  if (size > SVE4_POOL_MAX_SIZE || alignment > SVE4_POOL_MAX_ALIGN)
+    return large_alloc(pool, size, alignment);
+
+  size_t index = size_class_index(size, alignment);
+  thread_cache_t* cache = get_cache(pool);
+  if (sve4_unlikely(!cache)) {
+    free_block_t* block = NULL;
+    take_blocks(pool, index, &block, 1);
+    return block;
+  }
+
+  free_list_t* list = &cache->lists[index];
+  if (sve4_unlikely(!list->head))
+    list->count = take_blocks(pool, index, &list->head, batch_size(index));
+  free_block_t* block = list->head;
+  if (!block)
+    return NULL;
+  list->head = block->next;
+  --list->count;
+  return block;
+}
+
+static void pool_free(sve4_allocator_t* _Nonnull self, void* _Nullable ptr,
+                      size_t alignment) {
+  (void)alignment;
+  if (!ptr)
+    return;
+  pool_t* pool = self->state.p1;
+  slab_t* slab = slab_of(ptr);
+  if (slab->size_class == LARGE_CLASS) {
+    sve4_aligned_free(pool->backing, slab, SLAB_SIZE);
+    return;
+  }
+
+  size_t index = slab->size_class;
+  free_block_t* block = ptr;
+  thread_cache_t* cache = get_cache(pool);
+  if (sve4_unlikely(!cache)) {
+    give_blocks(pool, index, block, block);
+    return;
+  }
+
+  free_list_t* list = &cache->lists[index];
+  block->next = list->head;
+  list->head = block;
+  // keep a batch around so alternating alloc/free does not bounce blocks
+  size_t batch = batch_size(index);
+  if (++list->count > 2 * batch)
+    flush_blocks(pool, index, list, batch);
+}
+
+static void* _Nullable pool_grow(sve4_allocator_t* _Nonnull self,
+                                 void* _Nullable ptr, size_t old_size,
+                                 size_t new_size, size_t alignment) {
+  if (!ptr)
+    return pool_alloc(self, new_size, alignment);
+
+  slab_t* slab = slab_of(ptr);
+  if (new_size <= slab->size && (uintptr_t)ptr % alignment == 0)
+    return ptr;
+
+  void* new_ptr = pool_alloc(self, new_size, alignment);
+  if (new_ptr) {
+    memcpy(new_ptr, ptr, sve4_min(old_size, new_size));
+    pool_free(self, ptr, alignment);
+  }
+  return new_ptr;
+}
+
+bool sve4_allocator_pool_init(sve4_allocator_t* _Nonnull allocator,
+                              sve4_allocator_t* _Nullable backing) {
+  pool_t* pool = sve4_calloc(backing, sizeof(pool_t));
+  if (!pool)
+    return false;
+  pool->backing = backing;
+
+  size_t num_mutexes = 0;
+  // NOLINTBEGIN(misc-include-cleaner)
+  if (mtx_init(&pool->caches_mutex, mtx_plain) != thrd_success)
+    goto fail_caches_mutex;
+  if (mtx_init(&pool->chunks_mutex, mtx_plain) != thrd_success)
+    goto fail_chunks_mutex;
+  for (; num_mutexes < NUM_SIZE_CLASSES; ++num_mutexes)
+    if (mtx_init(&pool->classes[num_mutexes].mutex, mtx_plain) != thrd_success)
+      goto fail_class_mutex;
+  if (tss_create(&pool->cache_key, cache_destructor) != thrd_success)
+    goto fail_class_mutex;
+  // NOLINTEND(misc-include-cleaner)
+
+  *allocator = (sve4_allocator_t){
+      .state = {pool, NULL},
+      .alloc = pool_alloc,
+      .grow = pool_grow,
+      .free = pool_free,
+  };
+  sve4_allocator_impl_missing(allocator);
+  return true;
+
+fail_class_mutex:
+  while (num_mutexes > 0)
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_destroy(&pool->classes[--num_mutexes].mutex);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&pool->chunks_mutex);
+fail_chunks_mutex:
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&pool->caches_mutex);
+fail_caches_mutex:
+  sve4_free(backing, pool);
+  return false;
+}
+
+void sve4_allocator_pool_destroy(sve4_allocator_t* _Nonnull allocator) {
+  pool_t* pool = allocator->state.p1;
+  if (!pool)
+    return;
+
+  // deleting the key does not run destructors, and threads exiting later no
+  // longer see their cache, so every cache is freed here
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  tss_delete(pool->cache_key);
+  for (thread_cache_t* cache = pool->caches; cache;) {
+    thread_cache_t* next = cache->next;
+    sve4_free(pool->backing, cache);
+    cache = next;
+  }
+
+  for (chunk_t* chunk = pool->chunks; chunk;) {
+    chunk_t* next = chunk->next;
+    sve4_free(pool->backing, chunk);
+    chunk = next;
+  }
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; ++i)
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_destroy(&pool->classes[i].mutex);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&pool->chunks_mutex);
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&pool->caches_mutex);
+  sve4_free(pool->backing, pool);
+  allocator->state.p1 = NULL;
+}
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static sve4_allocator_t shared_pool;
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static bool shared_pool_valid = false;
+
+static void shared_pool_init(void) {
+  shared_pool_valid = sve4_allocator_pool_init(&shared_pool, NULL);
+}
+
+sve4_allocator_t* _Nullable sve4_allocator_pool_shared(void) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  static once_flag once = ONCE_FLAG_INIT;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  call_once(&once, shared_pool_init);
+  return shared_pool_valid ? &shared_pool : NULL;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include "sve4_utils_export.h"
+
+#include "allocator.h"
+#include "defines.h"
+
+// POOL ALLOCATOR
+//
+// Small objects (up to SVE4_POOL_MAX_SIZE bytes, aligned to at most
+// SVE4_POOL_MAX_ALIGN) are rounded up to one of a fixed set of size classes
+// and carved out of 64 KiB slabs, which are carved 16 at a time out of one
+// allocation from the backing allocator. Every thread keeps its own free list
+// per size class and exchanges blocks with the shared lists in batches, so
+// most allocations and frees are a list push/pop without any locking.
+//
+// Larger requests get a dedicated, 64 KiB aligned block from the backing
+// allocator. The libc backing rounds such blocks up to a multiple of 64 KiB,
+// which wastes up to 4x the memory of a request just over SVE4_POOL_MAX_SIZE
+// (less as requests grow), so the pool is a poor fit for buffers.
+// Slabs are only given back to the backing allocator when the pool is
+// destroyed.
+
+#define SVE4_POOL_MAX_SIZE 16384
+#define SVE4_POOL_MAX_ALIGN 64
+
+// initializes *allocator as a pool allocator. backing (NULL for libc) must
+// support 64 KiB aligned allocations for large objects. the resulting
+// allocator may be copied and is safe to use from multiple threads.
+SVE4_UTILS_EXPORT
+bool sve4_allocator_pool_init(sve4_allocator_t* _Nonnull allocator,
+                              sve4_allocator_t* _Nullable backing);
+
+// frees every slab of the pool, all small objects become invalid. large
+// objects must be freed before.
+SVE4_UTILS_EXPORT
+void sve4_allocator_pool_destroy(sve4_allocator_t* _Nonnull allocator);
+
+// process-wide pool backed by libc, created on first use and never destroyed.
+// meant for the small objects created per packet or frame, such as buffer
+// headers. returns NULL (the libc allocator) if the pool cannot be created.
+SVE4_UTILS_EXPORT
+sve4_allocator_t* _Nullable sve4_allocator_pool_shared(void);
@@ -0,0 +1,319 @@
+#include "queue.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+#include "allocator.h"
+#include "defines.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#define CACHE_LINE 64
+// failed attempts (each followed by a yield) before going to sleep
+#define SPIN_TRIES 32
+
+struct sve4_queue_t {
+  // producers and consumers each get their own cache line
+  alignas(CACHE_LINE) atomic_size_t enqueue_pos;
+  alignas(CACHE_LINE) atomic_size_t dequeue_pos;
+
+  alignas(CACHE_LINE) sve4_allocator_t* _Nullable allocator;
+  size_t mask;
+  size_t elem_size;
+  // every cell is a sequence number followed by the element
+  size_t cell_size;
+  char* _Nonnull cells;
+  atomic_bool closed;
+
+  // threads sleeping in sve4_queue_push()/sve4_queue_pop(), modified with
+  // the mutex held
+  atomic_size_t push_waiters, pop_waiters;
+  // only protects sleeping, the queue itself does not need it
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_t mutex;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_t push_condvar, pop_condvar;
+};
+
+static atomic_size_t* _Nonnull cell_sequence(const sve4_queue_t* _Nonnull queue,
+                                             size_t pos) {
+  return (atomic_size_t*)(void*)(queue->cells +
+                                 (pos & queue->mask) * queue->cell_size);
+}
+
+static void* _Nonnull cell_data(const sve4_queue_t* _Nonnull queue,
+                                size_t pos) {
+  return queue->cells + (pos & queue->mask) * queue->cell_size +
+         SVE4_MAX_ALIGN;
+}
+
+sve4_queue_t* _Nullable sve4_queue_create(sve4_allocator_t* _Nullable allocator,
+                                          size_t capacity, size_t elem_size) {
+  // the ring needs at least two cells to tell full and empty apart
+  size_t num_cells = 2;
+  while (num_cells < capacity) {
+    if (num_cells > SIZE_MAX / 2)
+      return NULL;
+    num_cells *= 2;
+  }
+
+  if (elem_size > SIZE_MAX / 2)
+    return NULL;
+  size_t cell_size = SVE4_MAX_ALIGN + sve4_align_up(elem_size, SVE4_MAX_ALIGN);
+  size_t offset = sve4_align_up(sizeof(sve4_queue_t), CACHE_LINE);
+  if (num_cells > (SIZE_MAX - offset) / cell_size)
+    return NULL;
+
+  char* mem = sve4_aligned_calloc(allocator, offset + num_cells * cell_size,
+                                  CACHE_LINE);
+  if (!mem)
+    return NULL;
+  sve4_queue_t* queue = (sve4_queue_t*)(void*)mem;
+  queue->allocator = allocator;
+  queue->mask = num_cells - 1;
+  queue->elem_size = elem_size;
+  queue->cell_size = cell_size;
+  queue->cells = mem + offset;
+  atomic_init(&queue->enqueue_pos, 0);
+  atomic_init(&queue->dequeue_pos, 0);
+  atomic_init(&queue->closed, false);
+  atomic_init(&queue->push_waiters, 0);
+  atomic_init(&queue->pop_waiters, 0);
+  for (size_t i = 0; i < num_cells; ++i)
+    atomic_init(cell_sequence(queue, i), i);
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  if (mtx_init(&queue->mutex, mtx_plain) != thrd_success)
+    goto fail_mutex;
+  if (cnd_init(&queue->push_condvar) != thrd_success)
+    goto fail_push_condvar;
+  if (cnd_init(&queue->pop_condvar) != thrd_success)
+    goto fail_pop_condvar;
+  // NOLINTEND(misc-include-cleaner)
+  return queue;
+
+fail_pop_condvar:
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_destroy(&queue->push_condvar);
+fail_push_condvar:
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&queue->mutex);
+fail_mutex:
+  sve4_aligned_free(allocator, mem, CACHE_LINE);
+  return NULL;
+}
+
+void sve4_queue_destroy(sve4_queue_t* _Nullable queue) {
+  if (!queue)
+    return;
+  // NOLINTBEGIN(misc-include-cleaner)
+  cnd_destroy(&queue->pop_condvar);
+  cnd_destroy(&queue->push_condvar);
+  mtx_destroy(&queue->mutex);
+  // NOLINTEND(misc-include-cleaner)
+  sve4_aligned_free(queue->allocator, queue, CACHE_LINE);
+}
+
+size_t sve4_queue_capacity(const sve4_queue_t* _Nonnull queue) {
+  return queue->mask + 1;
+}
+
+static bool push_cell(sve4_queue_t* _Nonnull queue,
+                      const void* _Nonnull elem) {
+  if (atomic_load_explicit(&queue->closed, memory_order_relaxed))
+    return false;
+
+  size_t pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+  while (true) {
+    size_t seq =
+        atomic_load_explicit(cell_sequence(queue, pos), memory_order_acquire);
+    // the cell is free once the consumer of the previous lap is done with it
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->enqueue_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+    }
+  }
+
+  memcpy(cell_data(queue, pos), elem, queue->elem_size);
+  atomic_store_explicit(cell_sequence(queue, pos), pos + 1,
+                        memory_order_release);
+  return true;
+}
+
+static bool pop_cell(sve4_queue_t* _Nonnull queue, void* _Nonnull elem) {
+  size_t pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+  while (true) {
+    size_t seq =
+        atomic_load_explicit(cell_sequence(queue, pos), memory_order_acquire);
+    // the cell is full once its producer is done with it
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&queue->dequeue_pos, &pos,
+                                                pos + 1, memory_order_relaxed,
+                                                memory_order_relaxed))
+        break;
+    } else if (diff < 0) {
+      return false;
+    } else {
+      pos = atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed);
+    }
+  }
+
+  memcpy(elem, cell_data(queue, pos), queue->elem_size);
+  atomic_store_explicit(cell_sequence(queue, pos), pos + queue->mask + 1,
+                        memory_order_release);
+  return true;
+}
+
+// wakes a thread sleeping on condvar. pairs with the fence in wait_op() so that
+// either the sleeper sees the cell this thread just published, or this
+// thread sees the sleeper.
+static void notify(sve4_queue_t* _Nonnull queue,
+                   // NOLINTNEXTLINE(misc-include-cleaner)
+                   cnd_t* _Nonnull condvar, atomic_size_t* _Nonnull waiters) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (sve4_likely(!atomic_load_explicit(waiters, memory_order_relaxed)))
+    return;
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&queue->mutex);
+  cnd_signal(condvar);
+  mtx_unlock(&queue->mutex);
+  // NOLINTEND(misc-include-cleaner)
+}
+
+bool sve4_queue_try_push(sve4_queue_t* _Nonnull queue,
+                         const void* _Nonnull elem) {
+  if (!push_cell(queue, elem))
+    return false;
+  notify(queue, &queue->pop_condvar, &queue->pop_waiters);
+  return true;
+}
+
+bool sve4_queue_try_pop(sve4_queue_t* _Nonnull queue, void* _Nonnull elem) {
+  if (!pop_cell(queue, elem))
+    return false;
+  notify(queue, &queue->push_condvar, &queue->push_waiters);
+  return true;
+}
+
+typedef struct {
+  // exactly one of them is set
+  const void* _Nullable push_elem;
+  void* _Nullable pop_elem;
+} op_t;
+
+static bool try_op(sve4_queue_t* _Nonnull queue, op_t op) {
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wnullable-to-nonnull-conversion"
+  return op.push_elem ? push_cell(queue, op.push_elem)
+                      : pop_cell(queue, op.pop_elem);
+#pragma GCC diagnostic pop
+}
+
+// whether op can never succeed anymore
+static bool is_done(sve4_queue_t* _Nonnull queue, op_t op) {
+  if (!atomic_load_explicit(&queue->closed, memory_order_acquire))
+    return false;
+  if (op.push_elem)
+    return true;
+  // elements pushed before the queue was closed may still be in flight
+  return atomic_load_explicit(&queue->dequeue_pos, memory_order_relaxed) ==
+         atomic_load_explicit(&queue->enqueue_pos, memory_order_relaxed);
+}
+
+static sve4_queue_result_t wait_op(sve4_queue_t* _Nonnull queue, op_t op,
+                                const struct timespec* _Nullable deadline) {
+  // NOLINTBEGIN(misc-include-cleaner)
+  cnd_t* condvar = op.push_elem ? &queue->push_condvar : &queue->pop_condvar;
+  cnd_t* other_condvar =
+      op.push_elem ? &queue->pop_condvar : &queue->push_condvar;
+  atomic_size_t* waiters =
+      op.push_elem ? &queue->push_waiters : &queue->pop_waiters;
+  atomic_size_t* other_waiters =
+      op.push_elem ? &queue->pop_waiters : &queue->push_waiters;
+
+  // handoffs are usually quick, so avoid sleeping if possible
+  for (size_t i = 0; i < SPIN_TRIES; ++i) {
+    if (try_op(queue, op)) {
+      notify(queue, other_condvar, other_waiters);
+      return SVE4_QUEUE_OK;
+    }
+    if (is_done(queue, op))
+      return SVE4_QUEUE_CLOSED;
+    thrd_yield();
+  }
+
+  sve4_queue_result_t result = SVE4_QUEUE_OK;
+  mtx_lock(&queue->mutex);
+  atomic_fetch_add_explicit(waiters, 1, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  while (true) {
+    if (try_op(queue, op)) {
+      // the mutex is held already, so notify() would deadlock
+      atomic_thread_fence(memory_order_seq_cst);
+      if (atomic_load_explicit(other_waiters, memory_order_relaxed))
+        cnd_signal(other_condvar);
+      break;
+    }
+    if (is_done(queue, op)) {
+      result = SVE4_QUEUE_CLOSED;
+      break;
+    }
+    int err = deadline ? cnd_timedwait(condvar, &queue->mutex, deadline)
+                       : cnd_wait(condvar, &queue->mutex);
+    if (err == thrd_timedout) {
+      // the wakeup may have raced with the timeout, so take one last look
+      if (try_op(queue, op)) {
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(other_waiters, memory_order_relaxed))
+          cnd_signal(other_condvar);
+      } else {
+        result = SVE4_QUEUE_TIMEOUT;
+      }
+      break;
+    }
+    if (err != thrd_success) {
+      result = SVE4_QUEUE_ERROR;
+      break;
+    }
+  }
+  atomic_fetch_sub_explicit(waiters, 1, memory_order_relaxed);
+  mtx_unlock(&queue->mutex);
+  // NOLINTEND(misc-include-cleaner)
+  return result;
+}
+
+sve4_queue_result_t sve4_queue_push(sve4_queue_t* _Nonnull queue,
+                                    const void* _Nonnull elem,
+                                    const struct timespec* _Nullable deadline) {
+  return wait_op(queue, (op_t){.push_elem = elem}, deadline);
+}
+
+sve4_queue_result_t sve4_queue_pop(sve4_queue_t* _Nonnull queue,
+                                   void* _Nonnull elem,
+                                   const struct timespec* _Nullable deadline) {
+  return wait_op(queue, (op_t){.pop_elem = elem}, deadline);
+}
+
+void sve4_queue_close(sve4_queue_t* _Nonnull queue) {
+  atomic_store_explicit(&queue->closed, true, memory_order_seq_cst);
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&queue->mutex);
+  cnd_broadcast(&queue->push_condvar);
+  cnd_broadcast(&queue->pop_condvar);
+  mtx_unlock(&queue->mutex);
+  // NOLINTEND(misc-include-cleaner)
+}
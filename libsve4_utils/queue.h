@@ -0,0 +1,73 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+
+#include "sve4_utils_export.h"
+
+#include "allocator.h"
+#include "defines.h"
+
+// QUEUE
+//
+// Bounded multi-producer multi-consumer queue of fixed-size elements, meant
+// for handing sve4_buffer_ref_t or sve4_decode_frame_t from decode workers to
+// render and encode threads. Elements are copied in and out bytewise, so
+// ownership of whatever they reference moves with them.
+//
+// The fast path is lock-free (a ring of sequence-numbered cells, as described
+// by Dmitry Vyukov): producers and consumers only contend on a single atomic
+// increment each. Blocking calls spin briefly, then sleep on a condition
+// variable. The mutex behind it is only taken when a thread actually has to
+// sleep or has to wake one up.
+
+typedef struct sve4_queue_t sve4_queue_t;
+
+typedef enum {
+  SVE4_QUEUE_OK = 0,
+  // the deadline passed before the operation could complete
+  SVE4_QUEUE_TIMEOUT,
+  // the queue is closed (and, for pops, drained)
+  SVE4_QUEUE_CLOSED,
+  // waiting failed
+  SVE4_QUEUE_ERROR,
+} sve4_queue_result_t;
+
+// capacity is rounded up to a power of two
+SVE4_UTILS_EXPORT
+sve4_queue_t* _Nullable sve4_queue_create(sve4_allocator_t* _Nullable allocator,
+                                          size_t capacity, size_t elem_size);
+// elements still in the queue are not released, pop them first if they own
+// anything. no thread may be waiting on the queue anymore.
+SVE4_UTILS_EXPORT
+void sve4_queue_destroy(sve4_queue_t* _Nullable queue);
+
+SVE4_UTILS_EXPORT
+size_t sve4_queue_capacity(const sve4_queue_t* _Nonnull queue);
+
+// returns false if the queue is full or closed
+SVE4_UTILS_EXPORT
+bool sve4_queue_try_push(sve4_queue_t* _Nonnull queue,
+                         const void* _Nonnull elem);
+// returns false if the queue is empty
+SVE4_UTILS_EXPORT
+bool sve4_queue_try_pop(sve4_queue_t* _Nonnull queue, void* _Nonnull elem);
+
+// waits for space until deadline (TIME_UTC, NULL to wait forever)
+SVE4_UTILS_EXPORT
+sve4_queue_result_t sve4_queue_push(sve4_queue_t* _Nonnull queue,
+                                    const void* _Nonnull elem,
+                                    const struct timespec* _Nullable deadline);
+// waits for an element until deadline (TIME_UTC, NULL to wait forever)
+SVE4_UTILS_EXPORT
+sve4_queue_result_t sve4_queue_pop(sve4_queue_t* _Nonnull queue,
+                                   void* _Nonnull elem,
+                                   const struct timespec* _Nullable deadline);
+
+// makes pushes fail with SVE4_QUEUE_CLOSED and wakes every waiting thread.
+// pops still return the remaining elements before failing. a push racing with
+// this may still succeed, so drain the queue with sve4_queue_try_pop() once
+// every producer is done.
+SVE4_UTILS_EXPORT
+void sve4_queue_close(sve4_queue_t* _Nonnull queue);
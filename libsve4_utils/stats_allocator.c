@@ -0,0 +1,248 @@
+#include "stats_allocator.h"
+
+#include <stdalign.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "allocator.h"
+#include "defines.h"
+
+#define NUM_SHARDS 16
+#define CACHE_LINE 64
+// net change of live bytes a shard accumulates before publishing it. growth
+// that may set a new high-water mark is published right away.
+#define FLUSH_BYTES ((long long)64 * 1024)
+
+typedef struct {
+  // live bytes not yet added to stats_t::live
+  alignas(CACHE_LINE) atomic_llong pending;
+  atomic_size_t total_bytes;
+  atomic_size_t num_allocs, num_grows, num_frees;
+  atomic_size_t histogram[SVE4_ALLOCATOR_STATS_NUM_BINS];
+} shard_t;
+
+typedef struct {
+  sve4_allocator_t* _Nullable inner;
+  const char* _Nonnull tag;
+  alignas(CACHE_LINE) atomic_llong live;
+  atomic_size_t peak;
+  shard_t shards[NUM_SHARDS];
+} stats_t;
+
+// stored right before every returned pointer
+typedef struct {
+  size_t size;
+  // alignment of the inner allocation
+  size_t alignment;
+} header_t;
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static atomic_size_t next_shard = 0;
+static _Thread_local size_t thread_shard = SIZE_MAX;
+
+static shard_t* _Nonnull get_shard(stats_t* _Nonnull stats) {
+  if (sve4_unlikely(thread_shard == SIZE_MAX))
+    thread_shard =
+        atomic_fetch_add_explicit(&next_shard, 1, memory_order_relaxed) %
+        NUM_SHARDS;
+  return &stats->shards[thread_shard];
+}
+
+static size_t histogram_bin(size_t size) {
+  size_t bin = 0;
+  while (size >>= 1)
+    ++bin;
+  return sve4_min(bin, (size_t)SVE4_ALLOCATOR_STATS_NUM_BINS - 1);
+}
+
+static void update_peak(stats_t* _Nonnull stats, long long live) {
+  if (live <= 0)
+    return;
+  size_t peak = atomic_load_explicit(&stats->peak, memory_order_relaxed);
+  while ((size_t)live > peak &&
+         !atomic_compare_exchange_weak_explicit(&stats->peak, &peak,
+                                                (size_t)live,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+    ;
+}
+
+static void add_live(stats_t* _Nonnull stats, shard_t* _Nonnull shard,
+                     long long delta) {
+  long long pending =
+      atomic_fetch_add_explicit(&shard->pending, delta, memory_order_relaxed) +
+      delta;
+  if (sve4_likely(pending < FLUSH_BYTES && pending > -FLUSH_BYTES)) {
+    if (delta <= 0)
+      return;
+    // only the published live bytes are known here, so this misses peaks
+    // built up from the unpublished growth of other shards
+    long long live = atomic_load_explicit(&stats->live, memory_order_relaxed);
+    size_t peak = atomic_load_explicit(&stats->peak, memory_order_relaxed);
+    if (sve4_likely(live + pending <= (long long)peak))
+      return;
+  }
+
+  pending = atomic_exchange_explicit(&shard->pending, 0, memory_order_relaxed);
+  long long live =
+      atomic_fetch_add_explicit(&stats->live, pending, memory_order_relaxed) +
+      pending;
+  update_peak(stats, live);
+}
+
+static void record_alloc(stats_t* _Nonnull stats, size_t size, bool grow,
+                         size_t old_size) {
+  shard_t* shard = get_shard(stats);
+  atomic_fetch_add_explicit(grow ? &shard->num_grows : &shard->num_allocs, 1,
+                            memory_order_relaxed);
+  atomic_fetch_add_explicit(&shard->histogram[histogram_bin(size)], 1,
+                            memory_order_relaxed);
+  if (size > old_size)
+    atomic_fetch_add_explicit(&shard->total_bytes, size - old_size,
+                              memory_order_relaxed);
+  add_live(stats, shard, (long long)size - (long long)old_size);
+}
+
+static size_t header_offset(size_t alignment) {
+  return sve4_align_up(sizeof(header_t), alignment);
+}
+
+static header_t* _Nonnull get_header(void* _Nonnull ptr) {
+  return (header_t*)((char*)ptr - sizeof(header_t));
+}
+
+static void* _Nullable stats_alloc_common(sve4_allocator_t* _Nonnull self,
+                                          size_t size, size_t alignment,
+                                          bool zero) {
+  stats_t* stats = self->state.p1;
+  alignment = sve4_max(alignment, SVE4_MAX_ALIGN);
+  size_t offset = header_offset(alignment);
+  if (size > SIZE_MAX - offset)
+    return NULL;
+
+  char* base =
+      zero ? sve4_aligned_calloc(stats->inner, size + offset, alignment)
+           : sve4_aligned_alloc(stats->inner, size + offset, alignment);
+  if (!base)
+    return NULL;
+  void* ptr = base + offset;
+  *get_header(ptr) = (header_t){size, alignment};
+  record_alloc(stats, size, false, 0);
+  return ptr;
+}
+
+static void* _Nullable stats_alloc(sve4_allocator_t* _Nonnull self, size_t size,
+                                   size_t alignment) {
+  return stats_alloc_common(self, size, alignment, false);
+}
+
+static void* _Nullable stats_calloc(sve4_allocator_t* _Nonnull self,
+                                    size_t size, size_t alignment) {
+  return stats_alloc_common(self, size, alignment, true);
+}
+
+static void stats_free(sve4_allocator_t* _Nonnull self, void* _Nullable ptr,
+                       size_t alignment) {
+  (void)alignment;
+  if (!ptr)
+    return;
+  stats_t* stats = self->state.p1;
+  header_t header = *get_header(ptr);
+  shard_t* shard = get_shard(stats);
+  atomic_fetch_add_explicit(&shard->num_frees, 1, memory_order_relaxed);
+  add_live(stats, shard, -(long long)header.size);
+  sve4_aligned_free(stats->inner, (char*)ptr - header_offset(header.alignment),
+                    header.alignment);
+}
+
+static void* _Nullable stats_grow(sve4_allocator_t* _Nonnull self,
+                                  void* _Nullable ptr, size_t old_size,
+                                  size_t new_size, size_t alignment) {
+  if (!ptr)
+    return stats_alloc(self, new_size, alignment);
+
+  stats_t* stats = self->state.p1;
+  header_t header = *get_header(ptr);
+  (void)old_size;
+  if (sve4_max(alignment, SVE4_MAX_ALIGN) != header.alignment) {
+    // the header would have to move, start over
+    void* new_ptr = stats_alloc(self, new_size, alignment);
+    if (new_ptr) {
+      memcpy(new_ptr, ptr, sve4_min(header.size, new_size));
+      stats_free(self, ptr, alignment);
+    }
+    return new_ptr;
+  }
+
+  size_t offset = header_offset(header.alignment);
+  if (new_size > SIZE_MAX - offset)
+    return NULL;
+  char* base = sve4_aligned_realloc(stats->inner, (char*)ptr - offset,
+                                    header.size + offset, new_size + offset,
+                                    header.alignment);
+  if (!base)
+    return NULL;
+  ptr = base + offset;
+  get_header(ptr)->size = new_size;
+  record_alloc(stats, new_size, true, header.size);
+  return ptr;
+}
+
+bool sve4_allocator_stats_init(sve4_allocator_t* _Nonnull allocator,
+                               sve4_allocator_t* _Nullable inner,
+                               const char* _Nonnull tag) {
+  stats_t* stats = sve4_aligned_calloc(inner, sizeof(stats_t), CACHE_LINE);
+  if (!stats)
+    return false;
+  stats->inner = inner;
+  stats->tag = tag;
+
+  *allocator = (sve4_allocator_t){
+      .state = {stats, NULL},
+      .alloc = stats_alloc,
+      .calloc = stats_calloc,
+      .grow = stats_grow,
+      .free = stats_free,
+  };
+  return true;
+}
+
+void sve4_allocator_stats_destroy(sve4_allocator_t* _Nonnull allocator) {
+  stats_t* stats = allocator->state.p1;
+  if (!stats)
+    return;
+  sve4_aligned_free(stats->inner, stats, CACHE_LINE);
+  allocator->state.p1 = NULL;
+}
+
+sve4_allocator_stats_t
+sve4_allocator_stats_get(const sve4_allocator_t* _Nonnull allocator) {
+  stats_t* stats = allocator->state.p1;
+  sve4_allocator_stats_t result = {.tag = stats->tag};
+  long long live = atomic_load_explicit(&stats->live, memory_order_relaxed);
+  for (size_t i = 0; i < NUM_SHARDS; ++i) {
+    shard_t* shard = &stats->shards[i];
+    live += atomic_load_explicit(&shard->pending, memory_order_relaxed);
+    result.total_bytes +=
+        atomic_load_explicit(&shard->total_bytes, memory_order_relaxed);
+    result.num_allocs +=
+        atomic_load_explicit(&shard->num_allocs, memory_order_relaxed);
+    result.num_grows +=
+        atomic_load_explicit(&shard->num_grows, memory_order_relaxed);
+    result.num_frees +=
+        atomic_load_explicit(&shard->num_frees, memory_order_relaxed);
+    for (size_t j = 0; j < SVE4_ALLOCATOR_STATS_NUM_BINS; ++j)
+      result.histogram[j] +=
+          atomic_load_explicit(&shard->histogram[j], memory_order_relaxed);
+  }
+
+  // the pending changes are included here, so this may raise the high-water
+  // mark too
+  update_peak(stats, live);
+  result.live_bytes = live > 0 ? (size_t)live : 0;
+  result.peak_bytes = atomic_load_explicit(&stats->peak, memory_order_relaxed);
+  return result;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sve4_utils_export.h"
+
+#include "allocator.h"
+#include "defines.h"
+
+// STATS ALLOCATOR
+//
+// Forwards every request to an inner allocator and records how much memory
+// goes through it. Each stats allocator is one tag, so giving every subsystem
+// its own (e.g. the decoder, the frame allocator and the logger) shows what
+// each of them holds.
+//
+// Allocations carry a small header remembering their size, so pointers must
+// be freed through the stats allocator that returned them. Counters are
+// sharded per thread and updated with relaxed atomics, so the allocator is as
+// thread-safe as the inner one and threads do not contend on a shared cache
+// line.
+//
+// Nothing is wrapped by default. To measure a subsystem, wrap the allocator
+// handed to it, e.g. the allocator and frame_allocator of
+// sve4_decode_decoder_config_t or the one passed to sve4_log_init() (see
+// libsve4_decode/bench/decode.c).
+
+// bin i of the histogram counts sizes in [2^i, 2^(i+1)), bin 0 also counts
+// empty allocations and the last bin everything larger
+#define SVE4_ALLOCATOR_STATS_NUM_BINS 32
+
+typedef struct {
+  const char* _Nonnull tag;
+  // bytes currently allocated, headers excluded
+  size_t live_bytes;
+  // high-water mark of live_bytes. exact for allocators used from a single
+  // thread. otherwise it may miss up to 64 KiB per other thread, as small
+  // changes are batched per thread before they are accounted for.
+  size_t peak_bytes;
+  // bytes ever allocated, growth included
+  size_t total_bytes;
+  size_t num_allocs, num_grows, num_frees;
+  // sizes of allocations and of grown allocations after growing
+  size_t histogram[SVE4_ALLOCATOR_STATS_NUM_BINS];
+} sve4_allocator_stats_t;
+
+// initializes *allocator as a stats allocator forwarding to inner (NULL for
+// libc). tag must outlive the allocator. the resulting allocator may be
+// copied.
+SVE4_UTILS_EXPORT
+bool sve4_allocator_stats_init(sve4_allocator_t* _Nonnull allocator,
+                               sve4_allocator_t* _Nullable inner,
+                               const char* _Nonnull tag);
+
+// frees the counters, memory still allocated through the allocator is not
+// released
+SVE4_UTILS_EXPORT
+void sve4_allocator_stats_destroy(sve4_allocator_t* _Nonnull allocator);
+
+// returns a snapshot of the counters. concurrent updates may or may not be
+// included.
+SVE4_UTILS_EXPORT
+sve4_allocator_stats_t
+sve4_allocator_stats_get(const sve4_allocator_t* _Nonnull allocator);
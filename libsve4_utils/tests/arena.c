@@ -1,3 +1,6 @@
+#include <stdint.h>
+#include <string.h>
+
 #include "libsve4_utils/arena.h"
 
 #include "libsve4_utils/allocator.h"
@@ -115,12 +118,172 @@ static MunitResult test_alloc_aligned(const MunitParameter params[],
 
   sve4_allocator_t alloc = sve4_allocator_arena_init;
 
-  size_t size = 128, align = SVE4_MAX_ALIGN * 2;
-  void* ptr = sve4_aligned_alloc(&alloc, size, align);
-  munit_assert_ptr_null(ptr);
+  size_t size = 128;
+  for (size_t align = 1; align <= 4096; align *= 2) {
+    // misalign the next allocation
+    sve4_malloc(&alloc, 1);
+    void* ptr = sve4_aligned_alloc(&alloc, size, align);
+    munit_assert_ptr_not_null(ptr);
+    munit_assert_size((uintptr_t)ptr % align, ==, 0);
+    memset(ptr, 0, size);
+  }
+
+  // larger than a region, still aligned
+  void* ptr = sve4_aligned_alloc(&alloc, SVE4_ARENA_DEFAULT_REGION_SIZE, 256);
+  munit_assert_ptr_not_null(ptr);
+  munit_assert_size((uintptr_t)ptr % 256, ==, 0);
+  memset(ptr, 0, SVE4_ARENA_DEFAULT_REGION_SIZE);
+
+  sve4_allocator_arena_destroy(&alloc);
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_grow_in_place(const MunitParameter params[],
+                                      void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t alloc =
+      sve4_allocator_arena_init_ex(1024, SVE4_ARENA_GROWTH_FIXED);
+
+  uint8_t* ptr = sve4_malloc(&alloc, 100);
+  munit_assert_ptr_not_null(ptr);
+  memset(ptr, 42, 100);
+  munit_assert_ptr_equal(sve4_realloc(&alloc, ptr, 100, 600), ptr);
+  munit_assert_ptr_equal(sve4_realloc(&alloc, ptr, 600, 50), ptr);
+
+  // the shrunk space is reused
+  uint8_t* next = sve4_malloc(&alloc, 16);
+  munit_assert_ptr_equal(next, ptr + sve4_align_up(50, SVE4_MAX_ALIGN));
+
+  // not the latest allocation anymore, so it is moved
+  uint8_t* moved = sve4_realloc(&alloc, ptr, 50, 60);
+  munit_assert_ptr_not_equal(moved, ptr);
+  for (size_t i = 0; i < 50; i++)
+    munit_assert_uint8(moved[i], ==, 42);
+
+  // does not fit in the region anymore
+  moved = sve4_realloc(&alloc, moved, 60, 2048);
+  munit_assert_ptr_not_null(moved);
+  for (size_t i = 0; i < 50; i++)
+    munit_assert_uint8(moved[i], ==, 42);
+
+  sve4_allocator_arena_destroy(&alloc);
+  return MUNIT_OK;
+}
+
+static MunitResult test_growth(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  // each allocation fills a region of the fixed arena, but only the first
+  // two need a new region in the doubling one
+  sve4_allocator_t fixed =
+      sve4_allocator_arena_init_ex(256, SVE4_ARENA_GROWTH_FIXED);
+  sve4_allocator_t doubling =
+      sve4_allocator_arena_init_ex(256, SVE4_ARENA_GROWTH_DOUBLE);
+  char* fixed_ptrs[3];
+  char* doubling_ptrs[3];
+  for (size_t i = 0; i < 3; ++i) {
+    fixed_ptrs[i] = sve4_malloc(&fixed, 200);
+    doubling_ptrs[i] = sve4_malloc(&doubling, 200);
+    munit_assert_ptr_not_null(fixed_ptrs[i]);
+    munit_assert_ptr_not_null(doubling_ptrs[i]);
+  }
+  munit_assert_ptr_not_equal(fixed_ptrs[2], fixed_ptrs[1] + 208);
+  munit_assert_ptr_equal(doubling_ptrs[2], doubling_ptrs[1] + 208);
+
+  // regions are kept across resets
+  sve4_allocator_arena_reset(&fixed);
+  for (size_t i = 0; i < 3; ++i)
+    munit_assert_ptr_equal(sve4_malloc(&fixed, 200), fixed_ptrs[i]);
+
+  sve4_allocator_arena_destroy(&fixed);
+  sve4_allocator_arena_destroy(&doubling);
+  return MUNIT_OK;
+}
+
+static MunitResult test_mark_rewind(const MunitParameter params[],
+                                    void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t alloc =
+      sve4_allocator_arena_init_ex(256, SVE4_ARENA_GROWTH_FIXED);
+
+  // marking an empty arena goes back to the very beginning
+  sve4_arena_mark_t empty = sve4_allocator_arena_mark(&alloc);
+  char* first = sve4_malloc(&alloc, 64);
+  munit_assert_ptr_not_null(first);
+
+  sve4_arena_mark_t mark = sve4_allocator_arena_mark(&alloc);
+  char* second = sve4_malloc(&alloc, 64);
+  munit_assert_ptr_not_null(second);
+  // spill over into more regions
+  for (size_t i = 0; i < 4; ++i)
+    munit_assert_ptr_not_null(sve4_malloc(&alloc, 200));
+
+  sve4_allocator_arena_rewind(&alloc, mark);
+  munit_assert_ptr_equal(sve4_malloc(&alloc, 64), second);
+  // the spilled regions are reused
+  char* spilled = sve4_malloc(&alloc, 200);
+  sve4_allocator_arena_rewind(&alloc, mark);
+  sve4_malloc(&alloc, 64);
+  munit_assert_ptr_equal(sve4_malloc(&alloc, 200), spilled);
+
+  sve4_allocator_arena_rewind(&alloc, empty);
+  munit_assert_ptr_equal(sve4_malloc(&alloc, 64), first);
 
   sve4_allocator_arena_destroy(&alloc);
+  return MUNIT_OK;
+}
 
+static MunitResult test_scratch(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_scratch_t outer;
+  munit_assert_true(sve4_scratch_begin(&outer, NULL));
+  char* outer_ptr = sve4_malloc(outer.arena, 32);
+  munit_assert_ptr_not_null(outer_ptr);
+
+  // nested scopes share the arena unless it conflicts
+  sve4_scratch_t inner;
+  munit_assert_true(sve4_scratch_begin(&inner, NULL));
+  munit_assert_ptr_equal(inner.arena, outer.arena);
+  char* inner_ptr = sve4_malloc(inner.arena, 32);
+  sve4_scratch_end(&inner);
+  munit_assert_ptr_equal(sve4_malloc(outer.arena, 32), inner_ptr);
+
+  sve4_scratch_t other;
+  munit_assert_true(sve4_scratch_begin(&other, outer.arena));
+  munit_assert_ptr_not_equal(other.arena, outer.arena);
+  sve4_scratch_end(&other);
+
+  sve4_scratch_end(&outer);
+  munit_assert_true(sve4_scratch_begin(&outer, NULL));
+  munit_assert_ptr_equal(sve4_malloc(outer.arena, 32), outer_ptr);
+  sve4_scratch_end(&outer);
+
+  // large temporaries do not stay with the thread once the outermost scope
+  // ends, but the first region does
+  munit_assert_true(sve4_scratch_begin(&outer, NULL));
+  for (size_t i = 0; i < 64; ++i)
+    munit_assert_ptr_not_null(
+        sve4_malloc(outer.arena, SVE4_ARENA_DEFAULT_REGION_SIZE / 2));
+  munit_assert_not_null(sve4_malloc(outer.arena, (size_t)4 << 20));
+  munit_assert_true(sve4_scratch_begin(&inner, NULL));
+  sve4_scratch_end(&inner);
+  munit_assert_size(sve4_allocator_arena_get_capacity(outer.arena), >,
+                    SVE4_ARENA_DEFAULT_REGION_SIZE);
+  sve4_scratch_end(&outer);
+  munit_assert_size(sve4_allocator_arena_get_capacity(outer.arena), <=,
+                    SVE4_ARENA_DEFAULT_REGION_SIZE);
+  munit_assert_true(sve4_scratch_begin(&outer, NULL));
+  munit_assert_ptr_equal(sve4_malloc(outer.arena, 32), outer_ptr);
+  sve4_scratch_end(&outer);
   return MUNIT_OK;
 }
 
@@ -173,6 +336,38 @@ static MunitTest test_suite_tests[] = {
         MUNIT_TEST_OPTION_NONE,
         NULL,
     },
+    {
+        "/grow_in_place",
+        test_grow_in_place,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/growth",
+        test_growth,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/mark_rewind",
+        test_mark_rewind,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/scratch",
+        test_scratch,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL} /* Mark the end of the array */
 };
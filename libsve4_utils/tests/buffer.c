@@ -1,4 +1,6 @@
 #include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
 
 #include <libsve4_utils/buffer.h>
 
@@ -106,6 +108,152 @@ static MunitResult test_ref_unref_destructor(const MunitParameter params[],
   return MUNIT_OK;
 }
 
+static MunitResult test_view(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  bool destroyed = false;
+  sve4_buffer_ref_t buf = sve4_buffer_create(NULL, sizeof(destructor_tracker),
+                                             destructor_tracker_destructor);
+  munit_assert_ptr_not_null(buf);
+  munit_assert_size(sve4_buffer_get_size(buf), ==, sizeof(destructor_tracker));
+  destructor_tracker* tracker = (destructor_tracker*)buf->data;
+  tracker->destroyed = &destroyed;
+
+  sve4_buffer_view_t all = sve4_buffer_view_all(buf);
+  munit_assert_ptr_equal(sve4_buffer_view_get_data(&all), buf->data);
+  munit_assert_size(all.length, ==, sizeof(destructor_tracker));
+  munit_assert_size(buf->ref_count, ==, 2);
+
+  sve4_buffer_view_t slice = sve4_buffer_view_slice(&all, 2, 4);
+  sve4_buffer_view_t sub_slice = sve4_buffer_view_slice(&slice, 1, 2);
+  munit_assert_ptr_equal(sve4_buffer_view_get_data(&sub_slice), buf->data + 3);
+  munit_assert_size(sub_slice.length, ==, 2);
+  munit_assert_size(buf->ref_count, ==, 4);
+
+  // views keep the parent alive
+  sve4_buffer_free(&buf);
+  sve4_buffer_view_unref(&all);
+  sve4_buffer_view_unref(&slice);
+  munit_assert_null(all.parent);
+  munit_assert_null(sve4_buffer_view_get_data(&all));
+  munit_assert_false(destroyed);
+
+  sve4_buffer_view_t copy = sve4_buffer_view_ref(&sub_slice);
+  sve4_buffer_view_unref(&sub_slice);
+  munit_assert_false(destroyed);
+  sve4_buffer_view_unref(&copy);
+  munit_assert_true(destroyed);
+
+  return MUNIT_OK;
+}
+
+typedef struct {
+  int num_releases;
+  void* released;
+} release_tracker;
+
+static void release_tracker_release(void* opaque, void* data) {
+  release_tracker* tracker = opaque;
+  ++tracker->num_releases;
+  tracker->released = data;
+}
+
+static MunitResult test_external(const MunitParameter params[],
+                                 void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  char memory[64] = {0};
+  release_tracker tracker = {0};
+  sve4_buffer_ref_t buf = sve4_buffer_create_external(
+      NULL, memory, sizeof(memory), release_tracker_release, &tracker);
+  munit_assert_ptr_not_null(buf);
+  munit_assert_ptr_equal(sve4_buffer_get_data(buf), memory);
+  munit_assert_size(sve4_buffer_get_size(buf), ==, sizeof(memory));
+
+  sve4_buffer_view_t slice = sve4_buffer_view(buf, 16, 8);
+  munit_assert_ptr_equal(sve4_buffer_view_get_data(&slice), memory + 16);
+
+  sve4_buffer_free(&buf);
+  munit_assert_int(tracker.num_releases, ==, 0);
+  sve4_buffer_view_unref(&slice);
+  munit_assert_int(tracker.num_releases, ==, 1);
+  munit_assert_ptr_equal(tracker.released, memory);
+
+  // without a release function, nothing happens to the memory
+  buf = sve4_buffer_create_external(NULL, memory, sizeof(memory), NULL, NULL);
+  munit_assert_ptr_not_null(buf);
+  sve4_buffer_free(&buf);
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_aligned(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  // small buffers do not pay for cache line alignment
+  sve4_buffer_ref_t small = sve4_buffer_create(NULL, 1, NULL);
+  munit_assert_ptr_not_null(small);
+  munit_assert_size(small->alignment, ==, SVE4_BUFFER_ALIGNMENT);
+  munit_assert_size(sizeof(sve4_buffer_t), <=, SVE4_BUFFER_CACHE_LINE);
+  sve4_buffer_unref(small);
+
+  for (size_t align = 0; align <= 8192; align = align ? align * 2 : 1) {
+    sve4_buffer_ref_t buf = sve4_buffer_create_ex(
+        NULL, 100, align, SVE4_BUFFER_FLAGS_NONE, NULL);
+    munit_assert_ptr_not_null(buf);
+    munit_assert_size(buf->alignment, >=, align);
+    munit_assert_size((uintptr_t)sve4_buffer_get_data(buf) % buf->alignment,
+                      ==, 0);
+    // the reference count shares a cache line with neither the data nor the
+    // fields every reader loads
+    if (align >= SVE4_BUFFER_CACHE_LINE) {
+      uintptr_t count_line =
+          (uintptr_t)sve4__buffer_ref_count(buf) / SVE4_BUFFER_CACHE_LINE;
+      munit_assert_size(count_line, !=,
+                        (uintptr_t)buf->data / SVE4_BUFFER_CACHE_LINE);
+      munit_assert_size(count_line, !=,
+                        (uintptr_t)&buf->ptr / SVE4_BUFFER_CACHE_LINE);
+      munit_assert_size(count_line, !=,
+                        (uintptr_t)&buf->size / SVE4_BUFFER_CACHE_LINE);
+    }
+    sve4_buffer_ref(buf);
+    sve4_buffer_unref(buf);
+    memset(sve4_buffer_get_data(buf), 0, 100);
+    sve4_buffer_unref(buf);
+  }
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_single_owner(const MunitParameter params[],
+                                     void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  bool destroyed = false;
+  sve4_buffer_ref_t buf =
+      sve4_buffer_create_ex(NULL, sizeof(destructor_tracker), 0,
+                            SVE4_BUFFER_SINGLE_OWNER,
+                            destructor_tracker_destructor);
+  munit_assert_ptr_not_null(buf);
+  ((destructor_tracker*)buf->data)->destroyed = &destroyed;
+
+  sve4_buffer_ref_t ref1 = sve4_buffer_ref(buf);
+  sve4_buffer_ref_t ref2 = sve4_buffer_ref(buf);
+  munit_assert_size(buf->ref_count, ==, 3);
+  sve4_buffer_unref(ref1);
+  sve4_buffer_unref(buf);
+  munit_assert_false(destroyed);
+  sve4_buffer_unref(ref2);
+  munit_assert_true(destroyed);
+
+  return MUNIT_OK;
+}
+
 static MunitTest test_suite_tests[] = {
     {
         "/simple_buffer",
@@ -139,6 +287,38 @@ static MunitTest test_suite_tests[] = {
         MUNIT_TEST_OPTION_NONE,
         NULL,
     },
+    {
+        "/view",
+        test_view,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/external",
+        test_external,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/aligned",
+        test_aligned,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/single_owner",
+        test_single_owner,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL} /* Mark the end of the array */
 };
@@ -0,0 +1,240 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libsve4_utils/buffer.h>
+#include <libsve4_utils/buffer_pool.h>
+#include <libsve4_utils/formats.h>
+#include <munit.h>
+
+static const sve4_buffer_pool_key_t key_720p = {
+    .pixfmt = {SVE4_FMT_SRC_DEFAULT, SVE4_PIXFMT_DEFAULT_NV12},
+    .width = 1280,
+    .height = 720,
+    .alignment = 64,
+};
+
+static const sve4_buffer_pool_key_t key_1080p = {
+    .pixfmt = {SVE4_FMT_SRC_DEFAULT, SVE4_PIXFMT_DEFAULT_NV12},
+    .width = 1920,
+    .height = 1080,
+    .alignment = 64,
+};
+
+static int num_destroyed = 0;
+
+static void count_destroyed(char* data) {
+  (void)data;
+  ++num_destroyed;
+}
+
+static MunitResult test_reuse(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_buffer_pool_t* pool = sve4_buffer_pool_create(NULL, 2, 4);
+  munit_assert_not_null(pool);
+
+  num_destroyed = 0;
+  sve4_buffer_ref_t first =
+      sve4_buffer_pool_get(pool, &key_720p, 1024, count_destroyed);
+  munit_assert_not_null(first);
+  memset(sve4_buffer_get_data(first), 0xAB, 1024);
+  sve4_buffer_unref(first);
+  // the destructor still runs when the buffer is recycled
+  munit_assert_int(num_destroyed, ==, 1);
+
+  sve4_buffer_ref_t second = sve4_buffer_pool_get(pool, &key_720p, 1024, NULL);
+  munit_assert_ptr_equal(first, second);
+  munit_assert_size(atomic_load(sve4__buffer_ref_count(second)), ==, 1);
+  munit_assert_true(second->destructor == NULL);
+
+  // a different size is a different layout
+  sve4_buffer_ref_t other = sve4_buffer_pool_get(pool, &key_720p, 2048, NULL);
+  munit_assert_ptr_not_equal(other, second);
+
+  sve4_buffer_pool_stats_t stats = sve4_buffer_pool_get_stats(pool);
+  munit_assert_size(stats.num_buffers, ==, 2);
+  munit_assert_size(stats.num_free, ==, 0);
+  munit_assert_size(stats.num_reused, ==, 1);
+  munit_assert_size(stats.num_allocated, ==, 2);
+
+  sve4_buffer_unref(second);
+  sve4_buffer_unref(other);
+  sve4_buffer_pool_unref(pool);
+  return MUNIT_OK;
+}
+
+static MunitResult test_watermarks(const MunitParameter params[],
+                                   void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  enum { NUM_BUFFERS = 8 };
+  sve4_buffer_pool_t* pool = sve4_buffer_pool_create(NULL, 2, 4);
+  munit_assert_not_null(pool);
+
+  sve4_buffer_ref_t buffers[NUM_BUFFERS];
+  for (size_t i = 0; i < NUM_BUFFERS; ++i) {
+    buffers[i] = sve4_buffer_pool_get(pool, &key_720p, 256, NULL);
+    munit_assert_not_null(buffers[i]);
+  }
+
+  // the fifth free buffer goes over the high watermark, which releases all
+  // but two
+  for (size_t i = 0; i < 5; ++i)
+    sve4_buffer_unref(buffers[i]);
+  sve4_buffer_pool_stats_t stats = sve4_buffer_pool_get_stats(pool);
+  munit_assert_size(stats.num_free, ==, 2);
+  munit_assert_size(stats.num_buffers, ==, 5);
+
+  for (size_t i = 5; i < NUM_BUFFERS; ++i)
+    sve4_buffer_unref(buffers[i]);
+  stats = sve4_buffer_pool_get_stats(pool);
+  munit_assert_size(stats.num_free, ==, 2);
+
+  sve4_buffer_pool_trim(pool, 0);
+  stats = sve4_buffer_pool_get_stats(pool);
+  munit_assert_size(stats.num_free, ==, 0);
+  munit_assert_size(stats.num_buffers, ==, 0);
+
+  sve4_buffer_pool_unref(pool);
+  return MUNIT_OK;
+}
+
+static MunitResult test_key_change(const MunitParameter params[],
+                                   void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_buffer_pool_t* pool = sve4_buffer_pool_create(NULL, 2, 4);
+  munit_assert_not_null(pool);
+
+  sve4_buffer_ref_t small = sve4_buffer_pool_get(pool, &key_720p, 256, NULL);
+  sve4_buffer_ref_t small_in_use =
+      sve4_buffer_pool_get(pool, &key_720p, 256, NULL);
+  sve4_buffer_unref(small);
+  munit_assert_size(sve4_buffer_pool_get_stats(pool).num_free, ==, 1);
+
+  // a new key does not release the free 720p buffer right away
+  sve4_buffer_ref_t large = sve4_buffer_pool_get(pool, &key_1080p, 512, NULL);
+  munit_assert_not_null(large);
+  sve4_buffer_unref(large);
+  sve4_buffer_pool_stats_t stats = sve4_buffer_pool_get_stats(pool);
+  munit_assert_size(stats.num_free, ==, 2);
+  munit_assert_size(stats.num_buffers, ==, 3);
+
+  // but once 720p goes unrequested for longer than the high watermark, it does
+  // by the next check, at most twice the high watermark later
+  for (size_t i = 0; i < 8; ++i) {
+    large = sve4_buffer_pool_get(pool, &key_1080p, 512, NULL);
+    munit_assert_not_null(large);
+    sve4_buffer_unref(large);
+  }
+  stats = sve4_buffer_pool_get_stats(pool);
+  munit_assert_size(stats.num_free, ==, 1);
+  munit_assert_size(stats.num_buffers, ==, 2);
+
+  // the one in use stays valid
+  sve4_buffer_unref(small_in_use);
+  munit_assert_size(sve4_buffer_pool_get_stats(pool).num_free, ==, 2);
+
+  sve4_buffer_pool_unref(pool);
+  return MUNIT_OK;
+}
+
+static MunitResult test_interleaved(const MunitParameter params[],
+                                    void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_buffer_pool_t* pool = sve4_buffer_pool_create(NULL, 2, 4);
+  munit_assert_not_null(pool);
+
+  // two streams of different layouts share the pool without evicting each
+  // other's buffers
+  enum { NUM_FRAMES = 16 };
+  for (size_t i = 0; i < NUM_FRAMES; ++i) {
+    sve4_buffer_ref_t small = sve4_buffer_pool_get(pool, &key_720p, 256, NULL);
+    sve4_buffer_ref_t large =
+        sve4_buffer_pool_get(pool, &key_1080p, 512, NULL);
+    munit_assert_not_null(small);
+    munit_assert_not_null(large);
+    sve4_buffer_unref(small);
+    sve4_buffer_unref(large);
+  }
+
+  sve4_buffer_pool_stats_t stats = sve4_buffer_pool_get_stats(pool);
+  munit_assert_size(stats.num_allocated, ==, 2);
+  munit_assert_size(stats.num_reused, ==, NUM_FRAMES * 2 - 2);
+  munit_assert_size(stats.num_buffers, ==, 2);
+
+  sve4_buffer_pool_unref(pool);
+  return MUNIT_OK;
+}
+
+static MunitResult test_outlive_pool(const MunitParameter params[],
+                                     void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_buffer_pool_t* pool = sve4_buffer_pool_create(NULL, 0, 1);
+  munit_assert_not_null(pool);
+
+  sve4_buffer_ref_t buffer = sve4_buffer_pool_get(pool, &key_720p, 64, NULL);
+  munit_assert_not_null(buffer);
+  sve4_buffer_pool_unref(pool);
+
+  // the pool goes away with its last buffer
+  memset(sve4_buffer_get_data(buffer), 0, 64);
+  sve4_buffer_unref(buffer);
+  return MUNIT_OK;
+}
+
+static MunitResult test_aligned(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_buffer_pool_t* pool = sve4_buffer_pool_create(NULL, 0, 1);
+  munit_assert_not_null(pool);
+
+  sve4_buffer_pool_key_t key = key_720p;
+  key.alignment = 4096;
+  sve4_buffer_ref_t first = sve4_buffer_pool_get(pool, &key, 100, NULL);
+  munit_assert_not_null(first);
+  munit_assert_size((uintptr_t)sve4_buffer_get_data(first) % 4096, ==, 0);
+  sve4_buffer_unref(first);
+
+  sve4_buffer_ref_t second = sve4_buffer_pool_get(pool, &key, 100, NULL);
+  munit_assert_ptr_equal(first, second);
+  munit_assert_size((uintptr_t)sve4_buffer_get_data(second) % 4096, ==, 0);
+  // over the high watermark, so this one is released
+  sve4_buffer_ref_t third = sve4_buffer_pool_get(pool, &key, 100, NULL);
+  sve4_buffer_unref(second);
+  sve4_buffer_unref(third);
+
+  sve4_buffer_pool_unref(pool);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {"/reuse", test_reuse, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/watermarks", test_watermarks, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/key_change", test_key_change, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/interleaved", test_interleaved, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/outlive_pool", test_outlive_pool, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/aligned", test_aligned, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {
+    "/buffer_pool", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,128 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libsve4_utils/allocator.h>
+#include <libsve4_utils/large_allocator.h>
+#include <libsve4_utils/stats_allocator.h>
+#include <munit.h>
+
+enum { THRESHOLD = 1 << 16 };
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+static size_t get_flags(const MunitParameter params[]) {
+  size_t flags = 0;
+  for (; params->name; ++params) {
+    if (strcmp(params->name, "flags") != 0)
+      continue;
+    if (strstr(params->value, "HUGETLB"))
+      flags |= SVE4_LARGE_ALLOC_HUGETLB;
+    if (strstr(params->value, "THP"))
+      flags |= SVE4_LARGE_ALLOC_THP;
+    if (strstr(params->value, "PREFAULT"))
+      flags |= SVE4_LARGE_ALLOC_PREFAULT;
+    if (strstr(params->value, "NUMA_LOCAL"))
+      flags |= SVE4_LARGE_ALLOC_NUMA_LOCAL;
+  }
+  return flags;
+}
+
+static void fill(uint8_t* ptr, size_t size) {
+  for (size_t i = 0; i < size; ++i)
+    ptr[i] = (uint8_t)(i * 7);
+}
+
+static void check(const uint8_t* ptr, size_t size) {
+  for (size_t i = 0; i < size; ++i)
+    munit_assert_uint8(ptr[i], ==, (uint8_t)(i * 7));
+}
+
+static MunitResult test_alloc(const MunitParameter params[], void* user_data) {
+  (void)user_data;
+
+  sve4_allocator_t fallback;
+  munit_assert_true(sve4_allocator_stats_init(&fallback, NULL, "fallback"));
+  sve4_allocator_t alloc =
+      sve4_allocator_large_init(&fallback, THRESHOLD, get_flags(params));
+
+  // below the threshold
+  uint8_t* small = sve4_malloc(&alloc, 100);
+  munit_assert_not_null(small);
+  fill(small, 100);
+  munit_assert_size(sve4_allocator_stats_get(&fallback).live_bytes, >, 0);
+
+  for (size_t alignment = 1; alignment <= 4096; alignment *= 4) {
+    uint8_t* large = sve4_aligned_calloc(&alloc, 3 * THRESHOLD, alignment);
+    munit_assert_not_null(large);
+    munit_assert_size((uintptr_t)large % alignment, ==, 0);
+    for (size_t i = 0; i < 3 * THRESHOLD; ++i)
+      munit_assert_uint8(large[i], ==, 0);
+    fill(large, 3 * THRESHOLD);
+    check(large, 3 * THRESHOLD);
+    sve4_aligned_free(&alloc, large, alignment);
+  }
+
+  check(small, 100);
+  sve4_free(&alloc, small);
+  munit_assert_size(sve4_allocator_stats_get(&fallback).live_bytes, ==, 0);
+  sve4_allocator_stats_destroy(&fallback);
+  return MUNIT_OK;
+}
+
+static MunitResult test_grow(const MunitParameter params[], void* user_data) {
+  (void)user_data;
+
+  sve4_allocator_t fallback;
+  munit_assert_true(sve4_allocator_stats_init(&fallback, NULL, "fallback"));
+  size_t flags = get_flags(params);
+  sve4_allocator_t alloc =
+      sve4_allocator_large_init(&fallback, THRESHOLD, flags);
+
+  // small -> small -> large -> larger -> much larger -> small
+  size_t sizes[] = {100, 1000, 2 * THRESHOLD, 40 * THRESHOLD, 200 * THRESHOLD,
+                    500};
+  uint8_t* ptr = NULL;
+  size_t old_size = 0;
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i) {
+    ptr = sve4_realloc(&alloc, ptr, old_size, sizes[i]);
+    munit_assert_not_null(ptr);
+    // mappings stay huge page aligned when mremap() moves them
+    if ((flags & SVE4_LARGE_ALLOC_THP) && sizes[i] >= THRESHOLD)
+      munit_assert_size((uintptr_t)ptr % HUGE_PAGE_SIZE, <, 4096);
+    check(ptr, sve4_min(old_size, sizes[i]));
+    fill(ptr, sizes[i]);
+    old_size = sizes[i];
+  }
+
+  sve4_free(&alloc, ptr);
+  munit_assert_size(sve4_allocator_stats_get(&fallback).live_bytes, ==, 0);
+  sve4_allocator_stats_destroy(&fallback);
+  return MUNIT_OK;
+}
+
+static MunitParameterEnum flags_params[] = {
+    {"flags",
+     (char*[]){
+         "NONE",
+         "HUGETLB",
+         "THP",
+         "PREFAULT|NUMA_LOCAL",
+         "HUGETLB|PREFAULT|NUMA_LOCAL",
+         NULL,
+     }},
+    {NULL, NULL},
+};
+
+static MunitTest test_suite_tests[] = {
+    {"/alloc", test_alloc, NULL, NULL, MUNIT_TEST_OPTION_NONE, flags_params},
+    {"/grow", test_grow, NULL, NULL, MUNIT_TEST_OPTION_NONE, flags_params},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {
+    "/large_allocator", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,480 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libsve4_utils/formats.h>
+#include <libsve4_utils/pixconv.h>
+#include <libsve4_utils/thread_pool.h>
+#include <munit.h>
+
+enum { WIDTH = 67, HEIGHT = 9, MAX_PLANES = 3 };
+
+typedef struct {
+  uint8_t* data[MAX_PLANES];
+  size_t linesizes[MAX_PLANES];
+} image_t;
+
+static void image_alloc(image_t* image, sve4_pixfmt_t fmt, size_t width,
+                        size_t height) {
+  memset(image, 0, sizeof *image);
+  for (size_t i = 0; i < sve4_pixfmt_num_planes(fmt); ++i) {
+    // odd padding on purpose, kernels must not assume aligned rows
+    image->linesizes[i] = sve4_pixfmt_linesize(fmt, i, width, 1) + 3;
+    image->data[i] = munit_malloc(image->linesizes[i] *
+                                  sve4_pixfmt_plane_height(fmt, i, height));
+  }
+}
+
+static void image_free(image_t* image) {
+  for (size_t i = 0; i < MAX_PLANES; ++i)
+    free(image->data[i]);
+}
+
+// mask selects the valid bits of 16-bit samples
+static void image_fill_random(image_t* image, sve4_pixfmt_t fmt, size_t height,
+                              uint16_t mask) {
+  bool wide = sve4_pixfmt_linesize(fmt, 0, 2, 1) == 4;
+  for (size_t i = 0; i < sve4_pixfmt_num_planes(fmt); ++i) {
+    size_t rows = sve4_pixfmt_plane_height(fmt, i, height);
+    if (!wide) {
+      munit_rand_memory(image->linesizes[i] * rows, image->data[i]);
+      continue;
+    }
+    // rows start at odd offsets, samples must stay within their bit depth
+    for (size_t row = 0; row < rows; ++row) {
+      uint8_t* line = &image->data[i][row * image->linesizes[i]];
+      for (size_t j = 0; j + 1 < image->linesizes[i]; j += 2) {
+        uint16_t sample = (uint16_t)(munit_rand_uint32() & mask);
+        line[j] = (uint8_t)sample;
+        line[j + 1] = (uint8_t)(sample >> 8);
+      }
+    }
+  }
+}
+
+static bool convert(sve4_pixfmt_t dst_fmt, image_t* dst, sve4_pixfmt_t src_fmt,
+                    const image_t* src, size_t width, size_t height,
+                    sve4_pixconv_options_t options) {
+  const uint8_t* src_data[MAX_PLANES] = {src->data[0], src->data[1],
+                                         src->data[2]};
+  return sve4_pixconv_convert(dst_fmt, dst->data, dst->linesizes, src_fmt,
+                              src_data, src->linesizes, width, height,
+                              &options);
+}
+
+// like convert(), scaling a WIDTH x HEIGHT source
+static bool scale(sve4_pixfmt_t dst_fmt, image_t* dst, size_t width,
+                  size_t height, sve4_pixfmt_t src_fmt, const image_t* src,
+                  sve4_pixconv_options_t options) {
+  const uint8_t* src_data[MAX_PLANES] = {src->data[0], src->data[1],
+                                         src->data[2]};
+  return sve4_pixconv_scale(dst_fmt, dst->data, dst->linesizes, width, height,
+                            src_fmt, src_data, src->linesizes, WIDTH, HEIGHT,
+                            &options);
+}
+
+static uint16_t read_u16(const uint8_t* ptr) {
+  return (uint16_t)(ptr[0] | (ptr[1] << 8));
+}
+
+static MunitResult test_known_values(const MunitParameter params[],
+                                     void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_pixfmt_t yuv = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV444P);
+  sve4_pixfmt_t rgba = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8);
+  sve4_pixfmt_t rgba16f = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA16F);
+  image_t src;
+  image_t dst;
+  image_t dst16f;
+  image_alloc(&src, yuv, 4, 1);
+  image_alloc(&dst, rgba, 4, 1);
+  image_alloc(&dst16f, rgba16f, 4, 1);
+
+  // black, white, pure red (BT.601 limited), mid gray
+  const uint8_t y[] = {16, 235, 81, 126};
+  const uint8_t u[] = {128, 128, 90, 128};
+  const uint8_t v[] = {128, 128, 240, 128};
+  memcpy(src.data[0], y, 4);
+  memcpy(src.data[1], u, 4);
+  memcpy(src.data[2], v, 4);
+
+  sve4_pixconv_options_t options = {.matrix = SVE4_PIXCONV_MATRIX_BT601};
+  munit_assert_true(convert(rgba, &dst, yuv, &src, 4, 1, options));
+  const uint8_t expected[] = {0,   0,   0,   255, 255, 255, 255, 255,
+                              255, 0,   0,   255, 128, 128, 128, 255};
+  for (size_t i = 0; i < sizeof expected; ++i)
+    munit_assert_int(abs(dst.data[0][i] - expected[i]), <=, 1);
+
+  munit_assert_true(convert(rgba16f, &dst16f, yuv, &src, 4, 1, options));
+  munit_assert_uint16(read_u16(&dst16f.data[0][0]), ==, 0x0000);
+  // white and alpha are exactly 1.0
+  munit_assert_uint16(read_u16(&dst16f.data[0][8]), ==, 0x3c00);
+  munit_assert_uint16(read_u16(&dst16f.data[0][14]), ==, 0x3c00);
+
+  // full range: 255 is white, 0 is black
+  options.range = SVE4_PIXCONV_RANGE_FULL;
+  src.data[0][0] = 0;
+  src.data[0][1] = 255;
+  munit_assert_true(convert(rgba, &dst, yuv, &src, 4, 1, options));
+  munit_assert_uint8(dst.data[0][0], ==, 0);
+  munit_assert_uint8(dst.data[0][4], ==, 255);
+
+  image_free(&src);
+  image_free(&dst);
+  image_free(&dst16f);
+  return MUNIT_OK;
+}
+
+// 10-bit formats must agree with their 8-bit counterparts when the low bits
+// are zero, and semi-planar formats with their planar counterparts
+static MunitResult test_layouts(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_pixfmt_t rgba = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8);
+  sve4_pixfmt_t yuv420p = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV420P);
+  sve4_pixfmt_t p10 = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV420P10);
+  sve4_pixfmt_t nv12 = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_NV12);
+  sve4_pixfmt_t p010 = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_P010);
+
+  image_t src;
+  image_t src_p10;
+  image_t src_nv12;
+  image_t src_p010;
+  image_t expected;
+  image_t actual;
+  image_alloc(&src, yuv420p, WIDTH, HEIGHT);
+  image_alloc(&src_p10, p10, WIDTH, HEIGHT);
+  image_alloc(&src_nv12, nv12, WIDTH, HEIGHT);
+  image_alloc(&src_p010, p010, WIDTH, HEIGHT);
+  image_alloc(&expected, rgba, WIDTH, HEIGHT);
+  image_alloc(&actual, rgba, WIDTH, HEIGHT);
+  image_fill_random(&src, yuv420p, HEIGHT, 0xff);
+
+  for (size_t plane = 0; plane < 3; ++plane) {
+    size_t width = plane ? (WIDTH + 1) / 2 : WIDTH;
+    size_t height = sve4_pixfmt_plane_height(yuv420p, plane, HEIGHT);
+    for (size_t row = 0; row < height; ++row) {
+      for (size_t x = 0; x < width; ++x) {
+        uint8_t sample = src.data[plane][row * src.linesizes[plane] + x];
+        uint8_t* p10_sample =
+            &src_p10.data[plane][row * src_p10.linesizes[plane] + x * 2];
+        p10_sample[0] = (uint8_t)(sample << 2);
+        p10_sample[1] = (uint8_t)(sample >> 6);
+
+        size_t nv_plane = plane ? 1 : 0;
+        size_t nv_x = plane ? x * 2 + plane - 1 : x;
+        src_nv12.data[nv_plane][row * src_nv12.linesizes[nv_plane] + nv_x] =
+            sample;
+        uint8_t* p010_sample =
+            &src_p010
+                 .data[nv_plane][row * src_p010.linesizes[nv_plane] + nv_x * 2];
+        p010_sample[0] = 0;
+        p010_sample[1] = sample;
+      }
+    }
+  }
+
+  sve4_pixconv_options_t options = {.backend = SVE4_PIXCONV_BACKEND_SCALAR};
+  munit_assert_true(
+      convert(rgba, &expected, yuv420p, &src, WIDTH, HEIGHT, options));
+
+  const struct {
+    sve4_pixfmt_t fmt;
+    const image_t* image;
+  } cases[] = {{p10, &src_p10}, {nv12, &src_nv12}, {p010, &src_p010}};
+  for (size_t i = 0; i < sizeof cases / sizeof cases[0]; ++i) {
+    munit_assert_true(convert(rgba, &actual, cases[i].fmt, cases[i].image,
+                              WIDTH, HEIGHT, options));
+    for (size_t row = 0; row < HEIGHT; ++row)
+      for (size_t x = 0; x < WIDTH * 4; ++x)
+        munit_assert_int(abs(actual.data[0][row * actual.linesizes[0] + x] -
+                             expected.data[0][row * expected.linesizes[0] + x]),
+                         <=, 1);
+  }
+
+  image_free(&src);
+  image_free(&src_p10);
+  image_free(&src_nv12);
+  image_free(&src_p010);
+  image_free(&expected);
+  image_free(&actual);
+  return MUNIT_OK;
+}
+
+static void check_backends(sve4_pixfmt_t dst_fmt, size_t width,
+                           size_t height, sve4_pixfmt_t src_fmt,
+                           const image_t* src,
+                           const sve4_pixconv_backend_t* backends,
+                           size_t num_backends) {
+  size_t row_size = sve4_pixfmt_linesize(dst_fmt, 0, width, 1);
+  image_t expected;
+  image_alloc(&expected, dst_fmt, width, height);
+  munit_assert_true(scale(dst_fmt, &expected, width, height, src_fmt, src,
+                          (sve4_pixconv_options_t){
+                              .matrix = SVE4_PIXCONV_MATRIX_BT2020,
+                              .backend = SVE4_PIXCONV_BACKEND_SCALAR,
+                          }));
+
+  for (size_t b = 0; b < num_backends; ++b) {
+    sve4_pixconv_options_t options = {
+        .matrix = SVE4_PIXCONV_MATRIX_BT2020,
+        .backend = backends[b],
+    };
+    image_t actual;
+    image_alloc(&actual, dst_fmt, width, height);
+    bool supported = sve4_pixconv_backend_supported(backends[b]);
+    munit_assert_int(
+        scale(dst_fmt, &actual, width, height, src_fmt, src, options), ==,
+        supported);
+    if (supported) {
+      munit_logf(MUNIT_LOG_DEBUG, "checking %s -> %s (%zux%zu) on %s",
+                 sve4_pixfmt_to_string(src_fmt),
+                 sve4_pixfmt_to_string(dst_fmt), width, height,
+                 sve4_pixconv_backend_to_string(backends[b]));
+      for (size_t row = 0; row < height; ++row) {
+        const uint8_t* a = &actual.data[0][row * actual.linesizes[0]];
+        const uint8_t* e = &expected.data[0][row * expected.linesizes[0]];
+        munit_assert_memory_equal(row_size, a, e);
+      }
+    }
+    image_free(&actual);
+  }
+  image_free(&expected);
+}
+
+// every available SIMD backend must match the scalar one, both converting
+// and scaling up or down
+static MunitResult test_backends(const MunitParameter params[],
+                                 void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  const sve4_pixfmt_default_t src_fmts[] = {
+      SVE4_PIXFMT_DEFAULT_YUV420P,   SVE4_PIXFMT_DEFAULT_YUV422P,
+      SVE4_PIXFMT_DEFAULT_YUV444P,   SVE4_PIXFMT_DEFAULT_YUV420P10,
+      SVE4_PIXFMT_DEFAULT_YUV422P10, SVE4_PIXFMT_DEFAULT_YUV444P10,
+      SVE4_PIXFMT_DEFAULT_NV12,      SVE4_PIXFMT_DEFAULT_P010,
+  };
+  const sve4_pixfmt_default_t dst_fmts[] = {
+      SVE4_PIXFMT_DEFAULT_RGBA8,
+      SVE4_PIXFMT_DEFAULT_RGBA16F,
+  };
+  const sve4_pixconv_backend_t backends[] = {
+      SVE4_PIXCONV_BACKEND_SSE41,
+      SVE4_PIXCONV_BACKEND_AVX2,
+      SVE4_PIXCONV_BACKEND_NEON,
+  };
+  const size_t sizes[][2] = {{WIDTH, HEIGHT}, {150, 31}, {29, 5}};
+
+  for (size_t s = 0; s < sizeof src_fmts / sizeof src_fmts[0]; ++s) {
+    sve4_pixfmt_t src_fmt = sve4_pixfmt_default(src_fmts[s]);
+    uint16_t mask = src_fmts[s] == SVE4_PIXFMT_DEFAULT_P010 ? 0xffc0 : 0x3ff;
+    image_t src;
+    image_alloc(&src, src_fmt, WIDTH, HEIGHT);
+    image_fill_random(&src, src_fmt, HEIGHT, mask);
+
+    for (size_t d = 0; d < sizeof dst_fmts / sizeof dst_fmts[0]; ++d) {
+      for (size_t z = 0; z < sizeof sizes / sizeof sizes[0]; ++z) {
+        check_backends(sve4_pixfmt_default(dst_fmts[d]), sizes[z][0],
+                       sizes[z][1], src_fmt, &src, backends,
+                       sizeof backends / sizeof backends[0]);
+      }
+    }
+    image_free(&src);
+  }
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_copy(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_pixfmt_t fmt = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV420P);
+  image_t src;
+  image_t dst;
+  image_alloc(&src, fmt, WIDTH, HEIGHT);
+  image_alloc(&dst, fmt, WIDTH, HEIGHT);
+  image_fill_random(&src, fmt, HEIGHT, 0xff);
+  munit_assert_true(convert(fmt, &dst, fmt, &src, WIDTH, HEIGHT,
+                            (sve4_pixconv_options_t){0}));
+  for (size_t i = 0; i < 3; ++i) {
+    size_t width = sve4_pixfmt_linesize(fmt, i, WIDTH, 1);
+    for (size_t row = 0; row < sve4_pixfmt_plane_height(fmt, i, HEIGHT);
+         ++row)
+      munit_assert_memory_equal(width, &dst.data[i][row * dst.linesizes[i]],
+                                &src.data[i][row * src.linesizes[i]]);
+  }
+
+  // RGBA8 can not be converted to YUV
+  munit_assert_false(sve4_pixconv_supported(
+      fmt, sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8)));
+
+  image_free(&src);
+  image_free(&dst);
+  return MUNIT_OK;
+}
+
+// tiling must not change the result, including odd heights where the last
+// chroma row belongs to a single luma row, and the narrower last column of
+// tiles. the reference converts narrow strips, which are never split.
+static MunitResult test_threads(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  enum { BIG_WIDTH = 2501, BIG_HEIGHT = 515, STRIP_WIDTH = 64 };
+  sve4_pixfmt_t yuv = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_YUV420P);
+  sve4_pixfmt_t rgba = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8);
+  sve4_thread_pool_t* pool = sve4_thread_pool_create(NULL, 3);
+  munit_assert_not_null(pool);
+
+  image_t src;
+  image_t expected;
+  image_t actual;
+  image_t copy;
+  image_alloc(&src, yuv, BIG_WIDTH, BIG_HEIGHT);
+  image_alloc(&expected, rgba, BIG_WIDTH, BIG_HEIGHT);
+  image_alloc(&actual, rgba, BIG_WIDTH, BIG_HEIGHT);
+  image_alloc(&copy, yuv, BIG_WIDTH, BIG_HEIGHT);
+  image_fill_random(&src, yuv, BIG_HEIGHT, 0xff);
+
+  for (size_t x = 0; x < BIG_WIDTH; x += STRIP_WIDTH) {
+    const uint8_t* src_data[] = {&src.data[0][x], &src.data[1][x / 2],
+                                 &src.data[2][x / 2]};
+    uint8_t* dst_data[] = {&expected.data[0][x * 4], NULL, NULL};
+    munit_assert_true(sve4_pixconv_convert(
+        rgba, dst_data, expected.linesizes, yuv, src_data, src.linesizes,
+        sve4_min((size_t)STRIP_WIDTH, BIG_WIDTH - x), BIG_HEIGHT, NULL));
+  }
+  munit_assert_true(convert(rgba, &actual, yuv, &src, BIG_WIDTH, BIG_HEIGHT,
+                            (sve4_pixconv_options_t){.thread_pool = pool}));
+  munit_assert_memory_equal(expected.linesizes[0] * BIG_HEIGHT,
+                            actual.data[0], expected.data[0]);
+
+  munit_assert_true(convert(yuv, &copy, yuv, &src, BIG_WIDTH, BIG_HEIGHT,
+                            (sve4_pixconv_options_t){.thread_pool = pool}));
+  for (size_t i = 0; i < 3; ++i) {
+    size_t width = sve4_pixfmt_linesize(yuv, i, BIG_WIDTH, 1);
+    for (size_t row = 0; row < sve4_pixfmt_plane_height(yuv, i, BIG_HEIGHT);
+         ++row)
+      munit_assert_memory_equal(width, &copy.data[i][row * copy.linesizes[i]],
+                                &src.data[i][row * src.linesizes[i]]);
+  }
+
+  image_free(&src);
+  image_free(&expected);
+  image_free(&actual);
+  image_free(&copy);
+  sve4_thread_pool_destroy(pool);
+  return MUNIT_OK;
+}
+
+static MunitResult test_scale(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  enum { DST_WIDTH = 150, DST_HEIGHT = 31 };
+  sve4_pixfmt_t yuv = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_NV12);
+  sve4_pixfmt_t rgba = sve4_pixfmt_default(SVE4_PIXFMT_DEFAULT_RGBA8);
+  sve4_thread_pool_t* pool = sve4_thread_pool_create(NULL, 2);
+  munit_assert_not_null(pool);
+
+  image_t src;
+  image_t single;
+  image_t threaded;
+  image_alloc(&src, yuv, WIDTH, HEIGHT);
+  image_alloc(&single, rgba, DST_WIDTH, DST_HEIGHT);
+  image_alloc(&threaded, rgba, DST_WIDTH, DST_HEIGHT);
+
+  // a horizontal luma ramp from 16 to 235 with neutral chroma
+  for (size_t row = 0; row < HEIGHT; ++row)
+    for (size_t x = 0; x < WIDTH; ++x)
+      src.data[0][row * src.linesizes[0] + x] =
+          (uint8_t)(16 + x * 219 / (WIDTH - 1));
+  memset(src.data[1], 128, src.linesizes[1] * ((HEIGHT + 1) / 2));
+
+  const uint8_t* src_data[] = {src.data[0], src.data[1], NULL};
+  sve4_pixconv_options_t options = {.matrix = SVE4_PIXCONV_MATRIX_BT709};
+  munit_assert_true(sve4_pixconv_scale(
+      rgba, single.data, single.linesizes, DST_WIDTH, DST_HEIGHT, yuv,
+      src_data, src.linesizes, WIDTH, HEIGHT, &options));
+  options.thread_pool = pool;
+  munit_assert_true(sve4_pixconv_scale(
+      rgba, threaded.data, threaded.linesizes, DST_WIDTH, DST_HEIGHT, yuv,
+      src_data, src.linesizes, WIDTH, HEIGHT, &options));
+
+  for (size_t row = 0; row < DST_HEIGHT; ++row) {
+    const uint8_t* line = &single.data[0][row * single.linesizes[0]];
+    munit_assert_memory_equal(DST_WIDTH * 4, line,
+                              &threaded.data[0][row * threaded.linesizes[0]]);
+    // gray, monotonic, and spanning the whole range
+    munit_assert_int(line[0], <=, 1);
+    munit_assert_int(line[(DST_WIDTH - 1) * 4], >=, 254);
+    for (size_t x = 0; x < DST_WIDTH; ++x) {
+      munit_assert_int(abs(line[x * 4] - line[x * 4 + 1]), <=, 1);
+      munit_assert_int(abs(line[x * 4] - line[x * 4 + 2]), <=, 1);
+      if (x > 0)
+        munit_assert_int(line[x * 4], >=, line[(x - 1) * 4]);
+    }
+  }
+
+  // chunks of a strong downscale are shortened to fit their source span,
+  // the ramp must stay monotonic across them
+  enum { WIDE_WIDTH = 4000, NARROW_WIDTH = 97 };
+  uint8_t* wide[] = {munit_malloc(2 * WIDE_WIDTH), munit_malloc(WIDE_WIDTH),
+                     NULL};
+  for (size_t x = 0; x < WIDE_WIDTH; ++x) {
+    wide[0][x] = (uint8_t)(16 + x * 219 / (WIDE_WIDTH - 1));
+    wide[0][WIDE_WIDTH + x] = wide[0][x];
+  }
+  memset(wide[1], 128, WIDE_WIDTH);
+  const uint8_t* wide_data[] = {wide[0], wide[1], NULL};
+  const size_t wide_linesizes[] = {WIDE_WIDTH, WIDE_WIDTH, 0};
+  munit_assert_true(sve4_pixconv_scale(
+      rgba, single.data, single.linesizes, NARROW_WIDTH, 1, yuv, wide_data,
+      wide_linesizes, WIDE_WIDTH, 2, &options));
+  for (size_t x = 1; x < NARROW_WIDTH; ++x)
+    munit_assert_int(single.data[0][x * 4], >=, single.data[0][(x - 1) * 4]);
+  munit_assert_int(single.data[0][0], <=, 2);
+  munit_assert_int(single.data[0][(NARROW_WIDTH - 1) * 4], >=, 253);
+  free(wide[0]);
+  free(wide[1]);
+
+  // only YUV sources can be scaled
+  const uint8_t* rgba_data[] = {single.data[0], NULL, NULL};
+  munit_assert_false(sve4_pixconv_scale(
+      rgba, threaded.data, threaded.linesizes, DST_WIDTH, DST_HEIGHT, rgba,
+      rgba_data, single.linesizes, DST_WIDTH / 2, DST_HEIGHT, NULL));
+
+  image_free(&src);
+  image_free(&single);
+  image_free(&threaded);
+  sve4_thread_pool_destroy(pool);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {"/known_values", test_known_values, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/layouts", test_layouts, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/backends", test_backends, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/copy", test_copy, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/threads", test_threads, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/scale", test_scale, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {
+    "/pixconv", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,237 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libsve4_utils/allocator.h>
+#include <libsve4_utils/pool.h>
+#include <libsve4_utils/stats_allocator.h>
+#include <munit.h>
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+enum { NUM_THREADS = 4, NUM_OBJECTS = 2000 };
+
+static MunitResult test_size_classes(const MunitParameter params[],
+                                     void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t pool;
+  munit_assert_true(sve4_allocator_pool_init(&pool, NULL));
+
+  for (size_t alignment = 1; alignment <= SVE4_POOL_MAX_ALIGN;
+       alignment *= 2) {
+    for (size_t size = 0; size <= SVE4_POOL_MAX_SIZE; size += 7) {
+      uint8_t* ptr = sve4_aligned_alloc(&pool, size, alignment);
+      munit_assert_not_null(ptr);
+      munit_assert_size((uintptr_t)ptr % alignment, ==, 0);
+      memset(ptr, 0xAB, size);
+      sve4_aligned_free(&pool, ptr, alignment);
+    }
+  }
+
+  sve4_allocator_pool_destroy(&pool);
+  return MUNIT_OK;
+}
+
+static MunitResult test_reuse(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t pool;
+  munit_assert_true(sve4_allocator_pool_init(&pool, NULL));
+
+  void* first = sve4_malloc(&pool, 40);
+  munit_assert_not_null(first);
+  sve4_free(&pool, first);
+  // same size class, straight from the thread cache
+  void* second = sve4_malloc(&pool, 48);
+  munit_assert_ptr_equal(first, second);
+
+  uint8_t* zeroed = sve4_calloc(&pool, 48);
+  munit_assert_not_null(zeroed);
+  for (size_t i = 0; i < 48; ++i)
+    munit_assert_uint8(zeroed[i], ==, 0);
+
+  sve4_free(&pool, second);
+  sve4_free(&pool, zeroed);
+  sve4_allocator_pool_destroy(&pool);
+  return MUNIT_OK;
+}
+
+static MunitResult test_grow(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t pool;
+  munit_assert_true(sve4_allocator_pool_init(&pool, NULL));
+
+  uint8_t* ptr = sve4_malloc(&pool, 20);
+  munit_assert_not_null(ptr);
+  for (size_t i = 0; i < 20; ++i)
+    ptr[i] = (uint8_t)i;
+
+  // still fits in the 32 byte class
+  munit_assert_ptr_equal(sve4_realloc(&pool, ptr, 20, 32), ptr);
+
+  // small to large and back
+  size_t sizes[] = {100, 3000, 12000, 100000, 1000, 16};
+  size_t old_size = 32;
+  for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i) {
+    ptr = sve4_realloc(&pool, ptr, old_size, sizes[i]);
+    munit_assert_not_null(ptr);
+    for (size_t j = 0; j < 16; ++j)
+      munit_assert_uint8(ptr[j], ==, (uint8_t)j);
+    old_size = sizes[i];
+  }
+  sve4_free(&pool, ptr);
+
+  uint8_t* large = sve4_aligned_alloc(&pool, 10000, 4096);
+  munit_assert_not_null(large);
+  munit_assert_size((uintptr_t)large % 4096, ==, 0);
+  memset(large, 0, 10000);
+  sve4_aligned_free(&pool, large, 4096);
+
+  sve4_allocator_pool_destroy(&pool);
+  return MUNIT_OK;
+}
+
+typedef struct {
+  sve4_allocator_t* pool;
+  // objects allocated by this thread, freed by the next one
+  void* objects[NUM_OBJECTS];
+} worker_t;
+
+static int allocate_objects(void* arg) {
+  worker_t* worker = arg;
+  for (size_t i = 0; i < NUM_OBJECTS; ++i) {
+    size_t size = 8 + i % 300;
+    worker->objects[i] = sve4_malloc(worker->pool, size);
+    if (!worker->objects[i])
+      return 1;
+    memset(worker->objects[i], (int)(i & 0xFF), size);
+  }
+  return 0;
+}
+
+static int free_objects(void* arg) {
+  worker_t* worker = arg;
+  for (size_t i = 0; i < NUM_OBJECTS; ++i) {
+    const uint8_t* object = worker->objects[i];
+    if (object[0] != (uint8_t)(i & 0xFF))
+      return 1;
+    sve4_free(worker->pool, worker->objects[i]);
+  }
+  return 0;
+}
+
+static MunitResult test_threads(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t pool;
+  munit_assert_true(sve4_allocator_pool_init(&pool, NULL));
+
+  worker_t* workers = munit_malloc(NUM_THREADS * sizeof(worker_t));
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  thrd_t threads[NUM_THREADS];
+  int ret = 0;
+  for (size_t round = 0; round < 3; ++round) {
+    for (size_t i = 0; i < NUM_THREADS; ++i) {
+      workers[i].pool = &pool;
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      munit_assert_int(thrd_create(&threads[i], allocate_objects, &workers[i]),
+                       ==, thrd_success);
+    }
+    for (size_t i = 0; i < NUM_THREADS; ++i) {
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      thrd_join(threads[i], &ret);
+      munit_assert_int(ret, ==, 0);
+    }
+
+    // blocks are freed on other threads than the ones allocating them
+    for (size_t i = 0; i < NUM_THREADS; ++i)
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      munit_assert_int(thrd_create(&threads[i], free_objects,
+                                   &workers[(i + 1) % NUM_THREADS]),
+                       ==, thrd_success);
+    for (size_t i = 0; i < NUM_THREADS; ++i) {
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      thrd_join(threads[i], &ret);
+      munit_assert_int(ret, ==, 0);
+    }
+  }
+
+  free(workers);
+  sve4_allocator_pool_destroy(&pool);
+  return MUNIT_OK;
+}
+
+static MunitResult test_slabs(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t backing;
+  munit_assert_true(sve4_allocator_stats_init(&backing, NULL, "backing"));
+  sve4_allocator_t pool;
+  munit_assert_true(sve4_allocator_pool_init(&pool, &backing));
+
+  // one block of each of the first 16 size classes, each in its own slab
+  enum { NUM_CLASSES = 16 };
+  void* ptrs[NUM_CLASSES];
+  ptrs[0] = sve4_malloc(&pool, 16);
+  munit_assert_not_null(ptrs[0]);
+  size_t num_allocs = sve4_allocator_stats_get(&backing).num_allocs;
+  for (size_t i = 1; i < NUM_CLASSES; ++i) {
+    ptrs[i] = sve4_malloc(&pool, i < 8 ? (i + 1) * 16 : (i - 6) * 128);
+    munit_assert_not_null(ptrs[i]);
+  }
+  // the slabs come from the chunk allocated for the first one
+  munit_assert_size(sve4_allocator_stats_get(&backing).num_allocs, ==,
+                    num_allocs);
+
+  for (size_t i = 0; i < NUM_CLASSES; ++i)
+    sve4_free(&pool, ptrs[i]);
+  sve4_allocator_pool_destroy(&pool);
+  munit_assert_size(sve4_allocator_stats_get(&backing).live_bytes, ==, 0);
+  sve4_allocator_stats_destroy(&backing);
+  return MUNIT_OK;
+}
+
+static MunitResult test_shared(const MunitParameter params[],
+                               void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t* pool = sve4_allocator_pool_shared();
+  munit_assert_not_null(pool);
+  munit_assert_ptr_equal(sve4_allocator_pool_shared(), pool);
+
+  void* first = sve4_malloc(pool, 100);
+  munit_assert_not_null(first);
+  sve4_free(pool, first);
+  munit_assert_ptr_equal(sve4_malloc(pool, 100), first);
+  sve4_free(pool, first);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {"/size_classes", test_size_classes, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/reuse", test_reuse, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/grow", test_grow, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/threads", test_threads, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/slabs", test_slabs, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/shared", test_shared, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {
+    "/pool", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
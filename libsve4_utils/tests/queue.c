@@ -0,0 +1,209 @@
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <libsve4_utils/queue.h>
+#include <munit.h>
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+enum { NUM_PRODUCERS = 4, NUM_CONSUMERS = 4, ITEMS_PER_PRODUCER = 20000 };
+
+typedef struct {
+  uint32_t producer;
+  uint32_t index;
+  // makes the element larger than a pointer
+  uint64_t padding[3];
+} item_t;
+
+static MunitResult test_fifo(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_queue_t* queue = sve4_queue_create(NULL, 5, sizeof(item_t));
+  munit_assert_not_null(queue);
+  munit_assert_size(sve4_queue_capacity(queue), ==, 8);
+
+  item_t item = {0};
+  munit_assert_false(sve4_queue_try_pop(queue, &item));
+  // wrap around a few times
+  for (uint32_t lap = 0; lap < 3; ++lap) {
+    for (uint32_t i = 0; i < 8; ++i) {
+      item = (item_t){.producer = lap, .index = i};
+      munit_assert_true(sve4_queue_try_push(queue, &item));
+    }
+    munit_assert_false(sve4_queue_try_push(queue, &item));
+    for (uint32_t i = 0; i < 8; ++i) {
+      munit_assert_true(sve4_queue_try_pop(queue, &item));
+      munit_assert_uint32(item.producer, ==, lap);
+      munit_assert_uint32(item.index, ==, i);
+    }
+    munit_assert_false(sve4_queue_try_pop(queue, &item));
+  }
+
+  sve4_queue_destroy(queue);
+  return MUNIT_OK;
+}
+
+static MunitResult test_timeout_close(const MunitParameter params[],
+                                      void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_queue_t* queue = sve4_queue_create(NULL, 2, sizeof(int));
+  munit_assert_not_null(queue);
+
+  struct timespec deadline;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  timespec_get(&deadline, TIME_UTC);
+  int value = 0;
+  munit_assert_int(sve4_queue_pop(queue, &value, &deadline), ==,
+                   SVE4_QUEUE_TIMEOUT);
+
+  for (int i = 0; i < 2; ++i)
+    munit_assert_int(sve4_queue_push(queue, &i, NULL), ==, SVE4_QUEUE_OK);
+  munit_assert_int(sve4_queue_push(queue, &value, &deadline), ==,
+                   SVE4_QUEUE_TIMEOUT);
+
+  // pops drain the queue before reporting it closed
+  sve4_queue_close(queue);
+  munit_assert_int(sve4_queue_push(queue, &value, NULL), ==,
+                   SVE4_QUEUE_CLOSED);
+  for (int i = 0; i < 2; ++i) {
+    munit_assert_int(sve4_queue_pop(queue, &value, NULL), ==, SVE4_QUEUE_OK);
+    munit_assert_int(value, ==, i);
+  }
+  munit_assert_int(sve4_queue_pop(queue, &value, NULL), ==, SVE4_QUEUE_CLOSED);
+
+  sve4_queue_destroy(queue);
+  return MUNIT_OK;
+}
+
+typedef struct {
+  sve4_queue_t* queue;
+  uint32_t producer;
+  // filled in by consumers
+  atomic_size_t received;
+  atomic_uint_fast64_t checksum;
+  bool in_order;
+} thread_data_t;
+
+static int producer_main(void* arg) {
+  thread_data_t* data = arg;
+  for (uint32_t i = 0; i < ITEMS_PER_PRODUCER; ++i) {
+    item_t item = {.producer = data->producer, .index = i};
+    if (sve4_queue_push(data->queue, &item, NULL) != SVE4_QUEUE_OK)
+      return 1;
+  }
+  return 0;
+}
+
+static int consumer_main(void* arg) {
+  thread_data_t* data = arg;
+  uint32_t last_index[NUM_PRODUCERS];
+  bool seen[NUM_PRODUCERS] = {false};
+  item_t item;
+  while (sve4_queue_pop(data->queue, &item, NULL) == SVE4_QUEUE_OK) {
+    // items of one producer arrive in order at every consumer
+    if (item.producer >= NUM_PRODUCERS ||
+        (seen[item.producer] && item.index <= last_index[item.producer]))
+      data->in_order = false;
+    seen[item.producer] = true;
+    last_index[item.producer] = item.index;
+    atomic_fetch_add(&data->received, 1);
+    atomic_fetch_add(&data->checksum, item.index + 1);
+  }
+  return 0;
+}
+
+static MunitResult test_threads(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  // small enough for both sides to block regularly
+  sve4_queue_t* queue = sve4_queue_create(NULL, 16, sizeof(item_t));
+  munit_assert_not_null(queue);
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  thrd_t producers[NUM_PRODUCERS];
+  thrd_t consumers[NUM_CONSUMERS];
+  thread_data_t producer_data[NUM_PRODUCERS];
+  thread_data_t consumer_data[NUM_CONSUMERS];
+  for (uint32_t i = 0; i < NUM_CONSUMERS; ++i) {
+    consumer_data[i] = (thread_data_t){.queue = queue, .in_order = true};
+    munit_assert_int(thrd_create(&consumers[i], consumer_main,
+                                 &consumer_data[i]),
+                     ==, thrd_success);
+  }
+  for (uint32_t i = 0; i < NUM_PRODUCERS; ++i) {
+    producer_data[i] = (thread_data_t){.queue = queue, .producer = i};
+    munit_assert_int(thrd_create(&producers[i], producer_main,
+                                 &producer_data[i]),
+                     ==, thrd_success);
+  }
+
+  for (size_t i = 0; i < NUM_PRODUCERS; ++i) {
+    int result = 1;
+    thrd_join(producers[i], &result);
+    munit_assert_int(result, ==, 0);
+  }
+  sve4_queue_close(queue);
+  size_t received = 0;
+  uint64_t checksum = 0;
+  for (size_t i = 0; i < NUM_CONSUMERS; ++i) {
+    thrd_join(consumers[i], NULL);
+    munit_assert_true(consumer_data[i].in_order);
+    received += atomic_load(&consumer_data[i].received);
+    checksum += atomic_load(&consumer_data[i].checksum);
+  }
+  // NOLINTEND(misc-include-cleaner)
+
+  munit_assert_size(received, ==, (size_t)NUM_PRODUCERS * ITEMS_PER_PRODUCER);
+  uint64_t expected = (uint64_t)ITEMS_PER_PRODUCER * (ITEMS_PER_PRODUCER + 1) /
+                      2 * NUM_PRODUCERS;
+  munit_assert_uint64(checksum, ==, expected);
+
+  sve4_queue_destroy(queue);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {
+        "/fifo",
+        test_fifo,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/timeout_close",
+        test_timeout_close,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {
+        "/threads",
+        test_threads,
+        NULL,
+        NULL,
+        MUNIT_TEST_OPTION_NONE,
+        NULL,
+    },
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL} /* Mark the end of the array */
+};
+
+static const MunitSuite test_suite = {
+    "/queue", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,182 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <libsve4_utils/allocator.h>
+#include <libsve4_utils/stats_allocator.h>
+#include <munit.h>
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+enum { NUM_THREADS = 4, NUM_OBJECTS = 1000 };
+
+static MunitResult test_counters(const MunitParameter params[],
+                                 void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t alloc;
+  munit_assert_true(sve4_allocator_stats_init(&alloc, NULL, "test"));
+
+  void* small = sve4_malloc(&alloc, 100);
+  uint8_t* zeroed = sve4_calloc(&alloc, 1000);
+  munit_assert_not_null(small);
+  munit_assert_not_null(zeroed);
+  for (size_t i = 0; i < 1000; ++i)
+    munit_assert_uint8(zeroed[i], ==, 0);
+
+  sve4_allocator_stats_t stats = sve4_allocator_stats_get(&alloc);
+  munit_assert_string_equal(stats.tag, "test");
+  munit_assert_size(stats.live_bytes, ==, 1100);
+  munit_assert_size(stats.peak_bytes, ==, 1100);
+  munit_assert_size(stats.total_bytes, ==, 1100);
+  munit_assert_size(stats.num_allocs, ==, 2);
+  munit_assert_size(stats.num_frees, ==, 0);
+  // 100 is in [64, 128), 1000 in [512, 1024)
+  munit_assert_size(stats.histogram[6], ==, 1);
+  munit_assert_size(stats.histogram[9], ==, 1);
+
+  sve4_free(&alloc, small);
+  sve4_free(&alloc, zeroed);
+  stats = sve4_allocator_stats_get(&alloc);
+  munit_assert_size(stats.live_bytes, ==, 0);
+  munit_assert_size(stats.peak_bytes, ==, 1100);
+  munit_assert_size(stats.num_frees, ==, 2);
+
+  // large allocations are accounted for right away
+  void* large = sve4_malloc(&alloc, 1 << 20);
+  sve4_free(&alloc, large);
+  stats = sve4_allocator_stats_get(&alloc);
+  munit_assert_size(stats.peak_bytes, >=, 1 << 20);
+
+  sve4_allocator_stats_destroy(&alloc);
+  return MUNIT_OK;
+}
+
+static MunitResult test_peak(const MunitParameter params[], void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t alloc;
+  munit_assert_true(sve4_allocator_stats_init(&alloc, NULL, "test"));
+
+  // a peak of small allocations that is gone before anyone looks is still
+  // recorded exactly
+  enum { NUM_SMALL = 8 };
+  void* ptrs[NUM_SMALL];
+  for (size_t i = 0; i < NUM_SMALL; ++i) {
+    ptrs[i] = sve4_malloc(&alloc, 1000);
+    munit_assert_not_null(ptrs[i]);
+  }
+  for (size_t i = 0; i < NUM_SMALL; ++i)
+    sve4_free(&alloc, ptrs[i]);
+  void* after = sve4_malloc(&alloc, 500);
+  munit_assert_not_null(after);
+
+  sve4_allocator_stats_t stats = sve4_allocator_stats_get(&alloc);
+  munit_assert_size(stats.live_bytes, ==, 500);
+  munit_assert_size(stats.peak_bytes, ==, NUM_SMALL * 1000);
+
+  sve4_free(&alloc, after);
+  sve4_allocator_stats_destroy(&alloc);
+  return MUNIT_OK;
+}
+
+static MunitResult test_grow_aligned(const MunitParameter params[],
+                                     void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t alloc;
+  munit_assert_true(sve4_allocator_stats_init(&alloc, NULL, "test"));
+
+  uint8_t* ptr = sve4_aligned_alloc(&alloc, 256, 256);
+  munit_assert_not_null(ptr);
+  munit_assert_size((uintptr_t)ptr % 256, ==, 0);
+  for (size_t i = 0; i < 256; ++i)
+    ptr[i] = (uint8_t)i;
+
+  ptr = sve4_aligned_realloc(&alloc, ptr, 256, 1024, 256);
+  munit_assert_not_null(ptr);
+  munit_assert_size((uintptr_t)ptr % 256, ==, 0);
+  // a different alignment moves the allocation
+  ptr = sve4_realloc(&alloc, ptr, 1024, 512);
+  munit_assert_not_null(ptr);
+  for (size_t i = 0; i < 256; ++i)
+    munit_assert_uint8(ptr[i], ==, (uint8_t)i);
+
+  sve4_allocator_stats_t stats = sve4_allocator_stats_get(&alloc);
+  munit_assert_size(stats.live_bytes, ==, 512);
+  munit_assert_size(stats.total_bytes, ==, 1024 + 512);
+  munit_assert_size(stats.num_allocs, ==, 2);
+  munit_assert_size(stats.num_grows, ==, 1);
+  munit_assert_size(stats.num_frees, ==, 1);
+
+  sve4_free(&alloc, ptr);
+  munit_assert_size(sve4_allocator_stats_get(&alloc).live_bytes, ==, 0);
+  sve4_allocator_stats_destroy(&alloc);
+  return MUNIT_OK;
+}
+
+static int thread_main(void* arg) {
+  sve4_allocator_t* alloc = arg;
+  void* ptrs[NUM_OBJECTS];
+  for (size_t i = 0; i < NUM_OBJECTS; ++i) {
+    ptrs[i] = sve4_malloc(alloc, i + 1);
+    if (!ptrs[i])
+      return 1;
+  }
+  for (size_t i = 0; i < NUM_OBJECTS; ++i)
+    sve4_free(alloc, ptrs[i]);
+  return 0;
+}
+
+static MunitResult test_threads(const MunitParameter params[],
+                                void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_allocator_t alloc;
+  munit_assert_true(sve4_allocator_stats_init(&alloc, NULL, "test"));
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  thrd_t threads[NUM_THREADS];
+  for (size_t i = 0; i < NUM_THREADS; ++i)
+    munit_assert_int(thrd_create(&threads[i], thread_main, &alloc), ==,
+                     thrd_success);
+  for (size_t i = 0; i < NUM_THREADS; ++i) {
+    int result = 0;
+    munit_assert_int(thrd_join(threads[i], &result), ==, thrd_success);
+    munit_assert_int(result, ==, 0);
+  }
+  // NOLINTEND(misc-include-cleaner)
+
+  sve4_allocator_stats_t stats = sve4_allocator_stats_get(&alloc);
+  munit_assert_size(stats.live_bytes, ==, 0);
+  munit_assert_size(stats.num_allocs, ==, NUM_THREADS * NUM_OBJECTS);
+  munit_assert_size(stats.num_frees, ==, NUM_THREADS * NUM_OBJECTS);
+  munit_assert_size(stats.total_bytes, ==,
+                    NUM_THREADS * NUM_OBJECTS * (NUM_OBJECTS + 1) / 2);
+  // every thread held all of its objects at once
+  munit_assert_size(stats.peak_bytes, >=, NUM_OBJECTS * (NUM_OBJECTS + 1) / 2);
+
+  sve4_allocator_stats_destroy(&alloc);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {"/counters", test_counters, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/peak", test_peak, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/grow_aligned", test_grow_aligned, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/threads", test_threads, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {
+    "/stats_allocator", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
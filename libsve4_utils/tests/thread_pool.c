@@ -0,0 +1,124 @@
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <libsve4_utils/thread_pool.h>
+#include <munit.h>
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+enum { COUNT = 100003, NUM_SUBMITTERS = 4 };
+
+typedef struct {
+  atomic_uint visits[COUNT];
+  atomic_size_t max_range;
+} visit_data_t;
+
+static void visit(void* user_data, size_t begin, size_t end) {
+  visit_data_t* data = user_data;
+  munit_assert_size(begin, <, end);
+  size_t range = end - begin;
+  size_t max_range = atomic_load(&data->max_range);
+  while (range > max_range &&
+         !atomic_compare_exchange_weak(&data->max_range, &max_range, range))
+    ;
+  for (size_t i = begin; i < end; ++i)
+    atomic_fetch_add(&data->visits[i], 1);
+}
+
+static void check_visits(visit_data_t* data, size_t grain) {
+  for (size_t i = 0; i < COUNT; ++i)
+    munit_assert_uint(atomic_load(&data->visits[i]), ==, 1);
+  munit_assert_size(atomic_load(&data->max_range), <=, grain);
+}
+
+static MunitResult test_parallel_for(const MunitParameter params[],
+                                     void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_thread_pool_t* pools[] = {
+      NULL,
+      sve4_thread_pool_create(NULL, 0),
+      sve4_thread_pool_create(NULL, 3),
+      sve4_thread_pool_shared(),
+  };
+  munit_assert_not_null(pools[1]);
+  munit_assert_not_null(pools[2]);
+  munit_assert_size(sve4_thread_pool_num_workers(pools[2]), ==, 3);
+
+  const size_t grains[] = {0, 1, 7, 4096, COUNT, 2 * COUNT};
+  for (size_t p = 0; p < sizeof pools / sizeof pools[0]; ++p) {
+    for (size_t g = 0; g < sizeof grains / sizeof grains[0]; ++g) {
+      visit_data_t* data = munit_malloc(sizeof(visit_data_t));
+      sve4_thread_pool_parallel_for(pools[p], COUNT, grains[g], visit, data);
+      check_visits(data, grains[g] ? grains[g] : 1);
+      free(data);
+    }
+  }
+
+  // nothing to do
+  sve4_thread_pool_parallel_for(pools[2], 0, 1, visit, NULL);
+
+  sve4_thread_pool_destroy(pools[1]);
+  sve4_thread_pool_destroy(pools[2]);
+  return MUNIT_OK;
+}
+
+typedef struct {
+  sve4_thread_pool_t* pool;
+  visit_data_t* data;
+} submitter_t;
+
+static int submit(void* arg) {
+  submitter_t* submitter = arg;
+  sve4_thread_pool_parallel_for(submitter->pool, COUNT, 64, visit,
+                                submitter->data);
+  return 0;
+}
+
+static MunitResult test_concurrent_submitters(const MunitParameter params[],
+                                              void* user_data) {
+  (void)params;
+  (void)user_data;
+
+  sve4_thread_pool_t* pool = sve4_thread_pool_create(NULL, 2);
+  munit_assert_not_null(pool);
+
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  thrd_t threads[NUM_SUBMITTERS];
+  submitter_t submitters[NUM_SUBMITTERS];
+  for (size_t i = 0; i < NUM_SUBMITTERS; ++i) {
+    submitters[i] = (submitter_t){pool, munit_malloc(sizeof(visit_data_t))};
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    munit_assert_int(thrd_create(&threads[i], submit, &submitters[i]), ==,
+                     thrd_success);
+  }
+
+  for (size_t i = 0; i < NUM_SUBMITTERS; ++i) {
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    thrd_join(threads[i], NULL);
+    check_visits(submitters[i].data, 64);
+    free(submitters[i].data);
+  }
+
+  sve4_thread_pool_destroy(pool);
+  return MUNIT_OK;
+}
+
+static MunitTest test_suite_tests[] = {
+    {"/parallel_for", test_parallel_for, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/concurrent_submitters", test_concurrent_submitters, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+};
+
+static const MunitSuite test_suite = {
+    "/thread_pool", test_suite_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE,
+};
+
+int main(int argc, char* argv[]) {
+  return munit_suite_main(&test_suite, NULL, argc, argv);
+}
@@ -0,0 +1,243 @@
+#include "thread_pool.h"
+
+#include <assert.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "allocator.h"
+
+// NOLINTNEXTLINE(misc-include-cleaner)
+#include <tinycthread.h>
+
+#if sve4_has_include(<unistd.h>)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+typedef struct job_t {
+  struct job_t* _Nullable next;
+  sve4_parallel_for_fn_t _Nonnull fn;
+  void* _Nullable user_data;
+  size_t count, grain, num_chunks;
+  atomic_size_t next_chunk;
+  // workers currently running chunks of this job, guarded by the pool mutex
+  size_t active_workers;
+  bool queued;
+} job_t;
+
+struct sve4_thread_pool_t {
+  sve4_allocator_t* _Nullable allocator;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_t mutex;
+  // signaled when a job is queued or the pool is shutting down
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_t work_condvar;
+  // signaled when a worker leaves a job
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_t done_condvar;
+  job_t* _Nullable jobs;
+  bool running;
+  size_t num_workers;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  thrd_t workers[];
+};
+
+static void run_chunks(job_t* _Nonnull job) {
+  size_t chunk = 0;
+  while ((chunk = atomic_fetch_add_explicit(&job->next_chunk, 1,
+                                            memory_order_relaxed)) <
+         job->num_chunks) {
+    size_t begin = chunk * job->grain;
+    size_t end = sve4_min(begin + job->grain, job->count);
+    job->fn(job->user_data, begin, end);
+  }
+}
+
+// must be called with the mutex held
+static void dequeue_job(sve4_thread_pool_t* _Nonnull pool,
+                        job_t* _Nonnull job) {
+  if (!job->queued)
+    return;
+  for (job_t** it = &pool->jobs; *it; it = &(*it)->next) {
+    if (*it == job) {
+      *it = job->next;
+      break;
+    }
+  }
+  job->queued = false;
+}
+
+static int worker_main(void* _Nonnull arg) {
+  sve4_thread_pool_t* pool = arg;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_lock(&pool->mutex);
+  while (pool->running) {
+    job_t* job = pool->jobs;
+    if (!job) {
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      cnd_wait(&pool->work_condvar, &pool->mutex);
+      continue;
+    }
+
+    // every chunk is claimed once next_chunk passes num_chunks, so
+    // nobody else has to look at this job anymore
+    if (atomic_load_explicit(&job->next_chunk, memory_order_relaxed) >=
+        job->num_chunks) {
+      dequeue_job(pool, job);
+      continue;
+    }
+
+    ++job->active_workers;
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_unlock(&pool->mutex);
+    run_chunks(job);
+    // NOLINTNEXTLINE(misc-include-cleaner)
+    mtx_lock(&pool->mutex);
+    dequeue_job(pool, job);
+    if (--job->active_workers == 0)
+      // NOLINTNEXTLINE(misc-include-cleaner)
+      cnd_broadcast(&pool->done_condvar);
+  }
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_unlock(&pool->mutex);
+  return 0;
+}
+
+sve4_thread_pool_t* _Nullable sve4_thread_pool_create(
+    sve4_allocator_t* _Nullable allocator, size_t num_workers) {
+  sve4_thread_pool_t* pool = sve4_calloc(
+      allocator, sizeof(sve4_thread_pool_t) + num_workers * sizeof(thrd_t));
+  if (!pool)
+    return NULL;
+
+  pool->allocator = allocator;
+  pool->running = true;
+  // NOLINTBEGIN(misc-include-cleaner)
+  if (mtx_init(&pool->mutex, mtx_plain) != thrd_success)
+    goto fail_mutex;
+  if (cnd_init(&pool->work_condvar) != thrd_success)
+    goto fail_work_condvar;
+  if (cnd_init(&pool->done_condvar) != thrd_success)
+    goto fail_done_condvar;
+
+  for (; pool->num_workers < num_workers; ++pool->num_workers)
+    if (thrd_create(&pool->workers[pool->num_workers], worker_main, pool) !=
+        thrd_success)
+      break;
+  // NOLINTEND(misc-include-cleaner)
+
+  // a pool with fewer workers than requested is still usable
+  return pool;
+
+fail_done_condvar:
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  cnd_destroy(&pool->work_condvar);
+fail_work_condvar:
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  mtx_destroy(&pool->mutex);
+fail_mutex:
+  sve4_free(allocator, pool);
+  return NULL;
+}
+
+void sve4_thread_pool_destroy(sve4_thread_pool_t* _Nullable pool) {
+  if (!pool)
+    return;
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&pool->mutex);
+  assert(!pool->jobs && "thread pool destroyed while in use");
+  pool->running = false;
+  cnd_broadcast(&pool->work_condvar);
+  mtx_unlock(&pool->mutex);
+
+  for (size_t i = 0; i < pool->num_workers; ++i)
+    thrd_join(pool->workers[i], NULL);
+
+  cnd_destroy(&pool->done_condvar);
+  cnd_destroy(&pool->work_condvar);
+  mtx_destroy(&pool->mutex);
+  // NOLINTEND(misc-include-cleaner)
+  sve4_free(pool->allocator, pool);
+}
+
+static size_t num_cpus(void) {
+#if sve4_has_include(<unistd.h>) && defined(_SC_NPROCESSORS_ONLN)
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (size_t)count : 1;
+#elif defined(_WIN32)
+  SYSTEM_INFO info;
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors ? (size_t)info.dwNumberOfProcessors : 1;
+#else
+  return 1;
+#endif
+}
+
+// NOLINTNEXTLINE(cppcoreguidelines-avoid-non-const-global-variables)
+static sve4_thread_pool_t* _Nullable shared_pool = NULL;
+
+static void shared_pool_init(void) {
+  shared_pool = sve4_thread_pool_create(NULL, num_cpus() - 1);
+}
+
+sve4_thread_pool_t* _Nullable sve4_thread_pool_shared(void) {
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  static once_flag once = ONCE_FLAG_INIT;
+  // NOLINTNEXTLINE(misc-include-cleaner)
+  call_once(&once, shared_pool_init);
+  return shared_pool;
+}
+
+size_t sve4_thread_pool_num_workers(const sve4_thread_pool_t* _Nullable pool) {
+  return pool ? pool->num_workers : 0;
+}
+
+void sve4_thread_pool_parallel_for(sve4_thread_pool_t* _Nullable pool,
+                                   size_t count, size_t grain,
+                                   sve4_parallel_for_fn_t _Nonnull fn,
+                                   void* _Nullable user_data) {
+  if (grain == 0)
+    grain = 1;
+  if (count == 0)
+    return;
+
+  job_t job = {
+      .fn = fn,
+      .user_data = user_data,
+      .count = count,
+      .grain = grain,
+      .num_chunks = (count + grain - 1) / grain,
+  };
+  atomic_init(&job.next_chunk, 0);
+
+  if (!pool || pool->num_workers == 0 || job.num_chunks == 1) {
+    run_chunks(&job);
+    return;
+  }
+
+  // NOLINTBEGIN(misc-include-cleaner)
+  mtx_lock(&pool->mutex);
+  job.next = pool->jobs;
+  job.queued = true;
+  pool->jobs = &job;
+  if (job.num_chunks - 1 < pool->num_workers)
+    for (size_t i = 0; i < job.num_chunks - 1; ++i)
+      cnd_signal(&pool->work_condvar);
+  else
+    cnd_broadcast(&pool->work_condvar);
+  mtx_unlock(&pool->mutex);
+
+  run_chunks(&job);
+
+  // job lives on this stack frame, so wait until no worker references it
+  mtx_lock(&pool->mutex);
+  dequeue_job(pool, &job);
+  while (job.active_workers > 0)
+    cnd_wait(&pool->done_condvar, &pool->mutex);
+  mtx_unlock(&pool->mutex);
+  // NOLINTEND(misc-include-cleaner)
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+
+#include "sve4_utils_export.h"
+
+#include "allocator.h"
+#include "defines.h"
+
+// THREAD POOL
+//
+// Fork-join pool for data-parallel work (e.g. converting the rows of a frame).
+// The thread calling sve4_thread_pool_parallel_for() takes part in the work,
+// so a pool with N workers runs on up to N + 1 threads. Several threads may
+// submit work to the same pool concurrently.
+
+typedef struct sve4_thread_pool_t sve4_thread_pool_t;
+
+// processes items [begin, end)
+typedef void (*sve4_parallel_for_fn_t)(void* _Nullable user_data, size_t begin,
+                                       size_t end);
+
+SVE4_UTILS_EXPORT
+sve4_thread_pool_t* _Nullable sve4_thread_pool_create(
+    sve4_allocator_t* _Nullable allocator, size_t num_workers);
+SVE4_UTILS_EXPORT
+void sve4_thread_pool_destroy(sve4_thread_pool_t* _Nullable pool);
+
+// process-wide pool with one worker per online CPU (minus the calling
+// thread), created on first use and never destroyed. returns NULL if the pool
+// could not be created, which sve4_thread_pool_parallel_for() accepts.
+SVE4_UTILS_EXPORT
+sve4_thread_pool_t* _Nullable sve4_thread_pool_shared(void);
+
+SVE4_UTILS_EXPORT
+size_t sve4_thread_pool_num_workers(const sve4_thread_pool_t* _Nullable pool);
+
+// calls fn on consecutive ranges of at most grain items covering
+// [0, count), and returns once all of them are done. a NULL pool runs
+// everything on the calling thread.
+SVE4_UTILS_EXPORT
+void sve4_thread_pool_parallel_for(sve4_thread_pool_t* _Nullable pool,
+                                   size_t count, size_t grain,
+                                   sve4_parallel_for_fn_t _Nonnull fn,
+                                   void* _Nullable user_data);